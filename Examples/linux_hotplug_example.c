@@ -0,0 +1,90 @@
+/*
+* Shows how to use the Linux serial hot-plug monitor to react to a sensor
+* being unplugged/replugged immediately instead of waiting on read timeouts.
+*/
+
+#include "tss/com/serial.h"
+#include "tss/api/sensor.h"
+#include "tss/sys/time.h"
+#include "tss/errors.h"
+
+#include <stdio.h>
+
+struct HotplugState {
+    struct SerialComClass *ser;
+    TSS_Sensor *sensor;
+    bool connected;
+};
+
+static void onHotplugEvent(uint8_t event, uint8_t port, const char *name, void *user_data)
+{
+    struct HotplugState *state = user_data;
+
+    if(event == SER_HOTPLUG_REMOVE && state->connected && port == state->ser->port.port) {
+        printf("Sensor disconnected from %s\n", name);
+        //Close the port so the next API call on the sensor will reconnect it,
+        //and mark dirty since the sensor may have reset.
+        tss_com_close(state->sensor->com);
+        sensorMarkSettingsDirty(state->sensor);
+        state->connected = false;
+    }
+    else if(event == SER_HOTPLUG_ADD && !state->connected) {
+        //Any new port may be the sensor coming back. Reconnect tries the likely port first
+        printf("Port %s added, attempting reconnect\n", name);
+        if(sensorReconnect(state->sensor, 2000) == TSS_SUCCESS) {
+            printf("Sensor reconnected\n");
+            state->connected = true;
+        }
+    }
+}
+
+int main(void) {
+    int err;
+    struct SerialComClass ser;
+    struct SerialHotplugMonitor monitor;
+    struct TSS_Com_Class *com;
+    struct TSS_Sensor sensor;
+
+    err = serial_com_auto_detect((struct TSS_Com_Class*)&ser, NULL, NULL);
+    if(err != TSS_AUTO_DETECT_SUCCESS) {
+        printf("Failed to detect com port\n");
+        return -1;
+    }
+
+    com = (struct TSS_Com_Class*) &ser;
+
+    if(tss_com_open(com)) {
+        printf("Failed to open port.\r\n");
+        return -1;
+    }
+
+    tssCreateSensor(&sensor, com);
+    err = tssInitSensor(&sensor);
+    if(err) {
+        printf("Failed to initialize sensor: %d\n", err);
+        return -1;
+    }
+
+    if(serHotplugOpen(&monitor)) {
+        printf("Failed to open hot-plug monitor\n");
+        return -1;
+    }
+
+    struct HotplugState state = {
+        .ser = &ser,
+        .sensor = &sensor,
+        .connected = true
+    };
+
+    //monitor.fd can instead be added to an existing poll/epoll loop
+    printf("Unplug and replug the sensor, running for 30 seconds\n");
+    tss_time_t start_time = tssTimeGet();
+    while(tssTimeDiff(start_time) < 30000) {
+        serHotplugUpdate(&monitor, 100, onHotplugEvent, &state);
+    }
+
+    serHotplugClose(&monitor);
+    sensorCleanup(&sensor);
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+* Shows how to run several sensors on one SPI bus from a single thread.
+* Each sensor has its own CS line, and optionally its own Data Available line
+* so the bus only reads from sensors that actually have data.
+*/
+
+#include "tss/com/spi.h"
+#include "tss/api/sensor.h"
+#include "tss/sys/time.h"
+
+#include <stdio.h>
+
+#define SPI_DEVICE "/dev/spidev0.0"
+#define GPIO_CHIP "/dev/gpiochip0"
+#define NUM_SENSORS 2
+
+//If setting up the IRQ pins for use, make sure that the setting
+//pin_mode0 is set to 8 (TransactionIRQ mode) on every sensor.
+static const unsigned int cs_lines[NUM_SENSORS] = { 25, 24 };
+static const int data_available_lines[NUM_SENSORS] = { -1, -1 };
+
+static enum TSS_DataCallbackState onStreamingPacket(TSS_Sensor *sensor)
+{
+    float quat[4];
+    sensorProcessDataStreamingCallbackOutput(sensor, quat);
+    printf("Sensor %p Quat: %f %f %f %f\n", (void*)sensor, quat[0], quat[1], quat[2], quat[3]);
+    return TSS_DataCallbackStateProcessed;
+}
+
+int main() {
+    int err;
+    struct SpiBus bus;
+    struct SpiComClass spi[NUM_SENSORS];
+    struct SpiComClass *coms[NUM_SENSORS];
+    struct TSS_Sensor sensors[NUM_SENSORS];
+
+    if(spiBusOpen(&bus, SPI_DEVICE, GPIO_CHIP, 5000000)) {
+        printf("Failed to open SPI bus.\r\n");
+        return -1;
+    }
+
+    for(int i = 0; i < NUM_SENSORS; i++) {
+        SpiPortId id = {
+            .device_name = SPI_DEVICE,
+            .chip_path = GPIO_CHIP,
+            .cs_line_num = cs_lines[i],
+            .bus = &bus,
+        };
+        create_spi_com_class(id, 5000000, &spi[i]);
+        coms[i] = &spi[i];
+
+        if(tss_com_open((struct TSS_Com_Class*)&spi[i])) {
+            printf("Failed to open sensor %d.\r\n", i);
+            return -1;
+        }
+        spiConfigurePinMode(&spi[i].device, data_available_lines[i], -1);
+
+        tssCreateSensor(&sensors[i], (struct TSS_Com_Class*)&spi[i]);
+        err = tssInitSensor(&sensors[i]);
+        if(err) {
+            printf("Failed to initialize sensor %d: %d\n", i, err);
+            return -1;
+        }
+
+        sensorWriteStreamSlots(&sensors[i], "0");
+        sensorWriteStreamHz(&sensors[i], 100);
+        sensorStreamingStart(&sensors[i], onStreamingPacket);
+    }
+
+    //Each update reads whatever the sensors have into their buffers, and the
+    //streaming updates then parse it without going back to the bus.
+    tss_time_t start_time = tssTimeGet();
+    while(tssTimeDiff(start_time) < 5000) {
+        spi_com_bus_update(&bus, coms, NUM_SENSORS, 100);
+        for(int i = 0; i < NUM_SENSORS; i++) {
+            while(sensorUpdateStreaming(&sensors[i]));
+        }
+    }
+
+    for(int i = 0; i < NUM_SENSORS; i++) {
+        sensorStreamingStop(&sensors[i]);
+        sensorCleanup(&sensors[i]);
+    }
+    spiBusClose(&bus);
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+/*
+* Runs the API against a simulated sensor instead of hardware.
+* The simulated sensor answers commands and settings, streams at the configured rate,
+* and can be set up to output debug messages and corrupt its output to exercise
+* the API's recovery. Link with tss_sim.
+*/
+
+#include "tss/com/sim.h"
+#include "tss/api/sensor.h"
+#include "tss/sys/time.h"
+#include "tss/constants.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+static uint32_t num_packets = 0;
+static uint32_t num_debug_messages = 0;
+
+static enum TSS_DataCallbackState onStreamingPacket(TSS_Sensor *sensor)
+{
+    float quat[4], accel[3];
+    sensorProcessDataStreamingCallbackOutput(sensor, quat, accel);
+    num_packets++;
+    return TSS_DataCallbackStateProcessed;
+}
+
+static enum TSS_DataCallbackState onDebugMessage(TSS_Sensor *sensor)
+{
+    char buffer[TSS_DEBUG_MESSAGE_MAX_SIZE];
+    int num_read = sensorProcessDebugCallbackOutput(sensor, buffer, sizeof(buffer));
+    if(num_read < 0) return TSS_DataCallbackStateError;
+    num_debug_messages++;
+    return TSS_DataCallbackStateProcessed;
+}
+
+int main() {
+    int err;
+    struct SimComClass sim;
+    struct TSS_Com_Class *com;
+    struct TSS_Sensor sensor;
+
+    struct SimSensorConfig config = {
+        .serial_number = 0x1234,
+        .debug_message_hz = 10,
+        .corrupt_interval = 100000, //One bad bit every 100KB
+    };
+    create_sim_com_class(&config, &sim);
+    com = (struct TSS_Com_Class*) &sim;
+
+    if(tss_com_open(com)) {
+        printf("Failed to open port.\r\n");
+        return -1;
+    }
+
+    tssCreateSensor(&sensor, com);
+    err = tssInitSensor(&sensor);
+    if(err) {
+        printf("Failed to initialize sensor: %d\n", err);
+        return -1;
+    }
+    printf("Serial Number: %016" PRIX64 "\n", sensor.serial_number);
+
+    //Commands are answered with generated data
+    float quat[4];
+    err = sensorGetTaredOrientation(&sensor, quat);
+    printf("Get Orientation: %d Quat: %f %f %f %f\n", err, quat[0], quat[1], quat[2], quat[3]);
+
+    sensorSetDebugCallback(&sensor, onDebugMessage);
+    sensorWriteDebugMode(&sensor, 1);
+
+    //Stream at 2000Hz for 2 seconds. Setting unthrottled in the config instead streams
+    //as fast as the API can parse the packets, in which case there is always another packet
+    //available, so only call sensorUpdateStreaming once per loop.
+    sensorWriteStreamSlots(&sensor, "0,39");
+    sensorWriteStreamHz(&sensor, 2000);
+    sensorStreamingStart(&sensor, onStreamingPacket);
+    tss_time_t start_time = tssTimeGet();
+    while(tssTimeDiff(start_time) < 2000) {
+        while(sensorUpdateStreaming(&sensor));
+    }
+    sensorStreamingStop(&sensor);
+    sensorWriteDebugMode(&sensor, 0);
+
+    printf("Packets: %" PRIu32 " Debug Messages: %" PRIu32 "\n", num_packets, num_debug_messages);
+    printf("Simulated Packets: %" PRIu64 " Dropped: %" PRIu64 " Corrupted Bytes: %" PRIu32 "\n",
+        sim.sensor.stats.packets_streamed, sim.sensor.stats.packets_dropped, sim.sensor.stats.bytes_corrupted);
+
+    sensorCleanup(&sensor);
+
+    return 0;
+}
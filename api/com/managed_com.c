@@ -1,6 +1,13 @@
 #include "tss/com/managed_com.h"
 #include "tss/errors.h"
 #include "tss/sys/time.h"
+#include "tss/sys/stdinc.h"
+
+#if TSS_INSTRUMENTATION
+#define COM_STATS_ADD(com, field, value) ((com)->stats.field += (value))
+#else
+#define COM_STATS_ADD(com, field, value) ((void)0)
+#endif
 
 static int open(struct TSS_Com_Class *com);
 static int close(struct TSS_Com_Class *com);
@@ -19,6 +26,7 @@ static void clear_immediate(struct TSS_Com_Class *com);
 static void clear_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
 
 static int write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len);
+static int write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
 
 #if TSS_BUFFERED_WRITES
 static int begin_write(struct TSS_Com_Class *com);
@@ -49,6 +57,7 @@ struct TSS_Com_Class_API m_tss_manage_com_api = {
     },
     .out = {
         .write = write,
+        .write_vectored = write_vectored,
 #if TSS_BUFFERED_WRITES                
         .begin_write = begin_write,
         .end_write = end_write
@@ -102,6 +111,8 @@ static int begin_write(struct TSS_Com_Class *com)
 static int end_write(struct TSS_Com_Class *com)
 {
     struct TSS_Managed_Com_Class *self = (struct TSS_Managed_Com_Class *)com;
+    COM_STATS_ADD(self, writes, 1);
+    COM_STATS_ADD(self, bytes_written, self->write_buffer_index);
     return self->child->api->out.write(self->child_container, self->write_buffer, self->write_buffer_index);
 }
 #endif
@@ -110,15 +121,17 @@ static int write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len)
 {
     struct TSS_Managed_Com_Class *self = (struct TSS_Managed_Com_Class *)com;
 #if TSS_BUFFERED_WRITES
-    uint32_t i = 0;
-    while(i < len) {
-        while(self->write_buffer_index < self->write_buffer_size && i < len) {
-            self->write_buffer[self->write_buffer_index++] = bytes[i++];
-        }
-        
-        //Previous loop ended because buffer would overflow, 
-        //so need to send now and start buffering again.
-        if(i < len) {
+    size_t space, copy_len;
+    while(len > 0) {
+        space = self->write_buffer_size - self->write_buffer_index;
+        copy_len = (len < space) ? len : space;
+        memcpy(self->write_buffer + self->write_buffer_index, bytes, copy_len);
+        self->write_buffer_index += (uint16_t)copy_len;
+        bytes += copy_len;
+        len -= copy_len;
+
+        //Buffer would overflow, so need to send now and start buffering again.
+        if(len > 0) {
             end_write(com);
             begin_write(com); //Start again to finish writing
         }
@@ -126,12 +139,67 @@ static int write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len)
 
     return self->write_buffer_index >= self->write_buffer_size;
 #else
+    COM_STATS_ADD(self, writes, 1);
+    COM_STATS_ADD(self, bytes_written, len);
     return self->child->api->out.write(self->child_container, bytes, len);
 #endif    
 }
 
+static int write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    struct TSS_Managed_Com_Class *self = (struct TSS_Managed_Com_Class *)com;
+    uint8_t i;
+
+    //Let the child gather the buffers itself, skipping the copy into the write buffer
+    if(self->child->api->out.write_vectored != NULL) {
+        COM_STATS_ADD(self, writes, 1);
+        for(i = 0; i < iov_count; i++) {
+            COM_STATS_ADD(self, bytes_written, iov[i].len);
+        }
+        return self->child->api->out.write_vectored(self->child_container, iov, iov_count);
+    }
+
+#if TSS_BUFFERED_WRITES
+    begin_write(com);
+    for(i = 0; i < iov_count; i++) {
+        write(com, (const uint8_t*)iov[i].base, iov[i].len);
+    }
+    return end_write(com);
+#else
+    int result = 0;
+    for(i = 0; i < iov_count && result == 0; i++) {
+        COM_STATS_ADD(self, writes, 1);
+        COM_STATS_ADD(self, bytes_written, iov[i].len);
+        result = self->child->api->out.write(self->child_container, (const uint8_t*)iov[i].base, iov[i].len);
+    }
+    return result;
+#endif
+}
+
 #if !(TSS_MINIMAL_SENSOR)
 //--------------------------CUSTOM READ BEHAVIOR----------------------------------
+inline static void fill_in_buffer_timeout(struct TSS_Managed_Com_Class *com, uint32_t timeout_ms);
+
+//Counts a child read made to fill the ring, after its result has been added to the ring
+static inline void count_fill(struct TSS_Managed_Com_Class *com, int result)
+{
+#if TSS_INSTRUMENTATION
+    com->stats.fill_reads++;
+    if(result > 0) {
+        com->stats.bytes_filled += (size_t)result;
+    }
+    else {
+        com->stats.empty_fill_reads++;
+    }
+    if(ring_size(&com->read_ring) > com->stats.peak_ring_occupancy) {
+        com->stats.peak_ring_occupancy = ring_size(&com->read_ring);
+    }
+#else
+    (void) com;
+    (void) result;
+#endif
+}
+
 static int read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out)
 {
     struct TSS_Managed_Com_Class *self = (struct TSS_Managed_Com_Class *)com;
@@ -145,31 +213,71 @@ static int read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out)
     if(result < 0) {
         return result;
     }
+    COM_STATS_ADD(self, direct_reads, 1);
+    COM_STATS_ADD(self, bytes_read_direct, (size_t)result);
     return (int)i + result;
 }
 
-static int read_until(struct TSS_Com_Class *com, uint8_t value, uint8_t *out, size_t size)
+//Moves buffered data to out until either value is found, out is full, or the ring is empty.
+//Returns the number of bytes moved and sets found if the last byte moved was value.
+static size_t pop_until(struct TSS_Ring_Buf2 *ring, uint8_t value, uint8_t *out, size_t size, bool *found)
 {
-    struct TSS_Managed_Com_Class *self = (struct TSS_Managed_Com_Class *)com;
-    size_t peek_len, num_read;
-    int result;
+    size_t num_read, len, index;
+    const uint8_t *match;
 
-    peek_len = ring_size(&self->read_ring);
     num_read = 0;
-    while(num_read < peek_len && num_read < size) {
-        *out = ring_pop(&self->read_ring);
-        num_read++;
-        if(*out == value) {
-            return (int)num_read;
+    *found = false;
+    while(num_read < size && !ring_empty(ring)) {
+        //Search the contiguous part of the ring up to either the wrap point or the end of the data
+        index = ring_index(ring, ring->r_index);
+        len = ring->capacity - index;
+        if(len > ring_size(ring)) len = ring_size(ring);
+        if(len > size - num_read) len = size - num_read;
+
+        match = memchr(ring->data + index, value, len);
+        if(match != NULL) {
+            len = (size_t)(match - (ring->data + index)) + 1;
+            *found = true;
         }
-        out++;
+
+        memcpy(out + num_read, ring->data + index, len);
+        ring_advance(ring, len);
+        num_read += len;
+        if(*found) break;
     }
 
-    result = self->child->api->in.read_until(self->child_container, value, out, size - num_read);
-    if(result < 0) {
-        return result;
+    return num_read;
+}
+
+static int read_until(struct TSS_Com_Class *com, uint8_t value, uint8_t *out, size_t size)
+{
+    struct TSS_Managed_Com_Class *self = (struct TSS_Managed_Com_Class *)com;
+    size_t num_read;
+    uint32_t timeout, elapsed;
+    tss_time_t start_time;
+    bool found;
+
+    //Use what is already buffered before waiting on more
+    num_read = pop_until(&self->read_ring, value, out, size, &found);
+    if(found || num_read == size) {
+        return (int)num_read;
     }
-    num_read += (size_t)result;
+
+    //Wait for more data to arrive directly in the ring, then search it. This reads
+    //everything available at once rather than a byte at a time. Always fills at least
+    //once, so a timeout of 0 still gets whatever the child already has.
+    timeout = self->child->api->in.get_timeout(self->child_container);
+    start_time = tssTimeGet();
+    elapsed = 0;
+    do {
+        fill_in_buffer_timeout(self, timeout - elapsed);
+        num_read += pop_until(&self->read_ring, value, out + num_read, size - num_read, &found);
+        if(found || num_read == size) {
+            break;
+        }
+    } while((elapsed = tssTimeDiff(start_time)) < timeout);
+
+    self->child->api->in.set_timeout(self->child_container, timeout);
     return (int)num_read;
 }
 
@@ -189,6 +297,10 @@ static int peek(struct TSS_Com_Class *com, size_t start, size_t num_bytes, uint8
     timeout = self->child->api->in.get_timeout(self->child_container);
     start_time = tssTimeGet();
     while((len = length(com)) < required_length && tssTimeDiff(start_time) < timeout);
+    //Non-blocking peeks that find too little data are just polling, not timing out
+    if(len < required_length && timeout > 0) {
+        COM_STATS_ADD(self, peek_timeouts, 1);
+    }
 
     //Read out as much as can
     for(i = 0; i < num_bytes && i + start < len; i++) {
@@ -227,51 +339,94 @@ static int peek_until(struct TSS_Com_Class *com, size_t start, uint8_t value, ui
     if(!done && num_read < size && num_read + start == self->read_ring.capacity) {
         return TSS_ERR_INSUFFICIENT_BUFFER;
     }
+    if(!done && num_read < size && timeout > 0) {
+        COM_STATS_ADD(self, peek_timeouts, 1);
+    }
 
     return (int)num_read;
 }
 
-inline static void fill_in_buffer(struct TSS_Managed_Com_Class *com)
+//Reads as much as is available into the free space of the ring. If the child supports vectored
+//reads, both the space up to the wrap point and the space after are filled with one read.
+static void read_into_ring(struct TSS_Managed_Com_Class *com)
 {
-    size_t space, start_index, start_len, read_len;
+    struct TSS_Com_Iovec iov[2];
+    size_t space;
+    uint8_t iov_count;
     int result;
-    uint32_t timeout;
 
     space = ring_space(&com->read_ring);
     if(space == 0) return;
 
-    //Need to do immediate reads, so cache the timeout and set to instant
-    timeout = com->child->api->in.get_timeout(com->child_container);
-    com->child->api->in.set_timeout(com->child_container, 0);
+    //Space from the write index up to either capacity or the read index.
+    iov[0].base = ring_write_span(&com->read_ring, &iov[0].len);
+    iov_count = 1;
+    if(space > iov[0].len) {
+        //Space at the start of the buffer up to the read index.
+        iov[1].base = com->read_ring.data;
+        iov[1].len = space - iov[0].len;
+        iov_count = 2;
+    }
 
-    //Read filling write index up to either capacity or the read index.
-    start_index = ring_index(&com->read_ring, com->read_ring.w_index);
-    start_len = com->read_ring.capacity - start_index;
-    if(space < start_len) start_len = space; //Can't reach the end, the read index is in front of it
-    result = com->child->api->in.read(com->child_container, start_len, com->read_ring.data + start_index);
-    read_len = (size_t)result;
-    if(result < 0) {
-        read_len = 0;
+    if(com->child->api->in.read_vectored != NULL) {
+        result = com->child->api->in.read_vectored(com->child_container, iov, iov_count);
+        if(result > 0) {
+            ring_commit(&com->read_ring, (size_t)result);
+        }
+        count_fill(com, result);
+        return;
     }
 
-    //Update state variables
-    com->read_ring.w_index += read_len;
-    space -= read_len;
-
-    //Check if more to read
-    if(read_len == start_len && space != 0) {
-        //Read filling start of buffer up to the read index.
-        //More to read possibly, fill from the start of the buffer now
-        size_t end_index = ring_index(&com->read_ring, com->read_ring.r_index);
-        result = com->child->api->in.read(com->child_container, end_index, com->read_ring.data);
-        read_len = (size_t) result;
-        if(result < 0) {
-            read_len = 0;
+    result = com->child->api->in.read(com->child_container, iov[0].len, iov[0].base);
+    if(result > 0) {
+        ring_commit(&com->read_ring, (size_t)result);
+    }
+    count_fill(com, result);
+    if(result <= 0) return;
+
+    //Check if more to read, only if the first part was filled. Don't wait on the second read.
+    if(iov_count == 2 && (size_t)result == iov[0].len) {
+        com->child->api->in.set_timeout(com->child_container, 0);
+        result = com->child->api->in.read(com->child_container, iov[1].len, iov[1].base);
+        if(result > 0) {
+            ring_commit(&com->read_ring, (size_t)result);
         }
+        count_fill(com, result);
+    }
+}
+
+//Waits up to timeout_ms for data to arrive, then fills the ring with everything available.
+//The wait only asks for a single byte since a child read may block until the full amount requested is available.
+//Leaves the child timeout modified, the caller must restore it.
+inline static void fill_in_buffer_timeout(struct TSS_Managed_Com_Class *com, uint32_t timeout_ms)
+{
+    size_t space;
+    int result;
 
-        com->read_ring.w_index += read_len;
+    if(ring_space(&com->read_ring) == 0) return;
+
+    if(timeout_ms > 0) {
+        com->child->api->in.set_timeout(com->child_container, timeout_ms);
+        result = com->child->api->in.read(com->child_container, 1, ring_write_span(&com->read_ring, &space));
+        if(result > 0) {
+            ring_commit(&com->read_ring, 1);
+        }
+        count_fill(com, result);
+        if(result <= 0) return;
     }
 
+    com->child->api->in.set_timeout(com->child_container, 0);
+    read_into_ring(com);
+}
+
+inline static void fill_in_buffer(struct TSS_Managed_Com_Class *com)
+{
+    uint32_t timeout;
+
+    //Need to do immediate reads, so cache the timeout and set to instant
+    timeout = com->child->api->in.get_timeout(com->child_container);
+    fill_in_buffer_timeout(com, 0);
+
     //Restore timeout
     com->child->api->in.set_timeout(com->child_container, timeout);
 }
@@ -366,7 +521,13 @@ static int reenumerate_callback(struct TSS_Com_Class *com, void *user_data)
         //In the case where the TSS_Managed_Com_Class is included in the struct of the child com class,
         //we don't want to wrap the managed class with itself. The child class reenumerate should have already handled the wrapping
         //and therefore this should only be done if com != managed
+#if TSS_INSTRUMENTATION
+        struct TSS_Managed_Com_Stats stats = managed->stats;
+#endif
         tssCreateManagedComDynamic(com, managed->read_ring.data, managed->read_ring.capacity, managed->write_buffer, managed->write_buffer_size, managed);
+#if TSS_INSTRUMENTATION
+        managed->stats = stats;
+#endif
     }
 
     return info->cb(&managed->base, info->detect_data);
@@ -395,6 +556,19 @@ static int auto_detect(struct TSS_Com_Class *out, TssComAutoDetectCallback cb, v
     return com->child->api->auto_detect(com->child_container, cb, detect_data);
 }
 
+//----------------------------------------INSTRUMENTATION------------------------------------------
+#if TSS_INSTRUMENTATION
+void tssManagedComGetStats(const struct TSS_Managed_Com_Class *com, struct TSS_Managed_Com_Stats *out)
+{
+    *out = com->stats;
+}
+
+void tssManagedComResetStats(struct TSS_Managed_Com_Class *com)
+{
+    com->stats = (struct TSS_Managed_Com_Stats) {0};
+}
+#endif
+
 //------------------------------------BASE FUNCTION VERSIONS--------------------------------------
 
 int tssManagedComBaseReadUntil(struct TSS_Com_Class *com, uint8_t value, uint8_t *out, size_t size)
@@ -6,13 +6,46 @@
 #include "tss/errors.h"
 #include "tss/sys/config.h"
 #include "tss/sys/endian.h"
+#include "sys/trace_internal.h"
 
 #include "tss/sys/stdinc.h"
 #include <stdarg.h>
 
+//Max number of pieces a frame is gathered from. Pieces past this are copied onto the end of the last one.
+#define FRAME_MAX_IOV 16
+//Space for parameters that had to be copied to swap their endianess, and pieces past FRAME_MAX_IOV.
+//Only a frame that needs more than this is sent out in more than one write.
+#define FRAME_SCRATCH_SIZE 256
+
+//Gathers the pieces of a command/setting frame so it can be sent with a single vectored write
+//instead of copying each piece into a write buffer.
+struct FrameWriter {
+    struct TSS_Com_Class *com;
+    struct TSS_Com_Iovec iov[FRAME_MAX_IOV];
+    uint8_t iov_count;
+
+    uint8_t scratch[FRAME_SCRATCH_SIZE];
+    uint16_t scratch_len;
+
+    //Total bytes added, including anything already sent early
+    size_t len;
+
+    //When set, the frame is copied here instead of being written to com
+    uint8_t *out;
+    size_t out_size;
+    size_t out_len;
+    int out_err;
+};
+
 //---------------------------------PROTOTYPES-------------------------------------
-inline static void send_params(struct TSS_Com_Class *com, const struct TSS_Param *cur_param, const void ***raw_data, uint8_t *checksum);
-inline static void send_param(struct TSS_Com_Class *com, const struct TSS_Param *cur_param, const uint8_t *raw_data, uint8_t *checksum);
+inline static void frame_init(struct FrameWriter *frame, struct TSS_Com_Class *com);
+inline static void frame_init_buffer(struct FrameWriter *frame, uint8_t *out, size_t size);
+inline static void frame_add(struct FrameWriter *frame, const void *data, size_t len);
+inline static void frame_add_swapped(struct FrameWriter *frame, const uint8_t *data, uint16_t size);
+static bool frame_coalesce_last(struct FrameWriter *frame, size_t extra_len);
+static int frame_flush(struct FrameWriter *frame);
+inline static void send_params(struct FrameWriter *frame, const struct TSS_Param *cur_param, const void ***raw_data, uint8_t *checksum);
+inline static void send_param(struct FrameWriter *frame, const struct TSS_Param *cur_param, const uint8_t *raw_data, uint8_t *checksum);
 inline static void swap_singular_param_endianess(uint8_t *data, const struct TSS_Param *param);
 inline static void swap_param_endianess(uint8_t *data, const struct TSS_Param *param);
 
@@ -22,24 +55,107 @@ inline static void swap_param_endianess(uint8_t *data, const struct TSS_Param *p
 //This is undesirable as this works via the raw bytes not the types, and so it is avoided by using a void** instead.
 int tssWriteCommand(struct TSS_Com_Class *com, bool header, const struct TSS_Command *command, const void **data)
 {   
+    struct FrameWriter frame;
     uint8_t start_byte, checksum;
 
     checksum = command->num;
     start_byte = (header) ? TSS_BINARY_HEADER_START_BYTE : TSS_BINARY_START_BYTE;
 
-    TSS_COM_BEGIN_WRITE(com);
-    tss_com_write(com, &start_byte, 1);
-    tss_com_write(com, &command->num, 1);
+    frame_init(&frame, com);
+    frame_add(&frame, &start_byte, 1);
+    frame_add(&frame, &command->num, 1);
 
     if(command->in_format != NULL) {
-        send_params(com, command->in_format, &data, &checksum);
+        send_params(&frame, command->in_format, &data, &checksum);
     }
 
-    tss_com_write(com, &checksum, 1);
-    TSS_COM_END_WRITE(com);
+    frame_add(&frame, &checksum, 1);
+    frame_flush(&frame);
+    TSS_TRACE(TSS_TRACE_FRAME_SENT, com, command->num, (uint16_t)frame.len, 0, NULL);
     return TSS_SUCCESS;
 }
 
+int tssBuildCommandFrame(const struct TSS_Command *command, const void **data, struct TSS_Command_Frame *out)
+{
+    struct FrameWriter frame;
+    const struct TSS_Param *cur_param;
+    uint8_t checksum;
+    int err;
+
+    out->command = command;
+
+    //Precompute where each output is in the response
+    out->response_size = 0;
+    out->num_outputs = 0;
+    for(cur_param = command->out_format; !TSS_PARAM_IS_NULL(cur_param); cur_param++) {
+        if(TSS_PARAM_IS_STRING(cur_param) || out->num_outputs == TSS_COMMAND_FRAME_MAX_OUTPUTS) {
+            return TSS_ERR_INVALID_SIZE;
+        }
+        struct TSS_Command_Frame_Output *output = &out->outputs[out->num_outputs++];
+        output->offset = out->response_size;
+        output->len = (uint16_t)(cur_param->count * cur_param->size);
+        output->element_size = cur_param->size;
+        out->response_size += output->len;
+    }
+    if(out->response_size > TSS_COMMAND_FRAME_MAX_RESPONSE_SIZE) {
+        return TSS_ERR_INVALID_SIZE;
+    }
+
+    //Serialize the same way tssWriteCommand does, just into the frame instead of the com class
+    checksum = command->num;
+    frame_init_buffer(&frame, out->data, sizeof(out->data));
+    frame_add(&frame, &command->num, 1);
+    if(command->in_format != NULL) {
+        send_params(&frame, command->in_format, &data, &checksum);
+    }
+    frame_add(&frame, &checksum, 1);
+    err = frame_flush(&frame);
+    if(err) return err;
+
+    out->len = (uint16_t)frame.out_len;
+    return TSS_SUCCESS;
+}
+
+int tssWriteCommandFrame(struct TSS_Com_Class *com, bool header, const struct TSS_Command_Frame *frame)
+{
+    uint8_t start_byte = (header) ? TSS_BINARY_HEADER_START_BYTE : TSS_BINARY_START_BYTE;
+    struct TSS_Com_Iovec iov[2] = {
+        { .base = &start_byte, .len = 1 },
+        { .base = (void*)frame->data, .len = frame->len }
+    };
+    TSS_TRACE(TSS_TRACE_FRAME_SENT, com, frame->command->num, (uint16_t)(frame->len + 1), 0, NULL);
+    return tss_com_write_vectored(com, iov, 2);
+}
+
+int tssReadCommandFrameResponse(struct TSS_Com_Class *com, const struct TSS_Command_Frame *frame, void **out)
+{
+    uint8_t buffer[TSS_COMMAND_FRAME_MAX_RESPONSE_SIZE];
+    const struct TSS_Command_Frame_Output *output;
+    uint8_t checksum;
+    uint8_t i;
+
+    if(frame->response_size == 0) return 0;
+    if(tss_com_read(com, frame->response_size, buffer) != frame->response_size) {
+        return TSS_ERR_READ;
+    }
+
+    checksum = 0;
+    for(uint16_t j = 0; j < frame->response_size; j++) {
+        checksum += buffer[j];
+    }
+
+    for(i = 0; i < frame->num_outputs; i++) {
+        output = &frame->outputs[i];
+        memcpy(out[i], buffer + output->offset, output->len);
+        if(TSS_ENDIAN_IS_BIG) {
+            for(uint16_t offset = 0; offset < output->len; offset += output->element_size) {
+                tssSwapEndianess((uint8_t*)out[i] + offset, output->element_size);
+            }
+        }
+    }
+
+    return checksum;
+}
 
 int tssReadCommand(struct TSS_Com_Class *com, const struct TSS_Command *command, ...)
 {
@@ -55,7 +171,16 @@ int tssReadCommand(struct TSS_Com_Class *com, const struct TSS_Command *command,
 
 int tssReadCommandV(struct TSS_Com_Class *com, const struct TSS_Command *command, va_list args)
 {
-    return tssReadCommandVp(com, command, &args);
+    va_list copy;
+    int result;
+
+    //Taking the address of a va_list parameter is not portable, on some ABIs it is
+    //an array that decays to a pointer. A local copy is always a real va_list.
+    va_copy(copy, args);
+    result = tssReadCommandVp(com, command, &copy);
+    va_end(copy);
+
+    return result;
 }
 
 int tssReadCommandVp(struct TSS_Com_Class *com, const struct TSS_Command *command, va_list *args)
@@ -264,6 +389,7 @@ int tssGetSettingsWrite(struct TSS_Com_Class *com, bool header, const char *key_
 {
     const uint8_t start_byte = (header) ? TSS_BINARY_READ_SETTINGS_HEADER_START_BYTE : TSS_BINARY_READ_SETTINGS_START_BYTE;
 
+    struct FrameWriter frame;
     size_t key_len;
     uint8_t checksum;
     
@@ -277,16 +403,16 @@ int tssGetSettingsWrite(struct TSS_Com_Class *com, bool header, const char *key_
         checksum += key_string[i];
     }
 
-    TSS_COM_BEGIN_WRITE(com);
-    tss_com_write(com, &start_byte, 1);
-    tss_com_write(com, (uint8_t*)key_string, key_len+1); //+1 to send the  null terminator
-    tss_com_write(com, &checksum, 1);
-    TSS_COM_END_WRITE(com);
+    frame_init(&frame, com);
+    frame_add(&frame, &start_byte, 1);
+    frame_add(&frame, key_string, key_len+1); //+1 to send the  null terminator
+    frame_add(&frame, &checksum, 1);
+    frame_flush(&frame);
+    TSS_TRACE(TSS_TRACE_FRAME_SENT, com, start_byte, (uint16_t)frame.len, 0, NULL);
 
     return TSS_SUCCESS;
 }
 
-#include <stdio.h>
 int tssGetSettingsReadCb(struct TSS_Com_Class *com, TssGetSettingsCallback callback, void *user_data) {
     char buffer[TSS_MAX_SETTINGS_KEY_LEN];
     struct TSS_GetSettingsCallbackInfo cb_info;
@@ -313,10 +439,10 @@ int tssGetSettingsReadCb(struct TSS_Com_Class *com, TssGetSettingsCallback callb
         if(setting == NULL) { //Unregistered key
             if(strcmp(key, TSS_SETTING_KEY_ERR_STRING) == 0) {
                 //Key Error. Unkown how to continue parsing, return
-                printf("Invalid Key!\n");
+                TSS_TRACE(TSS_TRACE_ERROR, com, 0, 0, TSS_ERR_SETTING_KEY_INVALID, "Invalid setting key");
                 return TSS_ERR_SETTING_KEY_INVALID;    
             }
-            printf("Unregistered Key: %s\n", key);
+            TSS_TRACE(TSS_TRACE_ERROR, com, 0, 0, TSS_ERR_SETTING_KEY_UNREGISTERED, "Unregistered setting key");
             return TSS_ERR_SETTING_KEY_UNREGISTERED;
         }
         if(setting->out_format == NULL) {
@@ -362,7 +488,7 @@ int tssGetSettingsReadCb(struct TSS_Com_Class *com, TssGetSettingsCallback callb
     }
 
     if((uint8_t)buffer[0] != checksum) {
-        printf("Checksum Mismatch: 0x%02x != 0x%02x\n", (uint8_t)buffer[0], checksum);
+        TSS_TRACE(TSS_TRACE_ERROR, com, 0, 0, TSS_ERR_CHECKSUM_MISMATCH, "Setting response checksum mismatch");
         return TSS_ERR_CHECKSUM_MISMATCH;
     }
 
@@ -420,13 +546,17 @@ int tssGetSettingsRead(struct TSS_Com_Class *com, uint16_t *num_read, ...)
 int tssGetSettingsReadV(struct TSS_Com_Class *com, uint16_t *num_read, va_list args)
 {
     int result;
+    va_list copy;
     struct GetSettingUserData user_data = {
-        .args.va = &args,
+        .args.va = &copy,
         .num_read = 0,
         .result = TSS_SUCCESS
     };
 
+    //See tssReadCommandV for why this is copied
+    va_copy(copy, args);
     result = tssGetSettingsReadCb(com, getSettingsCallback, &user_data);
+    va_end(copy);
     if(num_read != NULL) {
         *num_read = user_data.num_read;
     }
@@ -454,39 +584,48 @@ int tssSetSettingsWrite(struct TSS_Com_Class *com, bool header, const char **key
     static const uint8_t separator = TSS_SETTING_SEPARATOR;
     const uint8_t start_byte = (header) ? TSS_BINARY_WRITE_SETTINGS_HEADER_START_BYTE : TSS_BINARY_WRITE_SETTINGS_START_BYTE;
 
+    struct FrameWriter frame;
     const struct TSS_Setting *setting;
     uint8_t key_index, checksum;
     const char *key;
+    size_t key_len;
 
-    TSS_COM_BEGIN_WRITE(com);
-    tss_com_write(com, &start_byte, 1);
-
-    checksum = 0;
+    //Validate all the keys first so a bad key never results in a partially sent frame
     for(key_index = 0; key_index < num_keys; key_index++) {
-        key = keys[key_index];
-        setting = tssGetSetting(key);
+        setting = tssGetSetting(keys[key_index]);
         if(setting == NULL) {
             return TSS_ERR_SETTING_KEY_INVALID;
         }
         if(setting->in_format == NULL) {
             return TSS_ERR_INVALID_WRITE_KEY;
         }
+    }
 
-        tss_com_write(com, (uint8_t*)key, strlen(key) + 1);
-        while(*key != '\0') checksum += *key++; //Add key to the checksum
+    frame_init(&frame, com);
+    frame_add(&frame, &start_byte, 1);
 
-        send_params(com, setting->in_format, &data, &checksum);
+    checksum = 0;
+    for(key_index = 0; key_index < num_keys; key_index++) {
+        key = keys[key_index];
+        setting = tssGetSetting(key);
+
+        key_len = strlen(key);
+        frame_add(&frame, key, key_len + 1);
+        for(size_t i = 0; i < key_len; i++) checksum += (uint8_t)key[i]; //Add key to the checksum
+
+        send_params(&frame, setting->in_format, &data, &checksum);
 
         if(key_index < num_keys - 1) { //Insert the go next character
-            tss_com_write(com, &separator, 1);
+            frame_add(&frame, &separator, 1);
             checksum += separator;
         }
     }
 
     //Done writing, now add the null terminator and checksum
-    tss_com_write(com, (uint8_t*)"\0", 1);
-    tss_com_write(com, &checksum, 1);
-    TSS_COM_END_WRITE(com);
+    frame_add(&frame, "\0", 1);
+    frame_add(&frame, &checksum, 1);
+    frame_flush(&frame);
+    TSS_TRACE(TSS_TRACE_FRAME_SENT, com, start_byte, (uint16_t)frame.len, 0, NULL);
 
     return TSS_SUCCESS;
 }
@@ -537,40 +676,152 @@ int tssPeekSettingsHeader(struct TSS_Com_Class *com, uint32_t *id) {
 
 //-----------------------HELPER FUNCTIONS------------------------------
 
-inline static void send_params(struct TSS_Com_Class *com, const struct TSS_Param *cur_param, const void ***raw_data, uint8_t *checksum)
+inline static void frame_init(struct FrameWriter *frame, struct TSS_Com_Class *com)
+{
+    frame->com = com;
+    frame->iov_count = 0;
+    frame->scratch_len = 0;
+    frame->len = 0;
+    frame->out = NULL;
+}
+
+inline static void frame_init_buffer(struct FrameWriter *frame, uint8_t *out, size_t size)
+{
+    frame_init(frame, NULL);
+    frame->out = out;
+    frame->out_size = size;
+    frame->out_len = 0;
+    frame->out_err = TSS_SUCCESS;
+}
+
+//Moves the last piece to the end of the scratch space, if not already there, so bytes can be appended
+//to it without using another piece. Returns false if there is not room for it and extra_len more bytes.
+static bool frame_coalesce_last(struct FrameWriter *frame, size_t extra_len)
+{
+    struct TSS_Com_Iovec *last = &frame->iov[frame->iov_count-1];
+
+    if((uint8_t*)last->base + last->len == frame->scratch + frame->scratch_len) {
+        return frame->scratch_len + extra_len <= FRAME_SCRATCH_SIZE;
+    }
+    if(frame->scratch_len + last->len + extra_len > FRAME_SCRATCH_SIZE) {
+        return false;
+    }
+    memcpy(frame->scratch + frame->scratch_len, last->base, last->len);
+    last->base = frame->scratch + frame->scratch_len;
+    frame->scratch_len = (uint16_t)(frame->scratch_len + last->len);
+    return true;
+}
+
+inline static void frame_add(struct FrameWriter *frame, const void *data, size_t len)
+{
+    struct TSS_Com_Iovec *last;
+
+    if(len == 0) return;
+    if(frame->iov_count == FRAME_MAX_IOV) {
+        //Out of pieces, copy onto the end of the last one so the frame still goes out in a single write
+        if(frame_coalesce_last(frame, len)) {
+            last = &frame->iov[frame->iov_count-1];
+            memcpy(frame->scratch + frame->scratch_len, data, len);
+            frame->scratch_len = (uint16_t)(frame->scratch_len + len);
+            last->len += len;
+            frame->len += len;
+            return;
+        }
+        //Too large to gather, send what is built so far. The rest of the frame follows in the next write.
+        frame_flush(frame);
+    }
+    frame->iov[frame->iov_count].base = (void*)data;
+    frame->iov[frame->iov_count].len = len;
+    frame->iov_count++;
+    frame->len += len;
+}
+
+//Adds a copy of the element with its endianess swapped
+inline static void frame_add_swapped(struct FrameWriter *frame, const uint8_t *data, uint16_t size)
+{
+    struct TSS_Com_Iovec *last;
+    uint8_t *out;
+    bool extend;
+
+    //Consecutive swapped elements are contiguous in the scratch buffer, so extend the previous piece.
+    //When out of pieces, the previous piece is moved into the scratch buffer so it can be extended too.
+    last = (frame->iov_count > 0) ? &frame->iov[frame->iov_count-1] : NULL;
+    extend = (last != NULL && (uint8_t*)last->base + last->len == frame->scratch + frame->scratch_len);
+    if(!extend && frame->iov_count == FRAME_MAX_IOV) {
+        extend = frame_coalesce_last(frame, size);
+    }
+    out = frame->scratch + frame->scratch_len;
+
+    //Flushing resets the scratch buffer, so it must happen before writing into it. Otherwise
+    //frame_add could flush when out of pieces and leave the new piece pointing at reused scratch.
+    if(frame->scratch_len + size > FRAME_SCRATCH_SIZE || (!extend && frame->iov_count == FRAME_MAX_IOV)) {
+        frame_flush(frame);
+        out = frame->scratch;
+        extend = false;
+    }
+
+    for(uint16_t i = 0; i < size; i++) {
+        out[i] = data[size-1-i];
+    }
+    frame->scratch_len = (uint16_t)(frame->scratch_len + size);
+
+    if(extend) {
+        last->len += size;
+        frame->len += size;
+    }
+    else {
+        frame_add(frame, out, size);
+    }
+}
+
+static int frame_flush(struct FrameWriter *frame)
+{
+    int result = 0;
+    if(frame->out != NULL) {
+        for(uint8_t i = 0; i < frame->iov_count; i++) {
+            if(frame->out_len + frame->iov[i].len > frame->out_size) {
+                frame->out_err = TSS_ERR_BUFFER_OVERFLOW;
+                break;
+            }
+            memcpy(frame->out + frame->out_len, frame->iov[i].base, frame->iov[i].len);
+            frame->out_len += frame->iov[i].len;
+        }
+        result = frame->out_err;
+    }
+    else if(frame->iov_count > 0) {
+        result = tss_com_write_vectored(frame->com, frame->iov, frame->iov_count);
+    }
+    frame->iov_count = 0;
+    frame->scratch_len = 0;
+    return result;
+}
+
+inline static void send_params(struct FrameWriter *frame, const struct TSS_Param *cur_param, const void ***raw_data, uint8_t *checksum)
 {
     while(!TSS_PARAM_IS_NULL(cur_param)) {
-        send_param(com, cur_param, **raw_data, checksum);
+        send_param(frame, cur_param, **raw_data, checksum);
 
         cur_param++;
         (*raw_data)++; 
     }
 }
 
-inline static void send_param(struct TSS_Com_Class *com, const struct TSS_Param *cur_param, const uint8_t *raw_data, uint8_t *checksum)
+inline static void send_param(struct FrameWriter *frame, const struct TSS_Param *cur_param, const uint8_t *raw_data, uint8_t *checksum)
 {
     bool is_str = TSS_PARAM_IS_STRING(cur_param);
     size_t param_len = (is_str) ? strlen((const char*)raw_data) + 1 : cur_param->size * cur_param->count;
 
-    for(uint8_t i = 0; i < param_len; i++) {
+    for(size_t i = 0; i < param_len; i++) {
         *checksum += raw_data[i];
     }
 
     if(TSS_ENDIAN_IS_LITTLE || is_str) {
-        tss_com_write(com, raw_data, param_len);
+        frame_add(frame, raw_data, param_len);
     }
     else {
-        //Have to send each part of the param 1 at a time because need
-        //to swap endianess, but the incoming data is const, so not allowed to modify it there
+        //The incoming data is const, so each element is swapped into the frame's scratch space instead
         for(uint8_t element = 0; element < cur_param->count; element++) {
-            uint8_t conversion[8]; //Max U64 is 8 bytes
-            //Swap endianess
-            for(uint8_t i = 0; i < cur_param->size; i++) {
-                conversion[i] = raw_data[cur_param->size-1-i];
-            }
-
-            // cppcheck-suppress uninitvar
-            tss_com_write(com, conversion, cur_param->size);
+            frame_add_swapped(frame, raw_data, cur_param->size);
 
             //Advance to the next element
             raw_data += cur_param->size;
@@ -359,14 +359,20 @@ int sensorInternalReadStreamingBatch(TSS_Sensor *sensor, const struct TSS_Comman
     
     uint8_t checksum = 0;
     const struct TSS_Command **cur_slot = sensor->streaming.data.commands;
+    va_list args;
+
+    //Every slot continues from the outputs the previous slot stopped at, so they share one copy
+    va_copy(args, outputs);
     while(*cur_slot != NULL) {
-        int err_or_checksum = tssReadCommandVp(sensor->com, *cur_slot, &outputs);
+        int err_or_checksum = tssReadCommandVp(sensor->com, *cur_slot, &args);
         if(err_or_checksum < 0) {
+            va_end(args);
             return err_or_checksum;
         }
         checksum += (uint8_t)err_or_checksum;
         cur_slot++;
     }
+    va_end(args);
 
     return checksum;
 }
@@ -407,7 +413,10 @@ int sensorInternalReadStreamingBatchChecksumOnly(TSS_Sensor *sensor) {
 
 int sensorInternalUpdateDataStreaming(TSS_Sensor *sensor) {
     sensorInternalHandleHeader(sensor);
-    enum TSS_DataCallbackState state = sensor->streaming.data.cb(sensor);
+    SENSOR_STATS_ADD(sensor, packets[TSS_STATS_PACKET_DATA_STREAM], 1);
+    sensorInternalTraceReceived(sensor, TSS_STREAMING_DATA_BATCH_COMMAND_NUM, sensorInternalLastLength(sensor));
+    sensorInternalLatencyStreamPacket(sensor);
+    enum TSS_DataCallbackState state = sensorInternalCallCallback(sensor, sensor->streaming.data.cb);
     if(state == TSS_DataCallbackStateIgnored) {
         sensorInternalReadStreamingBatchChecksumOnly(sensor);
     }
@@ -431,8 +440,11 @@ int sensorInternalUpdateFileStreaming(TSS_Sensor *sensor)
     packet_len = sensor->last_header.length;
 #endif
     sensor->streaming.file.remaining_cur_packet_len = packet_len;
+    sensor->streaming.file.skipped_bytes = sensor->_resync_bytes;
 
-    enum TSS_DataCallbackState state = sensor->streaming.file.cb(sensor);
+    SENSOR_STATS_ADD(sensor, packets[TSS_STATS_PACKET_FILE_STREAM], 1);
+    sensorInternalTraceReceived(sensor, TSS_STREAMING_FILE_READ_BYTES_COMMAND_NUM, packet_len);
+    enum TSS_DataCallbackState state = sensorInternalCallCallback(sensor, sensor->streaming.file.cb);
     if(sensor->streaming.file.remaining_cur_packet_len > 0) { //Read unread data out
         tssReadBytesChecksumOnly(sensor->com, sensor->streaming.file.remaining_cur_packet_len, NULL);
     }
@@ -449,7 +461,10 @@ int sensorInternalUpdateLogStreaming(TSS_Sensor *sensor) {
     if(sensor->streaming.log.header_enabled) {
         tssReadHeader(sensor->com, &sensor->header_cfg, &sensor->last_header);
     }
-    enum TSS_DataCallbackState state = sensor->streaming.log.cb(sensor);
+    SENSOR_STATS_ADD(sensor, packets[TSS_STATS_PACKET_LOG_STREAM], 1);
+    sensorInternalTraceReceived(sensor, TSS_STREAMING_FILE_READ_BYTES_COMMAND_NUM,
+        (sensor->streaming.log.header_enabled) ? sensor->last_header.length : 0);
+    enum TSS_DataCallbackState state = sensorInternalCallCallback(sensor, sensor->streaming.log.cb);
     if(state == TSS_DataCallbackStateIgnored) {
 #if TSS_MINIMAL_SENSOR
         tss_com_clear_immediate(sensor->com);
@@ -475,13 +490,39 @@ static int consumeDebugMessage(TSS_Sensor *sensor)
 int sensorInternalUpdateDebugMessage(TSS_Sensor *sensor) {
     sensor->debug.bytes_read = 0;
     sensor->debug.message_processed = false;
-    sensor->debug.cb(sensor);
+    SENSOR_STATS_ADD(sensor, packets[TSS_STATS_PACKET_DEBUG_MESSAGE], 1);
+    sensorInternalCallCallback(sensor, sensor->debug.cb);
     if(!sensor->debug.message_processed) {
         consumeDebugMessage(sensor);
     }
     return 0;
 }
 
+//------------------------INSTRUMENTATION---------------------------------
+#if TSS_INSTRUMENTATION
+void sensorGetStats(const TSS_Sensor *sensor, struct TSS_Sensor_Stats *out)
+{
+    *out = sensor->stats;
+}
+
+void sensorResetStats(TSS_Sensor *sensor)
+{
+    sensor->stats = (struct TSS_Sensor_Stats) {0};
+}
+
+void sensorGetLatencyHistogram(const TSS_Sensor *sensor, enum TSS_Latency latency, struct TSS_Histogram *out)
+{
+    *out = sensor->latency.histograms[latency];
+}
+
+void sensorResetLatencyHistograms(TSS_Sensor *sensor)
+{
+    for(size_t i = 0; i < TSS_LATENCY_COUNT; i++) {
+        histogram_reset(&sensor->latency.histograms[i]);
+    }
+}
+#endif
+
 //------------------------WRAPPERS---------------------------------
 int sensorInternalExecuteCommand(TSS_Sensor *sensor, const struct TSS_Command *command, const void **input, ...)
 {
@@ -9,6 +9,9 @@ int sensorStreamingGetPacket(TSS_Sensor *sensor, ...) {
     va_list outputs;
     int result;
 
+    result = sensorInternalRestoreStreamSlots(sensor);
+    if(result) return result;
+
     va_start(outputs, sensor);
     result = sensorInternalExecuteCommandCustomV(sensor, tssGetCommand(84), NULL, sensorInternalProcessStreamingBatch, outputs);
     va_end(outputs);
@@ -16,14 +19,19 @@ int sensorStreamingGetPacket(TSS_Sensor *sensor, ...) {
 }
 
 int sensorStreamingGetPacketArray(TSS_Sensor *sensor, void **outputs) {
+    int err = sensorInternalRestoreStreamSlots(sensor);
+    if(err) return err;
     return sensorInternalExecuteCommandCustomArray(sensor, tssGetCommand(84), NULL, sensorInternalProcessStreamingBatchArray, outputs);
 }
 
 int sensorStreamingStart(TSS_Sensor *sensor, TssDataCallback cb) {
     int err;
     if(cb == NULL) return TSS_ERR_INVALID_STREAM_CALLBACK;
+    err = sensorInternalRestoreStreamSlots(sensor);
+    if(err) return err;
     err = sensorInternalExecuteCommand(sensor, tssGetCommand(85), NULL);
     if(!err) {
+        sensorInternalLatencyStreamStart(sensor);
         sensor->streaming.data.active = true;
         sensor->streaming.data.cb = cb;
     }
@@ -112,6 +120,13 @@ int sensorLoggingStop(TSS_Sensor *sensor) {
     return sensorInternalExecuteCommand(sensor, tssGetCommand(61), NULL);
 }
 
+int sensorCommitSettings(TSS_Sensor *sensor) {
+    //Batch get may have left its own slots on the sensor, which must not be saved as the user's
+    int err = sensorInternalRestoreStreamSlots(sensor);
+    if(err) return err;
+    return sensorInternalExecuteCommand(sensor, tssGetCommand(225), NULL);
+}
+
 int sensorSoftwareReset(TSS_Sensor *sensor) {
     bool header_was_enabled;
 
@@ -551,10 +566,6 @@ int sensorGPSSetData(TSS_Sensor *sensor, double latitude, double longitude, floa
     return sensorInternalExecuteCommand(sensor, tssGetCommand(221), (const void*[]) { &latitude, &longitude, &altitude });
 }
 
-int sensorCommitSettings(TSS_Sensor *sensor) {
-    return sensorInternalExecuteCommand(sensor, tssGetCommand(225), NULL);
-}
-
 int sensorGetCurrentLEDColor(TSS_Sensor *sensor, float out_color[3]) {
     return sensorInternalExecuteCommand(sensor, tssGetCommand(238), NULL, out_color);
 }
@@ -2,6 +2,7 @@
 #define __TSS_SENSOR_INTERNAL_H__
 
 #include "tss/api/sensor.h"
+#include "../sys/trace_internal.h"
 
 typedef int (*SensorInternalReadFunction)(TSS_Sensor *sensor, const struct TSS_Command *command, va_list outputs);
 typedef int (*SensorInternalReadFunctionArray)(TSS_Sensor *sensor, const struct TSS_Command *command, void **outputs);
@@ -20,6 +21,107 @@ int sensorInternalBootloaderCheckActive(TSS_Sensor *sensor, uint8_t *active);
 //-----------------------Control-------------------------
 void sensorInternalForceStopStreaming(TSS_Sensor *sensor);
 
+//Instrumentation, see TSS_INSTRUMENTATION
+#if TSS_INSTRUMENTATION
+#include "tss/sys/time.h"
+#define SENSOR_STATS_ADD(sensor, field, value) ((sensor)->stats.field += (value))
+#else
+#define SENSOR_STATS_ADD(sensor, field, value) ((void)0)
+#endif
+
+//Calls a streaming or debug callback, timing it when instrumented
+static inline enum TSS_DataCallbackState sensorInternalCallCallback(TSS_Sensor *sensor, TssDataCallback cb) {
+#if TSS_INSTRUMENTATION
+    enum TSS_DataCallbackState state;
+    tss_time_t start_time = tssTimeGet();
+    state = cb(sensor);
+    sensor->stats.callbacks++;
+    sensor->stats.callback_us += tssTimeDiffUs(start_time);
+    return state;
+#else
+    return cb(sensor);
+#endif
+}
+
+//Latency histograms, see enum TSS_Latency. Command latency is started before the command is written
+//and recorded when its response is found, which without awaiting a response is once it is read.
+static inline void sensorInternalLatencyCommandStart(TSS_Sensor *sensor) {
+#if TSS_INSTRUMENTATION
+    sensor->latency.command_start = tssTimeGet();
+    sensor->latency.command_pending = true;
+#else
+    (void) sensor;
+#endif
+}
+
+static inline void sensorInternalLatencyCommandFound(TSS_Sensor *sensor) {
+#if TSS_INSTRUMENTATION
+    if(!sensor->latency.command_pending) return;
+    histogram_record(&sensor->latency.histograms[TSS_LATENCY_COMMAND], tssTimeDiffUs(sensor->latency.command_start));
+    sensor->latency.command_pending = false;
+#else
+    (void) sensor;
+#endif
+}
+
+//Stops a response that was never found from being recorded by an unrelated wait later
+static inline void sensorInternalLatencyCommandEnd(TSS_Sensor *sensor) {
+#if TSS_INSTRUMENTATION
+    sensor->latency.command_pending = false;
+#else
+    (void) sensor;
+#endif
+}
+
+static inline void sensorInternalLatencyAwait(TSS_Sensor *sensor, tss_time_t start_time) {
+#if TSS_INSTRUMENTATION
+    histogram_record(&sensor->latency.histograms[TSS_LATENCY_AWAIT], tssTimeDiffUs(start_time));
+#else
+    (void) sensor; (void) start_time;
+#endif
+}
+
+static inline void sensorInternalLatencyStreamStart(TSS_Sensor *sensor) {
+#if TSS_INSTRUMENTATION
+    sensor->latency.stream_epoch = tssTimeGet();
+    sensor->latency.stream_offset_valid = false;
+#else
+    (void) sensor;
+#endif
+}
+
+//Must be called after the header of the streaming packet is read
+static inline void sensorInternalLatencyStreamPacket(TSS_Sensor *sensor) {
+#if TSS_INSTRUMENTATION
+    uint32_t offset;
+    if(!sensor->_header_enabled || !(sensor->header_cfg.bitfield & TSS_HEADER_TIMESTAMP_BIT)) return;
+
+    //Both clocks are in microseconds and wrap at 32 bits, so compare them modulo 2^32
+    offset = (uint32_t)tssTimeDiffUs(sensor->latency.stream_epoch) - sensor->last_header.timestamp;
+    if(!sensor->latency.stream_offset_valid || (int32_t)(offset - sensor->latency.stream_offset) < 0) {
+        sensor->latency.stream_offset = offset;
+        sensor->latency.stream_offset_valid = true;
+    }
+    histogram_record(&sensor->latency.histograms[TSS_LATENCY_STREAM_AGE], offset - sensor->latency.stream_offset);
+#else
+    (void) sensor;
+#endif
+}
+
+//Traces a valid packet being found, along with how much was discarded to find it
+static inline void sensorInternalTraceReceived(TSS_Sensor *sensor, uint8_t cmd, uint16_t length) {
+    if(sensor->_resync_bytes > 0) {
+        TSS_TRACE(TSS_TRACE_RESYNC, sensor, 0, 0, (int32_t)sensor->_resync_bytes, NULL);
+        sensor->_resync_bytes = 0;
+    }
+    TSS_TRACE(TSS_TRACE_FRAME_RECEIVED, sensor, cmd, length, 0, NULL);
+}
+
+//Length of the last packet, if the header has it
+static inline uint16_t sensorInternalLastLength(const TSS_Sensor *sensor) {
+    return (sensor->_header_enabled && (sensor->header_cfg.bitfield & TSS_HEADER_LENGTH_BIT)) ? sensor->last_header.length : 0;
+}
+
 //Frequently used helper
 static inline void sensorInternalHandleHeader(TSS_Sensor *sensor) {
     if(sensor->_header_enabled) {
@@ -43,14 +145,17 @@ int sensorInternalUpdateLogStreaming(TSS_Sensor *sensor);
 int sensorInternalUpdateDebugMessage(TSS_Sensor *sensor);
 
 //Internal Utility
-//TODO: Move Me
 #include "tss/constants.h"
-struct TSS_Stream_Slot {
-    uint8_t cmd_num;
-    uint8_t param;
-    bool has_param;
-};
 
+//Returns the number of slots parsed or -1 if str is not a valid stream slot string
+int tssUtilParseStreamSlots(const char *str, struct TSS_Stream_Slot out[TSS_NUM_STREAM_SLOTS]);
 int tssUtilStreamSlotStringToCommands(const char * str, const struct TSS_Command* out[TSS_NUM_STREAM_SLOTS+1]);
 
+//Puts back the user's stream slots if a batch get replaced them. Must be called before anything that relies on them.
+#if TSS_MINIMAL_SENSOR
+static inline int sensorInternalRestoreStreamSlots(TSS_Sensor *sensor) { (void) sensor; return 0; }
+#else
+int sensorInternalRestoreStreamSlots(TSS_Sensor *sensor);
+#endif
+
 #endif /* __TSS_SENSOR_INTERNAL_H__ */
\ No newline at end of file
@@ -25,7 +25,8 @@ void tssCreateSensor(TSS_Sensor *sensor, struct TSS_Com_Class *com)
 {
     *sensor = (TSS_Sensor) {
         .com = com,
-        ._header_enabled = true
+        ._header_enabled = true,
+        .batch.programmed = TSS_BATCH_GET_USER_SLOTS
     };
 }
 
@@ -93,68 +94,133 @@ static int initFirmware(TSS_Sensor *sensor) {
 
 //----------------------------------CACHEING FUNCTIONS-------------------------------------------
 
-static int cacheHeader(TSS_Sensor *sensor) {
-    int err;
+//All of the settings needed to initialize the cache, requested as a single settings query
+#define CACHED_SETTINGS_KEY_STRING "header;debug_mode;stream_slots;serial_number"
+
+#define CACHED_SETTING_HEADER_BIT        0x01
+#define CACHED_SETTING_DEBUG_MODE_BIT    0x02
+#define CACHED_SETTING_STREAM_SLOTS_BIT  0x04
+#define CACHED_SETTING_SERIAL_NUMBER_BIT 0x08
+#define CACHED_SETTING_ALL_BITS          0x0F
+
+struct CachedSettingsQuery {
     uint8_t header;
-    err = sensorReadHeader(sensor, &header);
-    if(err) return err;
+    uint8_t debug_mode;
+    uint64_t serial_number;
+    char stream_slots[130];
+    uint8_t found;
+};
+
+static int writeSettingsNoCache(TSS_Sensor *sensor, const char **keys, uint8_t num_keys, const void **data);
+
+static int applyHeader(TSS_Sensor *sensor, uint8_t header) {
+    int err;
     if(header == sensor->header_cfg.bitfield && (header & REQUIRED_HEADER_BITS) == REQUIRED_HEADER_BITS) return TSS_SUCCESS; //Nothing to update
 
     //Do not allow changing the header if currently streaming to prevent misalignment issues
     if(sensorIsStreaming(sensor)) {
-        return sensorWriteHeader(sensor, sensor->header_cfg.bitfield);
+        header = sensor->header_cfg.bitfield;
+        return writeSettingsNoCache(sensor, (const char*[]){"header"}, 1, (const void*[]){&header});
     }
 
-    //Force required bits to be enabled
+    //Force required bits to be enabled. The write does not re-read the header
+    //since the value written is exactly what will be cached.
     if((header & REQUIRED_HEADER_BITS) != REQUIRED_HEADER_BITS) {
         header |= REQUIRED_HEADER_BITS;
-        err = sensorWriteHeader(sensor, header);
+        err = writeSettingsNoCache(sensor, (const char*[]){"header"}, 1, (const void*[]){&header});
+        if(err) return err;
     }
     sensor->header_cfg = tssHeaderInfoFromBitfield(header);
 
-    return err;
+    return TSS_SUCCESS;
+}
+
+static void buildSlotLayout(struct TSS_Stream_Slot_Layout *layout, const struct TSS_Stream_Slot *slots, uint8_t num_slots);
+
+//Reading the stream slots always restores the user's slots first, so these are always the user's slots
+static void applyStreamSlots(TSS_Sensor *sensor, const char *stream_slots) {
+    struct TSS_Stream_Slot slots[TSS_NUM_STREAM_SLOTS];
+    int num_slots;
+
+    num_slots = tssUtilParseStreamSlots(stream_slots, slots);
+    if(num_slots < 0) num_slots = 0;
+
+    buildSlotLayout(&sensor->batch.user, slots, (uint8_t)num_slots);
+    sensor->batch.programmed = TSS_BATCH_GET_USER_SLOTS;
+
+    memcpy(sensor->streaming.data.commands, sensor->batch.user.commands, sizeof(sensor->streaming.data.commands));
+    sensor->streaming.data.output_size = sensor->batch.user.output_size;
+}
+
+static int cacheHeader(TSS_Sensor *sensor) {
+    int err;
+    uint8_t header;
+    err = sensorReadHeader(sensor, &header);
+    if(err) return err;
+    return applyHeader(sensor, header);
 }
 
 static int cacheStreamSlots(TSS_Sensor *sensor) {
     char stream_slots[130];
     int err;
-    uint16_t output_size, size;
-    uint8_t i;
     
     err = sensorReadStreamSlots(sensor, stream_slots, sizeof(stream_slots));
     if(err) return err;
-    tssUtilStreamSlotStringToCommands(stream_slots, sensor->streaming.data.commands);
-    
-    output_size = 0;
-    for(i = 0; i < TSS_NUM_STREAM_SLOTS && sensor->streaming.data.commands[i] != NULL; i++) {
-        tssGetParamListSize(sensor->streaming.data.commands[i]->out_format, &size, &size);
-        output_size += size;
-    }
-    sensor->streaming.data.output_size = output_size;
+    applyStreamSlots(sensor, stream_slots);
 
     return TSS_SUCCESS;
 }
 
+static enum TSS_SettingsCallbackState cachedSettingsCallback(struct TSS_GetSettingsCallbackInfo info, void *user_data)
+{
+    struct CachedSettingsQuery *query = user_data;
+    int err;
+
+    if(tssSettingKeyCmp(info.key, "header") == 0) {
+        err = tssReadParams(info.com, info.setting->out_format, info.checksum, &query->header);
+        query->found |= CACHED_SETTING_HEADER_BIT;
+    }
+    else if(tssSettingKeyCmp(info.key, "debug_mode") == 0) {
+        err = tssReadParams(info.com, info.setting->out_format, info.checksum, &query->debug_mode);
+        query->found |= CACHED_SETTING_DEBUG_MODE_BIT;
+    }
+    else if(tssSettingKeyCmp(info.key, "stream_slots") == 0) {
+        err = tssReadParams(info.com, info.setting->out_format, info.checksum, query->stream_slots, (uint32_t)sizeof(query->stream_slots));
+        query->found |= CACHED_SETTING_STREAM_SLOTS_BIT;
+    }
+    else if(tssSettingKeyCmp(info.key, "serial_number") == 0) {
+        err = tssReadParams(info.com, info.setting->out_format, info.checksum, &query->serial_number);
+        query->found |= CACHED_SETTING_SERIAL_NUMBER_BIT;
+    }
+    else {
+        return TSS_SettingsCallbackStateIgnored;
+    }
+
+    return (err == TSS_SUCCESS) ? TSS_SettingsCallbackStateProcessed : TSS_SettingsCallbackStateError;
+}
+
 int sensorUpdateCachedSettings(TSS_Sensor *sensor) {
+    struct CachedSettingsQuery query;
     int err;
-    uint8_t value;
     
     sensor->dirty = false;
 
-    //Cache the header
-    err = cacheHeader(sensor);
+    //Read everything that needs cached in one request/response cycle instead of one per setting
+    query.found = 0;
+    err = sensorReadSettingsQuery(sensor, CACHED_SETTINGS_KEY_STRING, cachedSettingsCallback, &query);
     if(err) return err;
+    if(query.found != CACHED_SETTING_ALL_BITS) return TSS_ERR_RESPONSE_NOT_FOUND;
 
-    //Cache debug mode
-    err = sensorReadDebugMode(sensor, &value);
+    //Cache the header, only writes to the sensor if the required bits are missing
+    err = applyHeader(sensor, query.header);
     if(err) return err;
-    sensor->debug._immediate = value;
 
-    err = cacheStreamSlots(sensor);
-    if(err) return err;
+    //Cache debug mode
+    sensor->debug._immediate = query.debug_mode;
 
-    err = sensorReadSerialNumber(sensor, &sensor->serial_number);
-    if(err) return err;
+    applyStreamSlots(sensor, query.stream_slots);
+
+    sensor->serial_number = query.serial_number;
 
     return TSS_SUCCESS;
 }
@@ -190,8 +256,10 @@ int sensorInternalExecuteCommandCustomV(TSS_Sensor *sensor, const struct TSS_Com
     int err_or_checksum;
     err_or_checksum = checkDirty(sensor);
     if(err_or_checksum) return err_or_checksum;
+    sensorInternalLatencyCommandStart(sensor);
     tssWriteCommand(sensor->com, sensor->_header_enabled, command, input);
     err_or_checksum = read_func(sensor, command, outputs);
+    sensorInternalLatencyCommandEnd(sensor);
     if(err_or_checksum < 0) return err_or_checksum;
     return TSS_SUCCESS;
 }
@@ -201,8 +269,28 @@ int sensorInternalExecuteCommandCustomArray(TSS_Sensor *sensor, const struct TSS
     int err_or_checksum;
     err_or_checksum = checkDirty(sensor);
     if(err_or_checksum) return err_or_checksum;
+    sensorInternalLatencyCommandStart(sensor);
     tssWriteCommand(sensor->com, sensor->_header_enabled, command, input);
     err_or_checksum = read_func(sensor, command, outputs);
+    sensorInternalLatencyCommandEnd(sensor);
+    if(err_or_checksum < 0) return err_or_checksum;
+    return TSS_SUCCESS;
+}
+
+int sensorExecuteCommandFrame(TSS_Sensor *sensor, const struct TSS_Command_Frame *frame, void **outputs)
+{
+    int err_or_checksum;
+    err_or_checksum = checkDirty(sensor);
+    if(err_or_checksum) return err_or_checksum;
+    sensorInternalLatencyCommandStart(sensor);
+    tssWriteCommandFrame(sensor->com, sensor->_header_enabled, frame);
+    err_or_checksum = awaitCommandResponse(sensor, frame->command->num, frame->response_size, frame->response_size);
+    sensorInternalLatencyCommandEnd(sensor);
+    if(err_or_checksum != THREESPACE_AWAIT_COMMAND_FOUND) {
+        return TSS_ERR_RESPONSE_NOT_FOUND;
+    }
+    sensorInternalHandleHeader(sensor);
+    err_or_checksum = tssReadCommandFrameResponse(sensor->com, frame, outputs);
     if(err_or_checksum < 0) return err_or_checksum;
     return TSS_SUCCESS;
 }
@@ -250,6 +338,9 @@ inline static int baseReadSettings(TSS_Sensor *sensor, const char *key_string)
     uint16_t min_response_len;
     err = checkDirty(sensor);
     if(err) return err;
+    //Any query, such as "all", may include the stream slots, so never let it see the batch get slots
+    err = sensorInternalRestoreStreamSlots(sensor);
+    if(err) return err;
     err = tssGetSettingsWrite(sensor->com, true, key_string);
     if(err) return err;
 
@@ -332,12 +423,10 @@ inline static void checkAndCacheDebugMode(TSS_Sensor *sensor, const char **keys,
 }
 
 static const char * const K_HEADER_KEYS[] = { "header", "header_status", "header_timestamp", "header_echo", "header_checksum", "header_serial", "header_length" }; 
-int sensorWriteSettings(TSS_Sensor *sensor, const char **keys, uint8_t num_keys, 
+static int writeSettingsNoCache(TSS_Sensor *sensor, const char **keys, uint8_t num_keys, 
     const void **data)
 {
     int err;
-    err = checkDirty(sensor);
-    if(err) return err;
 
     //Must check for debug_mode=1 before sending the change to be able to properly handle
     //reading the response (since debug messages may be output immediately before the response happens)
@@ -353,7 +442,17 @@ int sensorWriteSettings(TSS_Sensor *sensor, const char **keys, uint8_t num_keys,
     uint32_t id;
     err = tssReadSettingsHeader(sensor->com, &id);
     if(err < 0) return err;
-    err = tssSetSettingsRead(sensor->com, &sensor->last_write_setting_response);
+    return tssSetSettingsRead(sensor->com, &sensor->last_write_setting_response);
+}
+
+int sensorWriteSettings(TSS_Sensor *sensor, const char **keys, uint8_t num_keys, 
+    const void **data)
+{
+    int err;
+    err = checkDirty(sensor);
+    if(err) return err;
+
+    err = writeSettingsNoCache(sensor, keys, num_keys, data);
     if(err) return err;
 
     //Check for keys that may need cacheing. This is done here to allow the user to not have
@@ -361,9 +460,12 @@ int sensorWriteSettings(TSS_Sensor *sensor, const char **keys, uint8_t num_keys,
     //for the settings protocol either since changes should be infrequent.
 
     if(keyInArray("default", keys, num_keys) >= 0) {
+        sensor->batch.programmed = TSS_BATCH_GET_USER_SLOTS;
         err = sensorUpdateCachedSettings(sensor);
     }
     else if(keyInArray("stream_slots", keys, num_keys) >= 0) {
+        //The user replaced the slots, so there is nothing from a batch get to restore
+        sensor->batch.programmed = TSS_BATCH_GET_USER_SLOTS;
         err = cacheStreamSlots(sensor);
     }
     else{
@@ -410,7 +512,10 @@ int sensorUpdateStreaming(TSS_Sensor *sensor)
 static inline void handleMisalignment(TSS_Sensor *sensor) {
     //Continously read 1 byte until aligned
     uint8_t tmp;
-    tss_com_read(sensor->com, 1, &tmp);
+    if(tss_com_read(sensor->com, 1, &tmp) == 1) {
+        SENSOR_STATS_ADD(sensor, misaligned_bytes, 1);
+        sensor->_resync_bytes++;
+    }
 }
 
 
@@ -439,8 +544,17 @@ static int peekValidatePacket(TSS_Sensor *sensor, const struct TSS_Header *heade
         //by the read operation. This does mean if it actually is invalid
         //more data will be lost then normal.
         //TODO: Add a warning mechanism here.
+        SENSOR_STATS_ADD(sensor, insufficient_buffer, 1);
         return TSS_SUCCESS; 
     }
+    if(err == TSS_ERR_CHECKSUM_MISMATCH) {
+        SENSOR_STATS_ADD(sensor, checksum_failures, 1);
+        TSS_TRACE(TSS_TRACE_ERROR, sensor, header->echo, header->length, err, "Packet checksum mismatch");
+    }
+    else if(err == TSS_ERR_UNEXPECTED_PACKET_LENGTH) {
+        SENSOR_STATS_ADD(sensor, length_failures, 1);
+        TSS_TRACE(TSS_TRACE_ERROR, sensor, header->echo, header->length, err, "Unexpected packet length");
+    }
     return err;
 }
 
@@ -458,6 +572,10 @@ static int awaitCommandResponse(TSS_Sensor *sensor, uint8_t cmd_num, uint16_t mi
 
         if(header.echo == cmd_num) {
             if(peekValidatePacket(sensor, &header, min_data_len, max_data_len) == 0) {
+                SENSOR_STATS_ADD(sensor, packets[TSS_STATS_PACKET_COMMAND], 1);
+                sensorInternalTraceReceived(sensor, cmd_num, header.length);
+                sensorInternalLatencyCommandFound(sensor);
+                sensorInternalLatencyAwait(sensor, start_time);
                 return THREESPACE_AWAIT_COMMAND_FOUND;
             }
             handleMisalignment(sensor);
@@ -470,6 +588,9 @@ static int awaitCommandResponse(TSS_Sensor *sensor, uint8_t cmd_num, uint16_t mi
         
     }
 
+    SENSOR_STATS_ADD(sensor, timeouts, 1);
+    TSS_TRACE(TSS_TRACE_ERROR, sensor, cmd_num, 0, TSS_ERR_TIMEOUT, "Timed out waiting for a command response");
+    sensorInternalLatencyAwait(sensor, start_time);
     return THREESPACE_AWAIT_COMMAND_TIMEOUT;
 }
 
@@ -520,6 +641,9 @@ static int awaitGetSettingResponse(TSS_Sensor *sensor, uint16_t min_len, bool ch
             if(num_read_or_err == TSS_ERR_INSUFFICIENT_BUFFER) {
                 //Not enough room to peek the full key, so have to assume it is a success...
                 //TODO: Add Warning
+                SENSOR_STATS_ADD(sensor, insufficient_buffer, 1);
+                SENSOR_STATS_ADD(sensor, packets[TSS_STATS_PACKET_READ_SETTINGS], 1);
+                sensorInternalTraceReceived(sensor, TSS_BINARY_READ_SETTINGS_HEADER_START_BYTE, 0);
                 return THREESPACE_AWAIT_COMMAND_FOUND;
             }
             //May just not have enough data yet
@@ -538,9 +662,13 @@ static int awaitGetSettingResponse(TSS_Sensor *sensor, uint16_t min_len, bool ch
         }
 
         //Good enough, this is more then likely a GetSetting response
+        SENSOR_STATS_ADD(sensor, packets[TSS_STATS_PACKET_READ_SETTINGS], 1);
+        sensorInternalTraceReceived(sensor, TSS_BINARY_READ_SETTINGS_HEADER_START_BYTE, 0);
         return THREESPACE_AWAIT_COMMAND_FOUND;
     }
 
+    SENSOR_STATS_ADD(sensor, timeouts, 1);
+    TSS_TRACE(TSS_TRACE_ERROR, sensor, TSS_BINARY_READ_SETTINGS_HEADER_START_BYTE, 0, TSS_ERR_TIMEOUT, "Timed out waiting for a settings response");
     return THREESPACE_AWAIT_COMMAND_TIMEOUT;
 }
 
@@ -580,8 +708,12 @@ static int awaitSetSettingResponse(TSS_Sensor *sensor, uint16_t num_keys)
             continue;
         }
 
+        SENSOR_STATS_ADD(sensor, packets[TSS_STATS_PACKET_WRITE_SETTINGS], 1);
+        sensorInternalTraceReceived(sensor, TSS_BINARY_WRITE_SETTINGS_HEADER_START_BYTE, TSS_BINARY_WRITE_SETTING_RESPONSE_LEN);
         return THREESPACE_AWAIT_COMMAND_FOUND;
     }
+    SENSOR_STATS_ADD(sensor, timeouts, 1);
+    TSS_TRACE(TSS_TRACE_ERROR, sensor, TSS_BINARY_WRITE_SETTINGS_HEADER_START_BYTE, 0, TSS_ERR_TIMEOUT, "Timed out waiting for a settings response");
     return THREESPACE_AWAIT_COMMAND_TIMEOUT;
 }
 
@@ -680,6 +812,192 @@ static int peekCheckDebugMessage(TSS_Sensor *sensor) {
 }
 
 
+//---------------------------------------BATCH GET-------------------------------------------------
+
+static inline bool slotsEqual(const struct TSS_Stream_Slot *a, const struct TSS_Stream_Slot *b) {
+    return a->cmd_num == b->cmd_num && a->has_param == b->has_param && (!a->has_param || a->param == b->param);
+}
+
+static void buildSlotLayout(struct TSS_Stream_Slot_Layout *layout, const struct TSS_Stream_Slot *slots, uint8_t num_slots)
+{
+    uint16_t size;
+    uint8_t i;
+
+    layout->num_slots = num_slots;
+    layout->output_size = 0;
+    for(i = 0; i < num_slots; i++) {
+        layout->slots[i] = slots[i];
+        layout->commands[i] = tssGetCommand(slots[i].cmd_num);
+        if(layout->commands[i] != NULL) {
+            tssGetParamListSize(layout->commands[i]->out_format, &size, &size);
+            layout->output_size += size;
+        }
+    }
+    layout->commands[num_slots] = NULL;
+}
+
+static bool layoutMatches(const struct TSS_Stream_Slot_Layout *layout, const struct TSS_Stream_Slot *slots, uint8_t num_slots)
+{
+    if(layout->last_used == 0 || layout->num_slots != num_slots) return false;
+    for(uint8_t i = 0; i < num_slots; i++) {
+        if(!slotsEqual(&layout->slots[i], &slots[i])) return false;
+    }
+    return true;
+}
+
+//Maps each slot in the layout to the index of the requested slot it provides, or 0xFF if not requested.
+//Returns false if the layout does not contain every requested slot.
+static bool mapSlotsToLayout(const struct TSS_Stream_Slot_Layout *layout, const struct TSS_Stream_Slot *slots, uint8_t num_slots, uint8_t map[TSS_NUM_STREAM_SLOTS])
+{
+    uint8_t i, j;
+
+    memset(map, 0xFF, TSS_NUM_STREAM_SLOTS);
+    for(i = 0; i < num_slots; i++) {
+        for(j = 0; j < layout->num_slots; j++) {
+            if(map[j] == 0xFF && slotsEqual(&layout->slots[j], &slots[i])) break;
+        }
+        if(j == layout->num_slots) return false;
+        map[j] = i;
+    }
+    return true;
+}
+
+static int programSlots(TSS_Sensor *sensor, const struct TSS_Stream_Slot_Layout *layout)
+{
+    char value[TSS_NUM_STREAM_SLOTS * 8 + 1]; //"255:255," per slot
+    size_t len;
+    int err;
+
+    len = 0;
+    value[0] = '\0';
+    for(uint8_t i = 0; i < layout->num_slots; i++) {
+        const struct TSS_Stream_Slot *slot = &layout->slots[i];
+        if(slot->has_param) {
+            len += (size_t)snprintf(value + len, sizeof(value) - len, "%u:%u,", slot->cmd_num, slot->param);
+        }
+        else {
+            len += (size_t)snprintf(value + len, sizeof(value) - len, "%u,", slot->cmd_num);
+        }
+    }
+    if(len > 0) value[len-1] = '\0'; //Remove the trailing separator
+    else memcpy(value, "255", sizeof("255")); //No slots
+
+    err = writeSettingsNoCache(sensor, (const char*[]) { "stream_slots" }, 1, (const void*[]) { value });
+    if(err) return err;
+    if(sensor->last_write_setting_response.error != 0) {
+        return TSS_ERR_INVALID_WRITE_KEY;
+    }
+    return TSS_SUCCESS;
+}
+
+int sensorInternalRestoreStreamSlots(TSS_Sensor *sensor)
+{
+    int err;
+    if(sensor->batch.programmed == TSS_BATCH_GET_USER_SLOTS) return TSS_SUCCESS;
+    err = programSlots(sensor, &sensor->batch.user);
+    if(err) return err;
+    sensor->batch.programmed = TSS_BATCH_GET_USER_SLOTS;
+    return TSS_SUCCESS;
+}
+
+int sensorBatchGetRestoreSlots(TSS_Sensor *sensor)
+{
+    int err;
+    err = checkDirty(sensor);
+    if(err) return err;
+    return sensorInternalRestoreStreamSlots(sensor);
+}
+
+//Finds the cached layout for the slots, replacing the least recently used one if not cached
+static uint8_t getCachedLayout(TSS_Sensor *sensor, const struct TSS_Stream_Slot *slots, uint8_t num_slots)
+{
+    uint8_t i, oldest;
+
+    oldest = 0;
+    for(i = 0; i < TSS_BATCH_GET_CACHE_SIZE; i++) {
+        if(layoutMatches(&sensor->batch.cache[i], slots, num_slots)) {
+            return i;
+        }
+        if(sensor->batch.cache[i].last_used < sensor->batch.cache[oldest].last_used) {
+            oldest = i;
+        }
+    }
+
+    buildSlotLayout(&sensor->batch.cache[oldest], slots, num_slots);
+    return oldest;
+}
+
+int sensorBatchGet(TSS_Sensor *sensor, const char *slots, void **outputs)
+{
+    struct TSS_Stream_Slot requested[TSS_NUM_STREAM_SLOTS];
+    uint16_t output_index[TSS_NUM_STREAM_SLOTS];
+    uint8_t map[TSS_NUM_STREAM_SLOTS];
+    struct TSS_Stream_Slot_Layout *layout;
+    const struct TSS_Command *command;
+    const struct TSS_Param *param;
+    uint16_t argindex;
+    uint8_t num_requested, i, index;
+    int num_slots, err_or_checksum;
+
+    err_or_checksum = checkDirty(sensor);
+    if(err_or_checksum) return err_or_checksum;
+    if(sensorIsStreaming(sensor)) return TSS_ERR_STREAMING_ACTIVE;
+
+    num_slots = tssUtilParseStreamSlots(slots, requested);
+    if(num_slots <= 0) return TSS_ERR_UNEXPECTED_CHARACTER;
+    num_requested = (uint8_t)num_slots;
+
+    //Find where each command's outputs start in the outputs array
+    argindex = 0;
+    for(i = 0; i < num_requested; i++) {
+        command = tssGetCommand(requested[i].cmd_num);
+        if(command == NULL || command->out_format == NULL) return TSS_ERR_UNEXPECTED_CHARACTER;
+        output_index[i] = argindex;
+        for(param = command->out_format; !TSS_PARAM_IS_NULL(param); param++) {
+            argindex = (uint16_t)(argindex + (TSS_PARAM_IS_STRING(param) ? 2 : 1)); //Strings also take their max length
+        }
+    }
+
+    //Use the slots already on the sensor if they contain everything requested
+    layout = (sensor->batch.programmed == TSS_BATCH_GET_USER_SLOTS) ? &sensor->batch.user : &sensor->batch.cache[sensor->batch.programmed];
+    if(!mapSlotsToLayout(layout, requested, num_requested, map)) {
+        index = getCachedLayout(sensor, requested, num_requested);
+        layout = &sensor->batch.cache[index];
+        layout->last_used = ++sensor->batch.use_count;
+        //Set before writing so the user's slots still get restored if the write partially failed
+        sensor->batch.programmed = index;
+        err_or_checksum = programSlots(sensor, layout);
+        if(err_or_checksum) return err_or_checksum;
+        mapSlotsToLayout(layout, requested, num_requested, map);
+    }
+    else if(layout != &sensor->batch.user) {
+        layout->last_used = ++sensor->batch.use_count;
+    }
+
+    sensorInternalLatencyCommandStart(sensor);
+    tssWriteCommand(sensor->com, sensor->_header_enabled, tssGetCommand(TSS_STREAMING_DATA_BATCH_COMMAND_NUM), NULL);
+    err_or_checksum = awaitCommandResponse(sensor, TSS_STREAMING_DATA_BATCH_COMMAND_NUM, layout->output_size, layout->output_size);
+    sensorInternalLatencyCommandEnd(sensor);
+    if(err_or_checksum != THREESPACE_AWAIT_COMMAND_FOUND) {
+        return TSS_ERR_RESPONSE_NOT_FOUND;
+    }
+    sensorInternalHandleHeader(sensor);
+
+    //Slots that were not requested are still in the response, so just skip past them
+    for(i = 0; i < layout->num_slots; i++) {
+        if(map[i] == 0xFF) {
+            err_or_checksum = tssReadCommandChecksumOnly(sensor->com, layout->commands[i]);
+        }
+        else {
+            argindex = output_index[map[i]];
+            err_or_checksum = tssReadCommandArray(sensor->com, layout->commands[i], &argindex, outputs);
+        }
+        if(err_or_checksum < 0) return err_or_checksum;
+    }
+
+    return TSS_SUCCESS;
+}
+
 //--------------------------------------BOOTLOADER----------------------------------------------
 int sensorBootloaderIsActive(TSS_Sensor *sensor, uint8_t *active)
 {
@@ -44,7 +44,7 @@ void sensorUpdateCachedSettings(TSS_Sensor *sensor) {
     //Warn if debug mode 1 is enabled
     sensorReadDebugMode(sensor, &value);
     if(value == 1) {
-        printf("WARNING: Immediate debug mode enabled, may corrupt data.\n");
+        TSS_TRACE(TSS_TRACE_WARNING, sensor, 0, 0, 0, "Immediate debug mode enabled, may corrupt data");
     }
     
     //Cache the header
@@ -71,9 +71,31 @@ int sensorInternalProcessStreamingBatch(TSS_Sensor *sensor, const struct TSS_Com
 int sensorInternalExecuteCommandCustomV(TSS_Sensor *sensor, const struct TSS_Command *command, const void **input, SensorInternalReadFunction read_func, va_list outputs)
 {
     int err_or_checksum;
+    sensorInternalLatencyCommandStart(sensor);
     tssWriteCommand(sensor->com, sensor->_header_enabled, command, input);
     err_or_checksum = read_func(sensor, command, outputs);
-    if(err_or_checksum < 0) return err_or_checksum;
+    if(err_or_checksum < 0) {
+        sensorInternalLatencyCommandEnd(sensor);
+        return err_or_checksum;
+    }
+    sensorInternalTraceReceived(sensor, command->num, sensorInternalLastLength(sensor));
+    sensorInternalLatencyCommandFound(sensor);
+    return TSS_SUCCESS;
+}
+
+int sensorExecuteCommandFrame(TSS_Sensor *sensor, const struct TSS_Command_Frame *frame, void **outputs)
+{
+    int err_or_checksum;
+    sensorInternalLatencyCommandStart(sensor);
+    tssWriteCommandFrame(sensor->com, sensor->_header_enabled, frame);
+    sensorInternalHandleHeader(sensor);
+    err_or_checksum = tssReadCommandFrameResponse(sensor->com, frame, outputs);
+    if(err_or_checksum < 0) {
+        sensorInternalLatencyCommandEnd(sensor);
+        return err_or_checksum;
+    }
+    sensorInternalTraceReceived(sensor, frame->command->num, sensorInternalLastLength(sensor));
+    sensorInternalLatencyCommandFound(sensor);
     return TSS_SUCCESS;
 }
 
@@ -2,19 +2,17 @@
 #include "tss/constants.h"
 #include "internal.h"
 
-int tssUtilStreamSlotStringToCommands(const char *str, const struct TSS_Command* out[TSS_NUM_STREAM_SLOTS+1])
+int tssUtilParseStreamSlots(const char *str, struct TSS_Stream_Slot out[TSS_NUM_STREAM_SLOTS])
 {
     uint8_t num_slots_read = 0;
-    struct TSS_Stream_Slot slot = {0};
+    struct TSS_Stream_Slot slot;
 
     while(*str && num_slots_read < TSS_NUM_STREAM_SLOTS) {
+        slot = (struct TSS_Stream_Slot) {0};
         slot.cmd_num = (uint8_t)strtol(str, (char**)&str, 10);
         if(*str == ':') {
             str++;
-            
-            // cppcheck-suppress unreadVariable
             slot.param = (uint8_t)strtol(str, (char**)&str, 10);
-            // cppcheck-suppress unreadVariable
             slot.has_param = true;
         }
 
@@ -23,20 +21,38 @@ int tssUtilStreamSlotStringToCommands(const char *str, const struct TSS_Command*
             break;
         }
         
-        num_slots_read++;
-
-        //Add to the output
-        out[num_slots_read-1] = tssGetCommand(slot.cmd_num);
+        out[num_slots_read++] = slot;
         
-        //Validate and advance string
+        //Validate and advance string. The final slot may be the end of the string.
+        if(*str == '\0') {
+            break;
+        }
         if(*str != ',') {
             return -1;
         }
         str++;
     }
 
+    return num_slots_read;
+}
+
+int tssUtilStreamSlotStringToCommands(const char *str, const struct TSS_Command* out[TSS_NUM_STREAM_SLOTS+1])
+{
+    struct TSS_Stream_Slot slots[TSS_NUM_STREAM_SLOTS];
+    int num_slots;
+
+    num_slots = tssUtilParseStreamSlots(str, slots);
+    if(num_slots < 0) {
+        out[0] = NULL;
+        return -1;
+    }
+
+    for(int i = 0; i < num_slots; i++) {
+        out[i] = tssGetCommand(slots[i].cmd_num);
+    }
+
     //Null terminate the command list
-    out[num_slots_read] = NULL;
+    out[num_slots] = NULL;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,4 +1,5 @@
 #include "tss/sys/stdinc.h"
+#include <stdint.h>
 #if TSS_STDC_AVAILABLE == 0
 
 size_t strlen(const char *string)
@@ -28,6 +29,28 @@ int tolower(int c)
     return c;
 }
 
+void *memcpy(void *dest, const void *src, size_t count)
+{
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    while(count--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+void *memchr(const void *ptr, int value, size_t count)
+{
+    const uint8_t *p = ptr;
+    while(count--) {
+        if(*p == (uint8_t)value) {
+            return (void*)p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
 #endif
 
 size_t tssStrLenUntil(const char *str, char value) {
@@ -23,6 +23,16 @@
         return (uint32_t)((((double)(time.QuadPart - start_time)) / freq.QuadPart) * 1000);
     }
 
+    static uint64_t defaultDiffTimeUs(tss_time_t start_time)
+    {
+        LARGE_INTEGER time;
+        LARGE_INTEGER freq;
+        QueryPerformanceCounter(&time);
+        QueryPerformanceFrequency(&freq);
+
+        return (uint64_t)((((double)(time.QuadPart - start_time)) / freq.QuadPart) * 1000000);
+    }
+
 // Detect macOS
 #elif defined(__APPLE__) && defined(__MACH__)
 
@@ -47,16 +57,26 @@
         return (uint32_t)((now - start_time) / 1000000ULL);
     }
 
+    static uint64_t defaultDiffTimeUs(tss_time_t start_time)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+        return (now - start_time) / 1000ULL;
+    }
+
 #endif
 
 
 #ifdef DEFAULT_IMPLEMENTATION
 static tss_time_t (*getTimeFunc)(void) = defaultGetTime;
 static uint32_t (*diffTimeFunc)(tss_time_t) = defaultDiffTime;
+static uint64_t (*diffTimeUsFunc)(tss_time_t) = defaultDiffTimeUs;
 #else
 #include <stddef.h>
 static tss_time_t (*getTimeFunc)(void) = NULL;
 static uint32_t (*diffTimeFunc)(tss_time_t) = NULL;
+static uint64_t (*diffTimeUsFunc)(tss_time_t) = NULL;
 #endif
 
 /// @brief Retrieves the current system time
@@ -75,8 +95,24 @@ uint32_t tssTimeDiff(tss_time_t start_time)
     return diffTimeFunc(start_time);
 }
 
+uint64_t tssTimeDiffUs(tss_time_t start_time)
+{
+    if(diffTimeUsFunc == NULL) {
+        return (uint64_t)diffTimeFunc(start_time) * 1000;
+    }
+    return diffTimeUsFunc(start_time);
+}
+
 void tssTimeSetFunctions(tss_time_t (*timeGet)(void), uint32_t (*timeDiff)(tss_time_t))
 {
     getTimeFunc = timeGet;
     diffTimeFunc = timeDiff;
+
+    //The default may not match the units of the new time functions
+    diffTimeUsFunc = NULL;
+}
+
+void tssTimeSetDiffUsFunction(uint64_t (*timeDiffUs)(tss_time_t))
+{
+    diffTimeUsFunc = timeDiffUs;
 }
\ No newline at end of file
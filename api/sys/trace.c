@@ -0,0 +1,80 @@
+#include "tss/sys/trace.h"
+#include "tss/errors.h"
+#include "trace_internal.h"
+
+struct TSS_Trace_Hooks tssInternalTraceHooks;
+
+void tssTraceSetHooks(const struct TSS_Trace_Hooks *hooks)
+{
+    if(hooks == NULL) {
+        tssInternalTraceHooks = (struct TSS_Trace_Hooks) {0};
+        return;
+    }
+    tssInternalTraceHooks = *hooks;
+}
+
+void tssTrace(enum TSS_Trace_Event_Id id, const void *source, uint8_t cmd, uint16_t length, int32_t value, const char *message)
+{
+    struct TSS_Trace_Event event;
+    TssTraceCallback cb = tssInternalTraceHooks.callbacks[id];
+    if(cb == NULL) return;
+
+    event = (struct TSS_Trace_Event) {
+        .id = id,
+        .source = source,
+        .cmd = cmd,
+        .length = length,
+        .value = value,
+        .message = message
+    };
+    cb(&event, tssInternalTraceHooks.user_data);
+}
+
+//---------------------------------TRACE RING-----------------------------------------
+
+//Not synchronized, the ring is single threaded only (see trace.h)
+static void traceRingRecord(const struct TSS_Trace_Event *event, void *user_data)
+{
+    struct TSS_Trace_Ring *ring = user_data;
+    struct TSS_Trace_Record *record = &ring->records[ring->w_index++ & (ring->capacity - 1)];
+    record->time_us = tssTimeDiffUs(ring->start_time);
+    record->value = event->value;
+    record->length = event->length;
+    record->id = (uint8_t)event->id;
+    record->cmd = event->cmd;
+}
+
+int tssTraceRingCreate(struct TSS_Trace_Ring *ring, struct TSS_Trace_Record *records, size_t capacity)
+{
+    if(capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return TSS_ERR_INVALID_SIZE;
+    }
+    *ring = (struct TSS_Trace_Ring) {
+        .records = records,
+        .capacity = capacity,
+        .w_index = 0,
+        .start_time = tssTimeGet()
+    };
+    return TSS_SUCCESS;
+}
+
+void tssTraceRingHooks(struct TSS_Trace_Ring *ring, struct TSS_Trace_Hooks *out)
+{
+    for(size_t i = 0; i < TSS_TRACE_EVENT_COUNT; i++) {
+        out->callbacks[i] = traceRingRecord;
+    }
+    out->user_data = ring;
+}
+
+size_t tssTraceRingRead(const struct TSS_Trace_Ring *ring, struct TSS_Trace_Record *out, size_t max)
+{
+    size_t count, start;
+    count = (ring->w_index < ring->capacity) ? ring->w_index : ring->capacity;
+    if(count > max) count = max;
+
+    start = ring->w_index - count;
+    for(size_t i = 0; i < count; i++) {
+        out[i] = ring->records[(start + i) & (ring->capacity - 1)];
+    }
+    return count;
+}
@@ -0,0 +1,16 @@
+#ifndef __TSS_TRACE_INTERNAL_H__
+#define __TSS_TRACE_INTERNAL_H__
+
+#include "tss/sys/trace.h"
+
+//The hooks set by tssTraceSetHooks. Only visible inside the API so the check
+//for whether an event is traced does not need a function call.
+extern struct TSS_Trace_Hooks tssInternalTraceHooks;
+
+#define TSS_TRACE(id, source, cmd, length, value, message) do { \
+    if(tssInternalTraceHooks.callbacks[id] != NULL) { \
+        tssTrace(id, source, cmd, length, value, message); \
+    } \
+} while(0)
+
+#endif /* __TSS_TRACE_INTERNAL_H__ */
@@ -0,0 +1,469 @@
+#include "tss/tools/log_parser.h"
+#include "tss/sys/endian.h"
+#include "tss/sys/stdinc.h"
+#include "tss/errors.h"
+#include "../sensor/internal.h"
+
+//Longest log_slots setting, "255:255," for every slot
+#define LOG_SLOTS_MAX_LEN (TSS_NUM_STREAM_SLOTS * 8 + 1)
+
+//----------------------------------------FORMAT-------------------------------------------
+
+int tssLogFormatCreate(struct TSS_Log_Format *out, const char *log_slots, uint8_t data_mode, uint8_t header_bitfield, bool output_settings)
+{
+    struct TSS_Stream_Slot slots[TSS_NUM_STREAM_SLOTS];
+    const struct TSS_Param *param;
+    uint16_t min_size, max_size;
+    int num_slots, i;
+
+    *out = (struct TSS_Log_Format) {
+        .data_mode = data_mode,
+        .settings_preamble = output_settings,
+        .header = tssHeaderInfoFromBitfield(header_bitfield),
+    };
+    if(data_mode != TSS_LOG_DATA_MODE_BINARY && data_mode != TSS_LOG_DATA_MODE_ASCII) return TSS_ERR_INVALID_FORMAT;
+
+    num_slots = tssUtilParseStreamSlots(log_slots, slots);
+    if(num_slots < 0) return TSS_ERR_INVALID_FORMAT;
+
+    for(i = 0; i < num_slots; i++) {
+        out->commands[i] = tssGetCommand(slots[i].cmd_num);
+        if(out->commands[i] == NULL) return TSS_ERR_INVALID_FORMAT;
+        for(param = out->commands[i]->out_format; !TSS_PARAM_IS_NULL(param); param++) {
+            //Strings would make records vary in size
+            if(TSS_PARAM_IS_STRING(param) || out->num_fields == TSS_LOG_MAX_FIELDS) return TSS_ERR_INVALID_SIZE;
+            out->fields[out->num_fields++] = param;
+        }
+        tssGetParamListSize(out->commands[i]->out_format, &min_size, &max_size);
+        out->data_size = (uint16_t)(out->data_size + max_size);
+    }
+    if(out->header.size + out->data_size > TSS_LOG_MAX_RECORD_LEN) return TSS_ERR_INVALID_SIZE;
+
+    return TSS_SUCCESS;
+}
+
+int tssLogFormatFromSensor(TSS_Sensor *sensor, struct TSS_Log_Format *out)
+{
+    char log_slots[LOG_SLOTS_MAX_LEN];
+    uint8_t data_mode, header_enabled, output_settings, header;
+    int err;
+
+    err = sensorReadLogSlots(sensor, log_slots, sizeof(log_slots));
+    if(err) return err;
+    err = sensorReadLogDataMode(sensor, &data_mode);
+    if(err) return err;
+    err = sensorReadLogHeaderEnabled(sensor, &header_enabled);
+    if(err) return err;
+    err = sensorReadLogOutputSettings(sensor, &output_settings);
+    if(err) return err;
+    err = sensorReadHeader(sensor, &header);
+    if(err) return err;
+
+    return tssLogFormatCreate(out, log_slots, data_mode, header_enabled ? header : 0, output_settings != 0);
+}
+
+//----------------------------------------INDEX-------------------------------------------
+
+//Drops every other entry, keeping those on multiples of the doubled interval
+static void compactIndex(struct TSS_Log_Parser *parser)
+{
+    size_t i, count = 0;
+
+    parser->index_interval *= 2;
+    for(i = 0; i < parser->index_count; i++) {
+        if(parser->index[i].record % parser->index_interval == 0) {
+            parser->index[count++] = parser->index[i];
+        }
+    }
+    parser->index_count = count;
+}
+
+static void indexRecord(struct TSS_Log_Parser *parser, uint64_t offset, uint64_t timestamp)
+{
+    uint64_t record = parser->records;
+
+    if(parser->index_capacity == 0 || record % parser->index_interval != 0) return;
+
+    //Already indexed when parsing again after a seek
+    if(parser->index_count > 0 && parser->index[parser->index_count - 1].record >= record) return;
+
+    if(parser->index_count == parser->index_capacity) {
+        //Too small to thin out, so it only ever holds the first record
+        if(parser->index_capacity < 2) return;
+        compactIndex(parser);
+        if(record % parser->index_interval != 0) return;
+    }
+
+    parser->index[parser->index_count++] = (struct TSS_Log_Index_Entry) {
+        .record = record,
+        .offset = offset,
+        .timestamp = timestamp,
+    };
+}
+
+const struct TSS_Log_Index_Entry* tssLogIndexFindTime(const struct TSS_Log_Parser *parser, uint64_t timestamp)
+{
+    size_t low = 0, high, mid;
+
+    if(parser->index_count == 0) return NULL;
+    high = parser->index_count - 1;
+    while(low < high) {
+        mid = low + (high - low + 1) / 2;
+        if(parser->index[mid].timestamp <= timestamp) low = mid;
+        else high = mid - 1;
+    }
+    return &parser->index[low];
+}
+
+const struct TSS_Log_Index_Entry* tssLogIndexFindRecord(const struct TSS_Log_Parser *parser, uint64_t record)
+{
+    size_t low = 0, high, mid;
+
+    if(parser->index_count == 0) return NULL;
+    high = parser->index_count - 1;
+    while(low < high) {
+        mid = low + (high - low + 1) / 2;
+        if(parser->index[mid].record <= record) low = mid;
+        else high = mid - 1;
+    }
+    return &parser->index[low];
+}
+
+//----------------------------------------PARSER-------------------------------------------
+
+void tssLogParserCreate(struct TSS_Log_Parser *parser, const struct TSS_Log_Format *format,
+    TssLogRecordCallback cb, void *user_data,
+    struct TSS_Log_Index_Entry *index, size_t index_capacity, uint64_t index_interval)
+{
+    *parser = (struct TSS_Log_Parser) {
+        .format = *format,
+        .cb = cb,
+        .user_data = user_data,
+        .in_preamble = format->settings_preamble,
+        .index = index,
+        .index_capacity = (index == NULL) ? 0 : index_capacity,
+        .index_interval = (index_interval == 0) ? 1 : index_interval,
+    };
+}
+
+void tssLogParserSeek(struct TSS_Log_Parser *parser, const struct TSS_Log_Index_Entry *entry)
+{
+    parser->pending_len = 0;
+    parser->discarding_line = false;
+    parser->in_preamble = false;
+    parser->offset = entry->offset;
+    parser->records = entry->record;
+    parser->last_timestamp = (uint32_t)entry->timestamp;
+    parser->timestamp_high = entry->timestamp & ~(uint64_t)UINT32_MAX;
+    parser->have_timestamp = (parser->format.header.bitfield & TSS_HEADER_TIMESTAMP_BIT) != 0;
+}
+
+//Reads the next comma separated unsigned value. Returns false if there is none.
+static bool asciiNextUnsigned(const char **str, const char *end, uint64_t *out)
+{
+    const char *cur = *str;
+    uint64_t value = 0;
+    bool any = false;
+
+    while(cur < end && *cur == ' ') cur++;
+    while(cur < end && *cur >= '0' && *cur <= '9') {
+        value = value * 10 + (uint64_t)(*cur - '0');
+        any = true;
+        cur++;
+    }
+    if(!any) return false;
+    while(cur < end && *cur == ' ') cur++;
+    if(cur < end) {
+        if(*cur != ',') return false;
+        cur++;
+    }
+    *str = cur;
+    *out = value;
+    return true;
+}
+
+//Parses the header values at the start of an ASCII line, in the same order as the binary header
+static bool asciiParseHeader(const struct TSS_Header_Info *info, const char **str, const char *end, struct TSS_Header *out)
+{
+    uint64_t value;
+
+    if((info->bitfield & TSS_HEADER_STATUS_BIT)) {
+        if(!asciiNextUnsigned(str, end, &value)) return false;
+        out->status = (int8_t)value;
+    }
+    if((info->bitfield & TSS_HEADER_TIMESTAMP_BIT)) {
+        if(!asciiNextUnsigned(str, end, &value)) return false;
+        out->timestamp = (uint32_t)value;
+    }
+    if((info->bitfield & TSS_HEADER_ECHO_BIT)) {
+        if(!asciiNextUnsigned(str, end, &value)) return false;
+        out->echo = (uint8_t)value;
+    }
+    if((info->bitfield & TSS_HEADER_CHECKSUM_BIT)) {
+        if(!asciiNextUnsigned(str, end, &value)) return false;
+        out->checksum = (uint8_t)value;
+    }
+    if((info->bitfield & TSS_HEADER_SERIAL_BIT)) {
+        if(!asciiNextUnsigned(str, end, &value)) return false;
+        out->serial = (uint32_t)value;
+    }
+    if((info->bitfield & TSS_HEADER_LENGTH_BIT)) {
+        if(!asciiNextUnsigned(str, end, &value)) return false;
+        out->length = (uint16_t)value;
+    }
+    return true;
+}
+
+//Parses one complete record. Returns the callback's result.
+static int parseRecord(struct TSS_Log_Parser *parser, const uint8_t *bytes, uint16_t len, uint64_t offset)
+{
+    const struct TSS_Log_Format *format = &parser->format;
+    struct TSS_Log_Record record = { 0 };
+    const char *str, *end;
+
+    if(format->data_mode == TSS_LOG_DATA_MODE_BINARY) {
+        tssHeaderFromBytes(&format->header, (uint8_t*)bytes, &record.header);
+        record.data = bytes + format->header.size;
+        record.len = format->data_size;
+    }
+    else {
+        //Lines may end in \r\n
+        while(len > 0 && (bytes[len - 1] == '\n' || bytes[len - 1] == '\r')) len--;
+        if(len == 0) return 0;
+
+        str = (const char*)bytes;
+        end = str + len;
+        if(!asciiParseHeader(&format->header, &str, end, &record.header)) {
+            parser->malformed_records++;
+            return 0;
+        }
+        record.data = (const uint8_t*)str;
+        record.len = (uint16_t)(end - str);
+    }
+
+    if(format->header.bitfield & TSS_HEADER_TIMESTAMP_BIT) {
+        if(parser->have_timestamp && record.header.timestamp < parser->last_timestamp) {
+            parser->timestamp_high += (uint64_t)UINT32_MAX + 1;
+        }
+        parser->last_timestamp = record.header.timestamp;
+        parser->have_timestamp = true;
+        record.timestamp = parser->timestamp_high | record.header.timestamp;
+    }
+
+    record.index = parser->records;
+    record.offset = offset;
+    indexRecord(parser, offset, record.timestamp);
+    parser->records++;
+
+    if(parser->cb == NULL) return 0;
+    return parser->cb(parser, &record);
+}
+
+static int feedBinary(struct TSS_Log_Parser *parser, const uint8_t **data, size_t *len)
+{
+    uint16_t record_size, copy_len;
+    uint64_t offset;
+
+    record_size = (uint16_t)(parser->format.header.size + parser->format.data_size);
+
+    //Parse in place when the whole record is available
+    if(parser->pending_len == 0 && *len >= record_size) {
+        offset = parser->offset;
+        parser->offset += record_size;
+        *data += record_size;
+        *len -= record_size;
+        return parseRecord(parser, *data - record_size, record_size, offset);
+    }
+
+    copy_len = (uint16_t)(record_size - parser->pending_len);
+    if(copy_len > *len) copy_len = (uint16_t)*len;
+    memcpy(parser->pending + parser->pending_len, *data, copy_len);
+    parser->pending_len = (uint16_t)(parser->pending_len + copy_len);
+    parser->offset += copy_len;
+    *data += copy_len;
+    *len -= copy_len;
+
+    if(parser->pending_len < record_size) return 0;
+    parser->pending_len = 0;
+    return parseRecord(parser, parser->pending, record_size, parser->offset - record_size);
+}
+
+static int feedAscii(struct TSS_Log_Parser *parser, const uint8_t **data, size_t *len)
+{
+    const uint8_t *newline;
+    size_t line_len;
+    uint16_t record_len;
+
+    newline = memchr(*data, '\n', *len);
+    line_len = (newline != NULL) ? (size_t)(newline - *data) + 1 : *len;
+
+    if(parser->discarding_line) {
+        parser->discarding_line = (newline == NULL);
+        parser->offset += line_len;
+        *data += line_len;
+        *len -= line_len;
+        return 0;
+    }
+
+    //Parse in place when the whole line is available
+    if(parser->pending_len == 0 && newline != NULL && line_len <= TSS_LOG_MAX_RECORD_LEN) {
+        parser->offset += line_len;
+        *data += line_len;
+        *len -= line_len;
+        return parseRecord(parser, *data - line_len, (uint16_t)line_len, parser->offset - line_len);
+    }
+
+    if(parser->pending_len + line_len > TSS_LOG_MAX_RECORD_LEN) {
+        parser->malformed_records++;
+        parser->pending_len = 0;
+        parser->discarding_line = (newline == NULL);
+        parser->offset += line_len;
+        *data += line_len;
+        *len -= line_len;
+        return 0;
+    }
+
+    memcpy(parser->pending + parser->pending_len, *data, line_len);
+    parser->pending_len = (uint16_t)(parser->pending_len + line_len);
+    parser->offset += line_len;
+    *data += line_len;
+    *len -= line_len;
+
+    if(newline == NULL) return 0;
+    record_len = parser->pending_len;
+    parser->pending_len = 0;
+    return parseRecord(parser, parser->pending, record_len, parser->offset - record_len);
+}
+
+int tssLogParserFeed(struct TSS_Log_Parser *parser, const uint8_t *data, size_t len)
+{
+    const uint8_t *newline;
+    size_t skip_len;
+    int result;
+
+    while(len > 0) {
+        if(parser->in_preamble) {
+            newline = memchr(data, '\n', len);
+            skip_len = (newline != NULL) ? (size_t)(newline - data) + 1 : len;
+            parser->in_preamble = (newline == NULL);
+            parser->offset += skip_len;
+            data += skip_len;
+            len -= skip_len;
+            continue;
+        }
+
+        if(parser->format.data_mode == TSS_LOG_DATA_MODE_BINARY) {
+            result = feedBinary(parser, &data, &len);
+        }
+        else {
+            result = feedAscii(parser, &data, &len);
+        }
+        if(result) {
+            parser->stop_result = result;
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+int tssLogParserFeedFileStreaming(struct TSS_Log_Parser *parser, TSS_Sensor *sensor, uint8_t *out, uint16_t size, uint16_t *out_len)
+{
+    int num_read;
+
+    *out_len = 0;
+    num_read = sensorProcessFileStreamingCallbackOutput(sensor, out, size);
+    if(num_read < 0) return num_read;
+    *out_len = (uint16_t)num_read;
+    //The callback's result may be negative too, so it is reported separately from read errors
+    if(tssLogParserFeed(parser, out, (size_t)num_read) != 0) {
+        return TSS_LOG_PARSER_STOPPED;
+    }
+    return 0;
+}
+
+//----------------------------------------DECODING-------------------------------------------
+
+#if TSS_INCLUDE_PARAM_TYPE && TSS_STDC_AVAILABLE
+//Parses one ASCII value into the type of the param
+static bool asciiReadValue(const char **str, const char *end, const struct TSS_Param *param, uint8_t *out)
+{
+    char token[48];
+    size_t len = 0;
+    const char *cur = *str;
+    char *token_end;
+
+    while(cur < end && *cur == ' ') cur++;
+    while(cur < end && *cur != ',' && len < sizeof(token) - 1) {
+        token[len++] = *cur++;
+    }
+    while(len > 0 && token[len - 1] == ' ') len--;
+    if(len == 0) return false;
+    token[len] = '\0';
+    if(cur < end) {
+        if(*cur != ',') return false;
+        cur++;
+    }
+
+    switch(param->type) {
+    case TSS_ParamTypeFloat: { float v = strtof(token, &token_end); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeDouble: { double v = strtod(token, &token_end); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeU8: { uint8_t v = (uint8_t)strtoul(token, &token_end, 10); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeU16: { uint16_t v = (uint16_t)strtoul(token, &token_end, 10); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeU32: { uint32_t v = (uint32_t)strtoul(token, &token_end, 10); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeU64: { uint64_t v = (uint64_t)strtoull(token, &token_end, 10); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeS8: { int8_t v = (int8_t)strtol(token, &token_end, 10); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeS16: { int16_t v = (int16_t)strtol(token, &token_end, 10); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeS32: { int32_t v = (int32_t)strtol(token, &token_end, 10); memcpy(out, &v, sizeof(v)); break; }
+    case TSS_ParamTypeS64: { int64_t v = (int64_t)strtoll(token, &token_end, 10); memcpy(out, &v, sizeof(v)); break; }
+    default: return false;
+    }
+    if(*token_end != '\0') return false;
+
+    *str = cur;
+    return true;
+}
+#endif
+
+int tssLogRecordRead(const struct TSS_Log_Parser *parser, const struct TSS_Log_Record *record, void **outputs)
+{
+    const struct TSS_Log_Format *format = &parser->format;
+    const struct TSS_Param *param;
+    const uint8_t *data = record->data;
+    uint16_t field_size;
+    uint8_t i, j;
+
+    if(format->data_mode == TSS_LOG_DATA_MODE_BINARY) {
+        for(i = 0; i < format->num_fields; i++) {
+            param = format->fields[i];
+            field_size = (uint16_t)(param->count * param->size);
+            memcpy(outputs[i], data, field_size);
+            if(TSS_ENDIAN_IS_BIG) {
+                for(j = 0; j < param->count; j++) {
+                    tssSwapEndianess((uint8_t*)outputs[i] + j * param->size, param->size);
+                }
+            }
+            data += field_size;
+        }
+        return TSS_SUCCESS;
+    }
+
+#if TSS_INCLUDE_PARAM_TYPE && TSS_STDC_AVAILABLE
+    {
+        const char *str = (const char*)data;
+        const char *end = str + record->len;
+        for(i = 0; i < format->num_fields; i++) {
+            param = format->fields[i];
+            for(j = 0; j < param->count; j++) {
+                if(!asciiReadValue(&str, end, param, (uint8_t*)outputs[i] + j * param->size)) {
+                    return TSS_ERR_INVALID_FORMAT;
+                }
+            }
+        }
+        return TSS_SUCCESS;
+    }
+#else
+    //The type of each value and the standard library are needed to parse it
+    return TSS_ERR_INVALID_FORMAT;
+#endif
+}
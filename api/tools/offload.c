@@ -0,0 +1,775 @@
+#include "tss/tools/offload.h"
+#include "tss/errors.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#if TSS_OFFLOAD_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+//Most packets handled from one sensor before moving on to the next
+#define OFFLOAD_MAX_PACKETS_PER_POLL 64
+
+//Sleep when no sensor had anything to read
+#define OFFLOAD_IDLE_SLEEP_US 200
+
+enum OffloadJobState {
+    OFFLOAD_JOB_START,      //Needs file streaming started, or resumed from received
+    OFFLOAD_JOB_STREAMING,
+    OFFLOAD_JOB_FLUSHING,   //Nothing more to receive, waiting on writes to finish
+    OFFLOAD_JOB_DONE,
+};
+
+struct TSS_Offload_Buffer {
+    uint8_t *data;
+    size_t len;
+    uint64_t file_offset;
+    struct TSS_Offload_Job *job;
+
+    struct iovec iov;   //What is left to write
+    ssize_t result;     //Bytes written, or -errno
+    struct TSS_Offload_Buffer *next;
+};
+
+#if TSS_OFFLOAD_IO_URING
+struct OffloadRing {
+    int fd;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_map_size;
+    size_t cq_map_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_map_size;
+
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+#endif
+
+struct OffloadPool {
+    pthread_t *threads;
+    uint32_t num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    struct TSS_Offload_Buffer *submit_head;
+    struct TSS_Offload_Buffer *submit_tail;
+    struct TSS_Offload_Buffer *done;
+    bool stopping;
+};
+
+struct OffloadEngine {
+    struct TSS_Offload_Config config;
+
+    uint8_t *memory;
+    struct TSS_Offload_Buffer *buffers;
+    struct TSS_Offload_Buffer *free_list;
+    uint32_t in_flight;
+    struct TSS_Offload_Buffer *failed; //Writes that could not be submitted, completed on the next reap
+
+    bool use_ring;
+#if TSS_OFFLOAD_IO_URING
+    struct OffloadRing ring;
+#endif
+    struct OffloadPool pool;
+};
+
+static void sleepUs(uint64_t us)
+{
+    struct timespec ts = {
+        .tv_sec = (time_t)(us / 1000000),
+        .tv_nsec = (long)(us % 1000000) * 1000
+    };
+    nanosleep(&ts, NULL);
+}
+
+//-------------------------------------IO_URING------------------------------------------
+
+#if TSS_OFFLOAD_IO_URING
+static int ringSetup(struct OffloadRing *ring, uint32_t entries)
+{
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if(ring->fd < 0) return -1;
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    //Newer kernels map both rings together
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        if(ring->cq_map_size > ring->sq_map_size) ring->sq_map_size = ring->cq_map_size;
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ptr == MAP_FAILED) goto fail_fd;
+
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    }
+    else {
+        ring->cq_ptr = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ptr == MAP_FAILED) goto fail_sq;
+    }
+
+    ring->sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED) goto fail_cq;
+
+    ring->sq_tail = (unsigned*)((uint8_t*)ring->sq_ptr + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)((uint8_t*)ring->sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)((uint8_t*)ring->sq_ptr + params.sq_off.array);
+    ring->cq_head = (unsigned*)((uint8_t*)ring->cq_ptr + params.cq_off.head);
+    ring->cq_tail = (unsigned*)((uint8_t*)ring->cq_ptr + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)((uint8_t*)ring->cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)((uint8_t*)ring->cq_ptr + params.cq_off.cqes);
+    return 0;
+
+fail_cq:
+    if(ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_map_size);
+fail_sq:
+    munmap(ring->sq_ptr, ring->sq_map_size);
+fail_fd:
+    close(ring->fd);
+    return -1;
+}
+
+static void ringCleanup(struct OffloadRing *ring)
+{
+    munmap(ring->sqes, ring->sqes_map_size);
+    if(ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_map_size);
+    munmap(ring->sq_ptr, ring->sq_map_size);
+    close(ring->fd);
+}
+
+static int ringEnter(struct OffloadRing *ring, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    int result;
+    do {
+        result = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete, flags, NULL, 0);
+    } while(result < 0 && errno == EINTR);
+    return result;
+}
+
+//Never more writes in flight than buffers, and the ring has an entry for each, so there is always room.
+//Returns -errno if it could not be submitted.
+static int ringSubmit(struct OffloadRing *ring, struct TSS_Offload_Buffer *buffer)
+{
+    struct io_uring_sqe *sqe;
+    unsigned tail, index;
+
+    tail = *ring->sq_tail;
+    index = tail & *ring->sq_mask;
+    sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+
+    //Vectored so it works on kernels from before IORING_OP_WRITE
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = buffer->job->_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&buffer->iov;
+    sqe->len = 1;
+    sqe->off = buffer->file_offset + (uint64_t)(buffer->len - buffer->iov.iov_len);
+    sqe->user_data = (uint64_t)(uintptr_t)buffer;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    if(ringEnter(ring, 1, 0, 0) < 0) {
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+        return -errno;
+    }
+    return 0;
+}
+#endif
+
+//-------------------------------------THREAD POOL------------------------------------------
+
+static ssize_t pwriteAll(int fd, const uint8_t *data, size_t len, uint64_t offset)
+{
+    size_t total = 0;
+    ssize_t num_written;
+
+    while(total < len) {
+        num_written = pwrite(fd, data + total, len - total, (off_t)(offset + total));
+        if(num_written < 0) {
+            if(errno == EINTR) continue;
+            return -errno;
+        }
+        if(num_written == 0) return -EIO;
+        total += (size_t)num_written;
+    }
+    return (ssize_t)total;
+}
+
+static void* poolWorker(void *arg)
+{
+    struct OffloadPool *pool = arg;
+    struct TSS_Offload_Buffer *buffer;
+
+    pthread_mutex_lock(&pool->lock);
+    while(true) {
+        while(pool->submit_head == NULL && !pool->stopping) {
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+        }
+        if(pool->submit_head == NULL) break;
+
+        buffer = pool->submit_head;
+        pool->submit_head = buffer->next;
+        if(pool->submit_head == NULL) pool->submit_tail = NULL;
+        pthread_mutex_unlock(&pool->lock);
+
+        buffer->result = pwriteAll(buffer->job->_fd, buffer->data, buffer->len, buffer->file_offset);
+
+        pthread_mutex_lock(&pool->lock);
+        buffer->next = pool->done;
+        pool->done = buffer;
+        pthread_cond_signal(&pool->done_cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static void poolStop(struct OffloadPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(uint32_t i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+}
+
+static int poolStart(struct OffloadPool *pool, uint32_t num_threads)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = calloc(num_threads, sizeof(pthread_t));
+    if(pool->threads == NULL) return -1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    //Runs with fewer threads if not all could be created
+    for(pool->num_threads = 0; pool->num_threads < num_threads; pool->num_threads++) {
+        if(pthread_create(&pool->threads[pool->num_threads], NULL, poolWorker, pool) != 0) break;
+    }
+    if(pool->num_threads == 0) {
+        poolStop(pool);
+        return -1;
+    }
+    return 0;
+}
+
+static void poolSubmit(struct OffloadPool *pool, struct TSS_Offload_Buffer *buffer)
+{
+    buffer->next = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if(pool->submit_tail != NULL) pool->submit_tail->next = buffer;
+    else pool->submit_head = buffer;
+    pool->submit_tail = buffer;
+    pthread_cond_signal(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+//------------------------------------------WRITES------------------------------------------
+
+static struct TSS_Offload_Buffer* acquireBuffer(struct OffloadEngine *engine)
+{
+    struct TSS_Offload_Buffer *buffer = engine->free_list;
+    if(buffer != NULL) {
+        engine->free_list = buffer->next;
+        buffer->len = 0;
+    }
+    return buffer;
+}
+
+static void releaseBuffer(struct OffloadEngine *engine, struct TSS_Offload_Buffer *buffer)
+{
+    buffer->next = engine->free_list;
+    engine->free_list = buffer;
+}
+
+//Starts writing the job's current buffer
+static void submitBuffer(struct OffloadEngine *engine, struct TSS_Offload_Job *job)
+{
+    struct TSS_Offload_Buffer *buffer = job->_buffer;
+
+    job->_buffer = NULL;
+    if(buffer->len == 0) {
+        releaseBuffer(engine, buffer);
+        return;
+    }
+
+    buffer->job = job;
+    buffer->file_offset = job->received - buffer->len;
+    buffer->iov.iov_base = buffer->data;
+    buffer->iov.iov_len = buffer->len;
+    buffer->result = 0;
+    job->_writes_in_flight++;
+    engine->in_flight++;
+
+#if TSS_OFFLOAD_IO_URING
+    if(engine->use_ring) {
+        buffer->result = ringSubmit(&engine->ring, buffer);
+        if(buffer->result < 0) {
+            buffer->next = engine->failed;
+            engine->failed = buffer;
+        }
+        return;
+    }
+#endif
+    poolSubmit(&engine->pool, buffer);
+}
+
+static void completeWrite(struct OffloadEngine *engine, struct TSS_Offload_Buffer *buffer)
+{
+    struct TSS_Offload_Job *job = buffer->job;
+
+    job->_writes_in_flight--;
+    engine->in_flight--;
+    if(buffer->result < 0) {
+        if(job->result == TSS_SUCCESS) job->result = TSS_ERR_FILE;
+    }
+    else {
+        job->written += buffer->len;
+    }
+    releaseBuffer(engine, buffer);
+}
+
+#if TSS_OFFLOAD_IO_URING
+static uint32_t ringReap(struct OffloadEngine *engine, bool wait)
+{
+    struct OffloadRing *ring = &engine->ring;
+    struct TSS_Offload_Buffer *buffer;
+    struct io_uring_cqe *cqe;
+    unsigned head, tail;
+    uint32_t count = 0;
+
+    //Submissions that failed never reach the completion queue
+    while(engine->failed != NULL) {
+        buffer = engine->failed;
+        engine->failed = buffer->next;
+        completeWrite(engine, buffer);
+        count++;
+    }
+    if(count > 0 || engine->in_flight == 0) return count;
+
+    if(wait && ringEnter(ring, 0, 1, IORING_ENTER_GETEVENTS) < 0) return 0;
+
+    head = *ring->cq_head;
+    tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while(head != tail) {
+        cqe = &ring->cqes[head & *ring->cq_mask];
+        buffer = (struct TSS_Offload_Buffer*)(uintptr_t)cqe->user_data;
+        head++;
+
+        if(cqe->res < 0) {
+            buffer->result = cqe->res;
+        }
+        else if((size_t)cqe->res < buffer->iov.iov_len) {
+            //Short write, carry on from where it stopped
+            buffer->iov.iov_base = (uint8_t*)buffer->iov.iov_base + cqe->res;
+            buffer->iov.iov_len -= (size_t)cqe->res;
+            buffer->result = (cqe->res == 0) ? -EIO : ringSubmit(ring, buffer);
+            if(buffer->result == 0) continue;
+        }
+        completeWrite(engine, buffer);
+        count++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return count;
+}
+#endif
+
+//Handles finished writes. If wait is set, waits for at least one if any are in flight.
+static uint32_t reapWrites(struct OffloadEngine *engine, bool wait)
+{
+    struct OffloadPool *pool = &engine->pool;
+    struct TSS_Offload_Buffer *done, *next;
+    uint32_t count = 0;
+
+    if(engine->in_flight == 0) return 0;
+#if TSS_OFFLOAD_IO_URING
+    if(engine->use_ring) return ringReap(engine, wait);
+#endif
+
+    pthread_mutex_lock(&pool->lock);
+    while(wait && pool->done == NULL) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    done = pool->done;
+    pool->done = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    for(; done != NULL; done = next) {
+        next = done->next;
+        completeWrite(engine, done);
+        count++;
+    }
+    return count;
+}
+
+//------------------------------------------JOBS------------------------------------------
+
+static enum TSS_DataCallbackState offloadFileCallback(TSS_Sensor *sensor)
+{
+    struct TSS_Offload_Job *job = sensor->user_data;
+    struct TSS_Offload_Buffer *buffer = job->_buffer;
+    uint16_t packet_len;
+    int num_read;
+
+    //Only what is left of the file can arrive, and nothing before this packet can be missing
+    packet_len = sensor->streaming.file.remaining_cur_packet_len;
+    if(sensor->streaming.file.skipped_bytes > 0 ||
+        packet_len > sensor->streaming.file.remaining_len ||
+        job->received + sensor->streaming.file.remaining_len != job->size) {
+        job->_data_lost = true;
+        return TSS_DataCallbackStateIgnored;
+    }
+
+    num_read = sensorProcessFileStreamingCallbackOutput(sensor, buffer->data + buffer->len, packet_len);
+    if(num_read != (int)packet_len) {
+        job->_data_lost = true;
+        job->_read_result = (num_read < 0) ? num_read : TSS_ERR_READ;
+        return TSS_DataCallbackStateError;
+    }
+    buffer->len += (size_t)num_read;
+    job->received += (uint64_t)num_read;
+    return TSS_DataCallbackStateProcessed;
+}
+
+//Stops streaming and closes the sensor file, so it can be opened again or left closed
+static void jobCloseFile(struct TSS_Offload_Job *job)
+{
+    if(job->sensor->streaming.file.active) {
+        sensorFileStreamingStop(job->sensor);
+    }
+    if(job->_file_open) {
+        sensorCloseFile(job->sensor);
+        job->_file_open = false;
+    }
+}
+
+static void jobFail(struct OffloadEngine *engine, struct TSS_Offload_Job *job, int err)
+{
+    if(job->result == TSS_SUCCESS) job->result = err;
+    jobCloseFile(job);
+    if(job->_buffer != NULL) {
+        releaseBuffer(engine, job->_buffer);
+        job->_buffer = NULL;
+    }
+    job->_state = OFFLOAD_JOB_FLUSHING;
+}
+
+static void jobStart(struct OffloadEngine *engine, struct TSS_Offload_Job *job)
+{
+    TSS_Sensor *sensor = job->sensor;
+    uint64_t remaining;
+    int err;
+
+    if(job->_fd < 0) {
+        job->_fd = open(job->out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(job->_fd < 0) {
+            jobFail(engine, job, TSS_ERR_FILE);
+            return;
+        }
+    }
+
+    err = sensorFsOpenFile(sensor, job->sensor_path);
+    if(!err) {
+        job->_file_open = true;
+    }
+    if(!err && job->received > 0) {
+        err = sensorFileSetCursorIndex(sensor, job->received);
+    }
+    if(!err) {
+        err = sensorFileStreamingStart(sensor, offloadFileCallback, &remaining);
+    }
+    if(err) {
+        jobFail(engine, job, err);
+        return;
+    }
+
+    //Streaming starts from the cursor, so must have exactly what was not yet received
+    if(job->resumes == 0) {
+        job->size = remaining;
+    }
+    else if(job->received + remaining != job->size) {
+        jobFail(engine, job, TSS_ERR_INVALID_SIZE);
+        return;
+    }
+
+    job->_data_lost = false;
+    job->_read_result = TSS_SUCCESS;
+    job->_last_progress = tssTimeGet();
+    job->_state = OFFLOAD_JOB_STREAMING;
+    if(remaining == 0) {
+        sensorFileStreamingStop(sensor);
+        job->_state = OFFLOAD_JOB_FLUSHING;
+    }
+}
+
+//Starts streaming again from the last byte received, reconnecting first if the sensor stopped responding.
+//Fails with reason once out of resumes.
+static void jobResume(struct OffloadEngine *engine, struct TSS_Offload_Job *job, int reason, bool reconnect)
+{
+    int err;
+
+    if(job->resumes == engine->config.max_resumes) {
+        jobFail(engine, job, reason);
+        return;
+    }
+    job->resumes++;
+
+    if(reconnect) {
+        job->reconnects++;
+        err = sensorReconnect(job->sensor, engine->config.reconnect_timeout_ms);
+        if(err) {
+            jobFail(engine, job, err);
+            return;
+        }
+    }
+    //Anything still arriving is discarded while waiting for the response. The file is
+    //closed even after reconnecting, as the sensor may still have it open.
+    jobCloseFile(job);
+    job->_state = OFFLOAD_JOB_START;
+}
+
+//Makes sure the job has room for a full packet. Returns false if no buffer is free.
+static bool jobEnsureBuffer(struct OffloadEngine *engine, struct TSS_Offload_Job *job)
+{
+    if(job->_buffer != NULL) {
+        if(engine->config.buffer_size - job->_buffer->len >= TSS_FILE_STREAMING_MAX_PACKET_SIZE) return true;
+        submitBuffer(engine, job);
+    }
+    job->_buffer = acquireBuffer(engine);
+    return job->_buffer != NULL;
+}
+
+//Returns true if any data was received
+static bool jobPoll(struct OffloadEngine *engine, struct TSS_Offload_Job *job)
+{
+    TSS_Sensor *sensor = job->sensor;
+    uint64_t received = job->received;
+    bool starved = false;
+
+    for(uint32_t i = 0; i < OFFLOAD_MAX_PACKETS_PER_POLL && sensor->streaming.file.active && !job->_data_lost; i++) {
+        if(!jobEnsureBuffer(engine, job)) {
+            starved = true;
+            break;
+        }
+        if(sensorUpdateStreaming(sensor) <= 0) break;
+    }
+
+    if(job->result != TSS_SUCCESS) {
+        jobFail(engine, job, job->result);
+    }
+    else if(job->_data_lost) {
+        //A failed read may mean the connection dropped, a skipped packet only needs its data sent again
+        if(job->_read_result != TSS_SUCCESS) jobResume(engine, job, job->_read_result, true);
+        else jobResume(engine, job, TSS_ERR_CHECKSUM_MISMATCH, false);
+    }
+    else if(!sensor->streaming.file.active) {
+        //The last packet was received
+        if(job->received != job->size) {
+            jobFail(engine, job, TSS_ERR_INVALID_SIZE);
+        }
+        else {
+            if(job->_buffer != NULL) submitBuffer(engine, job);
+            job->_state = OFFLOAD_JOB_FLUSHING;
+        }
+    }
+    else if(job->received != received || starved) {
+        //Waiting on the disk is not the sensor stalling
+        job->_last_progress = tssTimeGet();
+    }
+    else if(tssTimeDiff(job->_last_progress) >= engine->config.stall_timeout_ms) {
+        jobResume(engine, job, TSS_ERR_TIMEOUT, true);
+    }
+
+    return job->received != received;
+}
+
+static void jobFinish(struct TSS_Offload_Job *job)
+{
+    if(job->result == TSS_SUCCESS && job->written != job->size) {
+        job->result = TSS_ERR_INVALID_SIZE;
+    }
+    if(job->_fd >= 0) {
+        if(close(job->_fd) != 0 && job->result == TSS_SUCCESS) {
+            job->result = TSS_ERR_FILE;
+        }
+        job->_fd = -1;
+    }
+    jobCloseFile(job);
+    job->_state = OFFLOAD_JOB_DONE;
+}
+
+//------------------------------------------ENGINE------------------------------------------
+
+void tssOffloadConfigDefault(struct TSS_Offload_Config *config)
+{
+    *config = (struct TSS_Offload_Config) {
+        .buffer_size = TSS_OFFLOAD_DEFAULT_BUFFER_SIZE,
+        .num_buffers = TSS_OFFLOAD_DEFAULT_NUM_BUFFERS,
+        .num_threads = TSS_OFFLOAD_DEFAULT_NUM_THREADS,
+        .stall_timeout_ms = TSS_OFFLOAD_DEFAULT_STALL_TIMEOUT_MS,
+        .reconnect_timeout_ms = TSS_OFFLOAD_DEFAULT_RECONNECT_TIMEOUT_MS,
+        .max_resumes = TSS_OFFLOAD_DEFAULT_MAX_RESUMES,
+    };
+}
+
+void tssOffloadJobCreate(struct TSS_Offload_Job *job, TSS_Sensor *sensor, const char *sensor_path, const char *out_path)
+{
+    *job = (struct TSS_Offload_Job) {
+        .sensor = sensor,
+        .sensor_path = sensor_path,
+        .out_path = out_path,
+        .result = TSS_SUCCESS,
+        ._state = OFFLOAD_JOB_START,
+        ._fd = -1,
+    };
+}
+
+bool tssOffloadIoUringAvailable(void)
+{
+#if TSS_OFFLOAD_IO_URING
+    struct OffloadRing ring;
+    if(ringSetup(&ring, 1) != 0) return false;
+    ringCleanup(&ring);
+    return true;
+#else
+    return false;
+#endif
+}
+
+static int engineStart(struct OffloadEngine *engine, const struct TSS_Offload_Config *config)
+{
+    memset(engine, 0, sizeof(*engine));
+    if(config != NULL) engine->config = *config;
+    else tssOffloadConfigDefault(&engine->config);
+
+    if(engine->config.buffer_size < TSS_FILE_STREAMING_MAX_PACKET_SIZE || engine->config.num_buffers == 0) {
+        return TSS_ERR_INSUFFICIENT_BUFFER;
+    }
+
+    engine->memory = malloc(engine->config.buffer_size * engine->config.num_buffers);
+    engine->buffers = calloc(engine->config.num_buffers, sizeof(*engine->buffers));
+    if(engine->memory == NULL || engine->buffers == NULL) {
+        free(engine->memory);
+        free(engine->buffers);
+        return TSS_ERR_INSUFFICIENT_BUFFER;
+    }
+    for(uint32_t i = 0; i < engine->config.num_buffers; i++) {
+        engine->buffers[i].data = engine->memory + i * engine->config.buffer_size;
+        releaseBuffer(engine, &engine->buffers[i]);
+    }
+
+#if TSS_OFFLOAD_IO_URING
+    if(!engine->config.force_thread_pool && ringSetup(&engine->ring, engine->config.num_buffers) == 0) {
+        engine->use_ring = true;
+        return TSS_SUCCESS;
+    }
+#endif
+
+    if(poolStart(&engine->pool, (engine->config.num_threads > 0) ? engine->config.num_threads : 1) != 0) {
+        free(engine->memory);
+        free(engine->buffers);
+        return TSS_ERR_FILE;
+    }
+    return TSS_SUCCESS;
+}
+
+static void engineStop(struct OffloadEngine *engine)
+{
+    while(engine->in_flight > 0) {
+        reapWrites(engine, true);
+    }
+#if TSS_OFFLOAD_IO_URING
+    if(engine->use_ring) ringCleanup(&engine->ring);
+    else poolStop(&engine->pool);
+#else
+    poolStop(&engine->pool);
+#endif
+    free(engine->memory);
+    free(engine->buffers);
+}
+
+int tssOffloadRun(struct TSS_Offload_Job *jobs, uint32_t num_jobs, const struct TSS_Offload_Config *config)
+{
+    struct OffloadEngine engine;
+    struct TSS_Offload_Job *job;
+    uint32_t num_active;
+    bool progressed;
+    int err;
+
+    err = engineStart(&engine, config);
+    if(err) return err;
+
+    for(uint32_t i = 0; i < num_jobs; i++) {
+        jobs[i]._sensor_user_data = jobs[i].sensor->user_data;
+        jobs[i].sensor->user_data = &jobs[i];
+    }
+
+    do {
+        progressed = reapWrites(&engine, false) > 0;
+        num_active = 0;
+        for(uint32_t i = 0; i < num_jobs; i++) {
+            job = &jobs[i];
+            switch(job->_state) {
+            case OFFLOAD_JOB_START:
+                jobStart(&engine, job);
+                progressed = true;
+                break;
+            case OFFLOAD_JOB_STREAMING:
+                if(jobPoll(&engine, job)) progressed = true;
+                break;
+            case OFFLOAD_JOB_FLUSHING:
+                if(job->_writes_in_flight == 0) {
+                    jobFinish(job);
+                    progressed = true;
+                }
+                break;
+            default:
+                break;
+            }
+            if(job->_state != OFFLOAD_JOB_DONE) num_active++;
+        }
+
+        if(!progressed && num_active > 0) {
+            //With every buffer waiting on the disk, nothing can be read until one is written
+            if(engine.free_list == NULL && engine.in_flight > 0) reapWrites(&engine, true);
+            else sleepUs(OFFLOAD_IDLE_SLEEP_US);
+        }
+    } while(num_active > 0);
+
+    engineStop(&engine);
+
+    err = TSS_SUCCESS;
+    for(uint32_t i = 0; i < num_jobs; i++) {
+        jobs[i].sensor->user_data = jobs[i]._sensor_user_data;
+        if(err == TSS_SUCCESS) err = jobs[i].result;
+    }
+    return err;
+}
@@ -0,0 +1,501 @@
+#include "tss/tools/recording.h"
+#include "tss/sys/endian.h"
+#include "tss/errors.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SLOT_DESCRIPTION_SIZE 4
+#define FIELD_DESCRIPTION_SIZE 4
+
+//--------------------------------------SCHEMA---------------------------------------
+
+//Describes the packets of the sensor's cached stream slots
+static int buildInfo(TSS_Sensor *sensor, struct TSS_Recording_Info *info)
+{
+    const struct TSS_Command **cur_slot;
+    const struct TSS_Param *param;
+    struct TSS_Recording_Slot *slot;
+    uint16_t offset = 0;
+
+    *info = (struct TSS_Recording_Info) {
+        .serial_number = sensor->serial_number,
+        .start_unix_time = (int64_t)time(NULL),
+    };
+    if(sensor->_header_enabled && (sensor->header_cfg.bitfield & TSS_HEADER_TIMESTAMP_BIT)) {
+        info->flags |= TSS_RECORDING_FLAG_SENSOR_TIMESTAMP;
+    }
+
+    for(cur_slot = sensor->streaming.data.commands; *cur_slot != NULL; cur_slot++) {
+        slot = &info->slots[info->num_slots];
+        slot->cmd_num = (*cur_slot)->num;
+#if !(TSS_MINIMAL_SENSOR)
+        slot->has_param = sensor->batch.user.slots[info->num_slots].has_param;
+        slot->param = sensor->batch.user.slots[info->num_slots].param;
+#endif
+        for(param = (*cur_slot)->out_format; !TSS_PARAM_IS_NULL(param); param++) {
+            if(TSS_PARAM_IS_STRING(param) || info->num_fields == TSS_RECORDING_MAX_FIELDS) {
+                return TSS_ERR_INVALID_SIZE;
+            }
+            info->fields[info->num_fields] = (struct TSS_Recording_Field) {
+#if TSS_INCLUDE_PARAM_TYPE
+                .type = (uint8_t)param->type,
+#else
+                .type = (uint8_t)TSS_ParamTypeBlob,
+#endif
+                .count = param->count,
+                .size = param->size,
+            };
+            info->field_offsets[info->num_fields] = offset;
+            offset = (uint16_t)(offset + param->count * param->size);
+            info->num_fields++;
+            slot->num_fields++;
+        }
+        info->num_slots++;
+    }
+
+    info->data_size = offset;
+    info->record_size = (uint16_t)(TSS_RECORDING_RECORD_HEADER_SIZE + offset);
+    return TSS_SUCCESS;
+}
+
+static size_t headerSize(const struct TSS_Recording_Info *info)
+{
+    return TSS_RECORDING_HEADER_SIZE + (size_t)info->num_slots * SLOT_DESCRIPTION_SIZE + (size_t)info->num_fields * FIELD_DESCRIPTION_SIZE;
+}
+
+//Fields are in the byte order of the host, which the header records
+static size_t writeHeader(const struct TSS_Recording_Info *info, uint8_t *out)
+{
+    uint32_t header_size;
+    uint16_t version = TSS_RECORDING_VERSION;
+    size_t pos;
+    uint8_t i;
+
+    header_size = (uint32_t)headerSize(info);
+    memcpy(out, TSS_RECORDING_MAGIC, TSS_RECORDING_MAGIC_LEN);
+    memcpy(out + 6, &version, sizeof(version));
+    out[8] = TSS_ENDIAN_IS_BIG ? 1 : 0;
+    out[9] = info->flags;
+    out[10] = info->num_slots;
+    out[11] = info->num_fields;
+    memcpy(out + 12, &info->record_size, sizeof(info->record_size));
+    memcpy(out + 14, &info->data_size, sizeof(info->data_size));
+    memcpy(out + 16, &header_size, sizeof(header_size));
+    memcpy(out + 20, &info->serial_number, sizeof(info->serial_number));
+    memcpy(out + 28, &info->start_unix_time, sizeof(info->start_unix_time));
+
+    pos = TSS_RECORDING_HEADER_SIZE;
+    for(i = 0; i < info->num_slots; i++) {
+        out[pos++] = info->slots[i].cmd_num;
+        out[pos++] = info->slots[i].has_param;
+        out[pos++] = info->slots[i].param;
+        out[pos++] = info->slots[i].num_fields;
+    }
+    for(i = 0; i < info->num_fields; i++) {
+        out[pos++] = info->fields[i].type;
+        out[pos++] = info->fields[i].count;
+        memcpy(out + pos, &info->fields[i].size, sizeof(info->fields[i].size));
+        pos += sizeof(info->fields[i].size);
+    }
+    return pos;
+}
+
+//Returns the size of the header, or 0 if it is not valid
+static size_t readHeader(const uint8_t *data, size_t size, struct TSS_Recording_Info *out)
+{
+    uint32_t header_size;
+    uint16_t version, offset;
+    size_t pos;
+    uint8_t i, num_fields;
+
+    if(size < TSS_RECORDING_HEADER_SIZE || memcmp(data, TSS_RECORDING_MAGIC, TSS_RECORDING_MAGIC_LEN) != 0) return 0;
+    memcpy(&version, data + 6, sizeof(version));
+    if(version != TSS_RECORDING_VERSION || data[8] != (TSS_ENDIAN_IS_BIG ? 1 : 0)) return 0;
+
+    *out = (struct TSS_Recording_Info) {
+        .flags = data[9],
+        .num_slots = data[10],
+        .num_fields = data[11],
+    };
+    memcpy(&out->record_size, data + 12, sizeof(out->record_size));
+    memcpy(&out->data_size, data + 14, sizeof(out->data_size));
+    memcpy(&header_size, data + 16, sizeof(header_size));
+    memcpy(&out->serial_number, data + 20, sizeof(out->serial_number));
+    memcpy(&out->start_unix_time, data + 28, sizeof(out->start_unix_time));
+
+    if(out->num_slots > TSS_NUM_STREAM_SLOTS || out->num_fields > TSS_RECORDING_MAX_FIELDS ||
+        header_size != headerSize(out) || header_size > size ||
+        out->record_size != TSS_RECORDING_RECORD_HEADER_SIZE + out->data_size) {
+        return 0;
+    }
+
+    pos = TSS_RECORDING_HEADER_SIZE;
+    num_fields = 0;
+    for(i = 0; i < out->num_slots; i++) {
+        out->slots[i].cmd_num = data[pos++];
+        out->slots[i].has_param = data[pos++] != 0;
+        out->slots[i].param = data[pos++];
+        out->slots[i].num_fields = data[pos++];
+        num_fields = (uint8_t)(num_fields + out->slots[i].num_fields);
+    }
+    if(num_fields != out->num_fields) return 0;
+
+    offset = 0;
+    for(i = 0; i < out->num_fields; i++) {
+        out->fields[i].type = data[pos++];
+        out->fields[i].count = data[pos++];
+        memcpy(&out->fields[i].size, data + pos, sizeof(out->fields[i].size));
+        pos += sizeof(out->fields[i].size);
+        out->field_offsets[i] = offset;
+        offset = (uint16_t)(offset + out->fields[i].count * out->fields[i].size);
+    }
+    if(offset != out->data_size) return 0;
+
+    return header_size;
+}
+
+//--------------------------------------RECORDER---------------------------------------
+
+int tssRecorderOpen(struct TSS_Recorder *recorder, TSS_Sensor *sensor, const char *path, uint8_t *buffer, size_t buffer_size)
+{
+    uint8_t header[TSS_RECORDING_HEADER_SIZE + TSS_NUM_STREAM_SLOTS * SLOT_DESCRIPTION_SIZE + TSS_RECORDING_MAX_FIELDS * FIELD_DESCRIPTION_SIZE];
+    size_t header_len, capacity;
+    int err;
+
+    *recorder = (struct TSS_Recorder) {
+        .sensor = sensor,
+        .buffer = buffer,
+        .buffer_size = buffer_size,
+    };
+
+    //The stream slots must be known to describe the packets
+    if(sensor->dirty) {
+        err = sensorUpdateCachedSettings(sensor);
+        if(err) return err;
+    }
+
+    err = buildInfo(sensor, &recorder->info);
+    if(err) return err;
+
+    if(buffer_size < TSS_RECORDING_CHUNK_HEADER_SIZE) return TSS_ERR_INSUFFICIENT_BUFFER;
+    capacity = (buffer_size - TSS_RECORDING_CHUNK_HEADER_SIZE) / recorder->info.record_size;
+    if(capacity == 0) return TSS_ERR_INSUFFICIENT_BUFFER;
+    recorder->chunk_capacity = (capacity > UINT32_MAX) ? UINT32_MAX : (uint32_t)capacity;
+
+    recorder->file = fopen(path, "wb");
+    if(recorder->file == NULL) return TSS_ERR_FILE;
+
+    //Whole chunks are written at once, so buffering them again would only add a copy
+    setvbuf(recorder->file, NULL, _IONBF, 0);
+
+    header_len = writeHeader(&recorder->info, header);
+    if(fwrite(header, 1, header_len, recorder->file) != header_len) {
+        fclose(recorder->file);
+        recorder->file = NULL;
+        return TSS_ERR_FILE;
+    }
+
+    recorder->start_time = tssTimeGet();
+    return TSS_SUCCESS;
+}
+
+int tssRecorderRecordPacket(struct TSS_Recorder *recorder)
+{
+    const struct TSS_Recording_Info *info = &recorder->info;
+    uint8_t *record, *data;
+    uint32_t sensor_timestamp;
+    uint64_t time_us;
+    int err;
+    uint8_t i;
+
+    if(recorder->write_failed) return TSS_ERR_FILE;
+    if(recorder->sensor->streaming.data.output_size != info->data_size) return TSS_ERR_INVALID_SIZE;
+
+    if(recorder->chunk_records == recorder->chunk_capacity) {
+        err = tssRecorderFlush(recorder);
+        if(err) return err;
+    }
+
+    record = recorder->buffer + TSS_RECORDING_CHUNK_HEADER_SIZE + (size_t)recorder->chunk_records * info->record_size;
+    data = record + TSS_RECORDING_RECORD_HEADER_SIZE;
+    for(i = 0; i < info->num_fields; i++) {
+        recorder->outputs[i] = data + info->field_offsets[i];
+    }
+
+    err = sensorProcessDataStreamingCallbackOutputArray(recorder->sensor, recorder->outputs);
+    if(err < 0) return err;
+
+    //Kept increasing so the records can be searched by time
+    time_us = tssTimeDiffUs(recorder->start_time);
+    if(time_us < recorder->last_us) time_us = recorder->last_us;
+    recorder->last_us = time_us;
+
+    sensor_timestamp = (info->flags & TSS_RECORDING_FLAG_SENSOR_TIMESTAMP) ? recorder->sensor->last_header.timestamp : 0;
+    memcpy(record, &time_us, sizeof(time_us));
+    memcpy(record + sizeof(time_us), &sensor_timestamp, sizeof(sensor_timestamp));
+
+    if(recorder->chunk_records == 0) {
+        recorder->chunk_first_us = time_us;
+    }
+    recorder->chunk_records++;
+    recorder->records++;
+    return TSS_SUCCESS;
+}
+
+int tssRecorderFlush(struct TSS_Recorder *recorder)
+{
+    uint32_t magic = TSS_RECORDING_CHUNK_MAGIC;
+    size_t len;
+
+    if(recorder->file == NULL || recorder->write_failed) return TSS_ERR_FILE;
+    if(recorder->chunk_records == 0) return TSS_SUCCESS;
+
+    memcpy(recorder->buffer, &magic, sizeof(magic));
+    memcpy(recorder->buffer + 4, &recorder->chunk_records, sizeof(recorder->chunk_records));
+    memcpy(recorder->buffer + 8, &recorder->chunk_first_us, sizeof(recorder->chunk_first_us));
+    memcpy(recorder->buffer + 16, &recorder->last_us, sizeof(recorder->last_us));
+
+    len = TSS_RECORDING_CHUNK_HEADER_SIZE + (size_t)recorder->chunk_records * recorder->info.record_size;
+    if(fwrite(recorder->buffer, 1, len, recorder->file) != len) {
+        //Part of the chunk may have been written. Nothing more is appended after it, so the file
+        //still ends in a torn chunk the reader ignores, instead of one that misaligns every chunk after it.
+        recorder->write_failed = true;
+        return TSS_ERR_FILE;
+    }
+    recorder->chunk_records = 0;
+    recorder->chunks++;
+    return TSS_SUCCESS;
+}
+
+int tssRecorderClose(struct TSS_Recorder *recorder)
+{
+    int err;
+
+    if(recorder->file == NULL) return TSS_SUCCESS;
+    err = tssRecorderFlush(recorder);
+    if(fclose(recorder->file) != 0 && err == TSS_SUCCESS) {
+        err = TSS_ERR_FILE;
+    }
+    recorder->file = NULL;
+    return err;
+}
+
+//---------------------------------------READER----------------------------------------
+
+static int mapFile(struct TSS_Recording_Reader *reader, const char *path)
+{
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    HANDLE file, mapping;
+
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) return TSS_ERR_FILE;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return (size.QuadPart == 0) ? TSS_ERR_INVALID_FORMAT : TSS_ERR_FILE;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping == NULL) {
+        CloseHandle(file);
+        return TSS_ERR_FILE;
+    }
+    reader->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(reader->data == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return TSS_ERR_FILE;
+    }
+    reader->file_handle = file;
+    reader->mapping_handle = mapping;
+    reader->size = (size_t)size.QuadPart;
+#else
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if(fd < 0) return TSS_ERR_FILE;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return TSS_ERR_FILE;
+    }
+    if(st.st_size == 0) {
+        close(fd);
+        return TSS_ERR_INVALID_FORMAT;
+    }
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); //The mapping keeps the file open
+    if(data == MAP_FAILED) return TSS_ERR_FILE;
+    reader->data = data;
+    reader->size = (size_t)st.st_size;
+#endif
+    return TSS_SUCCESS;
+}
+
+static void unmapFile(struct TSS_Recording_Reader *reader)
+{
+    if(reader->data == NULL) return;
+#ifdef _WIN32
+    UnmapViewOfFile(reader->data);
+    CloseHandle(reader->mapping_handle);
+    CloseHandle(reader->file_handle);
+#else
+    munmap((void*)reader->data, reader->size);
+#endif
+    reader->data = NULL;
+}
+
+//Walks the chunk headers, stopping at the first that is not complete
+static int indexChunks(struct TSS_Recording_Reader *reader, size_t offset)
+{
+    struct TSS_Recording_Chunk *chunks, *chunk;
+    size_t capacity = 0, len;
+    uint32_t magic, num_records;
+
+    while(offset < reader->size) {
+        if(reader->size - offset < TSS_RECORDING_CHUNK_HEADER_SIZE) break;
+        memcpy(&magic, reader->data + offset, sizeof(magic));
+        memcpy(&num_records, reader->data + offset + 4, sizeof(num_records));
+        len = (size_t)num_records * reader->info.record_size;
+        if(magic != TSS_RECORDING_CHUNK_MAGIC || num_records == 0 ||
+            len > reader->size - offset - TSS_RECORDING_CHUNK_HEADER_SIZE) {
+            break;
+        }
+
+        if(reader->num_chunks == capacity) {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            chunks = realloc(reader->chunks, capacity * sizeof(*chunks));
+            if(chunks == NULL) return TSS_ERR_INSUFFICIENT_BUFFER;
+            reader->chunks = chunks;
+        }
+
+        chunk = &reader->chunks[reader->num_chunks++];
+        chunk->offset = offset + TSS_RECORDING_CHUNK_HEADER_SIZE;
+        chunk->first_record = reader->num_records;
+        chunk->num_records = num_records;
+        memcpy(&chunk->first_us, reader->data + offset + 8, sizeof(chunk->first_us));
+        memcpy(&chunk->last_us, reader->data + offset + 16, sizeof(chunk->last_us));
+
+        reader->num_records += num_records;
+        offset = chunk->offset + len;
+    }
+
+    reader->truncated = (offset != reader->size);
+    return TSS_SUCCESS;
+}
+
+int tssRecordingReaderOpen(struct TSS_Recording_Reader *reader, const char *path)
+{
+    size_t header_size;
+    int err;
+
+    *reader = (struct TSS_Recording_Reader) { 0 };
+    err = mapFile(reader, path);
+    if(err) return err;
+
+    header_size = readHeader(reader->data, reader->size, &reader->info);
+    if(header_size == 0) {
+        tssRecordingReaderClose(reader);
+        return TSS_ERR_INVALID_FORMAT;
+    }
+
+    err = indexChunks(reader, header_size);
+    if(err) {
+        tssRecordingReaderClose(reader);
+        return err;
+    }
+    return TSS_SUCCESS;
+}
+
+void tssRecordingReaderClose(struct TSS_Recording_Reader *reader)
+{
+    unmapFile(reader);
+    free(reader->chunks);
+    reader->chunks = NULL;
+    reader->num_chunks = 0;
+    reader->num_records = 0;
+}
+
+//Index of the chunk holding the record. The record must be in range.
+static size_t findChunk(const struct TSS_Recording_Reader *reader, uint64_t index)
+{
+    size_t low = 0, high = reader->num_chunks - 1, mid;
+    while(low < high) {
+        mid = low + (high - low + 1) / 2;
+        if(reader->chunks[mid].first_record <= index) low = mid;
+        else high = mid - 1;
+    }
+    return low;
+}
+
+const uint8_t* tssRecordingReaderRecord(const struct TSS_Recording_Reader *reader, uint64_t index)
+{
+    const struct TSS_Recording_Chunk *chunk;
+
+    if(index >= reader->num_records) return NULL;
+    chunk = &reader->chunks[findChunk(reader, index)];
+    return reader->data + chunk->offset + (size_t)(index - chunk->first_record) * reader->info.record_size;
+}
+
+static uint64_t recordTime(const struct TSS_Recording_Reader *reader, const struct TSS_Recording_Chunk *chunk, uint32_t i)
+{
+    uint64_t time_us;
+    memcpy(&time_us, reader->data + chunk->offset + (size_t)i * reader->info.record_size, sizeof(time_us));
+    return time_us;
+}
+
+uint64_t tssRecordingReaderFind(const struct TSS_Recording_Reader *reader, uint64_t time_us)
+{
+    const struct TSS_Recording_Chunk *chunk;
+    size_t low = 0, high = reader->num_chunks, mid;
+    uint32_t first, last, middle;
+
+    //First chunk that ends at or after the time
+    while(low < high) {
+        mid = low + (high - low) / 2;
+        if(reader->chunks[mid].last_us < time_us) low = mid + 1;
+        else high = mid;
+    }
+    if(low == reader->num_chunks) return reader->num_records;
+    chunk = &reader->chunks[low];
+
+    //First record in it at or after the time
+    first = 0;
+    last = chunk->num_records - 1;
+    while(first < last) {
+        middle = first + (last - first) / 2;
+        if(recordTime(reader, chunk, middle) < time_us) first = middle + 1;
+        else last = middle;
+    }
+    return chunk->first_record + first;
+}
+
+int tssRecordingReaderRead(const struct TSS_Recording_Reader *reader, uint64_t index, uint64_t *time_us, uint32_t *sensor_timestamp, void **outputs)
+{
+    const struct TSS_Recording_Info *info = &reader->info;
+    const uint8_t *record, *data;
+    uint8_t i;
+
+    record = tssRecordingReaderRecord(reader, index);
+    if(record == NULL) return TSS_ERR_INVALID_SIZE;
+
+    if(time_us != NULL) memcpy(time_us, record, sizeof(*time_us));
+    if(sensor_timestamp != NULL) memcpy(sensor_timestamp, record + sizeof(uint64_t), sizeof(*sensor_timestamp));
+
+    data = record + TSS_RECORDING_RECORD_HEADER_SIZE;
+    for(i = 0; i < info->num_fields; i++) {
+        memcpy(outputs[i], data + info->field_offsets[i], (size_t)info->fields[i].count * info->fields[i].size);
+    }
+    return TSS_SUCCESS;
+}
@@ -0,0 +1,82 @@
+/*
+*   Round trip latency of commands, from sending the command to its response being parsed.
+*/
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct CommandCase {
+    const char *name;
+    int (*run)(TSS_Sensor *sensor);
+};
+
+static int runTaredOrientation(TSS_Sensor *sensor)
+{
+    float quat[4];
+    return sensorGetTaredOrientation(sensor, quat);
+}
+
+static int runCorrectedAccel(TSS_Sensor *sensor)
+{
+    float accel[3];
+    return sensorGetCorrectedAccelerometerVector(sensor, accel);
+}
+
+static int runAllCorrectedComponents(TSS_Sensor *sensor)
+{
+    float gyro[3], accel[3], mag[3];
+    return sensorGetAllCorrectedComponentSensorData(sensor, gyro, accel, mag);
+}
+
+static int runRawGyroById(TSS_Sensor *sensor)
+{
+    float gyro[3];
+    return sensorGetRawGyroRateByID(sensor, 0, gyro);
+}
+
+static const struct CommandCase K_CASES[] = {
+    { "GetTaredOrientation", runTaredOrientation },
+    { "GetCorrectedAccelerometerVector", runCorrectedAccel },
+    { "GetAllCorrectedComponentSensorData", runAllCorrectedComponents },
+    { "GetRawGyroRateByID", runRawGyroById },
+};
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    struct BenchSamples samples;
+    uint64_t start_ns;
+    uint32_t errors;
+
+    benchParseOptions(argc, argv, "commands", &options);
+
+    ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL) return 1;
+    if(benchOpen(ctx, &options, NULL)) return 1;
+
+    benchSamplesInit(&samples, options.iterations);
+    for(size_t i = 0; i < sizeof(K_CASES) / sizeof(K_CASES[0]); i++) {
+        samples.count = 0;
+        errors = 0;
+        for(uint32_t j = 0; j < options.iterations; j++) {
+            start_ns = benchTimeNs();
+            if(K_CASES[i].run(&ctx->sensor)) {
+                errors++;
+                continue;
+            }
+            benchSamplesAdd(&samples, benchTimeNs() - start_ns);
+        }
+
+        benchResultBegin(ctx, K_CASES[i].name);
+        benchResultU64("errors", errors);
+        benchResultPercentiles("latency_ns", &samples);
+        benchResultEnd();
+    }
+
+    benchSamplesFree(&samples);
+    benchClose(ctx);
+    free(ctx);
+    return 0;
+}
@@ -0,0 +1,240 @@
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_DURATION_MS 2000
+#define BENCH_DEFAULT_ITERATIONS 20000
+#define BENCH_LINE_SIZE 2048
+
+static char m_line[BENCH_LINE_SIZE];
+static size_t m_line_len;
+static const char *m_output_path;
+
+static void lineAppend(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+static void printUsage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -p <port>      Use this serial port instead of the simulated sensor\n"
+        "  -o <file>      Also append the results to this file\n"
+        "  -t <ms>        Duration of timed runs\n"
+        "  -n <count>     Iterations of latency runs\n"
+        "  -v <value>     Benchmark specific value\n",
+        name);
+}
+
+void benchParseOptions(int argc, char **argv, const char *name, struct BenchOptions *out)
+{
+    int opt;
+
+    *out = (struct BenchOptions) {
+        .name = name,
+        .port = -1,
+        .duration_ms = BENCH_DEFAULT_DURATION_MS,
+        .iterations = BENCH_DEFAULT_ITERATIONS,
+    };
+
+    while((opt = getopt(argc, argv, "p:o:t:n:v:h")) != -1) {
+        switch(opt) {
+        case 'p':
+            out->port = atoi(optarg);
+            if(out->port < 0 || out->port > 255) {
+                fprintf(stderr, "Port must be 0-255\n");
+                exit(1);
+            }
+            break;
+        case 'o': out->output_path = optarg; break;
+        case 't': out->duration_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'n': out->iterations = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'v': out->value = (uint32_t)strtoul(optarg, NULL, 10); break;
+        default:
+            printUsage(argv[0]);
+            exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if(out->iterations == 0) out->iterations = 1;
+    m_output_path = out->output_path;
+}
+
+int benchOpen(struct BenchContext *ctx, const struct BenchOptions *options, const struct SimSensorConfig *config)
+{
+    int err;
+
+    ctx->options = *options;
+    if(options->port < 0) {
+        create_sim_com_class(config, &ctx->com_storage.sim);
+        ctx->com = (struct TSS_Com_Class*)&ctx->com_storage.sim;
+        ctx->sim = &ctx->com_storage.sim.sensor;
+    }
+    else {
+        create_serial_com_class((uint8_t)options->port, &ctx->com_storage.ser);
+        ctx->com = (struct TSS_Com_Class*)&ctx->com_storage.ser;
+        ctx->sim = NULL;
+    }
+
+    if(tss_com_open(ctx->com)) {
+        fprintf(stderr, "%s: Failed to open com class\n", options->name);
+        return -1;
+    }
+
+    tssCreateSensor(&ctx->sensor, ctx->com);
+    err = tssInitSensor(&ctx->sensor);
+    if(err) {
+        fprintf(stderr, "%s: Failed to initialize sensor: %d\n", options->name, err);
+        tss_com_close(ctx->com);
+        return err;
+    }
+    return 0;
+}
+
+void benchClose(struct BenchContext *ctx)
+{
+    sensorCleanup(&ctx->sensor);
+    tss_com_close(ctx->com);
+}
+
+uint64_t benchTimeNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+//----------------------------------------SAMPLES------------------------------------------------
+
+void benchSamplesInit(struct BenchSamples *samples, size_t capacity)
+{
+    samples->count = 0;
+    samples->capacity = (capacity > 0) ? capacity : 1;
+    samples->values = malloc(samples->capacity * sizeof(samples->values[0]));
+    if(samples->values == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+}
+
+void benchSamplesAdd(struct BenchSamples *samples, uint64_t value)
+{
+    uint64_t *values;
+    if(samples->count == samples->capacity) {
+        values = realloc(samples->values, samples->capacity * 2 * sizeof(samples->values[0]));
+        if(values == NULL) return; //Drop the sample rather than fail the whole run
+        samples->values = values;
+        samples->capacity *= 2;
+    }
+    samples->values[samples->count++] = value;
+}
+
+void benchSamplesFree(struct BenchSamples *samples)
+{
+    free(samples->values);
+    samples->values = NULL;
+    samples->count = samples->capacity = 0;
+}
+
+static int compareU64(const void *a, const void *b)
+{
+    uint64_t va = *(const uint64_t*)a;
+    uint64_t vb = *(const uint64_t*)b;
+    return (va > vb) - (va < vb);
+}
+
+//Nearest rank percentile of sorted samples
+static uint64_t percentile(const struct BenchSamples *samples, double p)
+{
+    size_t rank = (size_t)(p / 100.0 * (double)samples->count + 0.5);
+    if(rank == 0) rank = 1;
+    if(rank > samples->count) rank = samples->count;
+    return samples->values[rank - 1];
+}
+
+//----------------------------------------RESULTS------------------------------------------------
+
+static void lineAppend(const char *format, ...)
+{
+    va_list args;
+    int len;
+
+    if(m_line_len >= sizeof(m_line)) return;
+    va_start(args, format);
+    len = vsnprintf(m_line + m_line_len, sizeof(m_line) - m_line_len, format, args);
+    va_end(args);
+    if(len > 0) m_line_len += (size_t)len;
+    if(m_line_len > sizeof(m_line) - 1) m_line_len = sizeof(m_line) - 1;
+}
+
+void benchResultBegin(const struct BenchContext *ctx, const char *bench_case)
+{
+    m_line_len = 0;
+    lineAppend("{\"bench\":\"%s\",\"com\":\"%s\"", ctx->options.name, (ctx->sim != NULL) ? "sim" : "serial");
+    benchResultString("case", bench_case);
+}
+
+void benchResultU64(const char *key, uint64_t value)
+{
+    lineAppend(",\"%s\":%" PRIu64, key, value);
+}
+
+void benchResultDouble(const char *key, double value)
+{
+    lineAppend(",\"%s\":%.3f", key, value);
+}
+
+void benchResultString(const char *key, const char *value)
+{
+    //Values are only ever names and slot layouts, which need no escaping
+    lineAppend(",\"%s\":\"%s\"", key, value);
+}
+
+void benchResultPercentiles(const char *prefix, struct BenchSamples *samples)
+{
+    char key[64];
+    uint64_t total = 0;
+
+    snprintf(key, sizeof(key), "%s_samples", prefix);
+    benchResultU64(key, samples->count);
+    if(samples->count == 0) return;
+
+    qsort(samples->values, samples->count, sizeof(samples->values[0]), compareU64);
+    for(size_t i = 0; i < samples->count; i++) {
+        total += samples->values[i];
+    }
+
+    snprintf(key, sizeof(key), "%s_mean", prefix);
+    benchResultDouble(key, (double)total / (double)samples->count);
+    snprintf(key, sizeof(key), "%s_p50", prefix);
+    benchResultU64(key, percentile(samples, 50.0));
+    snprintf(key, sizeof(key), "%s_p90", prefix);
+    benchResultU64(key, percentile(samples, 90.0));
+    snprintf(key, sizeof(key), "%s_p99", prefix);
+    benchResultU64(key, percentile(samples, 99.0));
+    snprintf(key, sizeof(key), "%s_p999", prefix);
+    benchResultU64(key, percentile(samples, 99.9));
+    snprintf(key, sizeof(key), "%s_max", prefix);
+    benchResultU64(key, samples->values[samples->count - 1]);
+}
+
+void benchResultEnd(void)
+{
+    FILE *file;
+
+    lineAppend("}\n");
+    fputs(m_line, stdout);
+    fflush(stdout);
+
+    if(m_output_path != NULL) {
+        file = fopen(m_output_path, "a");
+        if(file == NULL) {
+            fprintf(stderr, "Failed to open %s\n", m_output_path);
+            return;
+        }
+        fputs(m_line, file);
+        fclose(file);
+    }
+}
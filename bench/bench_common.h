@@ -0,0 +1,94 @@
+#ifndef __TSS_BENCH_COMMON_H__
+#define __TSS_BENCH_COMMON_H__
+
+/*
+*   Shared setup and reporting for the benchmarks.
+*
+*   Every benchmark runs against the in process simulated sensor by default, or against
+*   a serial port with -p, such as one served by tss_sim_pty. Results are written as one
+*   JSON object per line, to stdout and appended to the file given with -o.
+*/
+
+#include "tss/com/sim.h"
+#include "tss/com/serial.h"
+#include "tss/api/sensor.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct BenchOptions {
+    const char *name;
+
+    //Port to use instead of the simulated sensor. -1 for the simulated sensor.
+    int port;
+    const char *output_path;
+
+    uint32_t duration_ms;
+    uint32_t iterations;
+
+    //Benchmark specific value, such as the firmware size or corruption interval. 0 for the default.
+    uint32_t value;
+};
+
+struct BenchContext {
+    struct BenchOptions options;
+
+    union {
+        struct SimComClass sim;
+        struct SerialComClass ser;
+    } com_storage;
+    struct TSS_Com_Class *com;
+    struct SimSensor *sim; //NULL when connected over serial
+
+    TSS_Sensor sensor;
+};
+
+//A growable set of latency samples, reported as percentiles
+struct BenchSamples {
+    uint64_t *values;
+    size_t count;
+    size_t capacity;
+};
+
+/**
+ * @brief Parses the options shared by every benchmark. Exits with usage on invalid options.
+ * Accepts -p <port>, -o <file>, -t <duration ms>, -n <iterations> and -v <value>.
+ */
+void benchParseOptions(int argc, char **argv, const char *name, struct BenchOptions *out);
+
+/**
+ * @brief Opens the com class selected by the options and initializes the sensor on it.
+ * @param config Used for the simulated sensor. Ignored for a serial port, where the same behavior
+ * has to be given to whatever is serving it.
+ * @return 0 on success.
+ */
+int benchOpen(struct BenchContext *ctx, const struct BenchOptions *options, const struct SimSensorConfig *config);
+void benchClose(struct BenchContext *ctx);
+
+/**
+ * @brief Monotonic time in nanoseconds.
+ */
+uint64_t benchTimeNs(void);
+
+void benchSamplesInit(struct BenchSamples *samples, size_t capacity);
+void benchSamplesAdd(struct BenchSamples *samples, uint64_t value);
+void benchSamplesFree(struct BenchSamples *samples);
+
+/**
+ * @brief Writes one result line. Starts with the benchmark name, com type and case, followed by
+ * the fields given with the functions below and ended with benchResultEnd.
+ */
+void benchResultBegin(const struct BenchContext *ctx, const char *bench_case);
+void benchResultU64(const char *key, uint64_t value);
+void benchResultDouble(const char *key, double value);
+void benchResultString(const char *key, const char *value);
+
+/**
+ * @brief Adds the count, mean, p50, p90, p99, p99.9 and max of the samples, with keys prefixed by @p prefix.
+ * Sorts the samples.
+ */
+void benchResultPercentiles(const char *prefix, struct BenchSamples *samples);
+void benchResultEnd(void);
+
+#endif /* __TSS_BENCH_COMMON_H__ */
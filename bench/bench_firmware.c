@@ -0,0 +1,101 @@
+/*
+*   Firmware upload throughput through the firmware uploader tool.
+*
+*   Generates a firmware file of -v <KiB> of data (1024 by default) in the format the uploader
+*   parses, then enters the bootloader and times the upload from erase to loading the new firmware.
+*/
+#include "bench_common.h"
+#include "tss/tools/firmware.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_FIRMWARE_KIB 1024
+
+static const char K_FIRMWARE_START[] = "<SetAddr>00000000</SetAddr><MemProgC>";
+static const char K_FIRMWARE_END[] = "</MemProgC><Run></Run>";
+
+//Builds the text of a firmware file with the given amount of data. Returns NULL if out of memory.
+static char* buildFirmware(size_t num_bytes, size_t *out_len)
+{
+    static const char K_HEX[] = "0123456789ABCDEF";
+    size_t len, pos;
+    uint32_t state = 0x12345678u;
+    uint8_t byte;
+    char *text;
+
+    len = sizeof(K_FIRMWARE_START) - 1 + num_bytes * 2 + sizeof(K_FIRMWARE_END) - 1;
+    text = malloc(len);
+    if(text == NULL) return NULL;
+
+    pos = 0;
+    memcpy(text + pos, K_FIRMWARE_START, sizeof(K_FIRMWARE_START) - 1);
+    pos += sizeof(K_FIRMWARE_START) - 1;
+    for(size_t i = 0; i < num_bytes; i++) {
+        state = state * 1664525u + 1013904223u;
+        byte = (uint8_t)(state >> 24);
+        text[pos++] = K_HEX[byte >> 4];
+        text[pos++] = K_HEX[byte & 0xF];
+    }
+    memcpy(text + pos, K_FIRMWARE_END, sizeof(K_FIRMWARE_END) - 1);
+
+    *out_len = len;
+    return text;
+}
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    struct TSS_Firmware_Uploader uploader;
+    static uint8_t buffer[8192];
+    uint64_t start_ns, elapsed_ns, firmware_before = 0;
+    size_t num_bytes, text_len;
+    uint8_t active;
+    char bench_case[32];
+    char *text;
+    int err, result;
+
+    benchParseOptions(argc, argv, "firmware", &options);
+    num_bytes = (size_t)((options.value > 0) ? options.value : DEFAULT_FIRMWARE_KIB) * 1024;
+
+    text = buildFirmware(num_bytes, &text_len);
+    ctx = calloc(1, sizeof(*ctx));
+    if(text == NULL || ctx == NULL) return 1;
+    if(benchOpen(ctx, &options, NULL)) return 1;
+
+    sensorEnterBootloader(&ctx->sensor);
+    err = sensorBootloaderIsActive(&ctx->sensor, &active);
+    if(err || !active) {
+        fprintf(stderr, "Failed to enter the bootloader: %d\n", err);
+        return 1;
+    }
+
+    tssFirmwareUploaderCreate(&ctx->sensor, buffer, sizeof(buffer), &uploader);
+    if(ctx->sim != NULL) firmware_before = ctx->sim->stats.firmware_bytes;
+    start_ns = benchTimeNs();
+    err = tssFirmwareUpload(&uploader, text, text_len);
+    elapsed_ns = benchTimeNs() - start_ns;
+    if(err != TSS_FIRMWARE_UPLOAD_COMPLETE) {
+        fprintf(stderr, "Firmware upload failed: %d\n", err);
+    }
+
+    result = (err == TSS_FIRMWARE_UPLOAD_COMPLETE) ? 0 : 1;
+    snprintf(bench_case, sizeof(bench_case), "%zuKiB", num_bytes / 1024);
+    benchResultBegin(ctx, bench_case);
+    benchResultU64("result", (uint64_t)result);
+    benchResultU64("bytes", num_bytes);
+    benchResultU64("packets", uploader.packet_count);
+    if(ctx->sim != NULL) {
+        benchResultU64("bytes_programmed", ctx->sim->stats.firmware_bytes - firmware_before);
+    }
+    benchResultU64("elapsed_ns", elapsed_ns);
+    benchResultDouble("bytes_per_s", (double)num_bytes / ((double)elapsed_ns / 1e9));
+    benchResultEnd();
+
+    benchClose(ctx);
+    free(ctx);
+    free(text);
+    return result;
+}
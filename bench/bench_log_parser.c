@@ -0,0 +1,375 @@
+/*
+*   Parsing SD card logs, checking every record, the index and seeking along the way.
+*
+*   The binary and ascii cases generate a log in memory, starting with a line of settings and with
+*   32 bit timestamps that wrap several times, and feed it in chunks of random size as file streaming
+*   packets would arrive. Every record must decode to what was generated with its timestamp unwrapped,
+*   the index must have been compacted to fit its capacity while still pointing at the right records,
+*   and seeking to the entry for random times must decode up to the first record at or after each time.
+*   The file_streaming case parses a file streamed from the simulated sensor, stopping from the record
+*   callback part way through packets with a negative value, which must not be mistaken for a read error,
+*   and checks parsing continues from where it stopped.
+*   The number of generated records is set with -v. Seeks are set with -n.
+*/
+#include "bench_common.h"
+#include "tss/tools/log_parser.h"
+#include "tss/constants.h"
+#include "tss/errors.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define DEFAULT_NUM_RECORDS 100000
+#define LAYOUT "0,39"
+#define HEADER_BITFIELD (TSS_HEADER_STATUS_BIT | TSS_HEADER_TIMESTAMP_BIT)
+#define SETTINGS_LINE "serial_number=0x0000000100000001;log_slots=" LAYOUT "\n"
+#define MAX_CHUNK_SIZE 2048
+#define INDEX_CAPACITY 64
+
+//Starts close to wrapping, with records 0.1 s apart so 100000 records wrap twice
+#define TIMESTAMP_START 0xFFF00000ull
+#define TIMESTAMP_STEP 100000ull
+
+//File streaming case
+#define FILE_SIZE (256 * 1024)
+#define FILE_LAYOUT "0"
+#define FILE_RECORD_SIZE 16
+#define FILE_STOP_INTERVAL 97
+#define FILE_STOP_RESULT -1
+#define FILE_TIMEOUT_MS 5000
+
+struct LogCheck {
+    uint64_t next_record;
+    uint64_t errors;
+    const uint64_t *offsets;    //Of each generated record
+
+    //Set when seeking, to stop at the first record at or after the time
+    bool seeking;
+    uint64_t stop_time;
+    uint64_t stopped_record;
+};
+
+static uint64_t m_rng = 0x2545F4914F6CDD1Dull;
+
+static uint32_t nextRandom(void)
+{
+    m_rng ^= m_rng << 13;
+    m_rng ^= m_rng >> 7;
+    m_rng ^= m_rng << 17;
+    return (uint32_t)(m_rng >> 32);
+}
+
+static uint64_t recordTimestamp(uint64_t record)
+{
+    return TIMESTAMP_START + record * TIMESTAMP_STEP;
+}
+
+//Quarters are printed exactly in ASCII, so both modes must decode to the same values
+static float recordValue(uint64_t record, uint32_t field)
+{
+    return (float)((record * 7 + field) % 4096) * 0.25f;
+}
+
+//Generates a log of every record in the data mode. Returns the length, or 0 if out of memory.
+static size_t generateLog(uint8_t data_mode, uint64_t num_records, uint8_t **out, uint64_t **out_offsets)
+{
+    size_t capacity, len;
+    uint8_t *log;
+    uint64_t *offsets;
+    uint32_t timestamp;
+    float value;
+
+    //Each ASCII line is at most "status,timestamp," and 7 values of "1023.75,"
+    capacity = sizeof(SETTINGS_LINE) + num_records * (4 + 11 + 7 * 9 + 1);
+    log = malloc(capacity);
+    offsets = malloc(num_records * sizeof(offsets[0]));
+    if(log == NULL || offsets == NULL) {
+        free(log);
+        free(offsets);
+        return 0;
+    }
+
+    len = sizeof(SETTINGS_LINE) - 1;
+    memcpy(log, SETTINGS_LINE, len);
+    for(uint64_t i = 0; i < num_records; i++) {
+        offsets[i] = len;
+        timestamp = (uint32_t)recordTimestamp(i);
+        if(data_mode == TSS_LOG_DATA_MODE_BINARY) {
+            //Little endian, the same as the sensor writes it
+            log[len++] = (uint8_t)(i & 0x7F);
+            for(uint32_t b = 0; b < 4; b++) {
+                log[len++] = (uint8_t)(timestamp >> (8 * b));
+            }
+            for(uint32_t field = 0; field < 7; field++) {
+                uint32_t bits;
+                value = recordValue(i, field);
+                memcpy(&bits, &value, sizeof(bits));
+                for(uint32_t b = 0; b < 4; b++) {
+                    log[len++] = (uint8_t)(bits >> (8 * b));
+                }
+            }
+        }
+        else {
+            len += (size_t)sprintf((char*)log + len, "%u,%" PRIu32, (unsigned)(i & 0x7F), timestamp);
+            for(uint32_t field = 0; field < 7; field++) {
+                len += (size_t)sprintf((char*)log + len, ",%.2f", (double)recordValue(i, field));
+            }
+            log[len++] = '\n';
+        }
+    }
+
+    *out = log;
+    *out_offsets = offsets;
+    return len;
+}
+
+static int checkRecord(struct TSS_Log_Parser *parser, const struct TSS_Log_Record *record)
+{
+    struct LogCheck *check = parser->user_data;
+    float quat[4], accel[3];
+    bool valid;
+
+    valid = record->index == check->next_record &&
+        record->offset == check->offsets[record->index] &&
+        record->timestamp == recordTimestamp(record->index) &&
+        (uint64_t)record->header.status == (record->index & 0x7F) &&
+        tssLogRecordRead(parser, record, (void*[]) { quat, accel }) == TSS_SUCCESS;
+    for(uint32_t field = 0; field < 7 && valid; field++) {
+        valid = ((field < 4) ? quat[field] : accel[field - 4]) == recordValue(record->index, field);
+    }
+    if(!valid) check->errors++;
+    check->next_record = record->index + 1;
+
+    if(check->seeking && record->timestamp >= check->stop_time) {
+        check->stopped_record = record->index;
+        return 1;
+    }
+    return 0;
+}
+
+//Feeds the log from offset in chunks of random size. Returns the result of the last feed.
+static int feedLog(struct TSS_Log_Parser *parser, const uint8_t *log, size_t len, size_t offset)
+{
+    size_t chunk_len;
+    int result;
+
+    while(offset < len) {
+        chunk_len = 1 + nextRandom() % MAX_CHUNK_SIZE;
+        if(chunk_len > len - offset) chunk_len = len - offset;
+        result = tssLogParserFeed(parser, log + offset, chunk_len);
+        if(result) return result;
+        offset += chunk_len;
+    }
+    return 0;
+}
+
+//Checks the index still fits and every entry points at the record it says
+static bool checkIndex(const struct TSS_Log_Parser *parser, const uint64_t *offsets, uint64_t num_records)
+{
+    const struct TSS_Log_Index_Entry *entry;
+
+    if(parser->index_count == 0 || parser->index_count > parser->index_capacity) return false;
+    //Filling should have compacted it, so the last entry is within one interval of the end
+    if(parser->index_interval == 1) return false;
+    if(num_records - parser->index[parser->index_count - 1].record > parser->index_interval) return false;
+
+    for(size_t i = 0; i < parser->index_count; i++) {
+        entry = &parser->index[i];
+        if(entry->record >= num_records || entry->record % parser->index_interval != 0) return false;
+        if(i > 0 && entry->record <= parser->index[i - 1].record) return false;
+        if(entry->offset != offsets[entry->record] || entry->timestamp != recordTimestamp(entry->record)) return false;
+    }
+    return true;
+}
+
+static void runLogCase(struct BenchContext *ctx, const char *name, uint8_t data_mode, uint64_t num_records, int *out_result)
+{
+    static struct TSS_Log_Parser parser;
+    struct TSS_Log_Index_Entry index[INDEX_CAPACITY];
+    struct TSS_Log_Format format;
+    struct LogCheck check = { 0 };
+    const struct TSS_Log_Index_Entry *entry;
+    uint8_t *log;
+    uint64_t *offsets, start_ns, parse_ns, seek_ns, stop_time, expected;
+    uint64_t records;
+    uint32_t seek_errors = 0;
+    size_t len, index_count;
+    bool index_valid;
+    int err;
+
+    len = generateLog(data_mode, num_records, &log, &offsets);
+    if(len == 0) {
+        *out_result = 1;
+        return;
+    }
+    check.offsets = offsets;
+
+    err = tssLogFormatCreate(&format, LAYOUT, data_mode, HEADER_BITFIELD, true);
+    tssLogParserCreate(&parser, &format, checkRecord, &check, index, INDEX_CAPACITY, 1);
+
+    start_ns = benchTimeNs();
+    if(err == TSS_SUCCESS) err = feedLog(&parser, log, len, 0);
+    parse_ns = benchTimeNs() - start_ns;
+    records = parser.records;
+    index_valid = checkIndex(&parser, offsets, num_records);
+
+    //Seek to random times and decode up to the first record at or after each
+    index_count = parser.index_count;
+    check.seeking = true;
+    start_ns = benchTimeNs();
+    for(uint32_t i = 0; i < ctx->options.iterations; i++) {
+        stop_time = recordTimestamp(0) + (uint64_t)nextRandom() % (recordTimestamp(num_records - 1) - recordTimestamp(0) + 1);
+        expected = (stop_time - recordTimestamp(0) + TIMESTAMP_STEP - 1) / TIMESTAMP_STEP;
+
+        entry = tssLogIndexFindTime(&parser, stop_time);
+        if(entry == NULL || entry->timestamp > stop_time ||
+            (entry + 1 < parser.index + parser.index_count && entry[1].timestamp <= stop_time)) {
+            seek_errors++;
+            continue;
+        }
+
+        tssLogParserSeek(&parser, entry);
+        check.next_record = entry->record;
+        check.stop_time = stop_time;
+        if(feedLog(&parser, log, len, (size_t)entry->offset) != 1 || check.stopped_record != expected) {
+            seek_errors++;
+        }
+    }
+    seek_ns = benchTimeNs() - start_ns;
+    if(parser.index_count != index_count) seek_errors++;
+
+    *out_result = (err == TSS_SUCCESS && records == num_records && parser.malformed_records == 0 &&
+        check.errors == 0 && index_valid && seek_errors == 0) ? 0 : 1;
+
+    benchResultBegin(ctx, name);
+    benchResultU64("result", (uint64_t)*out_result);
+    benchResultU64("records", records);
+    benchResultU64("record_errors", check.errors);
+    benchResultU64("index_entries", index_count);
+    benchResultU64("index_interval", parser.index_interval);
+    benchResultU64("seek_errors", seek_errors);
+    benchResultU64("log_bytes", len);
+    benchResultDouble("mb_per_s", (double)len / 1e6 / ((double)parse_ns / 1e9));
+    benchResultDouble("seek_us", (double)seek_ns / 1e3 / ctx->options.iterations);
+    benchResultEnd();
+
+    free(log);
+    free(offsets);
+}
+
+//-------------------------------------FILE STREAMING------------------------------------------
+
+static struct TSS_Log_Parser m_file_parser;
+static uint64_t m_file_errors;
+static uint64_t m_file_offset;   //Of the start of the current packet
+static uint32_t m_file_stops;
+static int m_file_read_result;
+
+//The simulated file is not a real log, but with no header any bytes are valid binary records
+static int checkFileRecord(struct TSS_Log_Parser *parser, const struct TSS_Log_Record *record)
+{
+    (void)parser;
+    if(record->offset != record->index * FILE_RECORD_SIZE || record->len != FILE_RECORD_SIZE) {
+        m_file_errors++;
+        return 0;
+    }
+    for(uint16_t i = 0; i < record->len; i++) {
+        if(record->data[i] != simSensorFileByte(record->offset + i)) {
+            m_file_errors++;
+            break;
+        }
+    }
+    return (record->index % FILE_STOP_INTERVAL == FILE_STOP_INTERVAL - 1) ? FILE_STOP_RESULT : 0;
+}
+
+static enum TSS_DataCallbackState onFilePacket(TSS_Sensor *sensor)
+{
+    uint8_t packet[TSS_FILE_STREAMING_MAX_PACKET_SIZE];
+    uint16_t len;
+    size_t parsed;
+    int result;
+
+    result = tssLogParserFeedFileStreaming(&m_file_parser, sensor, packet, sizeof(packet), &len);
+    if(result < 0) {
+        m_file_read_result = result;
+        return TSS_DataCallbackStateError;
+    }
+
+    //Stopped by the callback, continue with the rest of the packet
+    while(result == TSS_LOG_PARSER_STOPPED || result == FILE_STOP_RESULT) {
+        if(m_file_parser.stop_result != FILE_STOP_RESULT) {
+            m_file_errors++;
+        }
+        m_file_stops++;
+        parsed = (size_t)(m_file_parser.offset - m_file_offset);
+        result = tssLogParserFeed(&m_file_parser, packet + parsed, len - parsed);
+    }
+    m_file_offset += len;
+    return TSS_DataCallbackStateProcessed;
+}
+
+static void runFileStreamingCase(struct BenchContext *ctx, int *out_result)
+{
+    struct TSS_Log_Format format;
+    uint64_t size = 0, start_ns, elapsed_ns;
+    int err;
+
+    m_file_errors = 0;
+    m_file_offset = 0;
+    m_file_stops = 0;
+    m_file_read_result = TSS_SUCCESS;
+
+    err = tssLogFormatCreate(&format, FILE_LAYOUT, TSS_LOG_DATA_MODE_BINARY, 0, false);
+    tssLogParserCreate(&m_file_parser, &format, checkFileRecord, NULL, NULL, 0, 1);
+
+    if(err == TSS_SUCCESS) err = sensorFsOpenFile(&ctx->sensor, "log.bin");
+    start_ns = benchTimeNs();
+    if(err == TSS_SUCCESS) err = sensorFileStreamingStart(&ctx->sensor, onFilePacket, &size);
+    while(err == TSS_SUCCESS && ctx->sensor.streaming.file.active && benchTimeNs() - start_ns < FILE_TIMEOUT_MS * 1000000ull) {
+        sensorUpdateStreaming(&ctx->sensor);
+    }
+    elapsed_ns = benchTimeNs() - start_ns;
+    if(ctx->sensor.streaming.file.active) {
+        sensorFileStreamingStop(&ctx->sensor);
+    }
+
+    *out_result = (err == TSS_SUCCESS && m_file_read_result == TSS_SUCCESS && size == FILE_SIZE &&
+        m_file_parser.records == FILE_SIZE / FILE_RECORD_SIZE && m_file_errors == 0 && m_file_stops > 0) ? 0 : 1;
+
+    benchResultBegin(ctx, "file_streaming");
+    benchResultU64("result", (uint64_t)*out_result);
+    benchResultU64("records", m_file_parser.records);
+    benchResultU64("record_errors", m_file_errors);
+    benchResultU64("stops", m_file_stops);
+    benchResultU64("file_bytes", size);
+    benchResultDouble("mb_per_s", (double)m_file_offset / 1e6 / ((double)elapsed_ns / 1e9));
+    benchResultEnd();
+}
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    struct SimSensorConfig config = {0};
+    uint64_t num_records;
+    int binary_result, ascii_result, file_result;
+
+    benchParseOptions(argc, argv, "log_parser", &options);
+    options.port = -1;
+    num_records = (options.value > 0) ? options.value : DEFAULT_NUM_RECORDS;
+
+    ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL) return 1;
+    config.file_size = FILE_SIZE;
+    if(benchOpen(ctx, &options, &config)) return 1;
+
+    runLogCase(ctx, "binary/" LAYOUT, TSS_LOG_DATA_MODE_BINARY, num_records, &binary_result);
+    runLogCase(ctx, "ascii/" LAYOUT, TSS_LOG_DATA_MODE_ASCII, num_records, &ascii_result);
+    runFileStreamingCase(ctx, &file_result);
+
+    benchClose(ctx);
+    free(ctx);
+    return (binary_result || ascii_result || file_result) ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/*
+*   Offloading SD card files from many sensors, one at a time compared to all at once.
+*
+*   Every simulated sensor holds a file streamed at a fixed rate, as a sensor's link would limit it,
+*   so one at a time takes the sum of every transfer while all at once takes about the longest one.
+*   Each case checks every output file byte for byte. The resume case drops the stream of every
+*   sensor part way through several times and corrupts bytes, so every file has to be resumed.
+*   Always uses simulated sensors, the number of which is set with -v.
+*/
+#include "bench_common.h"
+#include "tss/tools/offload.h"
+#include "tss/errors.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DEFAULT_NUM_SENSORS 8
+#define FILE_SIZE (1024 * 1024)
+#define FILE_BYTES_PER_S (2 * 1024 * 1024)
+#define SENSOR_PATH "log.bin"
+#define OUT_PATH_FORMAT "tss_bench_offload_%u.bin"
+
+//Resume case
+#define DROP_INTERVAL (FILE_SIZE / 3 + 1000)
+#define CORRUPT_INTERVAL 700000
+#define STALL_TIMEOUT_MS 100
+
+struct OffloadCase {
+    const char *name;
+    bool concurrent;
+    bool force_thread_pool;
+    bool needs_io_uring;
+    bool drops;
+};
+
+static uint32_t m_num_sensors;
+static struct BenchContext *m_ctxs;
+static struct TSS_Offload_Job *m_jobs;
+static char (*m_out_paths)[64];
+
+//Compares the output file to what the sensor holds
+static bool verifyFile(const char *path)
+{
+    static uint8_t data[FILE_SIZE + 1];
+    FILE *file;
+    size_t len;
+
+    file = fopen(path, "rb");
+    if(file == NULL) return false;
+    len = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    if(len != FILE_SIZE) return false;
+
+    for(size_t i = 0; i < len; i++) {
+        if(data[i] != simSensorFileByte(i)) return false;
+    }
+    return true;
+}
+
+static void setDrops(bool drops)
+{
+    for(uint32_t i = 0; i < m_num_sensors; i++) {
+        struct SimSensor *sim = m_ctxs[i].sim;
+        sim->config.file_drop_interval = drops ? DROP_INTERVAL : 0;
+        sim->config.corrupt_interval = drops ? CORRUPT_INTERVAL : 0;
+        sim->bytes_until_corrupt = sim->config.corrupt_interval;
+    }
+}
+
+//Returns 0 if every file was offloaded and matches what the sensor holds
+static int runCase(const struct OffloadCase *test)
+{
+    struct TSS_Offload_Config config;
+    uint64_t start_ns, elapsed_ns, total_bytes = 0, resumes = 0, reconnects = 0;
+    uint32_t verified = 0;
+    int err = TSS_SUCCESS, job_err, result;
+
+    tssOffloadConfigDefault(&config);
+    config.force_thread_pool = test->force_thread_pool;
+    if(test->drops) config.stall_timeout_ms = STALL_TIMEOUT_MS;
+
+    for(uint32_t i = 0; i < m_num_sensors; i++) {
+        tssOffloadJobCreate(&m_jobs[i], &m_ctxs[i].sensor, SENSOR_PATH, m_out_paths[i]);
+    }
+
+    setDrops(test->drops);
+    start_ns = benchTimeNs();
+    if(test->concurrent) {
+        err = tssOffloadRun(m_jobs, m_num_sensors, &config);
+    }
+    else {
+        for(uint32_t i = 0; i < m_num_sensors; i++) {
+            job_err = tssOffloadRun(&m_jobs[i], 1, &config);
+            if(err == TSS_SUCCESS) err = job_err;
+        }
+    }
+    elapsed_ns = benchTimeNs() - start_ns;
+    setDrops(false);
+
+    for(uint32_t i = 0; i < m_num_sensors; i++) {
+        total_bytes += m_jobs[i].written;
+        resumes += m_jobs[i].resumes;
+        reconnects += m_jobs[i].reconnects;
+        if(m_jobs[i].result == TSS_SUCCESS && verifyFile(m_out_paths[i])) verified++;
+        remove(m_out_paths[i]);
+    }
+
+    result = (err == TSS_SUCCESS && verified == m_num_sensors) ? 0 : 1;
+    benchResultBegin(&m_ctxs[0], test->name);
+    benchResultU64("result", (uint64_t)result);
+    benchResultU64("sensors", m_num_sensors);
+    benchResultU64("files_verified", verified);
+    benchResultU64("bytes", total_bytes);
+    benchResultU64("buffer_bytes", (uint64_t)config.buffer_size * config.num_buffers);
+    benchResultU64("resumes", resumes);
+    benchResultU64("reconnects", reconnects);
+    benchResultDouble("elapsed_ms", (double)elapsed_ns / 1e6);
+    benchResultDouble("mb_per_s", (double)total_bytes / 1e6 / ((double)elapsed_ns / 1e9));
+    benchResultEnd();
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct OffloadCase cases[] = {
+        { "serial",              false, true,  false, false },
+        { "concurrent/threads",  true,  true,  false, false },
+        { "concurrent/io_uring", true,  false, true,  false },
+        { "concurrent/resume",   true,  false, false, true  },
+    };
+    struct BenchOptions options;
+    struct SimSensorConfig config = {0};
+    int result = 0;
+
+    benchParseOptions(argc, argv, "offload", &options);
+    options.port = -1;
+    m_num_sensors = (options.value > 0) ? options.value : DEFAULT_NUM_SENSORS;
+
+    m_ctxs = calloc(m_num_sensors, sizeof(*m_ctxs));
+    m_jobs = calloc(m_num_sensors, sizeof(*m_jobs));
+    m_out_paths = calloc(m_num_sensors, sizeof(*m_out_paths));
+    if(m_ctxs == NULL || m_jobs == NULL || m_out_paths == NULL) return 1;
+
+    config.file_size = FILE_SIZE;
+    config.file_bytes_per_s = FILE_BYTES_PER_S;
+    for(uint32_t i = 0; i < m_num_sensors; i++) {
+        config.serial_number = 0x0000000100000001ull + i;
+        config.seed = i + 1;
+        if(benchOpen(&m_ctxs[i], &options, &config)) return 1;
+        snprintf(m_out_paths[i], sizeof(m_out_paths[i]), OUT_PATH_FORMAT, i);
+    }
+
+    for(size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if(cases[i].needs_io_uring && !tssOffloadIoUringAvailable()) continue;
+        if(runCase(&cases[i])) result = 1;
+    }
+
+    for(uint32_t i = 0; i < m_num_sensors; i++) {
+        benchClose(&m_ctxs[i]);
+    }
+    free(m_ctxs);
+    free(m_jobs);
+    free(m_out_paths);
+    return result;
+}
@@ -0,0 +1,219 @@
+/*
+*   Cost of saving streaming packets to disk, as binary recordings compared to CSV.
+*
+*   The simulated sensor streams unthrottled, so the rate is bound by parsing plus saving each packet.
+*   The csv case formats every value with fprintf, as is commonly done in the streaming callback.
+*   The recording case decodes straight into a recording, keeping a copy of what was decoded from each
+*   packet. The recording is then read back and every record must match the packet it came from, and
+*   finding records by time is timed and must give the first record at or after each time.
+*/
+#include "bench_common.h"
+#include "tss/tools/recording.h"
+#include "tss/errors.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LAYOUT "0,39"
+#define CSV_PATH "tss_bench_recording.csv"
+#define RECORDING_PATH "tss_bench_recording.tssrec"
+#define CHUNK_BUFFER_SIZE 65536
+
+//What was decoded from a streamed packet, to compare against what is read back
+struct StreamedPacket {
+    uint64_t time_us;
+    float quat[4];
+    float accel[3];
+};
+
+static FILE *m_csv;
+static struct TSS_Recorder m_recorder;
+static uint64_t m_num_packets;
+static bool m_counting;
+
+static struct StreamedPacket *m_streamed;
+static uint64_t m_num_streamed;
+static uint64_t m_streamed_capacity;
+
+static enum TSS_DataCallbackState onPacketCsv(TSS_Sensor *sensor)
+{
+    float quat[4], accel[3];
+    if(sensorProcessDataStreamingCallbackOutput(sensor, quat, accel) < 0) {
+        return TSS_DataCallbackStateError;
+    }
+    fprintf(m_csv, "%f,%f,%f,%f,%f,%f,%f\n", (double)quat[0], (double)quat[1], (double)quat[2], (double)quat[3],
+        (double)accel[0], (double)accel[1], (double)accel[2]);
+    if(m_counting) m_num_packets++;
+    return TSS_DataCallbackStateProcessed;
+}
+
+static enum TSS_DataCallbackState onPacketRecording(TSS_Sensor *sensor)
+{
+    struct StreamedPacket *packet;
+    (void)sensor;
+    if(tssRecorderRecordPacket(&m_recorder) < 0) {
+        return TSS_DataCallbackStateError;
+    }
+
+    //The outputs point at the fields of the record just added
+    if(m_num_streamed == m_streamed_capacity) {
+        m_streamed_capacity = (m_streamed_capacity == 0) ? 65536 : m_streamed_capacity * 2;
+        packet = realloc(m_streamed, m_streamed_capacity * sizeof(m_streamed[0]));
+        if(packet == NULL) return TSS_DataCallbackStateError;
+        m_streamed = packet;
+    }
+    packet = &m_streamed[m_num_streamed++];
+    packet->time_us = m_recorder.last_us;
+    memcpy(packet->quat, m_recorder.outputs[0], sizeof(packet->quat));
+    memcpy(packet->accel, m_recorder.outputs[1], sizeof(packet->accel));
+
+    if(m_counting) m_num_packets++;
+    return TSS_DataCallbackStateProcessed;
+}
+
+//Reads back every record and compares it with the packet it was recorded from. Returns the number that differ.
+static uint64_t verifyRecords(const struct TSS_Recording_Reader *reader)
+{
+    struct StreamedPacket packet;
+    uint64_t mismatched = 0;
+
+    for(uint64_t i = 0; i < reader->num_records && i < m_num_streamed; i++) {
+        if(tssRecordingReaderRead(reader, i, &packet.time_us, NULL, (void*[]) { packet.quat, packet.accel }) != TSS_SUCCESS ||
+            packet.time_us != m_streamed[i].time_us ||
+            memcmp(packet.quat, m_streamed[i].quat, sizeof(packet.quat)) != 0 ||
+            memcmp(packet.accel, m_streamed[i].accel, sizeof(packet.accel)) != 0) {
+            mismatched++;
+        }
+    }
+    return mismatched;
+}
+
+//Whether index is the first record at or after time_us
+static bool isFirstAtOrAfter(uint64_t index, uint64_t time_us)
+{
+    if(index < m_num_streamed && m_streamed[index].time_us < time_us) return false;
+    if(index > 0 && m_streamed[index - 1].time_us >= time_us) return false;
+    return true;
+}
+
+static void runStreaming(struct BenchContext *ctx, TssDataCallback cb, uint64_t *out_elapsed_ns)
+{
+    uint64_t start_ns;
+
+    m_num_packets = 0;
+    m_counting = true;
+    sensorStreamingStart(&ctx->sensor, cb);
+    start_ns = benchTimeNs();
+    while(benchTimeNs() - start_ns < (uint64_t)ctx->options.duration_ms * 1000000ull) {
+        sensorUpdateStreaming(&ctx->sensor);
+    }
+    *out_elapsed_ns = benchTimeNs() - start_ns;
+    m_counting = false;
+    sensorStreamingStop(&ctx->sensor);
+}
+
+static long fileSize(const char *path)
+{
+    FILE *file;
+    long size;
+
+    file = fopen(path, "rb");
+    if(file == NULL) return 0;
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    struct SimSensorConfig config = {0};
+    struct TSS_Recording_Reader reader;
+    static uint8_t chunk_buffer[CHUNK_BUFFER_SIZE];
+    uint64_t elapsed_ns, recorded_packets, find_ns, last_us, mismatched, misplaced = 0;
+    uint64_t *indices;
+    int err, result;
+
+    benchParseOptions(argc, argv, "recording", &options);
+    config.unthrottled = true;
+
+    ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL) return 1;
+    if(benchOpen(ctx, &options, &config)) return 1;
+
+    err = sensorWriteStreamSlots(&ctx->sensor, LAYOUT);
+    if(err) {
+        fprintf(stderr, "Failed to set stream slots: %d\n", err);
+        return 1;
+    }
+
+    //CSV
+    m_csv = fopen(CSV_PATH, "w");
+    if(m_csv == NULL) return 1;
+    runStreaming(ctx, onPacketCsv, &elapsed_ns);
+    fclose(m_csv);
+
+    benchResultBegin(ctx, "csv/" LAYOUT);
+    benchResultU64("packets", m_num_packets);
+    benchResultU64("file_bytes", (uint64_t)fileSize(CSV_PATH));
+    benchResultDouble("packets_per_s", (double)m_num_packets / ((double)elapsed_ns / 1e9));
+    benchResultEnd();
+    remove(CSV_PATH);
+
+    //Recording
+    err = tssRecorderOpen(&m_recorder, &ctx->sensor, RECORDING_PATH, chunk_buffer, sizeof(chunk_buffer));
+    if(err) {
+        fprintf(stderr, "Failed to open recording: %d\n", err);
+        return 1;
+    }
+    runStreaming(ctx, onPacketRecording, &elapsed_ns);
+    recorded_packets = m_recorder.records;
+    tssRecorderClose(&m_recorder);
+
+    err = tssRecordingReaderOpen(&reader, RECORDING_PATH);
+    if(err) {
+        fprintf(stderr, "Failed to read recording: %d\n", err);
+        return 1;
+    }
+
+    mismatched = verifyRecords(&reader);
+
+    //Look up evenly spaced times across the whole recording
+    indices = malloc(options.iterations * sizeof(indices[0]));
+    if(indices == NULL) return 1;
+    last_us = (reader.num_chunks > 0) ? reader.chunks[reader.num_chunks - 1].last_us : 0;
+    find_ns = benchTimeNs();
+    for(uint32_t i = 0; i < options.iterations; i++) {
+        indices[i] = tssRecordingReaderFind(&reader, last_us * i / options.iterations);
+    }
+    find_ns = benchTimeNs() - find_ns;
+    for(uint32_t i = 0; i < options.iterations; i++) {
+        if(!isFirstAtOrAfter(indices[i], last_us * i / options.iterations)) misplaced++;
+    }
+    //Past the end there is nothing at or after
+    if(tssRecordingReaderFind(&reader, last_us + 1) != reader.num_records) misplaced++;
+    free(indices);
+
+    result = (reader.num_records == recorded_packets && reader.num_records == m_num_streamed && mismatched == 0 && misplaced == 0) ? 0 : 1;
+    benchResultBegin(ctx, "recording/" LAYOUT);
+    benchResultU64("result", (uint64_t)result);
+    benchResultU64("packets", m_num_packets);
+    benchResultU64("records_read_back", reader.num_records);
+    benchResultU64("records_mismatched", mismatched);
+    benchResultU64("finds_misplaced", misplaced);
+    benchResultU64("chunks", reader.num_chunks);
+    benchResultU64("file_bytes", reader.size);
+    benchResultDouble("packets_per_s", (double)m_num_packets / ((double)elapsed_ns / 1e9));
+    benchResultDouble("find_ns", (double)find_ns / options.iterations);
+    benchResultEnd();
+
+    tssRecordingReaderClose(&reader);
+    remove(RECORDING_PATH);
+    benchClose(ctx);
+    free(ctx);
+    free(m_streamed);
+    return result;
+}
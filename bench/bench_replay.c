@@ -0,0 +1,132 @@
+/*
+*   Parsing throughput when replaying captured traffic.
+*
+*   Streams for the duration through a tee com class to capture the traffic, then replays the
+*   capture at maximum speed through a new sensor that does the same as was done while capturing.
+*   The replay is bound only by how fast the API parses, so it measures parsing of real traffic.
+*   Every captured packet must also come back out of the replay.
+*/
+#include "bench_common.h"
+#include "tss/com/tee.h"
+#include "tss/com/replay.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CAPTURE_PATH "tss_bench_replay.tsscap"
+#define LAYOUT "0,39"
+
+static uint64_t m_num_packets;
+
+static enum TSS_DataCallbackState onPacket(TSS_Sensor *sensor)
+{
+    float quat[4], accel[3];
+    if(sensorProcessDataStreamingCallbackOutput(sensor, quat, accel) < 0) {
+        return TSS_DataCallbackStateError;
+    }
+    m_num_packets++;
+    return TSS_DataCallbackStateProcessed;
+}
+
+//Everything done to the sensor before streaming, which has to match between capturing and replaying
+static int startStreaming(TSS_Sensor *sensor, struct TSS_Com_Class *com)
+{
+    int err;
+
+    if(tss_com_open(com)) {
+        fprintf(stderr, "replay: Failed to open com class\n");
+        return -1;
+    }
+    tssCreateSensor(sensor, com);
+    err = tssInitSensor(sensor);
+    if(err == 0) err = sensorWriteStreamSlots(sensor, LAYOUT);
+    if(err == 0) err = sensorStreamingStart(sensor, onPacket);
+    if(err) {
+        fprintf(stderr, "replay: Failed to start streaming: %d\n", err);
+        tss_com_close(com);
+        return err;
+    }
+    return 0;
+}
+
+static void stopStreaming(TSS_Sensor *sensor, struct TSS_Com_Class *com)
+{
+    sensorStreamingStop(sensor);
+    sensorCleanup(sensor);
+    tss_com_close(com);
+}
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    struct SimSensorConfig config = {0};
+    struct TeeComClass *tee;
+    struct ReplayComClass *replay;
+    uint64_t start_ns, elapsed_ns, captured_packets, captured_bytes;
+    bool capture_failed;
+    int result;
+
+    benchParseOptions(argc, argv, "replay", &options);
+    config.unthrottled = true;
+
+    ctx = calloc(1, sizeof(*ctx));
+    tee = calloc(1, sizeof(*tee));
+    replay = calloc(1, sizeof(*replay));
+    if(ctx == NULL || tee == NULL || replay == NULL) return 1;
+
+    ctx->options = options;
+    if(options.port < 0) {
+        create_sim_com_class(&config, &ctx->com_storage.sim);
+        ctx->com = (struct TSS_Com_Class*)&ctx->com_storage.sim;
+        ctx->sim = &ctx->com_storage.sim.sensor;
+    }
+    else {
+        create_serial_com_class((uint8_t)options.port, &ctx->com_storage.ser);
+        ctx->com = (struct TSS_Com_Class*)&ctx->com_storage.ser;
+        ctx->sim = NULL;
+    }
+
+    //Capture
+    create_tee_com_class(ctx->com, CAPTURE_PATH, tee);
+    if(startStreaming(&ctx->sensor, (struct TSS_Com_Class*)tee)) return 1;
+    start_ns = benchTimeNs();
+    while(benchTimeNs() - start_ns < (uint64_t)options.duration_ms * 1000000ull) {
+        sensorUpdateStreaming(&ctx->sensor);
+    }
+    stopStreaming(&ctx->sensor, (struct TSS_Com_Class*)tee);
+    captured_packets = m_num_packets;
+    captured_bytes = tee->writer.bytes;
+    capture_failed = tee->capture_failed;
+
+    //Replay until every captured packet is parsed again, or the capture runs out
+    m_num_packets = 0;
+    create_replay_com_class(CAPTURE_PATH, true, replay);
+    start_ns = benchTimeNs();
+    if(startStreaming(&ctx->sensor, (struct TSS_Com_Class*)replay)) return 1;
+    while(m_num_packets < captured_packets) {
+        uint64_t before = m_num_packets;
+        sensorUpdateStreaming(&ctx->sensor);
+        if(m_num_packets == before && replay_com_finished(replay)) break;
+    }
+    elapsed_ns = benchTimeNs() - start_ns;
+    stopStreaming(&ctx->sensor, (struct TSS_Com_Class*)replay);
+
+    result = (!capture_failed && m_num_packets == captured_packets) ? 0 : 1;
+    benchResultBegin(ctx, LAYOUT);
+    benchResultU64("result", (uint64_t)result);
+    benchResultU64("capture_bytes", captured_bytes);
+    benchResultU64("captured_packets", captured_packets);
+    benchResultU64("replayed_packets", m_num_packets);
+    benchResultU64("replayed_bytes", replay->bytes_replayed);
+    benchResultU64("elapsed_ns", elapsed_ns);
+    benchResultDouble("packets_per_s", (double)m_num_packets / ((double)elapsed_ns / 1e9));
+    benchResultDouble("bytes_per_s", (double)replay->bytes_replayed / ((double)elapsed_ns / 1e9));
+    benchResultEnd();
+
+    remove(CAPTURE_PATH);
+    free(replay);
+    free(tee);
+    free(ctx);
+    return result;
+}
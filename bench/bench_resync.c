@@ -0,0 +1,123 @@
+/*
+*   How long streaming takes to recover after corrupted data.
+*
+*   The simulated sensor streams unthrottled while flipping one bit in every -v <interval> output
+*   bytes. Every packet carries its sample number, so a jump in it marks packets lost to the
+*   corruption. The recovery time of each is how long passed between the good packets on either side,
+*   compared against the time between packets while nothing is lost.
+*/
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+
+#define DEFAULT_CORRUPT_INTERVAL 20000
+
+//The simulated sensor outputs its sample number modulo this as each float
+#define SAMPLE_MODULO 1000
+
+#define LAYOUT "0,39"
+
+struct ResyncState {
+    bool counting;
+    bool have_last;
+    uint32_t last_sample;
+    uint64_t last_ns;
+
+    uint64_t packets;
+    uint64_t lost;
+    struct BenchSamples recovery_ns;
+    struct BenchSamples interval_ns;
+};
+
+static struct ResyncState m_state;
+
+static enum TSS_DataCallbackState onPacket(TSS_Sensor *sensor)
+{
+    float quat[4], accel[3];
+    uint32_t sample, missing;
+    uint64_t now;
+
+    if(sensorProcessDataStreamingCallbackOutput(sensor, quat, accel) < 0) {
+        return TSS_DataCallbackStateError;
+    }
+    if(!m_state.counting) return TSS_DataCallbackStateProcessed;
+
+    now = benchTimeNs();
+    sample = (uint32_t)lroundf(quat[0] * SAMPLE_MODULO) % SAMPLE_MODULO;
+    if(m_state.have_last) {
+        missing = (sample + SAMPLE_MODULO - m_state.last_sample - 1) % SAMPLE_MODULO;
+        if(missing == 0) {
+            benchSamplesAdd(&m_state.interval_ns, now - m_state.last_ns);
+        }
+        else {
+            benchSamplesAdd(&m_state.recovery_ns, now - m_state.last_ns);
+            m_state.lost += missing;
+        }
+    }
+    m_state.have_last = true;
+    m_state.last_sample = sample;
+    m_state.last_ns = now;
+    m_state.packets++;
+    return TSS_DataCallbackStateProcessed;
+}
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    struct SimSensorConfig config = {0};
+    uint32_t corrupted_before = 0;
+    uint64_t start_ns;
+    char bench_case[64];
+    int err;
+
+    benchParseOptions(argc, argv, "resync", &options);
+    config.unthrottled = true;
+    config.corrupt_interval = (options.value > 0) ? options.value : DEFAULT_CORRUPT_INTERVAL;
+
+    ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL) return 1;
+    if(benchOpen(ctx, &options, &config)) return 1;
+
+    err = sensorWriteStreamSlots(&ctx->sensor, LAYOUT);
+    if(err) {
+        fprintf(stderr, "Failed to set stream slots: %d\n", err);
+        return 1;
+    }
+
+    benchSamplesInit(&m_state.recovery_ns, 1024);
+    benchSamplesInit(&m_state.interval_ns, 1u << 20);
+
+    if(ctx->sim != NULL) corrupted_before = ctx->sim->stats.bytes_corrupted;
+    m_state.counting = true;
+    sensorStreamingStart(&ctx->sensor, onPacket);
+    start_ns = benchTimeNs();
+    while(benchTimeNs() - start_ns < (uint64_t)options.duration_ms * 1000000ull) {
+        sensorUpdateStreaming(&ctx->sensor);
+    }
+    m_state.counting = false;
+    sensorStreamingStop(&ctx->sensor);
+
+    snprintf(bench_case, sizeof(bench_case), "%s/1in%" PRIu32, LAYOUT, config.corrupt_interval);
+    benchResultBegin(ctx, bench_case);
+    benchResultU64("packets", m_state.packets);
+    if(ctx->sim != NULL) {
+        benchResultU64("corruptions", ctx->sim->stats.bytes_corrupted - corrupted_before);
+    }
+    benchResultU64("gaps", m_state.recovery_ns.count);
+    benchResultU64("packets_lost", m_state.lost);
+    benchResultDouble("packets_lost_per_gap", (m_state.recovery_ns.count > 0) ?
+        (double)m_state.lost / (double)m_state.recovery_ns.count : 0.0);
+    benchResultPercentiles("recovery_ns", &m_state.recovery_ns);
+    benchResultPercentiles("interval_ns", &m_state.interval_ns);
+    benchResultEnd();
+
+    benchSamplesFree(&m_state.recovery_ns);
+    benchSamplesFree(&m_state.interval_ns);
+    benchClose(ctx);
+    free(ctx);
+    return 0;
+}
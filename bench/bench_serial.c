@@ -0,0 +1,254 @@
+/*
+*   The serial com class end to end, against the simulated sensor served on a pseudo terminal.
+*
+*   Times discovery, and the round trip of commands and settings through the pseudo terminal along
+*   with the read and write system calls each one takes, from /proc/self/io.
+*
+*   Starts tss_sim_pty linked to a port, unless -p gives a port that is already being served.
+*   Linking the port needs permission to create it in /dev, without which this is skipped.
+*   -v <port> links a different port than the default.
+*/
+#define _GNU_SOURCE
+
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+//ttyUSB120, high enough to be unlikely to be a real device
+#define SERIAL_BENCH_DEFAULT_PORT 120
+#define SERIAL_BENCH_SERIAL_NUMBER UINT64_C(0x0000BE0C00000001)
+
+#define SERIAL_BENCH_DISCOVER_ROUNDS 10
+#define SERIAL_BENCH_DISCOVER_COMS 8
+#define SERIAL_BENCH_DISCOVER_TIMEOUT_MS 500
+
+extern char **environ;
+
+struct SerialCase {
+    const char *name;
+    int (*run)(TSS_Sensor *sensor);
+};
+
+static int runTaredOrientation(TSS_Sensor *sensor)
+{
+    float quat[4];
+    return sensorGetTaredOrientation(sensor, quat);
+}
+
+static int runReadLedMode(TSS_Sensor *sensor)
+{
+    uint8_t value;
+    return sensorReadLedMode(sensor, &value);
+}
+
+static const struct SerialCase K_CASES[] = {
+    { "GetTaredOrientation", runTaredOrientation },
+    { "read:led_mode", runReadLedMode },
+};
+
+//Starts tss_sim_pty linked to the port and waits until it is serving. Returns the pid, or -1 on failure.
+static pid_t startSimPty(uint8_t port)
+{
+    posix_spawn_file_actions_t actions;
+    char port_arg[8], serial_arg[24], line[64];
+    char *argv[] = { TSS_SIM_PTY_PATH, "-p", port_arg, "-s", serial_arg, NULL };
+    FILE *output;
+    pid_t pid;
+    int fds[2];
+
+    snprintf(port_arg, sizeof(port_arg), "%u", port);
+    snprintf(serial_arg, sizeof(serial_arg), "%" PRIx64, SERIAL_BENCH_SERIAL_NUMBER);
+    if(pipe(fds) != 0) return -1;
+
+    //The link path is printed to stdout once serving, the stats on exit go to stderr
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    if(posix_spawn(&pid, argv[0], &actions, NULL, argv, environ) != 0) {
+        pid = -1;
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+
+    output = fdopen(fds[0], "r");
+    if(output == NULL) {
+        close(fds[0]);
+    }
+    else if(pid >= 0 && fgets(line, sizeof(line), output) == NULL) {
+        //Exited without serving, such as not being allowed to create the link
+        waitpid(pid, NULL, 0);
+        pid = -1;
+    }
+    if(output != NULL) fclose(output);
+    return pid;
+}
+
+static void stopSimPty(pid_t pid)
+{
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+//Read and write system calls made by this process so far. Returns false if not available.
+static bool readSyscallCounts(uint64_t *reads, uint64_t *writes)
+{
+    char line[64];
+    unsigned long long value;
+    int found = 0;
+    FILE *file;
+
+    file = fopen("/proc/self/io", "r");
+    if(file == NULL) return false;
+    while(fgets(line, sizeof(line), file) != NULL) {
+        if(sscanf(line, "syscr: %llu", &value) == 1) {
+            *reads = value;
+            found++;
+        }
+        else if(sscanf(line, "syscw: %llu", &value) == 1) {
+            *writes = value;
+            found++;
+        }
+    }
+    fclose(file);
+    return found == 2;
+}
+
+//Latency of each case over the serial com class, and the system calls it takes
+static uint32_t runCommands(struct BenchContext *ctx)
+{
+    struct BenchSamples samples;
+    uint64_t start_ns, reads_before, writes_before, reads_after, writes_after;
+    uint32_t errors, total_errors = 0;
+    bool counted;
+
+    benchSamplesInit(&samples, ctx->options.iterations);
+    for(size_t i = 0; i < sizeof(K_CASES) / sizeof(K_CASES[0]); i++) {
+        samples.count = 0;
+        errors = 0;
+        //Reading the counts is itself a read, so is taken out below
+        counted = readSyscallCounts(&reads_before, &writes_before);
+        for(uint32_t j = 0; j < ctx->options.iterations; j++) {
+            start_ns = benchTimeNs();
+            if(K_CASES[i].run(&ctx->sensor)) {
+                errors++;
+                continue;
+            }
+            benchSamplesAdd(&samples, benchTimeNs() - start_ns);
+        }
+        counted = counted && readSyscallCounts(&reads_after, &writes_after);
+
+        benchResultBegin(ctx, K_CASES[i].name);
+        benchResultU64("errors", errors);
+        if(counted) {
+            benchResultDouble("read_syscalls_per_call", (double)(reads_after - reads_before - 1) / ctx->options.iterations);
+            benchResultDouble("write_syscalls_per_call", (double)(writes_after - writes_before) / ctx->options.iterations);
+        }
+        benchResultPercentiles("latency_ns", &samples);
+        benchResultEnd();
+        total_errors += errors;
+    }
+
+    benchSamplesFree(&samples);
+    return total_errors;
+}
+
+//Time to discover every sensor, checking the served sensor is found on its port each round.
+//A serial_number of 0 accepts any sensor on the port.
+static uint32_t runDiscover(struct BenchContext *ctx, uint8_t port, uint64_t serial_number)
+{
+    struct SerialComClass *coms;
+    struct SerialComDiscovery found[SERIAL_BENCH_DISCOVER_COMS];
+    struct BenchSamples samples;
+    uint64_t start_ns;
+    uint32_t errors = 0;
+    int num_found, i;
+    bool matched;
+
+    //Each com class holds its read buffer, too large for the stack
+    coms = malloc(sizeof(*coms) * SERIAL_BENCH_DISCOVER_COMS);
+    if(coms == NULL) return 1;
+
+    benchSamplesInit(&samples, SERIAL_BENCH_DISCOVER_ROUNDS);
+    for(uint32_t round = 0; round < SERIAL_BENCH_DISCOVER_ROUNDS; round++) {
+        start_ns = benchTimeNs();
+        num_found = serial_com_discover(coms, SERIAL_BENCH_DISCOVER_COMS, found, SERIAL_BENCH_DISCOVER_COMS, SERIAL_BENCH_DISCOVER_TIMEOUT_MS);
+        benchSamplesAdd(&samples, benchTimeNs() - start_ns);
+
+        matched = false;
+        for(i = 0; i < num_found; i++) {
+            if(found[i].port == port && (serial_number == 0 || found[i].serial_number == serial_number) && !found[i].in_bootloader) {
+                matched = true;
+            }
+        }
+        if(!matched) {
+            fprintf(stderr, "Discovery round %" PRIu32 " did not find the sensor on port %u\n", round, port);
+            errors++;
+        }
+    }
+
+    benchResultBegin(ctx, "discover");
+    benchResultU64("errors", errors);
+    benchResultPercentiles("latency_ns", &samples);
+    benchResultEnd();
+
+    benchSamplesFree(&samples);
+    free(coms);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    uint32_t errors = 0;
+    uint64_t serial_number = 0;
+    uint8_t port;
+    pid_t sim_pid = -1;
+
+    benchParseOptions(argc, argv, "serial", &options);
+
+    if(options.port < 0) {
+        port = (options.value > 0) ? (uint8_t)options.value : SERIAL_BENCH_DEFAULT_PORT;
+        sim_pid = startSimPty(port);
+        if(sim_pid < 0) {
+            fprintf(stderr, "serial: Could not serve the simulated sensor on port %u, skipping\n", port);
+            return 0;
+        }
+        serial_number = SERIAL_BENCH_SERIAL_NUMBER;
+    }
+    else {
+        port = (uint8_t)options.port;
+    }
+
+    ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL) {
+        errors++;
+    }
+    else {
+        ctx->options = options;
+        errors += runDiscover(ctx, port, serial_number);
+
+        options.port = port;
+        if(benchOpen(ctx, &options, NULL)) {
+            errors++;
+        }
+        else {
+            errors += runCommands(ctx);
+            benchClose(ctx);
+        }
+    }
+
+    free(ctx);
+    if(sim_pid >= 0) stopSimPty(sim_pid);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/*
+*   Latency of reading and writing settings, from sending the request to its response being parsed.
+*/
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct SettingsCase {
+    const char *name;
+    int (*run)(TSS_Sensor *sensor, uint32_t iteration);
+};
+
+static int runReadLedMode(TSS_Sensor *sensor, uint32_t iteration)
+{
+    uint8_t value;
+    (void) iteration;
+    return sensorReadLedMode(sensor, &value);
+}
+
+static int runReadTimestamp(TSS_Sensor *sensor, uint32_t iteration)
+{
+    uint64_t value;
+    (void) iteration;
+    return sensorReadTimestamp(sensor, &value);
+}
+
+static int runReadMultiple(TSS_Sensor *sensor, uint32_t iteration)
+{
+    uint8_t led_mode, filter_mode;
+    float stream_hz;
+    (void) iteration;
+    return sensorReadSettings(sensor, "led_mode;filter_mode;stream_hz", &led_mode, &filter_mode, &stream_hz);
+}
+
+static int runWriteLedMode(TSS_Sensor *sensor, uint32_t iteration)
+{
+    return sensorWriteLedMode(sensor, (uint8_t)(iteration & 1));
+}
+
+static int runWriteMultiple(TSS_Sensor *sensor, uint32_t iteration)
+{
+    uint8_t led_mode = (uint8_t)(iteration & 1);
+    uint8_t filter_mode = 1;
+    return sensorWriteSettings(sensor, (const char*[]) { "led_mode", "filter_mode" }, 2,
+        (const void*[]) { &led_mode, &filter_mode });
+}
+
+static const struct SettingsCase K_CASES[] = {
+    { "read:led_mode", runReadLedMode },
+    { "read:timestamp", runReadTimestamp },
+    { "read:led_mode;filter_mode;stream_hz", runReadMultiple },
+    { "write:led_mode", runWriteLedMode },
+    { "write:led_mode;filter_mode", runWriteMultiple },
+};
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    struct BenchSamples samples;
+    uint64_t start_ns;
+    uint32_t errors;
+
+    benchParseOptions(argc, argv, "settings", &options);
+
+    ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL) return 1;
+    if(benchOpen(ctx, &options, NULL)) return 1;
+
+    benchSamplesInit(&samples, options.iterations);
+    for(size_t i = 0; i < sizeof(K_CASES) / sizeof(K_CASES[0]); i++) {
+        samples.count = 0;
+        errors = 0;
+        for(uint32_t j = 0; j < options.iterations; j++) {
+            start_ns = benchTimeNs();
+            if(K_CASES[i].run(&ctx->sensor, j)) {
+                errors++;
+                continue;
+            }
+            benchSamplesAdd(&samples, benchTimeNs() - start_ns);
+        }
+
+        benchResultBegin(ctx, K_CASES[i].name);
+        benchResultU64("errors", errors);
+        benchResultPercentiles("latency_ns", &samples);
+        benchResultEnd();
+    }
+
+    benchSamplesFree(&samples);
+    benchClose(ctx);
+    free(ctx);
+    return 0;
+}
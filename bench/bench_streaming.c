@@ -0,0 +1,130 @@
+/*
+*   Streaming packets decoded per second for a range of stream slot layouts.
+*
+*   The simulated sensor streams unthrottled, so the rate is bound by how fast the API can
+*   parse packets. -v <hz> streams at that rate instead, to measure delivery at a fixed load.
+*   Fails if a layout can not be set or started, or streams nothing.
+*/
+#include "bench_common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_OUTPUTS (TSS_NUM_STREAM_SLOTS * 4)
+
+static const char * const K_LAYOUTS[] = {
+    "0",                        //Quaternion
+    "0,39",                     //Quaternion and accelerometer
+    "0,38,39,40",               //Quaternion and all corrected components
+    "2,37,41,42,43,45",         //Large mixed packet
+    "0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0", //Every slot in use
+};
+
+static void *m_outputs[MAX_OUTPUTS];
+static uint8_t m_scratch[TSS_MAX_CMD_LEN];
+static uint64_t m_num_packets;
+static bool m_counting;
+
+static enum TSS_DataCallbackState onPacket(TSS_Sensor *sensor)
+{
+    if(sensorProcessDataStreamingCallbackOutputArray(sensor, m_outputs) < 0) {
+        return TSS_DataCallbackStateError;
+    }
+    if(m_counting) m_num_packets++;
+    return TSS_DataCallbackStateProcessed;
+}
+
+//Points an output at the scratch buffer for every parameter of every slot. Returns the packet data size.
+static size_t buildOutputs(const char *layout)
+{
+    const struct TSS_Command *command;
+    const struct TSS_Param *param;
+    size_t offset = 0, num_outputs = 0;
+    char *end;
+    long cmd_num;
+
+    while(*layout != '\0') {
+        cmd_num = strtol(layout, &end, 10);
+        command = tssGetCommand((uint8_t)cmd_num);
+        for(param = command->out_format; !TSS_PARAM_IS_NULL(param); param++) {
+            m_outputs[num_outputs++] = m_scratch + offset;
+            offset += (size_t)param->count * param->size;
+        }
+        layout = (*end == ',') ? end + 1 : end;
+    }
+    return offset;
+}
+
+int main(int argc, char **argv)
+{
+    struct BenchOptions options;
+    struct BenchContext *ctx;
+    struct SimSensorConfig config = {0};
+    uint64_t start_ns, elapsed_ns, streamed_before;
+    size_t packet_size;
+    double seconds;
+    uint32_t errors = 0;
+    int err;
+
+    benchParseOptions(argc, argv, "streaming", &options);
+    config.unthrottled = (options.value == 0);
+
+    ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL) return 1;
+    if(benchOpen(ctx, &options, &config)) return 1;
+    if(options.value > 0) {
+        err = sensorWriteStreamHz(&ctx->sensor, (float)options.value);
+        if(err) {
+            fprintf(stderr, "Failed to set stream hz %u: %d\n", options.value, err);
+            errors++;
+        }
+    }
+
+    for(size_t i = 0; i < sizeof(K_LAYOUTS) / sizeof(K_LAYOUTS[0]); i++) {
+        packet_size = buildOutputs(K_LAYOUTS[i]);
+        err = sensorWriteStreamSlots(&ctx->sensor, K_LAYOUTS[i]);
+        if(err) {
+            fprintf(stderr, "Failed to set stream slots %s: %d\n", K_LAYOUTS[i], err);
+            errors++;
+            continue;
+        }
+
+        m_num_packets = 0;
+        m_counting = true;
+        streamed_before = (ctx->sim != NULL) ? ctx->sim->stats.packets_streamed : 0;
+        err = sensorStreamingStart(&ctx->sensor, onPacket);
+        if(err) {
+            fprintf(stderr, "Failed to start streaming %s: %d\n", K_LAYOUTS[i], err);
+            m_counting = false;
+            errors++;
+            continue;
+        }
+        start_ns = benchTimeNs();
+        do {
+            //Unthrottled, there is always another packet, so this is only called once per check
+            sensorUpdateStreaming(&ctx->sensor);
+            elapsed_ns = benchTimeNs() - start_ns;
+        } while(elapsed_ns < (uint64_t)options.duration_ms * 1000000ull);
+        m_counting = false;
+        sensorStreamingStop(&ctx->sensor);
+        if(m_num_packets == 0) {
+            fprintf(stderr, "No packets received for stream slots %s\n", K_LAYOUTS[i]);
+            errors++;
+        }
+
+        seconds = (double)elapsed_ns / 1e9;
+        benchResultBegin(ctx, K_LAYOUTS[i]);
+        benchResultU64("packet_data_bytes", packet_size);
+        benchResultU64("packets", m_num_packets);
+        benchResultDouble("packets_per_s", (double)m_num_packets / seconds);
+        benchResultDouble("data_bytes_per_s", (double)(m_num_packets * packet_size) / seconds);
+        if(ctx->sim != NULL) {
+            benchResultU64("packets_streamed", ctx->sim->stats.packets_streamed - streamed_before);
+        }
+        benchResultEnd();
+    }
+
+    benchClose(ctx);
+    free(ctx);
+    return errors ? 1 : 0;
+}
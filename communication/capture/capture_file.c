@@ -0,0 +1,182 @@
+#include "tss/com/backend/capture/capture_file.h"
+
+#include <string.h>
+
+//Longest unsigned LEB128 encoding of a uint64_t
+#define VARINT_MAX_LEN 10
+
+static size_t encode_varint(uint64_t value, uint8_t *out)
+{
+    size_t len = 0;
+    while(value >= 0x80) {
+        out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[len++] = (uint8_t)value;
+    return len;
+}
+
+static int decode_varint(FILE *file, uint64_t *out)
+{
+    uint64_t value = 0;
+    int c;
+
+    for(uint8_t shift = 0; shift < VARINT_MAX_LEN * 7; shift += 7) {
+        c = fgetc(file);
+        if(c == EOF) return -1;
+        value |= (uint64_t)(c & 0x7F) << shift;
+        if((c & 0x80) == 0) {
+            *out = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+//--------------------------------------WRITER---------------------------------------
+
+int captureWriterOpen(struct CaptureWriter *writer, const char *path)
+{
+    uint8_t header[CAPTURE_FILE_MAGIC_LEN + 2];
+
+    *writer = (struct CaptureWriter) { 0 };
+    writer->file = fopen(path, "wb");
+    if(writer->file == NULL) return -1;
+
+    memcpy(header, CAPTURE_FILE_MAGIC, CAPTURE_FILE_MAGIC_LEN);
+    header[CAPTURE_FILE_MAGIC_LEN] = CAPTURE_FILE_VERSION & 0xFF;
+    header[CAPTURE_FILE_MAGIC_LEN + 1] = CAPTURE_FILE_VERSION >> 8;
+    if(fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+        fclose(writer->file);
+        writer->file = NULL;
+        return -1;
+    }
+
+    writer->start_time = tssTimeGet();
+    return 0;
+}
+
+static int write_record_header(struct CaptureWriter *writer, enum CaptureRecordType type, size_t len)
+{
+    uint8_t header[1 + VARINT_MAX_LEN * 2];
+    uint64_t now_us;
+    size_t header_len;
+
+    now_us = tssTimeDiffUs(writer->start_time);
+    if(now_us < writer->last_us) now_us = writer->last_us;
+
+    header[0] = (uint8_t)type;
+    header_len = 1;
+    header_len += encode_varint(now_us - writer->last_us, header + header_len);
+    header_len += encode_varint(len, header + header_len);
+    writer->last_us = now_us;
+    writer->records++;
+    writer->bytes += len;
+
+    return (fwrite(header, 1, header_len, writer->file) == header_len) ? 0 : -1;
+}
+
+int captureWriterRecord(struct CaptureWriter *writer, enum CaptureRecordType type, const uint8_t *data, size_t len)
+{
+    size_t chunk;
+
+    if(writer->file == NULL) return -1;
+    do {
+        chunk = (len > CAPTURE_MAX_RECORD_LEN) ? CAPTURE_MAX_RECORD_LEN : len;
+        if(write_record_header(writer, type, chunk)) return -1;
+        if(chunk > 0 && fwrite(data, 1, chunk, writer->file) != chunk) return -1;
+        data += chunk;
+        len -= chunk;
+    } while(len > 0);
+
+    return 0;
+}
+
+int captureWriterRecordVectored(struct CaptureWriter *writer, enum CaptureRecordType type, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    size_t total = 0;
+    uint8_t i;
+
+    if(writer->file == NULL) return -1;
+    for(i = 0; i < iov_count; i++) {
+        total += iov[i].len;
+    }
+
+    //Too long to be one record, so give each buffer its own instead
+    if(total > CAPTURE_MAX_RECORD_LEN) {
+        for(i = 0; i < iov_count; i++) {
+            if(captureWriterRecord(writer, type, iov[i].base, iov[i].len)) return -1;
+        }
+        return 0;
+    }
+
+    if(write_record_header(writer, type, total)) return -1;
+    for(i = 0; i < iov_count; i++) {
+        if(iov[i].len > 0 && fwrite(iov[i].base, 1, iov[i].len, writer->file) != iov[i].len) return -1;
+    }
+    return 0;
+}
+
+int captureWriterClose(struct CaptureWriter *writer)
+{
+    int result;
+
+    if(writer->file == NULL) return 0;
+    result = fclose(writer->file);
+    writer->file = NULL;
+    return (result == 0) ? 0 : -1;
+}
+
+//--------------------------------------READER---------------------------------------
+
+int captureReaderOpen(struct CaptureReader *reader, const char *path)
+{
+    uint8_t header[CAPTURE_FILE_MAGIC_LEN + 2];
+
+    *reader = (struct CaptureReader) { 0 };
+    reader->file = fopen(path, "rb");
+    if(reader->file == NULL) return -1;
+
+    if(fread(header, 1, sizeof(header), reader->file) != sizeof(header) ||
+        memcmp(header, CAPTURE_FILE_MAGIC, CAPTURE_FILE_MAGIC_LEN) != 0) {
+        captureReaderClose(reader);
+        return -1;
+    }
+
+    reader->version = (uint16_t)(header[CAPTURE_FILE_MAGIC_LEN] | (header[CAPTURE_FILE_MAGIC_LEN + 1] << 8));
+    if(reader->version != CAPTURE_FILE_VERSION) {
+        captureReaderClose(reader);
+        return -1;
+    }
+
+    return 0;
+}
+
+int captureReaderNext(struct CaptureReader *reader, struct CaptureRecord *out)
+{
+    uint64_t delta_us, len;
+    int type;
+
+    if(reader->file == NULL) return -1;
+
+    type = fgetc(reader->file);
+    if(type == EOF) return 0;
+    if(type < CAPTURE_RECORD_READ || type > CAPTURE_RECORD_CLEAR) return -1;
+    if(decode_varint(reader->file, &delta_us) || decode_varint(reader->file, &len)) return -1;
+    if(len > CAPTURE_MAX_RECORD_LEN) return -1;
+    if(len > 0 && fread(out->data, 1, (size_t)len, reader->file) != len) return -1;
+
+    reader->time_us += delta_us;
+    out->type = (enum CaptureRecordType)type;
+    out->time_us = reader->time_us;
+    out->len = (uint16_t)len;
+    return 1;
+}
+
+void captureReaderClose(struct CaptureReader *reader)
+{
+    if(reader->file != NULL) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
@@ -0,0 +1,249 @@
+#include "tss/com/replay.h"
+#include "tss/errors.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define REPLAY_COM_DEFAULT_TIMEOUT_MS 1000
+
+//Longest a blocked read sleeps before checking the time again
+#define REPLAY_COM_MAX_SLEEP_US 1000
+
+static int replay_open(struct TSS_Com_Class *com);
+static int replay_close(struct TSS_Com_Class *com);
+
+static int replay_read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out);
+
+static void replay_set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
+static uint32_t replay_get_timeout(struct TSS_Com_Class *com);
+
+static void replay_clear_immediate(struct TSS_Com_Class *com);
+static void replay_clear_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
+
+static int replay_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len);
+static int replay_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
+
+static const struct TSS_Com_Class_API m_replay_com_api = {
+    .open  = replay_open,
+    .close = replay_close,
+
+    //There is no port that can change
+    .reenumerate = NULL,
+    .auto_detect = NULL,
+
+    .in = {
+        .read       = replay_read,
+        .read_until = tssManagedComBaseReadUntil,
+
+        .set_timeout     = replay_set_timeout,
+        .get_timeout     = replay_get_timeout,
+
+        .clear_immediate = replay_clear_immediate,
+        .clear_timeout   = replay_clear_timeout,
+    },
+    .out = {
+        .write = replay_write,
+        .write_vectored = replay_write_vectored,
+    },
+};
+
+void create_replay_com_class(const char *path, bool max_speed, struct ReplayComClass *out)
+{
+    *out = (struct ReplayComClass) {
+        .replay_com = (struct TSS_Com_Class) {
+            .api          = &m_replay_com_api,
+            .reenumerates = false,
+        },
+        .path = path,
+        .max_speed = max_speed,
+        .timeout_ms = REPLAY_COM_DEFAULT_TIMEOUT_MS,
+    };
+
+    tssCreateManagedCom(
+        &out->replay_com,
+        (struct TSS_Com_Class *)out,
+        out->read_buffer,  sizeof(out->read_buffer),
+        out->write_buffer, sizeof(out->write_buffer),
+        &out->base
+    );
+}
+
+bool replay_com_finished(const struct ReplayComClass *replay)
+{
+    return replay->finished;
+}
+
+static void sleep_us(uint64_t us)
+{
+#ifdef _WIN32
+    Sleep((DWORD)((us + 999) / 1000));
+#else
+    struct timespec ts = {
+        .tv_sec = (time_t)(us / 1000000),
+        .tv_nsec = (long)(us % 1000000) * 1000
+    };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+static int replay_open(struct TSS_Com_Class *com)
+{
+    struct ReplayComClass *self = (struct ReplayComClass *)com;
+
+    if(self->open) return 0;
+    if(captureReaderOpen(&self->reader, self->path)) return -1;
+
+    self->have_record = false;
+    self->finished = false;
+    self->corrupt = false;
+    self->bytes_replayed = 0;
+    self->bytes_written = 0;
+    self->bytes_captured_written = 0;
+    self->start_time = tssTimeGet();
+    self->open = true;
+    return 0;
+}
+
+static int replay_close(struct TSS_Com_Class *com)
+{
+    struct ReplayComClass *self = (struct ReplayComClass *)com;
+    captureReaderClose(&self->reader);
+    self->open = false;
+    return 0;
+}
+
+//Makes sure there is an unconsumed record. Returns false once the capture has run out.
+static bool load_record(struct ReplayComClass *self)
+{
+    int result;
+
+    if(self->have_record) return true;
+    if(self->finished) return false;
+
+    result = captureReaderNext(&self->reader, &self->record);
+    if(result <= 0) {
+        //A capture cut off part way through a record, such as by a crash, is replayed up to that record
+        self->finished = true;
+        self->corrupt = (result < 0);
+        return false;
+    }
+
+    self->have_record = true;
+    self->record_pos = 0;
+    return true;
+}
+
+static int replay_read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out)
+{
+    struct ReplayComClass *self = (struct ReplayComClass *)com;
+    uint64_t now_us, wait_us, remaining_us;
+    tss_time_t start_time;
+    uint32_t elapsed_ms;
+    size_t total, len;
+
+    if(!self->open) return TSS_ERR_READ;
+
+    start_time = tssTimeGet();
+    total = 0;
+    while(total < num_bytes && load_record(self)) {
+        if(self->record.type == CAPTURE_RECORD_WRITE) {
+            self->bytes_captured_written += self->record.len;
+            self->have_record = false;
+            continue;
+        }
+
+        //Nothing after this was available until the input was cleared while capturing
+        if(self->record.type == CAPTURE_RECORD_CLEAR) break;
+
+        if(!self->max_speed) {
+            now_us = tssTimeDiffUs(self->start_time);
+            if(now_us < self->record.time_us) {
+                //Not received yet, wait for it the same as waiting on a device
+                elapsed_ms = tssTimeDiff(start_time);
+                if(total > 0 || elapsed_ms >= self->timeout_ms) break;
+                wait_us = self->record.time_us - now_us;
+                remaining_us = (uint64_t)(self->timeout_ms - elapsed_ms) * 1000;
+                if(wait_us > remaining_us) wait_us = remaining_us;
+                if(wait_us > REPLAY_COM_MAX_SLEEP_US) wait_us = REPLAY_COM_MAX_SLEEP_US;
+                sleep_us(wait_us);
+                continue;
+            }
+        }
+
+        len = self->record.len - self->record_pos;
+        if(len > num_bytes - total) len = num_bytes - total;
+        memcpy(out + total, self->record.data + self->record_pos, len);
+        self->record_pos += (uint16_t)len;
+        total += len;
+        if(self->record_pos == self->record.len) {
+            self->have_record = false;
+        }
+    }
+
+    self->bytes_replayed += total;
+    return (int)total;
+}
+
+static void replay_set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms)
+{
+    struct ReplayComClass *self = (struct ReplayComClass *)com;
+    self->timeout_ms = timeout_ms;
+}
+
+static uint32_t replay_get_timeout(struct TSS_Com_Class *com)
+{
+    struct ReplayComClass *self = (struct ReplayComClass *)com;
+    return self->timeout_ms;
+}
+
+//Discards everything up to and including the next point the input was cleared while capturing,
+//so the replay continues from the same place the capture did after its clear
+static void replay_clear(struct ReplayComClass *self)
+{
+    enum CaptureRecordType type;
+
+    if(!self->open) return;
+    while(load_record(self)) {
+        type = self->record.type;
+        if(type == CAPTURE_RECORD_WRITE) {
+            self->bytes_captured_written += self->record.len;
+        }
+        self->have_record = false;
+        if(type == CAPTURE_RECORD_CLEAR) break;
+    }
+}
+
+static void replay_clear_immediate(struct TSS_Com_Class *com)
+{
+    replay_clear((struct ReplayComClass *)com);
+}
+
+static void replay_clear_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    replay_clear((struct ReplayComClass *)com);
+}
+
+static int replay_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len)
+{
+    struct ReplayComClass *self = (struct ReplayComClass *)com;
+    (void)bytes;
+    if(!self->open) return TSS_ERR_WRITE;
+    self->bytes_written += len;
+    return 0;
+}
+
+static int replay_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    struct ReplayComClass *self = (struct ReplayComClass *)com;
+    if(!self->open) return TSS_ERR_WRITE;
+    for(uint8_t i = 0; i < iov_count; i++) {
+        self->bytes_written += iov[i].len;
+    }
+    return 0;
+}
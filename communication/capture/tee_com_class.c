@@ -0,0 +1,163 @@
+#include "tss/com/tee.h"
+
+static int tee_open(struct TSS_Com_Class *com);
+static int tee_close(struct TSS_Com_Class *com);
+
+static int tee_read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out);
+
+static void tee_set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
+static uint32_t tee_get_timeout(struct TSS_Com_Class *com);
+
+static void tee_clear_immediate(struct TSS_Com_Class *com);
+static void tee_clear_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
+
+static int tee_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len);
+static int tee_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
+
+static const struct TSS_Com_Class_API m_tee_com_api = {
+    .open  = tee_open,
+    .close = tee_close,
+
+    //Reenumerating would replace the inner com class, so traffic would no longer be captured
+    .reenumerate = NULL,
+    .auto_detect = NULL,
+
+    .in = {
+        .read       = tee_read,
+        .read_until = tssManagedComBaseReadUntil,
+
+        .set_timeout     = tee_set_timeout,
+        .get_timeout     = tee_get_timeout,
+
+        .clear_immediate = tee_clear_immediate,
+        .clear_timeout   = tee_clear_timeout,
+    },
+    .out = {
+        .write = tee_write,
+        .write_vectored = tee_write_vectored,
+    },
+};
+
+void create_tee_com_class(struct TSS_Com_Class *inner, const char *path, struct TeeComClass *out)
+{
+    *out = (struct TeeComClass) {
+        .tee_com = (struct TSS_Com_Class) {
+            .api          = &m_tee_com_api,
+            .reenumerates = false,
+        },
+        .inner = inner,
+        .path = path,
+    };
+
+    tssCreateManagedCom(
+        &out->tee_com,
+        (struct TSS_Com_Class *)out,
+        out->read_buffer,  sizeof(out->read_buffer),
+        out->write_buffer, sizeof(out->write_buffer),
+        &out->base
+    );
+}
+
+static void record(struct TeeComClass *self, enum CaptureRecordType type, const uint8_t *data, size_t len)
+{
+    if(self->capture_failed || self->writer.file == NULL) return;
+    if(captureWriterRecord(&self->writer, type, data, len)) {
+        self->capture_failed = true;
+    }
+}
+
+static int tee_open(struct TSS_Com_Class *com)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    int result;
+
+    result = tss_com_open(self->inner);
+    if(result) return result;
+
+    //Already capturing if opened again without closing
+    if(self->writer.file != NULL) return 0;
+    self->capture_failed = false;
+    if(captureWriterOpen(&self->writer, self->path)) {
+        tss_com_close(self->inner);
+        return -1;
+    }
+    return 0;
+}
+
+static int tee_close(struct TSS_Com_Class *com)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    if(captureWriterClose(&self->writer)) {
+        self->capture_failed = true;
+    }
+    return tss_com_close(self->inner);
+}
+
+static int tee_read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    int result;
+
+    result = tss_com_read(self->inner, num_bytes, out);
+    if(result > 0) {
+        record(self, CAPTURE_RECORD_READ, out, (size_t)result);
+    }
+    return result;
+}
+
+static void tee_set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    tss_com_set_timeout(self->inner, timeout_ms);
+}
+
+static uint32_t tee_get_timeout(struct TSS_Com_Class *com)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    return tss_com_get_timeout(self->inner);
+}
+
+//Clearing by reading, rather than clearing the inner com class directly, so the
+//discarded bytes are captured too. The clear record tells replay where to stop discarding.
+static void tee_clear_immediate(struct TSS_Com_Class *com)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    tssManagedComBaseClear(com);
+    record(self, CAPTURE_RECORD_CLEAR, NULL, 0);
+}
+
+static void tee_clear_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    tssManagedComBaseClearTimeout(com, timeout_ms);
+    record(self, CAPTURE_RECORD_CLEAR, NULL, 0);
+}
+
+static int tee_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    struct TSS_Com_Iovec iov = { (void*)bytes, len };
+    int result;
+
+    //The tee is only ever written to by its managed base, so this is a complete write
+    //and has to be sent now rather than buffered by the inner com class
+    result = tss_com_write_vectored(self->inner, &iov, 1);
+    if(len > 0) {
+        record(self, CAPTURE_RECORD_WRITE, bytes, len);
+    }
+    return result;
+}
+
+static int tee_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    struct TeeComClass *self = (struct TeeComClass *)com;
+    int result;
+
+    result = tss_com_write_vectored(self->inner, iov, iov_count);
+    if(!self->capture_failed && self->writer.file != NULL) {
+        if(captureWriterRecordVectored(&self->writer, CAPTURE_RECORD_WRITE, iov, iov_count)) {
+            self->capture_failed = true;
+        }
+    }
+    return result;
+}
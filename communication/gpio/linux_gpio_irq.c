@@ -0,0 +1,170 @@
+#if defined(__linux__) || defined(unix)
+
+#include "tss/com/backend/gpio/gpio_irq.h"
+#include "tss/sys/time.h"
+#include "tss/errors.h"
+#include "tss/sys/trace.h"
+
+#include <errno.h>
+#include <poll.h>
+
+//Requests edge events so waits can sleep instead of spinning on the value.
+//Falls back to a plain input if the GPIO chip can not generate interrupts for the line.
+int gpioIrqRequestLine(struct gpiod_line *line, const char *consumer, bool both_edges, bool *events)
+{
+    int result;
+
+    //Data available only has to be waited on going active, data loaded is waited on in both directions
+    if(both_edges) {
+        result = gpiod_line_request_both_edges_events(line, consumer);
+    }
+    else {
+        result = gpiod_line_request_falling_edge_events(line, consumer);
+    }
+    *events = (result == 0);
+    if(result == 0) return 0;
+
+    if(gpiod_line_request_input(line, consumer) < 0) {
+        tssTrace(TSS_TRACE_ERROR, line, 0, 0, errno, "gpioIrqRequestLine: gpiod_line_request_input failed");
+        return -1;
+    }
+    return 0;
+}
+
+int gpioIrqDrainEvents(struct gpiod_line *line)
+{
+    struct gpiod_line_event event;
+    struct timespec wait_time = { 0 };
+    int result;
+
+    while((result = gpiod_line_event_wait(line, &wait_time)) > 0) {
+        if(gpiod_line_event_read(line, &event) < 0) {
+            return -1;
+        }
+    }
+    return (result < 0) ? -1 : 0;
+}
+
+int gpioIrqWaitForLine(struct gpiod_line *line, bool events, int state, uint32_t timeout_ms)
+{
+    struct timespec wait_time;
+    tss_time_t start = tssTimeGet();
+    uint32_t elapsed_time = 0;
+    int result;
+
+    if(!events) {
+        while(gpiod_line_get_value(line) != state) {
+            if(elapsed_time > timeout_ms) {
+                return TSS_ERR_TIMEOUT;
+            }
+            elapsed_time = tssTimeDiff(start);
+        }
+        return 0;
+    }
+
+    while(true) {
+        //Any edge after the drain stays queued, so a change between the check and the wait is not missed.
+        if(gpioIrqDrainEvents(line) < 0) {
+            return -1;
+        }
+
+        if(gpiod_line_get_value(line) == state) {
+            return 0;
+        }
+        if(elapsed_time > timeout_ms) {
+            return TSS_ERR_TIMEOUT;
+        }
+
+        uint32_t remaining = timeout_ms - elapsed_time;
+        wait_time.tv_sec = (time_t)(remaining / 1000);
+        wait_time.tv_nsec = (long)(remaining % 1000) * 1000000L;
+        result = gpiod_line_event_wait(line, &wait_time);
+        if(result < 0) {
+            return -1;
+        }
+        if(result == 0) {
+            return (gpiod_line_get_value(line) == state) ? 0 : TSS_ERR_TIMEOUT;
+        }
+        elapsed_time = tssTimeDiff(start);
+    }
+}
+
+int gpioIrqSchedule(struct gpiod_line *const *lines, const bool *events, uint8_t count, uint8_t *next_start, uint8_t *order, uint32_t timeout_ms)
+{
+    struct pollfd fds[GPIO_IRQ_MAX_LINES];
+    uint8_t num_ready, num_fds, i, index;
+    bool can_sleep;
+
+    if(count == 0) return 0;
+    if(count > GPIO_IRQ_MAX_LINES) return -1;
+
+    tss_time_t start = tssTimeGet();
+    uint32_t elapsed_time = 0;
+    while(true) {
+        //Devices signaling data available are served first, starting after the
+        //device that was first last cycle so every ready device gets a turn.
+        num_ready = 0;
+        for(i = 0; i < count; i++) {
+            index = (uint8_t)((*next_start + i) % count);
+            if(lines[index] != NULL && gpiod_line_get_value(lines[index]) == GPIO_IRQ_ACTIVE_STATE) {
+                order[num_ready++] = index;
+            }
+        }
+
+        //Devices without a data available line can't say if they have data, so they are always polled, but last
+        for(i = 0; i < count; i++) {
+            index = (uint8_t)((*next_start + i) % count);
+            if(lines[index] == NULL) {
+                order[num_ready++] = index;
+            }
+        }
+
+        if(num_ready > 0) {
+            break;
+        }
+        if(elapsed_time > timeout_ms) {
+            return 0;
+        }
+
+        //Nothing ready. Sleep on the data available edges of every device, unless one of
+        //the lines can't generate events, in which case keep checking the values.
+        num_fds = 0;
+        can_sleep = true;
+        for(i = 0; i < count; i++) {
+            if(!events[i]) {
+                can_sleep = false;
+                break;
+            }
+            if(gpioIrqDrainEvents(lines[i]) < 0) {
+                return -1;
+            }
+            fds[num_fds++] = (struct pollfd) { .fd = gpiod_line_event_get_fd(lines[i]), .events = POLLIN };
+        }
+        //Check again in case a line went active before its events were drained
+        for(i = 0; i < count && can_sleep; i++) {
+            if(gpiod_line_get_value(lines[i]) == GPIO_IRQ_ACTIVE_STATE) {
+                can_sleep = false;
+            }
+        }
+        if(can_sleep) {
+            int result = poll(fds, num_fds, (int)(timeout_ms - elapsed_time));
+            if(result == 0) {
+                return 0;
+            }
+            if(result < 0 && errno != EINTR) {
+                return -1;
+            }
+        }
+        elapsed_time = tssTimeDiff(start);
+    }
+
+    *next_start = (uint8_t)((*next_start + 1) % count);
+    return num_ready;
+}
+
+#else
+
+/* Dummy variable to prevent empty translation unit warning under ISO C */
+typedef int tss_dummy_linux_gpio_irq_tu;
+
+#endif /* __linux__ || unix */
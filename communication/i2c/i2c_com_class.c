@@ -96,3 +96,51 @@ static int i2c_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len
     struct I2cComClass *self = (struct I2cComClass *)com;
     return i2cWrite(&self->device, bytes, len);
 }
+
+#if TSS_MINIMAL_SENSOR == 0
+int i2c_com_bus_update(struct I2cBus *bus, struct I2cComClass *const *coms, uint8_t count, uint32_t timeout_ms)
+{
+    struct I2cDevice *devices[I2C_BUS_MAX_DEVICES];
+    struct I2cBusRead reads[I2C_BUS_MAX_DEVICES];
+    struct TSS_Ring_Buf2 *rings[I2C_BUS_MAX_DEVICES];
+    uint8_t order[I2C_BUS_MAX_DEVICES];
+    uint8_t i, num_reads;
+    int num_ready, result;
+
+    if(count > I2C_BUS_MAX_DEVICES) return TSS_ERR_INVALID_SIZE;
+
+    for(i = 0; i < count; i++) {
+        devices[i] = &coms[i]->device;
+    }
+
+    num_ready = i2cBusSchedule(bus, devices, count, order, timeout_ms);
+    if(num_ready <= 0) return num_ready;
+
+    //Read straight into the free space of each read buffer, up to where it wraps
+    num_reads = 0;
+    for(i = 0; i < num_ready; i++) {
+        struct TSS_Ring_Buf2 *ring = &coms[order[i]]->base.read_ring;
+        size_t space;
+        uint8_t *out = ring_write_span(ring, &space);
+        if(space == 0) continue;
+
+        rings[num_reads] = ring;
+        reads[num_reads++] = (struct I2cBusRead) {
+            .dev = devices[order[i]],
+            .out = out,
+            .length = (space > 255) ? 255 : (uint8_t)space,
+        };
+    }
+
+    result = i2cBusRead(bus, reads, num_reads);
+    if(result < 0) return result;
+
+    for(i = 0; i < num_reads; i++) {
+        if(reads[i].result > 0) {
+            ring_commit(rings[i], (size_t)reads[i].result);
+        }
+    }
+
+    return num_ready;
+}
+#endif
@@ -1,11 +1,13 @@
 #if defined(__linux__) || defined(unix)
 
 #include "tss/com/backend/i2c/i2c_device.h"
+#include "tss/com/backend/gpio/gpio_irq.h"
 #include "tss/constants.h"
 #include "tss/sys/time.h"
 #include "tss/errors.h"
+#include "tss/sys/trace.h"
 
-#include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -13,13 +15,17 @@
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <sys/ioctl.h>
+#include <time.h>
 
-#define IRQ_ACTIVE_STATE 0
-#define IRQ_INACTIVE_STATE 1
+//Range of the wait between polls of a response status that is still loading
+#define I2C_POLL_MIN_DELAY_US 50
+#define I2C_POLL_MAX_DELAY_US 1000
 
-static int i2cReadNoIrq(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
-static int i2cReadWithDataAvailableIrq(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
-static int i2cReadWithFullIrq(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
+static int i2cReadNoIrq(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
+static int i2cReadNoIrqLocked(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
+static int i2cReadWithDataAvailableIrq(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
+static int i2cReadWithFullIrq(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
+static int i2cReadLoadedChunk(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
 
 // -----------------------------------------------------------------------
 // Open / Close
@@ -36,7 +42,7 @@ int i2cOpen(I2cPortId id, uint32_t speed_hz, struct I2cDevice *out)
         id.data_loaded_line_num = -1;
     }
     else if(id.data_available_line_num == 0 || id.data_loaded_line_num == 0) {
-        fprintf(stderr, "Warning: One IRQ line number is set to 0, while the other is not. Was this intentional?\n");
+        tssTrace(TSS_TRACE_WARNING, out, 0, 0, 0, "One IRQ line number is set to 0, while the other is not");
     }
 
     *out = (struct I2cDevice) {
@@ -53,17 +59,24 @@ int i2cOpen(I2cPortId id, uint32_t speed_hz, struct I2cDevice *out)
 
     //----------------Configure I2C device----------------
 
+    //The bus already opened and configured the file descriptor. Transfers address
+    //the device in each message, so the fd's I2C_SLAVE address is not needed.
+    if(id.bus != NULL) {
+        out->fd = id.bus->fd;
+        return 0;
+    }
+
     // 1. Open the I2C bus file descriptor
     int fd = open(id.device_name, O_RDWR);
     if (fd < 0) {
-        fprintf(stderr, "Failed to open I2C device %s: %s\n", id.device_name, strerror(errno));
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, errno, "i2cOpen: Failed to open I2C device");
         i2cClose(out);
         return -1;
     }
 
     // 2. Set the target I2C device address
     if (ioctl(fd, I2C_SLAVE, id.bus_address) < 0) {
-        perror("Failed to acquire bus access and/or talk to slave");
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, errno, "i2cOpen: Failed to acquire bus access and/or talk to slave");
         close(fd);
         return -1;
     }
@@ -77,7 +90,7 @@ int i2cOpen(I2cPortId id, uint32_t speed_hz, struct I2cDevice *out)
     // ACK/NACK to fail instantly if something goes wrong. If the device isn't responding
     // it should fail ASAP and try again.
     if(ioctl(fd, I2C_TIMEOUT, 100 / 10) < 0) {
-        perror("i2cOpen: ioctl I2C_TIMEOUT failed");
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, errno, "i2cOpen: ioctl I2C_TIMEOUT failed");
         close(fd);
         return -1;
     }
@@ -116,7 +129,7 @@ int i2cConfigurePinMode(struct I2cDevice *dev, int data_available_line_num, int
     if(dev->chip == NULL) {
         dev->chip = gpiod_chip_open(dev->id.chip_path);
         if(!dev->chip) {
-            perror("gpiod_chip_open");
+            tssTrace(TSS_TRACE_ERROR, dev, 0, 0, errno, "i2cConfigurePinMode: gpiod_chip_open failed");
             return -1;
         }   
     }
@@ -125,8 +138,7 @@ int i2cConfigurePinMode(struct I2cDevice *dev, int data_available_line_num, int
     if(data_available_line_num >= 0) {
         dev->data_available_line = gpiod_chip_get_line(dev->chip, (unsigned int)data_available_line_num);
         if(dev->data_available_line != NULL) {
-            if(gpiod_line_request_input(dev->data_available_line, "i2c_data_available") < 0) {
-                perror("gpiod_line_request_input");
+            if(gpioIrqRequestLine(dev->data_available_line, "i2c_data_available", false, &dev->data_available_events) < 0) {
                 return -1;
             }
         }
@@ -134,8 +146,7 @@ int i2cConfigurePinMode(struct I2cDevice *dev, int data_available_line_num, int
     if(data_loaded_line_num >= 0) {
         dev->data_loaded_line = gpiod_chip_get_line(dev->chip, (unsigned int)data_loaded_line_num);
         if(dev->data_loaded_line != NULL) {
-            if(gpiod_line_request_input(dev->data_loaded_line, "i2c_data_loaded") < 0) {
-                perror("gpiod_line_request_input");
+            if(gpioIrqRequestLine(dev->data_loaded_line, "i2c_data_loaded", true, &dev->data_loaded_events) < 0) {
                 return -1;
             }
         }
@@ -169,10 +180,233 @@ void i2cClose(struct I2cDevice *dev)
         dev->chip = NULL;
     }
     
-    close(dev->fd);
+    //The file descriptor of a shared bus stays open for the other devices on it
+    if(dev->id.bus == NULL) {
+        close(dev->fd);
+    }
     dev->fd = -1;
 }
 
+// -----------------------------------------------------------------------
+// IRQ lines
+// -----------------------------------------------------------------------
+
+int i2cGetDataAvailableFd(const struct I2cDevice *dev)
+{
+    if(dev->data_available_line == NULL || !dev->data_available_events) {
+        return -1;
+    }
+    return gpiod_line_event_get_fd(dev->data_available_line);
+}
+
+// -----------------------------------------------------------------------
+// Shared bus
+// -----------------------------------------------------------------------
+
+int i2cBusOpen(struct I2cBus *bus, const char *device_name)
+{
+    *bus = (struct I2cBus) {
+        .fd = -1,
+    };
+
+    if(pthread_mutex_init(&bus->lock, NULL) != 0) {
+        return -1;
+    }
+
+    bus->fd = open(device_name, O_RDWR);
+    if (bus->fd < 0) {
+        tssTrace(TSS_TRACE_ERROR, bus, 0, 0, errno, "i2cBusOpen: Failed to open I2C device");
+        i2cBusClose(bus);
+        return -1;
+    }
+
+    //Same fast per transaction timeout as a device opened on its own, see i2cOpen
+    if(ioctl(bus->fd, I2C_TIMEOUT, 100 / 10) < 0) {
+        tssTrace(TSS_TRACE_ERROR, bus, 0, 0, errno, "i2cBusOpen: ioctl I2C_TIMEOUT failed");
+        i2cBusClose(bus);
+        return -1;
+    }
+
+    return 0;
+}
+
+void i2cBusClose(struct I2cBus *bus)
+{
+    if(bus->fd >= 0) {
+        close(bus->fd);
+        bus->fd = -1;
+    }
+    pthread_mutex_destroy(&bus->lock);
+}
+
+//On a shared bus, waits for any other device's transaction to finish before starting one
+static void i2cLock(struct I2cDevice *dev)
+{
+    if(dev->id.bus != NULL) {
+        pthread_mutex_lock(&dev->id.bus->lock);
+    }
+}
+
+static void i2cUnlock(struct I2cDevice *dev)
+{
+    if(dev->id.bus != NULL) {
+        pthread_mutex_unlock(&dev->id.bus->lock);
+    }
+}
+
+//Sleeps between polls of a status that is not ready yet, doubling the wait each time up to a limit,
+//so a slow response doesn't keep the bus and CPU busy. Start *delay_us at 0.
+static void i2cPollBackoff(uint32_t *delay_us)
+{
+    struct timespec ts;
+
+    *delay_us = (*delay_us == 0) ? I2C_POLL_MIN_DELAY_US : *delay_us * 2;
+    if(*delay_us > I2C_POLL_MAX_DELAY_US) {
+        *delay_us = I2C_POLL_MAX_DELAY_US;
+    }
+    ts.tv_sec = 0;
+    ts.tv_nsec = (long)*delay_us * 1000L;
+    nanosleep(&ts, NULL);
+}
+
+int i2cBusSchedule(struct I2cBus *bus, struct I2cDevice *const *devices, uint8_t count, uint8_t *order, uint32_t timeout_ms)
+{
+    struct gpiod_line *lines[I2C_BUS_MAX_DEVICES];
+    bool events[I2C_BUS_MAX_DEVICES];
+    uint8_t i;
+
+    if(count > I2C_BUS_MAX_DEVICES) return -1;
+
+    for(i = 0; i < count; i++) {
+        lines[i] = devices[i]->data_available_line;
+        events[i] = devices[i]->data_available_events;
+    }
+    return gpioIrqSchedule(lines, events, count, &bus->next_start, order, timeout_ms);
+}
+
+//Reads each listed device on its own after a combined transfer failed. A NACK from one device aborts
+//the whole transfer without saying which messages went out, so every device that may have been part
+//way through is restarted with a new request instead of being left out of step.
+static void i2cBusReadEach(struct I2cBus *bus, struct I2cBusRead *reads, const uint8_t *indices, uint8_t num)
+{
+    uint8_t i, j;
+
+    for(j = 0; j < num; j++) {
+        i = indices[j];
+        reads[i].result = i2cReadNoIrqLocked(reads[i].dev, reads[i].out, reads[i].length, reads[i].dev->timeout);
+        if(reads[i].result < 0) {
+            tssTrace(TSS_TRACE_ERROR, bus, 0, reads[i].dev->id.bus_address, reads[i].result, "i2cBusRead: device read failed");
+        }
+    }
+}
+
+static int i2cBusReadLocked(struct I2cBus *bus, struct I2cBusRead *reads, uint8_t count)
+{
+    struct i2c_msg msgs[I2C_BUS_MAX_DEVICES];
+    uint8_t requests[I2C_BUS_MAX_DEVICES][2];
+    uint8_t headers[I2C_BUS_MAX_DEVICES][2];
+    uint8_t pending[I2C_BUS_MAX_DEVICES];
+    uint8_t loaded[I2C_BUS_MAX_DEVICES];
+    uint8_t num_msgs, num_pending, num_loaded, i, j;
+
+    if(count > I2C_BUS_MAX_DEVICES) return -1;
+
+    //Request the data from every device at once
+    num_msgs = 0;
+    for(i = 0; i < count; i++) {
+        reads[i].result = 0;
+        if(reads[i].length == 0) continue;
+        requests[i][0] = TSS_TRANSACTION_READ_DATA_WITH_SIZE_BYTE;
+        requests[i][1] = reads[i].length;
+        pending[num_msgs] = i;
+        msgs[num_msgs++] = (struct i2c_msg) { .addr = reads[i].dev->id.bus_address, .flags = 0, .len = 2, .buf = requests[i] };
+    }
+    num_pending = num_msgs;
+    if(num_pending == 0) return 0;
+
+    struct i2c_rdwr_ioctl_data rdwr_data = { .msgs = msgs, .nmsgs = num_msgs };
+    if(ioctl(bus->fd, I2C_RDWR, &rdwr_data) < 0) {
+        tssTrace(TSS_TRACE_RETRY, bus, 0, 0, errno, "i2cBusRead: I2C_RDWR request failed, reading each device");
+        i2cBusReadEach(bus, reads, pending, num_pending);
+        return 0;
+    }
+
+    //Poll the status of every device still loading its response in one transfer per round
+    num_loaded = 0;
+    tss_time_t start = tssTimeGet();
+    uint32_t elapsed_time = 0;
+    uint32_t delay_us = 0;
+    while(num_pending > 0) {
+        for(j = 0; j < num_pending; j++) {
+            i = pending[j];
+            memset(headers[i], 0xFF, sizeof(headers[i]));
+            msgs[j] = (struct i2c_msg) { .addr = reads[i].dev->id.bus_address, .flags = I2C_M_RD, .len = 2, .buf = headers[i] };
+        }
+        rdwr_data.nmsgs = num_pending;
+        if(ioctl(bus->fd, I2C_RDWR, &rdwr_data) < 0) {
+            tssTrace(TSS_TRACE_RETRY, bus, 0, 0, errno, "i2cBusRead: I2C_RDWR status failed, reading each device");
+            i2cBusReadEach(bus, reads, pending, num_pending);
+            break;
+        }
+
+        elapsed_time = tssTimeDiff(start);
+        num_msgs = 0;
+        for(j = 0; j < num_pending; j++) {
+            i = pending[j];
+            uint8_t status = headers[i][0];
+            uint8_t data_len = headers[i][1];
+
+            // Guard against buffer overflows caused by a corrupt length field.
+            if(status != 0xFF && data_len > reads[i].length) {
+                tssTrace(TSS_TRACE_RETRY, bus, 0, data_len, (int32_t)reads[i].length, "i2cBusRead: sensor data_len > buffer, retrying");
+                status = 0xFF;
+            }
+
+            if(status != 0xFF) {
+                reads[i].result = data_len;
+                if(data_len > 0) {
+                    loaded[num_loaded++] = i;
+                }
+            }
+            else if(elapsed_time > reads[i].dev->header_timeout) {
+                reads[i].result = TSS_ERR_TIMEOUT;
+            }
+            else {
+                pending[num_msgs++] = i; //Still loading, poll again
+            }
+        }
+        num_pending = num_msgs;
+        if(num_pending > 0) {
+            i2cPollBackoff(&delay_us);
+        }
+    }
+
+    //Read every payload in one transfer
+    if(num_loaded > 0) {
+        for(j = 0; j < num_loaded; j++) {
+            i = loaded[j];
+            msgs[j] = (struct i2c_msg) { .addr = reads[i].dev->id.bus_address, .flags = I2C_M_RD, .len = (uint16_t)reads[i].result, .buf = reads[i].out };
+        }
+        rdwr_data.nmsgs = num_loaded;
+        if(ioctl(bus->fd, I2C_RDWR, &rdwr_data) < 0) {
+            tssTrace(TSS_TRACE_RETRY, bus, 0, 0, errno, "i2cBusRead: I2C_RDWR payload failed, reading each device");
+            i2cBusReadEach(bus, reads, loaded, num_loaded);
+        }
+    }
+
+    return 0;
+}
+
+int i2cBusRead(struct I2cBus *bus, struct I2cBusRead *reads, uint8_t count)
+{
+    int result;
+
+    pthread_mutex_lock(&bus->lock);
+    result = i2cBusReadLocked(bus, reads, count);
+    pthread_mutex_unlock(&bus->lock);
+    return result;
+}
+
 // -----------------------------------------------------------------------
 // Write
 // -----------------------------------------------------------------------
@@ -185,6 +419,7 @@ int i2cWrite(struct I2cDevice *dev, const uint8_t *data, size_t len)
 
     size_t write_index = 0;
 
+    i2cLock(dev);
     while (len > 0) {
         uint8_t send_len = (len > 255) ? 255 : (uint8_t)len;
         write_buf[1] = send_len;
@@ -210,47 +445,74 @@ int i2cWrite(struct I2cDevice *dev, const uint8_t *data, size_t len)
         rdwr_data.nmsgs = 2; // Execute both back-to-back in 1 bus transaction
 
         if (ioctl(dev->fd, I2C_RDWR, &rdwr_data) < 0) {
-            perror("I2C_RDWR write failed");
+            tssTrace(TSS_TRACE_ERROR, dev, 0, 0, errno, "i2cWrite: I2C_RDWR write failed");
+            i2cUnlock(dev);
             return -1; // Return error code
         }
 
         len -= send_len;
         write_index += send_len;
     }
+    i2cUnlock(dev);
 
     return 0;
 }
 
 // -----------------------------------------------------------------------
-// Protocol read (no-IRQ polling style)
+// Raw transfers
 // -----------------------------------------------------------------------
 
-int i2cReadNoIrq(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
+//Single message transfers addressed to the device. Used instead of read/write on the fd so they
+//don't depend on the I2C_SLAVE address of the fd, which is shared by every device on a bus.
+//Return 0 on success, or negative with errno set on error.
+static int i2cRawTransfer(struct I2cDevice *dev, uint16_t flags, uint8_t *buf, uint16_t len)
 {
-    (void) timeout_ms;
-    
-    if (length == 0) return 0;
+    struct i2c_msg msg = {
+        .addr  = dev->id.bus_address,
+        .flags = flags,
+        .len   = len,
+        .buf   = buf,
+    };
+    struct i2c_rdwr_ioctl_data rdwr_data = { .msgs = &msg, .nmsgs = 1 };
 
-    // Send READ_DATA_WITH_SIZE command followed by the requested byte count.
-    uint8_t header[2] = { TSS_TRANSACTION_READ_DATA_WITH_SIZE_BYTE, length };
-    tss_time_t start = tssTimeGet();
-    uint32_t elapsed = 0;
-    ssize_t write_result = -1;
-    while(elapsed <= timeout_ms && write_result < 0) {
-        write_result = write(dev->fd, header, sizeof(header));
-        elapsed = tssTimeDiff(start);
-    }
-    if(write_result < 0) {
+    if(ioctl(dev->fd, I2C_RDWR, &rdwr_data) < 0) {
         return -1;
     }
+    return 0;
+}
+
+static int i2cRawWrite(struct I2cDevice *dev, uint8_t *data, uint16_t len)
+{
+    return i2cRawTransfer(dev, 0, data, len);
+}
+
+static int i2cRawRead(struct I2cDevice *dev, uint8_t *out, uint16_t len)
+{
+    return i2cRawTransfer(dev, I2C_M_RD, out, len);
+}
+
+// -----------------------------------------------------------------------
+// Protocol read (no-IRQ polling style)
+// -----------------------------------------------------------------------
 
+//The READ_DATA_WITH_SIZE length is a single byte, so larger reads are split into chunks of this size
+static uint8_t i2cReadChunkLen(size_t remaining)
+{
+    return (remaining > 255) ? 255 : (uint8_t)remaining;
+}
 
+//Polls the status of a READ_DATA_WITH_SIZE request until the sensor has the response ready.
+//Returns the payload length, or negative on error/timeout.
+static int i2cPollReadStatus(struct I2cDevice *dev, uint8_t requested)
+{
+    uint8_t header[2];
     uint8_t status = 0xFF, data_len = 0;
-    start = tssTimeGet();
+    tss_time_t start = tssTimeGet();
     uint32_t elapsed_time = 0;
+    uint32_t delay_us = 0;
     while (status == 0xFF && elapsed_time <= dev->header_timeout) {
         memset(header, 0xFF, sizeof(header));
-        ssize_t num_read = read(dev->fd, header, sizeof(header));
+        int num_read = i2cRawRead(dev, header, sizeof(header));
         if(num_read < 0) {
             if(errno == ETIMEDOUT) {
                 return TSS_ERR_TIMEOUT;
@@ -264,52 +526,115 @@ int i2cReadNoIrq(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t t
         data_len = header[1];
 
         // Guard against buffer overflows caused by a corrupt length field.
-        if (status != 0xFF && data_len > length) {
+        if (status != 0xFF && data_len > requested) {
             status = 0xFF;
-            fprintf(stderr,
-                    "i2cReadNoIrq: sensor data_len (%d) > buffer (%d), retrying...\n",
-                    data_len, length);
+            tssTrace(TSS_TRACE_RETRY, dev, 0, data_len, requested, "i2cReadNoIrq: sensor data_len > buffer, retrying");
+        }
+        if(status == 0xFF) {
+            i2cPollBackoff(&delay_us);
         }
         elapsed_time = tssTimeDiff(start);
     }
 
     if(status == 0xFF) {
-        fprintf(stderr, "i2cReadNoIrq: timeout waiting for valid header\n");
+        tssTrace(TSS_TRACE_ERROR, dev, 0, 0, TSS_ERR_TIMEOUT, "i2cReadNoIrq: timeout waiting for valid header");
         return TSS_ERR_TIMEOUT;
     }
+    return data_len;
+}
 
-    if (data_len > 0) {
-        if(data_len > length) {
-            fprintf(stderr, "i2cReadNoIrq: Unexpected data_len (%d) > buffer (%d)\n", data_len, length);
-            return -1;
+int i2cReadNoIrq(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms)
+{
+    int result;
+
+    if (length == 0) return 0;
+
+    i2cLock(dev);
+    result = i2cReadNoIrqLocked(dev, out, length, timeout_ms);
+    i2cUnlock(dev);
+    return result;
+}
+
+//i2cReadNoIrq for when the bus lock is already held
+static int i2cReadNoIrqLocked(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms)
+{
+    if (length == 0) return 0;
+
+    // Send READ_DATA_WITH_SIZE command followed by the requested byte count.
+    uint8_t request[2] = { TSS_TRANSACTION_READ_DATA_WITH_SIZE_BYTE, i2cReadChunkLen(length) };
+    tss_time_t start = tssTimeGet();
+    uint32_t elapsed = 0;
+    uint32_t delay_us = 0;
+    int write_result = i2cRawWrite(dev, request, sizeof(request));
+    while(write_result < 0 && (elapsed = tssTimeDiff(start)) <= timeout_ms) {
+        i2cPollBackoff(&delay_us);
+        write_result = i2cRawWrite(dev, request, sizeof(request));
+    }
+    if(write_result < 0) {
+        return -1;
+    }
+
+    size_t total = 0;
+    while(true) {
+        uint8_t requested = request[1];
+        int data_len = i2cPollReadStatus(dev, requested);
+        if(data_len < 0) {
+            //Previous chunks were already consumed from the sensor, so report them instead of the error
+            return (total > 0) ? (int)total : data_len;
         }
-        ssize_t num_read = read(dev->fd, out, data_len);
-        if(num_read < 0) {
-            return -1;
+
+        //A full chunk means the sensor may have more queued. The request for the next chunk is
+        //sent with a repeated start after this payload, so both happen in one bus transaction.
+        size_t remaining = length - total - (size_t)data_len;
+        bool more = (data_len == requested && remaining > 0);
+        if(more) {
+            request[1] = i2cReadChunkLen(remaining);
         }
+
+        struct i2c_msg msgs[2];
+        uint32_t num_msgs = 0;
+        if(data_len > 0) {
+            msgs[num_msgs].addr  = dev->id.bus_address;
+            msgs[num_msgs].flags = I2C_M_RD;
+            msgs[num_msgs].len   = (uint16_t)data_len;
+            msgs[num_msgs].buf   = out + total;
+            num_msgs++;
+        }
+        if(more) {
+            msgs[num_msgs].addr  = dev->id.bus_address;
+            msgs[num_msgs].flags = 0;
+            msgs[num_msgs].len   = sizeof(request);
+            msgs[num_msgs].buf   = request;
+            num_msgs++;
+        }
+        if(num_msgs > 0) {
+            struct i2c_rdwr_ioctl_data rdwr_data = { .msgs = msgs, .nmsgs = num_msgs };
+            if(ioctl(dev->fd, I2C_RDWR, &rdwr_data) < 0) {
+                return -1;
+            }
+        }
+
+        total += (size_t)data_len;
+        if(!more) break;
     }
-    return data_len;
+    return (int)total;
 }
 
-static int i2cReadWithDataAvailableIrq(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
+static int i2cReadWithDataAvailableIrq(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms)
 {
     if (length == 0) return 0;
 
     // Wait for the Data Available line to go low
-    tss_time_t start = tssTimeGet();
-    uint32_t elapsed_time = 0;
-    while (gpiod_line_get_value(dev->data_available_line) == IRQ_INACTIVE_STATE) {
-        if(elapsed_time > timeout_ms) {
-            return TSS_ERR_TIMEOUT;
-        }
-        elapsed_time = tssTimeDiff(start);
+    int result = gpioIrqWaitForLine(dev->data_available_line, dev->data_available_events, GPIO_IRQ_ACTIVE_STATE, timeout_ms);
+    if(result < 0) {
+        return result;
     }
 
     //Then do a normal read
     return i2cReadNoIrq(dev, out, length, timeout_ms);
 }
 
-static int i2cReadWithFullIrq(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
+static int i2cReadChunkWithFullIrq(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
 {
     if(length == 0) return 0;
     //Wait for data_loaded pin to reset
@@ -317,52 +642,56 @@ static int i2cReadWithFullIrq(struct I2cDevice *dev, uint8_t *out, uint8_t lengt
     //back to back that his pin may not have been deasserted yet.
     //Doing this check here instead of after reading to avoid wasting time when could continue processing.
     tss_time_t start_time = tssTimeGet();
-    tss_time_t elapsed_time = 0;
-
-    while(gpiod_line_get_value(dev->data_loaded_line) == IRQ_ACTIVE_STATE) {
-        if(elapsed_time > timeout_ms + dev->header_timeout) {
-            //There might actually be data loaded that shouldn't be there if this times out.
-            //Clear it.
-
-            //Have to clear using the no irq mode otherwise the same issue will occur.
-            uint8_t clear_buffer[40];
-            int len;
-            do {
-                len = i2cReadNoIrq(dev, clear_buffer, sizeof(clear_buffer), 0);
-            } while(len > 0);
-            return TSS_ERR_TIMEOUT;
-        }
-        elapsed_time = tssTimeDiff(start_time);
+    int result = gpioIrqWaitForLine(dev->data_loaded_line, dev->data_loaded_events, GPIO_IRQ_INACTIVE_STATE, timeout_ms + dev->header_timeout);
+    if(result == TSS_ERR_TIMEOUT) {
+        //There might actually be data loaded that shouldn't be there if this times out.
+        //Clear it.
+
+        //Have to clear using the no irq mode otherwise the same issue will occur.
+        uint8_t clear_buffer[40];
+        int len;
+        do {
+            len = i2cReadNoIrq(dev, clear_buffer, sizeof(clear_buffer), 0);
+        } while(len > 0);
+        return TSS_ERR_TIMEOUT;
+    }
+    if(result < 0) {
+        return result;
     }
 
     //Wait for data to be available
-    elapsed_time = 0;
-    while(gpiod_line_get_value(dev->data_available_line) == IRQ_INACTIVE_STATE) {
-        if(elapsed_time > timeout_ms) {
-            return TSS_ERR_TIMEOUT;
-        }
-        elapsed_time = tssTimeDiff(start_time);
+    uint32_t elapsed_time = tssTimeDiff(start_time);
+    if(elapsed_time > timeout_ms) {
+        elapsed_time = timeout_ms;
+    }
+    result = gpioIrqWaitForLine(dev->data_available_line, dev->data_available_events, GPIO_IRQ_ACTIVE_STATE, timeout_ms - elapsed_time);
+    if(result < 0) {
+        return result;
     }
 
+    i2cLock(dev);
+    result = i2cReadLoadedChunk(dev, out, length, timeout_ms);
+    i2cUnlock(dev);
+    return result;
+}
+
+//Requests a chunk once data is available, then waits on the data loaded line to read it
+static int i2cReadLoadedChunk(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
+{
     //Start the read
     uint8_t header[2] = { TSS_TRANSACTION_READ_DATA_WITH_SIZE_BYTE, length };
-    ssize_t num_written = write(dev->fd, header, sizeof(header));
+    int num_written = i2cRawWrite(dev, header, sizeof(header));
     if(num_written < 0) {
         return -1;
     }
 
     //Wait until the data is loaded
-    start_time = tssTimeGet();
-    elapsed_time = 0;
-    while(gpiod_line_get_value(dev->data_loaded_line) == IRQ_INACTIVE_STATE) {
-        if(elapsed_time > timeout_ms + dev->header_timeout) {
-            return -1; //Somehow failed to load data
-        }
-        elapsed_time = tssTimeDiff(start_time);
+    if(gpioIrqWaitForLine(dev->data_loaded_line, dev->data_loaded_events, GPIO_IRQ_ACTIVE_STATE, timeout_ms + dev->header_timeout) != 0) {
+        return -1; //Somehow failed to load data
     }
 
     //Read the header
-    ssize_t num_read = read(dev->fd, header, sizeof(header));
+    int num_read = i2cRawRead(dev, header, sizeof(header));
     if(num_read < 0) {
         return -1;
     }
@@ -371,7 +700,7 @@ static int i2cReadWithFullIrq(struct I2cDevice *dev, uint8_t *out, uint8_t lengt
 
     //This should never occur when using the data loaded pin, but checking anyways
     if(status == 0xFF) {
-        fprintf(stderr, "i2cReadWithFullIrq: Unexpected 0xFF status when using full data IRQ\n");
+        tssTrace(TSS_TRACE_ERROR, dev, 0, 0, -1, "i2cReadWithFullIrq: Unexpected 0xFF status when using full data IRQ");
         return -1;
     }
 
@@ -380,10 +709,10 @@ static int i2cReadWithFullIrq(struct I2cDevice *dev, uint8_t *out, uint8_t lengt
         //issue with the I2C lines. Checking anyways
         //to ensure no buffer overruns.
         if(data_len > length) {
-            fprintf(stderr, "i2cReadWithFullIrq: Unexpected data_len (%d) > buffer (%d)\n", data_len, length);
+            tssTrace(TSS_TRACE_ERROR, dev, 0, data_len, (int32_t)length, "i2cReadWithFullIrq: Unexpected data_len > buffer");
             return -1;
         }
-        num_read = read(dev->fd, out, data_len);
+        num_read = i2cRawRead(dev, out, data_len);
         if(num_read < 0) {
             return -1;
         }
@@ -392,6 +721,25 @@ static int i2cReadWithFullIrq(struct I2cDevice *dev, uint8_t *out, uint8_t lengt
     return data_len;
 }
 
+static int i2cReadWithFullIrq(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms)
+{
+    size_t total = 0;
+    while(total < length) {
+        uint8_t requested = i2cReadChunkLen(length - total);
+        int n = i2cReadChunkWithFullIrq(dev, out + total, requested, timeout_ms);
+        if(n < 0) {
+            return (total > 0) ? (int)total : n;
+        }
+        total += (size_t)n;
+
+        //Only keep going while the sensor still has data, otherwise the next chunk would wait out the timeout
+        if(n < requested || gpiod_line_get_value(dev->data_available_line) == GPIO_IRQ_INACTIVE_STATE) {
+            break;
+        }
+    }
+    return (int)total;
+}
+
 // -----------------------------------------------------------------------
 // High-level read (uses dev->read_fn and dev->timeout)
 // -----------------------------------------------------------------------
@@ -404,11 +752,8 @@ int i2cRead(struct I2cDevice *dev, size_t num_bytes, uint8_t *out)
     tss_time_t start = tssTimeGet();
     uint32_t elapsed_time = 0;
     while (total < num_bytes && elapsed_time <= dev->timeout) {
-        size_t chunk = num_bytes - total;
-        if (chunk > 255) chunk = 255;
-
         uint32_t remaining = dev->timeout - elapsed_time;
-        int n = dev->read_fn(dev, out + total, (uint8_t)chunk, remaining);
+        int n = dev->read_fn(dev, out + total, num_bytes - total, remaining);
         if(n >= 0) {
             total += (size_t)n;
         }
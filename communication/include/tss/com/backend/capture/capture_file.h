@@ -0,0 +1,105 @@
+#ifndef __TSS_CAPTURE_FILE_H__
+#define __TSS_CAPTURE_FILE_H__
+
+/*
+*   Compact binary file of the bytes read from and written to a com class, with when each happened.
+*
+*   The file starts with the 6 byte magic "TSSCAP" and a little endian uint16 version.
+*   Every record after that is:
+*       uint8   type        CaptureRecordType
+*       varint  delta_us    Microseconds since the previous record, or since capturing started for the first
+*       varint  len         Number of data bytes that follow
+*       uint8   data[len]
+*   Varints are unsigned LEB128, so most records have only 3 bytes of overhead.
+*/
+
+#include "tss/sys/time.h"
+#include "tss/com/com_class.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CAPTURE_FILE_MAGIC "TSSCAP"
+#define CAPTURE_FILE_MAGIC_LEN 6
+#define CAPTURE_FILE_VERSION 1
+
+//Longer data is split into multiple records, so readers never need more than this
+#define CAPTURE_MAX_RECORD_LEN 8192
+
+enum CaptureRecordType {
+    CAPTURE_RECORD_READ = 1,    //Bytes received from the device
+    CAPTURE_RECORD_WRITE = 2,   //Bytes sent to the device
+    CAPTURE_RECORD_CLEAR = 3,   //The input was cleared. Has no data, the cleared bytes are in the reads before it.
+};
+
+struct CaptureWriter {
+    FILE *file;
+    tss_time_t start_time;
+    uint64_t last_us;
+
+    uint64_t records;
+    uint64_t bytes;
+};
+
+struct CaptureRecord {
+    enum CaptureRecordType type;
+    uint64_t time_us; //Since capturing started
+    uint16_t len;
+    uint8_t data[CAPTURE_MAX_RECORD_LEN];
+};
+
+struct CaptureReader {
+    FILE *file;
+    uint64_t time_us;
+    uint16_t version;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Creates the capture file, writes its header and starts the capture clock.
+ * @return 0 on success, -1 if the file could not be created or written.
+ */
+int captureWriterOpen(struct CaptureWriter *writer, const char *path);
+
+/**
+ * @brief Appends a record of the data, split into multiple records if longer than CAPTURE_MAX_RECORD_LEN.
+ * @return 0 on success, -1 if writing failed.
+ */
+int captureWriterRecord(struct CaptureWriter *writer, enum CaptureRecordType type, const uint8_t *data, size_t len);
+
+/**
+ * @brief Appends the buffers as a single record, as they were sent as one contiguous write.
+ * @return 0 on success, -1 if writing failed.
+ */
+int captureWriterRecordVectored(struct CaptureWriter *writer, enum CaptureRecordType type, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
+
+/**
+ * @brief Flushes and closes the file. Safe to call when not open.
+ * @return 0 on success, -1 if flushing failed.
+ */
+int captureWriterClose(struct CaptureWriter *writer);
+
+/**
+ * @brief Opens a capture file and validates its header.
+ * @return 0 on success, -1 if the file could not be opened or is not a capture of a supported version.
+ */
+int captureReaderOpen(struct CaptureReader *reader, const char *path);
+
+/**
+ * @brief Reads the next record.
+ * @return 1 if a record was read, 0 at the end of the capture, -1 if the capture is corrupt or truncated.
+ */
+int captureReaderNext(struct CaptureReader *reader, struct CaptureRecord *out);
+
+void captureReaderClose(struct CaptureReader *reader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TSS_CAPTURE_FILE_H__ */
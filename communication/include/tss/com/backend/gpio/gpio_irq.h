@@ -0,0 +1,54 @@
+#ifndef __TSS_GPIO_IRQ_H__
+#define __TSS_GPIO_IRQ_H__
+
+/*
+* Waiting on the data available and data loaded IRQ lines of sensors, shared by
+* the Linux SPI and I2C backends. Lines requested for edge events are slept on,
+* lines from chips that can't generate interrupts are polled instead.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <gpiod.h>
+
+#define GPIO_IRQ_ACTIVE_STATE 0
+#define GPIO_IRQ_INACTIVE_STATE 1
+
+//Max lines gpioIrqSchedule can arbitrate between
+#define GPIO_IRQ_MAX_LINES 16
+
+/**
+ * @brief Requests an IRQ line as an input, with edge events if the chip supports them.
+ * @param both_edges Request both edges instead of only the falling edge.
+ * @param events Set to true if edge events were requested, false if the line can only be polled.
+ * @return 0 on success, -1 on error.
+ */
+int gpioIrqRequestLine(struct gpiod_line *line, const char *consumer, bool both_edges, bool *events);
+
+/**
+ * @brief Discards edges that already happened so a following wait only wakes on a new one.
+ * @return 0 on success, -1 on error.
+ */
+int gpioIrqDrainEvents(struct gpiod_line *line);
+
+/**
+ * @brief Waits up to timeout_ms for an IRQ line to reach state.
+ * @param events If the line was requested for edge events. If not, its value is polled.
+ * @return 0 once the line is in state, TSS_ERR_TIMEOUT if it did not get there in time, or -1 on error.
+ */
+int gpioIrqWaitForLine(struct gpiod_line *line, bool events, int state, uint32_t timeout_ms);
+
+/**
+ * @brief Orders the devices of a shared bus to be serviced, waiting up to timeout_ms for one to be ready.
+ * Devices with an active data available line come first, then devices without one, which are always
+ * included since they can't say if they have data. Both start at *next_start, which is rotated on each
+ * call that returns devices so one busy device can't starve the others.
+ * @param lines The data available line of each device, NULL if it has none.
+ * @param events If each line was requested for edge events.
+ * @param count Number of devices, at most GPIO_IRQ_MAX_LINES.
+ * @param order Receives the indices of the devices to service, in order.
+ * @return The number of indices written to order, 0 on timeout, or -1 on error.
+ */
+int gpioIrqSchedule(struct gpiod_line *const *lines, const bool *events, uint8_t count, uint8_t *next_start, uint8_t *order, uint32_t timeout_ms);
+
+#endif /* __TSS_GPIO_IRQ_H__ */
@@ -22,6 +22,53 @@ int i2cOpen(I2cPortId id, uint32_t speed_hz, struct I2cDevice *out);
  */
 void i2cClose(struct I2cDevice *dev);
 
+/**
+ * @brief One device's part of a combined i2cBusRead.
+ */
+struct I2cBusRead {
+    struct I2cDevice *dev;
+    uint8_t *out;
+    uint8_t length;     //Max bytes to read from the device, at most 255
+    int result;         //Set to the number of bytes read, or negative on error/timeout
+};
+
+/**
+ * @brief Opens an I2C bus to be shared by multiple devices at different addresses.
+ * Set I2cDeviceInfo.bus to the bus before opening each device on it.
+ * @return 0 on success, non-zero on error.
+ */
+int i2cBusOpen(struct I2cBus *bus, const char *device_name);
+
+/**
+ * @brief Closes the I2C bus. Every device on it must already be closed.
+ */
+void i2cBusClose(struct I2cBus *bus);
+
+/**
+ * @brief Picks which devices on a shared bus to service this cycle.
+ * Devices asserting their Data Available line are listed first, followed by any devices
+ * without a Data Available line since they can't signal when they have data. The starting
+ * device rotates every call so no ready device is starved.
+ * If no device is ready, sleeps on the Data Available lines for up to @p timeout_ms.
+ * @param devices The devices on the bus, at most I2C_BUS_MAX_DEVICES.
+ * @param order Receives the indices into @p devices to service, in order. Must hold @p count entries.
+ * @return The number of devices to service, 0 if none became ready in time, or negative on error.
+ */
+int i2cBusSchedule(struct I2cBus *bus, struct I2cDevice *const *devices, uint8_t count, uint8_t *order, uint32_t timeout_ms);
+
+/**
+ * @brief Reads from several devices on a bus at once using the READ_DATA_WITH_SIZE protocol.
+ * The read requests, each round of status polling, and the payloads are each sent as a
+ * single I2C_RDWR call covering every device, instead of one call per device per step.
+ * Each device's outcome is stored in its entry's result.
+ * If a combined transfer fails, such as a device NACKing, every device it covered is read again
+ * on its own with a new request, so one failing device can't leave the others out of step.
+ * The bus lock is held throughout, so reads and writes of the same devices from other threads wait for it.
+ * @param count Number of entries in @p reads, at most I2C_BUS_MAX_DEVICES.
+ * @return 0 once every device has a result, or negative if @p count is too large.
+ */
+int i2cBusRead(struct I2cBus *bus, struct I2cBusRead *reads, uint8_t count);
+
 /**
  * @brief Writes @p len bytes to the I2C device.
  * @return 0 on success, non-zero on error.
@@ -29,7 +76,7 @@ void i2cClose(struct I2cDevice *dev);
 int i2cWrite(struct I2cDevice *dev, const uint8_t *data, size_t len);
 
 /**
- * @brief High-level read that calls dev->read_fn in 255-byte chunks until
+ * @brief High-level read that calls dev->read_fn with the remaining length until
  * @p num_bytes are received or the timeout stored in the device (dev->timeout) expires.
  * @return Total bytes received, or negative on error.
  */
@@ -54,4 +101,13 @@ void i2cSetTimeout(struct I2cDevice *dev, uint32_t timeout_ms);
  */
 int i2cConfigurePinMode(struct I2cDevice *dev, int data_available_line_num, int data_loaded_line_num);
 
+/**
+ * @brief Gets a file descriptor that becomes readable when the Data Available line asserts,
+ * allowing the sensor to be added to an existing poll/epoll loop instead of blocking in i2cRead.
+ * Pending events on it are consumed by the next read, so the caller only needs to wait on it.
+ * @return The file descriptor, or -1 if the Data Available line is not configured or its GPIO chip
+ * does not support edge events.
+ */
+int i2cGetDataAvailableFd(const struct I2cDevice *dev);
+
 #endif /* __TSS_I2C_DEVICE_H__ */
@@ -2,8 +2,32 @@
 #define __TSS_LINUX_I2C_H__
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include <gpiod.h>
 
+//Max devices that can be scheduled and read together on one bus.
+//Kept below the kernel's limit of 42 messages per I2C_RDWR call.
+#define I2C_BUS_MAX_DEVICES 16
+
+/*
+* A single I2C bus shared by several sensors at different addresses.
+* The bus owns the file descriptor, so every device on it uses the same kernel handle
+* and reads from several devices can be combined into one I2C_RDWR call.
+*/
+struct I2cBus {
+    int fd;
+
+    //Held from a device's request until its response is read, so the transactions of
+    //devices used from different threads never interleave on the bus.
+    pthread_mutex_t lock;
+
+    //Where i2cBusSchedule starts looking for ready devices, rotated each cycle
+    //so one busy device can't starve the others.
+    uint8_t next_start;
+};
+
 /*
 * device_name, chip_path, and cs_line_num are required to create a SpiDevice.
 * data_available_line_num and data_loaded_line_num are optional, but if provided, will be
@@ -18,6 +42,10 @@ struct I2cDeviceInfo {
     char *chip_path;
     int data_available_line_num;
     int data_loaded_line_num;
+
+    // Optional. When set, the device uses this bus's file descriptor
+    // instead of opening device_name itself.
+    struct I2cBus *bus;
 };
 
 /*
@@ -35,6 +63,10 @@ struct I2cDevice {
     struct gpiod_chip *chip;
     struct gpiod_line *data_available_line;
     struct gpiod_line *data_loaded_line;
+    //True when the matching IRQ line was requested for edge events, so waits sleep on
+    //the line instead of polling it. False if the GPIO chip can not generate interrupts.
+    bool data_available_events;
+    bool data_loaded_events;
 
     //Configuration parameters for the I2C device
     uint32_t speed_hz;
@@ -46,8 +78,9 @@ struct I2cDevice {
 
     // Read strategy used by i2cRead. Swap this pointer to change the
     // chunked-read behaviour without altering any higher-level code.
+    // Reads larger than the protocol's 255-byte limit are chunked by the strategy itself.
     // Default (set by i2cOpen): i2cReadNoIrq.
-    int (*read_fn)(struct I2cDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
+    int (*read_fn)(struct I2cDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
 };
 
 #endif /* __TSS_LINUX_I2C_H__ */
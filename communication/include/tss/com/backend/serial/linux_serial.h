@@ -12,6 +12,31 @@ struct SerialDevice {
     uint8_t port;
     uint32_t timeout;
     bool blocking;
+
+    //Low latency state, tracked so the original settings can be restored
+    uint8_t low_latency;
+    bool restore_async_low_latency;
+    int16_t restore_latency_timer; //-1 if not changed
+};
+
+//Watches for serial ports being added/removed using the kernel uevent netlink socket.
+//The fd can be added to an external event loop, it becomes readable when events are available.
+struct SerialHotplugMonitor {
+    int fd;
 };
 
+#define SER_HOTPLUG_ADD 0
+#define SER_HOTPLUG_REMOVE 1
+
+//Returns 0 on success, non-zero on failure
+int serHotplugOpen(struct SerialHotplugMonitor *out);
+void serHotplugClose(struct SerialHotplugMonitor *monitor);
+
+//Waits up to timeout_ms for hot-plug events, then calls cb once for each ttyUSB/ttyACM port added or removed.
+//A timeout of 0 only processes the events already available.
+//Note: The /dev node may not have its final permissions yet when the add event arrives, so opening may need retried.
+//Returns the number of events reported or negative on error.
+int serHotplugUpdate(struct SerialHotplugMonitor *monitor, uint32_t timeout_ms, 
+    void (*cb)(uint8_t event, uint8_t port, const char *name, void *user_data), void *user_data);
+
 #endif /* __TSS_LINUX_SERIAL_H__ */
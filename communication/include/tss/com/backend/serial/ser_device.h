@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 #if defined(_WIN32) || defined(_WIN64)
 #include "tss/com/backend/serial/win_serial.h"
@@ -13,17 +14,49 @@
 
 int serOpen(uint8_t port, uint32_t baudrate, struct SerialDevice *out);
 void serClose(struct SerialDevice *ser);
+//Changes the baudrate of an open port. Any pending output is sent at the old rate first.
+//Returns 0 on success, non-zero if the rate is not supported.
+int serSetBaudrate(struct SerialDevice *ser, uint32_t baudrate);
 int serConfigBufferSize(struct SerialDevice *ser, uint32_t in_size, uint32_t out_size);
 
 uint32_t serWrite(struct SerialDevice *ser, const char *buffer, uint32_t len);
 uint32_t serRead(struct SerialDevice *ser, char *buffer, uint32_t len);
+
+struct SerialBuffer {
+    void *data;
+    uint32_t len;
+};
+
+//Same as serRead, but fills each buffer in order, using a single read where supported.
+uint32_t serReadVectored(struct SerialDevice *ser, const struct SerialBuffer *buffers, uint8_t count);
+//Same as serWrite, but sends each buffer in order, using a single write where supported.
+uint32_t serWriteVectored(struct SerialDevice *ser, const struct SerialBuffer *buffers, uint8_t count);
 void serClear(struct SerialDevice *ser);
 
+//Waits up to timeout_ms for any of the ports to have data available to read, setting ready[i] for each one that does.
+//Returns the number of ready ports, 0 if none became ready in time, or negative on error.
+//If a port has an error or was disconnected, returns negative with ready[i] set only for the failed ports.
+int serWaitReadable(struct SerialDevice *const *devices, uint8_t count, bool *ready, uint32_t timeout_ms);
+
+//Bits returned by serSetLowLatency for what was applied
+#define SER_LOW_LATENCY_ASYNC 0x01 //Driver low latency flag enabled (ASYNC_LOW_LATENCY on Linux)
+#define SER_LOW_LATENCY_TIMER 0x02 //USB adapter latency timer minimized (FTDI latency_timer on Linux)
+
+//Reduces the time between data arriving at the adapter and it being readable, at the cost of more
+//USB/CPU overhead. Anything changed is restored when disabled or on serClose.
+//Returns the SER_LOW_LATENCY_* bits that are active. Settings that require permissions the process
+//does not have, or that the driver does not support, are skipped.
+uint8_t serSetLowLatency(struct SerialDevice *ser, bool enable);
+
 uint32_t serGetTimeout(const struct SerialDevice *ser);
 void serSetTimeout(struct SerialDevice *ser, uint32_t timeout_ms);
 
 const char * serPortToName(uint8_t port, char *out, size_t size);
 
+//Retrieves the serial number string of the USB device the port belongs to without opening the port.
+//Returns 0 on success, non-zero if the port is not a USB device or the platform does not support it.
+int serGetUsbSerial(uint8_t port, char *out, size_t size);
+
 #define SER_ENUM_CONTINUE 0
 #define SER_ENUM_STOP 1
 
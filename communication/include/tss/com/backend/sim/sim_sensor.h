@@ -0,0 +1,175 @@
+#ifndef __TSS_SIM_SENSOR_H__
+#define __TSS_SIM_SENSOR_H__
+
+/*
+*   Emulates the sensor side of the 3-Space binary protocol entirely in memory.
+*   Bytes the host sends are parsed as commands and settings requests, and the
+*   responses, streaming packets and debug messages the sensor would output are
+*   produced in an output buffer for the host to read back.
+*   The bootloader is emulated as well, entered with the enter bootloader command
+*   and left with the bootloader's load firmware command.
+*   The SD card holds a single file of configurable size, which every open file command
+*   opens regardless of path, and which can be read with file streaming.
+*/
+
+#include "tss/constants.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//Must be a power of 2
+#define SIM_SENSOR_OUT_BUFFER_SIZE 16384
+#define SIM_SENSOR_MAX_SETTINGS 32
+#define SIM_SENSOR_MAX_SETTING_LEN 256
+
+//Largest request is a bootloader program of 4096 bytes plus its command, length and checksum
+#define SIM_SENSOR_IN_BUFFER_SIZE (TSS_MAX_CMD_LEN + 8)
+
+struct SimSensorConfig {
+    uint64_t serial_number;
+
+    //When true, streaming ignores the stream_interval setting. Instead a burst of packets is
+    //produced whenever the host has read everything, so streaming runs as fast as the host can parse.
+    bool unthrottled;
+
+    //Immediate debug messages output per second while debug_mode is 1. 0 to never output.
+    uint32_t debug_message_hz;
+
+    //Flips a random bit in one of every this many output bytes. 0 to disable.
+    uint32_t corrupt_interval;
+
+    //Seed for choosing which bits are corrupted
+    uint32_t seed;
+
+    //Power on into the bootloader instead of firmware, as a sensor with no firmware loaded would
+    bool start_in_bootloader;
+
+    //Size of the file on the SD card, with contents given by simSensorFileByte. 0 for no file.
+    uint64_t file_size;
+
+    //File streaming rate. 0 streams as fast as the host reads, the same as unthrottled streaming.
+    uint32_t file_bytes_per_s;
+
+    //File streaming silently stops after every this many bytes, as it would if the connection
+    //dropped part way through. The host must restart it to continue. 0 to disable.
+    uint64_t file_drop_interval;
+};
+
+struct SimSensorSetting {
+    char key[TSS_MAX_SETTINGS_KEY_LEN];
+    uint8_t value[SIM_SENSOR_MAX_SETTING_LEN]; //Stored as sent over the wire
+    uint16_t len;
+};
+
+struct SimSensorStats {
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint32_t commands;
+    uint32_t settings_reads;
+    uint32_t settings_writes;
+    uint64_t packets_streamed;
+    uint64_t packets_dropped; //Streaming packets that did not fit in the output buffer
+    uint32_t debug_messages;
+    uint32_t bytes_corrupted;
+    uint64_t firmware_bytes; //Programmed through the bootloader
+    uint64_t file_bytes_streamed;
+    uint32_t file_drops;
+};
+
+struct SimSensor {
+    struct SimSensorConfig config;
+
+    //Written values of every setting that is not computed from the state below
+    struct SimSensorSetting settings[SIM_SENSOR_MAX_SETTINGS];
+    uint8_t num_settings;
+
+    uint8_t header_bits;
+    uint8_t debug_mode;
+    uint64_t start_us;
+    bool in_bootloader;
+
+    char stream_slots[TSS_NUM_STREAM_SLOTS * 8 + 1];
+    uint8_t slot_commands[TSS_NUM_STREAM_SLOTS];
+    uint8_t num_slots;
+    uint64_t stream_interval_us;
+    uint64_t next_stream_us;
+    bool streaming;
+
+    bool file_open;
+    uint64_t file_cursor;
+    bool file_streaming;
+    uint64_t file_stream_start_us;
+    uint64_t file_stream_bytes;     //Sent since file streaming started
+    uint64_t file_bytes_until_drop;
+
+    uint64_t next_debug_us;
+    uint32_t rand_state;
+    uint32_t bytes_until_corrupt;
+
+    //Unparsed bytes from the host
+    uint8_t in_buffer[SIM_SENSOR_IN_BUFFER_SIZE];
+    size_t in_len;
+
+    //Bytes waiting for the host to read
+    uint8_t out_buffer[SIM_SENSOR_OUT_BUFFER_SIZE];
+    size_t out_w_index;
+    size_t out_r_index;
+
+    struct SimSensorStats stats;
+};
+
+/**
+ * @brief Resets the sensor to its power on state with the given configuration.
+ * @param config The behavior of the sensor. NULL uses defaults.
+ */
+void simSensorInit(struct SimSensor *sim, const struct SimSensorConfig *config);
+
+/**
+ * @brief Feeds bytes sent by the host to the sensor. Every complete request is handled immediately,
+ * incomplete ones are kept until the rest arrives.
+ */
+void simSensorWrite(struct SimSensor *sim, const uint8_t *bytes, size_t len);
+
+/**
+ * @brief Produces any streaming packets and debug messages that are due.
+ * @return The number of bytes available to read.
+ */
+size_t simSensorUpdate(struct SimSensor *sim);
+
+/**
+ * @brief Reads up to @p num_bytes of the sensor output without waiting.
+ * Call simSensorUpdate first for any newly due output to be included.
+ * @return The number of bytes read.
+ */
+size_t simSensorRead(struct SimSensor *sim, uint8_t *out, size_t num_bytes);
+
+/**
+ * @brief Discards everything currently waiting to be read.
+ */
+void simSensorClear(struct SimSensor *sim);
+
+/**
+ * @brief How long until the sensor will next output data on its own, such as a streaming packet.
+ * @return Microseconds until the next output, 0 if already due, or UINT64_MAX if nothing is scheduled.
+ */
+uint64_t simSensorNextOutputUs(const struct SimSensor *sim);
+
+/**
+ * @brief Queues a debug message as the sensor would output it with debug_mode set to immediate.
+ * Output regardless of the debug_mode setting.
+ */
+void simSensorDebugMessage(struct SimSensor *sim, uint8_t level, uint8_t module, const char *message);
+
+/**
+ * @brief The contents of the simulated file. Every byte depends on its position, so
+ * data that is missing, repeated or out of order is detected when compared.
+ */
+uint8_t simSensorFileByte(uint64_t index);
+
+/**
+ * @brief Monotonic time in microseconds used for all of the sensor's timing.
+ */
+uint64_t simSensorTimeUs(void);
+
+#endif /* __TSS_SIM_SENSOR_H__ */
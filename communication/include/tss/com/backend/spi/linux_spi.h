@@ -2,8 +2,35 @@
 #define __TSS_LINUX_SPI_H__
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include <gpiod.h>
 
+//Max devices spiBusSchedule can arbitrate between on one bus
+#define SPI_BUS_MAX_DEVICES 16
+
+/*
+* A single SPI bus shared by several sensors, each selected by its own GPIO CS line.
+* The bus owns the spidev file descriptor and GPIO chip, so every device on it
+* uses the same kernel handles instead of opening its own.
+*/
+struct SpiBus {
+    int fd;
+    struct gpiod_chip *chip;
+
+    uint8_t bits_per_word;
+    uint8_t mode;
+
+    //Held from asserting a device's CS until releasing it, so transactions
+    //from different devices never overlap on the bus.
+    pthread_mutex_t lock;
+
+    //Where spiBusSchedule starts looking for ready devices, rotated each cycle
+    //so one busy device can't starve the others.
+    uint8_t next_start;
+};
+
 /*
 * device_name, chip_path, and cs_line_num are required to create a SpiDevice.
 * data_available_line_num and data_loaded_line_num are optional, but if provided, will be
@@ -18,6 +45,10 @@ struct SpiDeviceInfo {
     // Optional, so can be negative
     int data_available_line_num;
     int data_loaded_line_num;
+
+    // Optional. When set, the device uses this bus's file descriptor and GPIO chip
+    // instead of opening device_name and chip_path itself.
+    struct SpiBus *bus;
 };
 
 /*
@@ -36,6 +67,10 @@ struct SpiDevice {
     struct gpiod_line *cs_line;
     struct gpiod_line *data_available_line;
     struct gpiod_line *data_loaded_line;
+    //True when the matching IRQ line was requested for edge events, so waits sleep on
+    //the line instead of polling it. False if the GPIO chip can not generate interrupts.
+    bool data_available_events;
+    bool data_loaded_events;
 
     //Configuration parameters for the SPI device
     uint32_t speed_hz;
@@ -47,10 +82,15 @@ struct SpiDevice {
     //Timeout for specifically the header portion of a Transactional Response
     uint32_t header_timeout;
 
+    //Max number of payload bytes to read in the same message as the status when the
+    //data loaded line indicates the response is ready. Avoids a second message for small responses.
+    uint8_t rx_piggyback_len;
+
     // Read strategy used by spiRead. Swap this pointer to change the
     // chunked-read behaviour without altering any higher-level code.
+    // Reads larger than the protocol's 255-byte limit are chunked by the strategy itself.
     // Default (set by spiOpen): spiReadNoIrq.
-    int (*read_fn)(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
+    int (*read_fn)(struct SpiDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
 };
 
 #endif /* __TSS_LINUX_SPI_H__ */
@@ -22,6 +22,32 @@ int spiOpen(SpiPortId id, uint32_t speed_hz, struct SpiDevice *out);
  */
 void spiClose(struct SpiDevice *dev);
 
+/**
+ * @brief Opens an SPI bus to be shared by multiple devices with separate CS lines.
+ * Set SpiDeviceInfo.bus to the bus before opening each device on it. Transactions from
+ * devices on the same bus are serialized, so the devices may be used from different threads.
+ * @param speed_hz Default clock frequency. Each device still uses its own speed.
+ * @return 0 on success, non-zero on error.
+ */
+int spiBusOpen(struct SpiBus *bus, const char *device_name, const char *chip_path, uint32_t speed_hz);
+
+/**
+ * @brief Closes the SPI bus. Every device on it must already be closed.
+ */
+void spiBusClose(struct SpiBus *bus);
+
+/**
+ * @brief Picks which devices on a shared bus to service this cycle.
+ * Devices asserting their Data Available line are listed first, followed by any devices
+ * without a Data Available line since they can't signal when they have data. The starting
+ * device rotates every call so no ready device is starved.
+ * If no device is ready, sleeps on the Data Available lines for up to @p timeout_ms.
+ * @param devices The devices on the bus, at most SPI_BUS_MAX_DEVICES.
+ * @param order Receives the indices into @p devices to service, in order. Must hold @p count entries.
+ * @return The number of devices to service, 0 if none became ready in time, or negative on error.
+ */
+int spiBusSchedule(struct SpiBus *bus, struct SpiDevice *const *devices, uint8_t count, uint8_t *order, uint32_t timeout_ms);
+
 /**
  * @brief Basic write function. Raw write that adds no protocol bytes. Single transaction.
  * @param data Pointer to the data to write.
@@ -36,6 +62,32 @@ int spiBasicWrite(struct SpiDevice *dev, const uint8_t *data, size_t len);
  */
 int spiWrite(struct SpiDevice *dev, const uint8_t *data, size_t len);
 
+struct SpiBuffer {
+    const uint8_t *data;
+    size_t len;
+};
+
+/**
+ * @brief Same as spiWrite, but sends the data from each buffer, in order, as one write.
+ * The buffers are chained together in a single SPI message instead of being copied into one buffer first.
+ * @return 0 on success, non-zero on error.
+ */
+int spiWriteVectored(struct SpiDevice *dev, const struct SpiBuffer *buffers, uint8_t count);
+
+//One piece of a full duplex SPI message
+struct SpiTransfer {
+    const uint8_t *tx;  //Data to send, or NULL to send zeroes
+    uint8_t *rx;        //Where to store received data, or NULL to discard it
+    uint32_t len;
+};
+
+/**
+ * @brief Performs all the transfers back to back in a single SPI message. Data is received while sending.
+ * Does not modify CS, so multiple transfers can be done in one CS assertion.
+ * @return 0 on success, non-zero on error.
+ */
+int spiTransfer(struct SpiDevice *dev, const struct SpiTransfer *transfers, uint8_t count);
+
 /**
  * @brief Basic read function. Raw read, does not handle sending protocol read request. Single transaction.
  * @return Number of bytes received, or negative on error.
@@ -45,15 +97,17 @@ int spiBasicRead(struct SpiDevice *dev, uint8_t *out, size_t len);
 /**
  * @brief Full protocol read using the READ_DATA_WITH_SIZE command.
  * Sends the read command, polls the status byte until the sensor signals
- * that data is ready, then reads the payload.
- * @param length  Number of bytes to request from the sensor (max 255).
+ * that data is ready, then reads the payload. Requests larger than 255 bytes are
+ * split into chunks, with the request for each chunk sent in the same message as
+ * the previous payload. Stops early when the sensor returns less than a full chunk.
+ * @param length  Number of bytes to request from the sensor.
  * @param timeout_ms Maximum time to spend waiting for a valid response (ms).
  * @return Number of bytes received, or negative on error/timeout.
  */
-int spiReadNoIrq(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
+int spiReadNoIrq(struct SpiDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
 
 /**
- * @brief High-level read that calls dev->read_fn in 255-byte chunks until
+ * @brief High-level read that calls dev->read_fn with the remaining length until
  * @p num_bytes are received or the timeout stored in the device (dev->timeout) expires.
  * @return Total bytes received, or negative on error.
  */
@@ -78,4 +132,13 @@ void spiSetTimeout(struct SpiDevice *dev, uint32_t timeout_ms);
  */
 int spiConfigurePinMode(struct SpiDevice *dev, int data_available_line_num, int data_loaded_line_num);
 
+/**
+ * @brief Gets a file descriptor that becomes readable when the Data Available line asserts,
+ * allowing the sensor to be added to an existing poll/epoll loop instead of blocking in spiRead.
+ * Pending events on it are consumed by the next read, so the caller only needs to wait on it.
+ * @return The file descriptor, or -1 if the Data Available line is not configured or its GPIO chip
+ * does not support edge events.
+ */
+int spiGetDataAvailableFd(const struct SpiDevice *dev);
+
 #endif /* __TSS_SPI_DEVICE_H__ */
@@ -33,6 +33,19 @@ extern "C" {
  */
 TSS_API void create_i2c_com_class(I2cPortId id, uint32_t speed_hz, struct I2cComClass *out);
 
+#if TSS_MINIMAL_SENSOR == 0
+/**
+ * @brief Runs one cycle of a shared I2C bus. Reads from every com class that may have data
+ * directly into its read buffer, using combined transfers (see i2cBusSchedule and i2cBusRead).
+ * Afterwards the sensor API can consume the buffered data without touching the bus,
+ * so one thread can service every sensor on the bus.
+ * @param coms The opened com classes on @p bus, at most I2C_BUS_MAX_DEVICES.
+ * @param timeout_ms Max time to wait for any com class to have data.
+ * @return The number of com classes serviced, or negative on error.
+ */
+TSS_API int i2c_com_bus_update(struct I2cBus *bus, struct I2cComClass *const *coms, uint8_t count, uint32_t timeout_ms);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
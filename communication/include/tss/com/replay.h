@@ -0,0 +1,72 @@
+#ifndef __REPLAY_COM_CLASS_H__
+#define __REPLAY_COM_CLASS_H__
+
+#include "tss/com/managed_com.h"
+#include "tss/com/backend/capture/capture_file.h"
+#include "tss/export.h"
+
+/*
+*   A com class that plays back the bytes read in a capture made by the tee com class.
+*   Writes are accepted and discarded, so the API runs the same as it did while capturing
+*   as long as it is used the same way. Reads are stopped at each point the input was cleared
+*   while capturing until it is cleared again, keeping the replay aligned with the API.
+*
+*   At original speed, data becomes available at the same time after opening as it was
+*   received after the tee was opened. At maximum speed, all data is available immediately,
+*   which makes replaying a benchmark of parsing real traffic.
+*/
+
+struct ReplayComClass {
+    struct TSS_Managed_Com_Class base;
+    struct TSS_Com_Class replay_com;
+
+    const char *path;
+    bool max_speed;
+
+    struct CaptureReader reader;
+    struct CaptureRecord record;
+    bool have_record;           //record has not been fully consumed
+    uint16_t record_pos;
+    bool finished;              //No records remain, or the rest of the capture is corrupt
+    bool corrupt;               //The capture ended part way through a record
+
+    tss_time_t start_time;
+    uint32_t timeout_ms;
+    bool open;
+
+    uint64_t bytes_replayed;
+    uint64_t bytes_written;     //Written by the API during the replay, and discarded
+    uint64_t bytes_captured_written; //Written while capturing, up to the current point of the replay
+
+#if TSS_MINIMAL_SENSOR == 0
+    uint8_t read_buffer[4096];
+#endif
+
+#if TSS_BUFFERED_WRITES
+    uint8_t write_buffer[512];
+#endif
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialises a ReplayComClass. The capture is opened and replay starts when the com class is opened.
+ * Opening again after closing restarts the replay from the beginning.
+ * @param path      The capture file to replay. Must outlive the replay.
+ * @param max_speed If true, replay without waiting. Otherwise replay at the speed it was captured.
+ * @param out       Output struct to initialise. Must outlive all use of the com class.
+ */
+TSS_API void create_replay_com_class(const char *path, bool max_speed, struct ReplayComClass *out);
+
+/**
+ * @brief Checks if all of the capture has been replayed.
+ * Data may still be buffered in the managed com class that has not been read yet.
+ */
+TSS_API bool replay_com_finished(const struct ReplayComClass *replay);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __REPLAY_COM_CLASS_H__ */
@@ -2,15 +2,37 @@
 #define __SERIAL_COM_CLASS_H__
 
 #include "tss/com/managed_com.h"
+#include "tss/api/sensor.h"
 #include "tss/com/backend/serial/ser_device.h"
 #include "tss/utility/ring_buf2.h"
 
 #include "tss/export.h"
 
+#include <stdbool.h>
+
+#define SERIAL_COM_DEFAULT_BAUDRATE 115200
+#define SERIAL_COM_USB_SERIAL_MAX_LEN 64
+#define SERIAL_COM_PORT_CACHE_MAX_ENTRIES 32
+
 struct SerialComClass {
     struct TSS_Managed_Com_Class base;
     struct TSS_Com_Class serial_com;
     struct SerialDevice port;
+    uint32_t baudrate;
+    bool is_open;
+
+    //If low latency mode should be applied when opening, and the SER_LOW_LATENCY_* bits that
+    //actually were applied to the open port.
+    bool low_latency;
+    uint8_t low_latency_applied;
+
+    //USB serial number string of the last opened port, empty if unknown.
+    //Used to find the device again first when reenumerating.
+    char usb_serial[SERIAL_COM_USB_SERIAL_MAX_LEN];
+
+    //Optional, see serial_com_set_port_cache
+    struct SerialComPortCache *port_cache;
+    uint64_t port_cache_serial_number;
 
 #if TSS_MINIMAL_SENSOR == 0
     uint8_t read_buffer[4096];
@@ -21,6 +43,26 @@ struct SerialComClass {
 #endif
 };
 
+//A sensor found by serial_com_discover
+struct SerialComDiscovery {
+    uint8_t port;
+    uint64_t serial_number;
+    bool in_bootloader;
+};
+
+//Last known location of a sensor
+struct SerialComPortCacheEntry {
+    uint64_t serial_number;
+    uint8_t port;
+    char usb_serial[SERIAL_COM_USB_SERIAL_MAX_LEN];
+};
+
+//Map from sensor serial number to the last port it was found on.
+//Can be saved to disk to allow finding sensors quickly across runs.
+struct SerialComPortCache {
+    struct SerialComPortCacheEntry entries[SERIAL_COM_PORT_CACHE_MAX_ENTRIES];
+    uint8_t count;
+};
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,6 +71,86 @@ extern "C" {
 TSS_API void create_serial_com_class(uint8_t port, struct SerialComClass *out);
 TSS_API int serial_com_auto_detect(struct TSS_Com_Class *out, TssComAutoDetectCallback cb, void *user_data);
 
+/**
+ * @brief Sets the host side baudrate. Defaults to SERIAL_COM_DEFAULT_BAUDRATE.
+ * If the port is open, it is changed immediately, otherwise it is used when opened.
+ * Any rate supported by the serial driver can be used, not just the standard rates.
+ * @return 0 on success, non-zero if the rate is not supported
+ */
+TSS_API int serial_com_set_baudrate(struct SerialComClass *ser, uint32_t baudrate);
+
+/**
+ * @brief Enables or disables low latency mode. When enabled, the port is configured to deliver data as soon
+ * as it arrives (see serSetLowLatency) each time it is opened. Changes made are undone when the port is closed.
+ * @return The SER_LOW_LATENCY_* bits that are currently applied. If the port is not open, this will be 0 until opened.
+ */
+TSS_API uint8_t serial_com_set_low_latency(struct SerialComClass *ser, bool enable);
+
+/**
+ * @brief Changes the baudrate of both the sensor and the host. The sensor is changed using
+ * the uart_baudrate setting, then communication is verified at the new rate. If verification fails,
+ * both are restored to the previous rate.
+ * @note The sensor must be initialized and using ser as its com class.
+ * @note This only changes the active rate. Use sensorCommitSettings to keep the rate across power cycles.
+ * @return TSS_SUCCESS or a TSS_ERR code
+ */
+TSS_API int serial_com_negotiate_baudrate(TSS_Sensor *sensor, struct SerialComClass *ser, uint32_t baudrate);
+
+/**
+ * @brief Finds every sensor on the available serial ports by probing all of them at the same time.
+ * 
+ * Up to num_coms ports are opened and probed together, using coms as the storage for each open port.
+ * If there are more ports than com classes, the remaining ports are probed in additional rounds.
+ * All ports are closed before returning, create and open a com class using the found port to use a sensor.
+ * 
+ * @param coms Com classes used while probing. Providing at least as many as there are ports gives the fastest discovery.
+ * @param num_coms Number of elements in coms
+ * @param out Filled with the port and serial number of each sensor found
+ * @param max_out Max number of elements in out
+ * @param timeout_ms Max time to wait on a round of ports to respond
+ * @return Number of sensors found or TSS_ERR_INVALID_SIZE if num_coms is 0
+ */
+TSS_API int serial_com_discover(struct SerialComClass *coms, uint8_t num_coms, struct SerialComDiscovery *out, uint8_t max_out, uint32_t timeout_ms);
+
+/**
+ * @brief Finds the port currently used by the USB device with the given serial number string, without opening any ports.
+ * @return 0 on success, non-zero if not found
+ */
+TSS_API int serial_com_find_usb_serial(const char *usb_serial, uint8_t *port);
+
+TSS_API void serial_com_port_cache_init(struct SerialComPortCache *cache);
+
+/**
+ * @brief Records the port the com class is connected to as the location of the sensor with the given serial number.
+ * If the cache is full, the oldest entry is replaced.
+ */
+TSS_API void serial_com_port_cache_update(struct SerialComPortCache *cache, uint64_t serial_number, const struct SerialComClass *ser);
+
+/**
+ * @brief Gets the most likely port of the sensor with the given serial number. If the USB serial
+ * of the device was cached, the port is relocated using it in case the device was assigned a new port.
+ * @return 0 on success, non-zero if the serial number is not in the cache
+ */
+TSS_API int serial_com_port_cache_lookup(const struct SerialComPortCache *cache, uint64_t serial_number, uint8_t *port);
+
+/**
+ * @brief Has reenumerating, such as by sensorReconnect, also try the port the cache has for the sensor
+ * with the given serial number before the remaining ports, and record the port the sensor is found on.
+ * The cache must remain valid while set. Pass NULL to stop using it.
+ */
+TSS_API void serial_com_set_port_cache(struct SerialComClass *ser, struct SerialComPortCache *cache, uint64_t serial_number);
+
+/**
+ * @brief Writes the cache to a text file, one entry per line. Read it back with serial_com_port_cache_load.
+ * @return 0 on success, non-zero if the file could not be written
+ */
+TSS_API int serial_com_port_cache_save(const struct SerialComPortCache *cache, const char *path);
+/**
+ * @brief Replaces the contents of the cache with a file written by serial_com_port_cache_save. Malformed lines are skipped.
+ * @return 0 on success, non-zero if the file could not be opened
+ */
+TSS_API int serial_com_port_cache_load(struct SerialComPortCache *cache, const char *path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,45 @@
+#ifndef __SIM_COM_CLASS_H__
+#define __SIM_COM_CLASS_H__
+
+#include "tss/com/managed_com.h"
+#include "tss/com/backend/sim/sim_sensor.h"
+#include "tss/export.h"
+
+/*
+*   A com class connected to a simulated sensor instead of hardware.
+*   Drives the full API stack without a sensor, at any data rate, for testing and benchmarking.
+*/
+
+struct SimComClass {
+    struct TSS_Managed_Com_Class base;
+    struct TSS_Com_Class sim_com;
+    struct SimSensor sensor;
+
+    uint32_t timeout_ms;
+    bool open;
+
+#if TSS_MINIMAL_SENSOR == 0
+    uint8_t read_buffer[4096];
+#endif
+
+#if TSS_BUFFERED_WRITES
+    uint8_t write_buffer[512];
+#endif
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialises a SimComClass and the simulated sensor behind it.
+ * The simulated sensor starts the same as a sensor that was just powered on.
+ * @param config The behavior of the simulated sensor, see struct SimSensorConfig. NULL uses defaults.
+ * @param out    Output struct to initialise. Must outlive all use of the com class.
+ */
+TSS_API void create_sim_com_class(const struct SimSensorConfig *config, struct SimComClass *out);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __SIM_COM_CLASS_H__ */
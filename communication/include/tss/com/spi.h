@@ -33,6 +33,19 @@ extern "C" {
  */
 TSS_API void create_spi_com_class(SpiPortId id, uint32_t speed_hz, struct SpiComClass *out);
 
+#if TSS_MINIMAL_SENSOR == 0
+/**
+ * @brief Runs one cycle of a shared SPI bus. Fills the read buffer of every com class
+ * that has data, serving the ones asserting Data Available first (see spiBusSchedule).
+ * Afterwards the sensor API can consume the buffered data without touching the bus,
+ * so one thread can service every sensor on the bus instead of one thread per sensor.
+ * @param coms The opened com classes on @p bus, at most SPI_BUS_MAX_DEVICES.
+ * @param timeout_ms Max time to wait for any com class to have data.
+ * @return The number of com classes serviced, or negative on error.
+ */
+TSS_API int spi_com_bus_update(struct SpiBus *bus, struct SpiComClass *const *coms, uint8_t count, uint32_t timeout_ms);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
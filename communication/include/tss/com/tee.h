@@ -0,0 +1,55 @@
+#ifndef __TEE_COM_CLASS_H__
+#define __TEE_COM_CLASS_H__
+
+#include "tss/com/managed_com.h"
+#include "tss/com/backend/capture/capture_file.h"
+#include "tss/export.h"
+
+/*
+*   A com class that passes everything through to another com class while recording
+*   every byte read and written, with when it happened, into a capture file.
+*   The capture can be fed back through the API with the replay com class to reproduce
+*   exactly what the sensor sent.
+*/
+
+struct TeeComClass {
+    struct TSS_Managed_Com_Class base;
+    struct TSS_Com_Class tee_com;
+
+    //The com class being captured. Owned by the caller.
+    struct TSS_Com_Class *inner;
+
+    const char *path;
+    struct CaptureWriter writer;
+
+    //Set once recording fails, such as when the disk is full. Data still passes through,
+    //but the capture stops at that point.
+    bool capture_failed;
+
+#if TSS_MINIMAL_SENSOR == 0
+    uint8_t read_buffer[4096];
+#endif
+
+#if TSS_BUFFERED_WRITES
+    uint8_t write_buffer[512];
+#endif
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialises a TeeComClass that captures all traffic of another com class.
+ * The capture file is created when the tee is opened, replacing any existing file, and finished when it is closed.
+ * @note The tee does not reenumerate, even if the inner com class does.
+ * @param inner The com class to pass through to. Opened and closed along with the tee. Must outlive the tee.
+ * @param path  Where to write the capture. Must outlive the tee.
+ * @param out   Output struct to initialise. Must outlive all use of the com class.
+ */
+TSS_API void create_tee_com_class(struct TSS_Com_Class *inner, const char *path, struct TeeComClass *out);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __TEE_COM_CLASS_H__ */
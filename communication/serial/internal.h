@@ -0,0 +1,15 @@
+#ifndef __SERIAL_COM_INTERNAL_H__
+#define __SERIAL_COM_INTERNAL_H__
+
+#include <stdint.h>
+
+//Every port found by serEnumeratePorts, in enumeration order
+struct SerialPortList {
+    uint8_t ports[256];
+    uint16_t count;
+};
+
+//Fills the list with every port currently available
+void serialPortListCollect(struct SerialPortList *list);
+
+#endif /* __SERIAL_COM_INTERNAL_H__ */
@@ -1,6 +1,7 @@
 #if defined(__linux__) || defined(unix)
 
 #include "tss/com/backend/serial/ser_device.h"
+#include "tss/sys/trace.h"
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -10,6 +11,18 @@
 #include <dirent.h>
 #include <stdlib.h>
 #include <poll.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+#if defined(__linux__)
+//Implemented in linux_serial_baud.c
+int serLinuxSetCustomBaudrate(int fd, uint32_t baudrate);
+#endif
 
 static speed_t to_baud(uint32_t baudrate)
 {
@@ -53,14 +66,15 @@ int serOpen(uint8_t port, uint32_t baudrate, struct SerialDevice *out)
         .fd = -1,
         .port = port,
         .timeout = 1000,
-        .blocking = true
+        .blocking = true,
+        .restore_latency_timer = -1
     };
 
     serPortToName(port, name, DEV_MAXNAME);
 
     int fd = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK);
     if(fd < 0) {
-        printf("Failed to open serial port %s: %s\n", name, strerror(errno));
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, errno, "serOpen: Failed to open serial port");
         return -1;
     }
     out->fd = fd;
@@ -72,9 +86,12 @@ int serOpen(uint8_t port, uint32_t baudrate, struct SerialDevice *out)
         return -1;
     }
 
+    //Non standard rates are applied after the rest of the configuration
     speed_t baud = to_baud(baudrate);
-    cfsetispeed(&tty, baud);
-    cfsetospeed(&tty, baud);
+    if(baud != B0) {
+        cfsetispeed(&tty, baud);
+        cfsetospeed(&tty, baud);
+    }
 
     // 8N1, raw mode
     tty.c_cflag &= ~(uint32_t)PARENB;           // No parity
@@ -101,12 +118,43 @@ int serOpen(uint8_t port, uint32_t baudrate, struct SerialDevice *out)
         return -1;
     }
 
+    if(baud == B0 && serSetBaudrate(out, baudrate) != 0) {
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, (int32_t)baudrate, "serOpen: Unsupported baudrate");
+        close(fd);
+        out->fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+int serSetBaudrate(struct SerialDevice *ser, uint32_t baudrate)
+{
+    struct termios tty;
+    speed_t baud;
+
+    if(ser->fd < 0) return -1;
+
+    baud = to_baud(baudrate);
+    if(baud == B0) {
+#if defined(__linux__)
+        return serLinuxSetCustomBaudrate(ser->fd, baudrate);
+#else
+        return -1;
+#endif
+    }
+
+    if(tcgetattr(ser->fd, &tty) != 0) return -1;
+    cfsetispeed(&tty, baud);
+    cfsetospeed(&tty, baud);
+    if(tcsetattr(ser->fd, TCSADRAIN, &tty) != 0) return -1;
     return 0;
 }
 
 void serClose(struct SerialDevice *ser)
 {
     if(ser->fd < 0) return;
+    serSetLowLatency(ser, false);
     close(ser->fd);
     ser->fd = -1;
 }
@@ -132,6 +180,54 @@ uint32_t serRead(struct SerialDevice *ser, char *buffer, uint32_t len)
     return (uint32_t)n;
 }
 
+#define SER_MAX_IOV 8
+
+uint32_t serReadVectored(struct SerialDevice *ser, const struct SerialBuffer *buffers, uint8_t count)
+{
+    struct iovec iov[SER_MAX_IOV];
+    uint32_t total = 0;
+
+    if(ser->fd < 0 || count == 0) return 0;
+    if(count > SER_MAX_IOV) count = SER_MAX_IOV;
+    for(uint8_t i = 0; i < count; i++) {
+        iov[i].iov_base = buffers[i].data;
+        iov[i].iov_len = buffers[i].len;
+        total += buffers[i].len;
+    }
+    if(total == 0) return 0;
+
+    struct pollfd pfd = { .fd = ser->fd, .events = POLLIN };
+    int timeout_ms = ser->blocking ? (int)ser->timeout : 0;
+    int ret = poll(&pfd, 1, timeout_ms);
+    if(ret <= 0) return 0;
+
+    ssize_t n = readv(ser->fd, iov, count);
+    if(n < 0) return 0;
+    return (uint32_t)n;
+}
+
+uint32_t serWriteVectored(struct SerialDevice *ser, const struct SerialBuffer *buffers, uint8_t count)
+{
+    struct iovec iov[SER_MAX_IOV];
+    uint32_t total = 0;
+    ssize_t n;
+
+    if(ser->fd < 0) return 0;
+    while(count > 0) {
+        uint8_t num_iov = (count > SER_MAX_IOV) ? SER_MAX_IOV : count;
+        for(uint8_t i = 0; i < num_iov; i++) {
+            iov[i].iov_base = buffers[i].data;
+            iov[i].iov_len = buffers[i].len;
+        }
+        n = writev(ser->fd, iov, num_iov);
+        if(n < 0) break;
+        total += (uint32_t)n;
+        buffers += num_iov;
+        count -= num_iov;
+    }
+    return total;
+}
+
 uint32_t serWrite(struct SerialDevice *ser, const char *buffer, uint32_t len)
 {
     if(len == 0 || ser->fd < 0) return 0;
@@ -146,6 +242,123 @@ void serClear(struct SerialDevice *ser)
     tcflush(ser->fd, TCIFLUSH);
 }
 
+int serWaitReadable(struct SerialDevice *const *devices, uint8_t count, bool *ready, uint32_t timeout_ms)
+{
+    struct pollfd fds[UINT8_MAX];
+    int result;
+
+    for(uint8_t i = 0; i < count; i++) {
+        fds[i] = (struct pollfd) { .fd = devices[i]->fd, .events = POLLIN };
+    }
+    result = poll(fds, count, (int)timeout_ms);
+    if(result < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    //A port that errored or hung up (unplugged) is reported as ready so it can be found, but fails the wait,
+    //otherwise poll keeps returning immediately for it and the caller spins until the timeout.
+    result = 0;
+    for(uint8_t i = 0; i < count; i++) {
+        ready[i] = (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) != 0;
+        if(ready[i]) result = -1;
+    }
+    if(result < 0) {
+        return result;
+    }
+    for(uint8_t i = 0; i < count; i++) {
+        ready[i] = (fds[i].revents & POLLIN) != 0;
+        if(ready[i]) result++;
+    }
+    return result;
+}
+
+//FTDI style USB serial adapters buffer data for up to latency_timer ms (default 16) before sending it to the host
+#define LOW_LATENCY_TIMER_MS 1
+
+static int latencyTimerPath(uint8_t port, char *out, size_t size)
+{
+    char name[32];
+    serPortToName(port, name, sizeof(name));
+    return snprintf(out, size, "/sys/class/tty/%s/device/latency_timer", name + 5) >= (int)size;
+}
+
+static int readLatencyTimer(uint8_t port)
+{
+    char path[128];
+    int value;
+    FILE *file;
+
+    if(latencyTimerPath(port, path, sizeof(path))) return -1;
+    file = fopen(path, "r");
+    if(file == NULL) return -1;
+    if(fscanf(file, "%d", &value) != 1) {
+        value = -1;
+    }
+    fclose(file);
+    return value;
+}
+
+static int writeLatencyTimer(uint8_t port, int value)
+{
+    char path[128];
+    FILE *file;
+
+    if(latencyTimerPath(port, path, sizeof(path))) return -1;
+    file = fopen(path, "w");
+    if(file == NULL) return -1;
+    fprintf(file, "%d", value);
+    return (fclose(file) == 0) ? 0 : -1;
+}
+
+uint8_t serSetLowLatency(struct SerialDevice *ser, bool enable)
+{
+    struct serial_struct serinfo;
+    int timer;
+
+    if(ser->fd < 0) return 0;
+
+    if(!enable) {
+        if(ser->restore_async_low_latency && ioctl(ser->fd, TIOCGSERIAL, &serinfo) == 0) {
+            serinfo.flags = (int)((unsigned)serinfo.flags & ~(unsigned)ASYNC_LOW_LATENCY);
+            ioctl(ser->fd, TIOCSSERIAL, &serinfo);
+        }
+        if(ser->restore_latency_timer >= 0) {
+            writeLatencyTimer(ser->port, ser->restore_latency_timer);
+        }
+        ser->restore_async_low_latency = false;
+        ser->restore_latency_timer = -1;
+        ser->low_latency = 0;
+        return 0;
+    }
+
+    //Tells the driver to push received data to the tty immediately instead of deferring it
+    if(!(ser->low_latency & SER_LOW_LATENCY_ASYNC) && ioctl(ser->fd, TIOCGSERIAL, &serinfo) == 0) {
+        if((unsigned)serinfo.flags & (unsigned)ASYNC_LOW_LATENCY) {
+            ser->low_latency |= SER_LOW_LATENCY_ASYNC;
+        }
+        else {
+            serinfo.flags = (int)((unsigned)serinfo.flags | (unsigned)ASYNC_LOW_LATENCY);
+            if(ioctl(ser->fd, TIOCSSERIAL, &serinfo) == 0) {
+                ser->low_latency |= SER_LOW_LATENCY_ASYNC;
+                ser->restore_async_low_latency = true;
+            }
+        }
+    }
+
+    //Only exists for FTDI adapters, and usually requires root or a udev rule to write
+    if(!(ser->low_latency & SER_LOW_LATENCY_TIMER)) {
+        timer = readLatencyTimer(ser->port);
+        if(timer >= 0 && timer <= LOW_LATENCY_TIMER_MS) {
+            ser->low_latency |= SER_LOW_LATENCY_TIMER;
+        }
+        else if(timer > 0 && writeLatencyTimer(ser->port, LOW_LATENCY_TIMER_MS) == 0) {
+            ser->low_latency |= SER_LOW_LATENCY_TIMER;
+            ser->restore_latency_timer = (int16_t)timer;
+        }
+    }
+
+    return ser->low_latency;
+}
+
 uint32_t serGetTimeout(const struct SerialDevice *ser)
 {
     if(!ser->blocking) return 0;
@@ -175,52 +388,200 @@ const char * serPortToName(uint8_t port, char *out, size_t size)
     return out;
 }
 
-uint8_t serEnumeratePorts(uint8_t (*cb)(const char *name, uint8_t port, void *user_data), void *user_data)
+int serGetUsbSerial(uint8_t port, char *out, size_t size)
 {
-    static const struct {
-        const char *prefix;
-        uint8_t offset;
-    } device_types[] = {
-        { "ttyUSB", 0   },   // port = suffix + 0   (range 0-127)
-        { "ttyACM", 128 },   // port = suffix + 128  (range 128-255)
-    };
-    static const size_t num_types = sizeof(device_types) / sizeof(device_types[0]);
+    char name[32], path[256], sys_path[PATH_MAX];
+    char *slash;
+    FILE *file;
+
+    if(size == 0) return -1;
+
+    //Skip past the "/dev/" to get the tty name
+    serPortToName(port, name, sizeof(name));
+    snprintf(path, sizeof(path), "/sys/class/tty/%s/device", name + 5);
+    if(realpath(path, sys_path) == NULL) return -1;
+
+    //cdc-acm devices link to the USB interface, usb-serial devices link to a child of the interface.
+    //Walk up the tree until reaching the USB device that has the serial attribute.
+    for(int i = 0; i < 4; i++) {
+        slash = strrchr(sys_path, '/');
+        if(slash == NULL || slash == sys_path) return -1;
+        *slash = '\0';
+
+        snprintf(path, sizeof(path), "%.240s/serial", sys_path);
+        file = fopen(path, "r");
+        if(file == NULL) continue;
+
+        if(fgets(out, (int)size, file) == NULL) {
+            fclose(file);
+            return -1;
+        }
+        fclose(file);
+        out[strcspn(out, "\r\n")] = '\0';
+        return 0;
+    }
+
+    return -1;
+}
+
+static const struct {
+    const char *prefix;
+    uint8_t offset;
+} m_device_types[] = {
+    { "ttyUSB", 0   },   // port = suffix + 0   (range 0-127)
+    { "ttyACM", 128 },   // port = suffix + 128  (range 128-255)
+};
+
+//Converts a device name, such as ttyUSB0, to its port number. Returns 0 on success.
+static int nameToPort(const char *name, uint8_t *port)
+{
+    static const size_t num_types = sizeof(m_device_types) / sizeof(m_device_types[0]);
+
+    for(size_t i = 0; i < num_types; i++) {
+        const char *prefix = m_device_types[i].prefix;
+        size_t prefix_len = strlen(prefix);
+
+        if(strncmp(name, prefix, prefix_len) != 0) continue;
 
+        const char *num_str = name + prefix_len;
+        char *end;
+        long num = strtol(num_str, &end, 10);
+        if(end == num_str || *end != '\0' || num < 0) return -1;
+
+        unsigned long encoded = (unsigned long)num + m_device_types[i].offset;
+        if(encoded > 255) return -1;
+
+        *port = (uint8_t)encoded;
+        return 0;
+    }
+    return -1;
+}
+
+uint8_t serEnumeratePorts(uint8_t (*cb)(const char *name, uint8_t port, void *user_data), void *user_data)
+{
     uint8_t ports_discovered = 0;
+    uint8_t port;
 
     DIR *dev_dir = opendir("/dev");
     if(!dev_dir) return 0;
 
     const struct dirent *entry;
     while((entry = readdir(dev_dir)) != NULL) {
-        for(size_t i = 0; i < num_types; i++) {
-            const char *prefix = device_types[i].prefix;
-            size_t prefix_len = strlen(prefix);
+        if(nameToPort(entry->d_name, &port) != 0) continue;
+
+        char full_path[64];
+        snprintf(full_path, sizeof(full_path), "/dev/%.58s", entry->d_name);
 
-            if(strncmp(entry->d_name, prefix, prefix_len) != 0) continue;
+        ports_discovered++;
+        if(cb(full_path, port, user_data) == SER_ENUM_STOP) {
+            closedir(dev_dir);
+            return ports_discovered;
+        }
+    }
+
+    closedir(dev_dir);
+    return ports_discovered;
+}
 
-            const char *num_str = entry->d_name + prefix_len;
-            char *end;
-            long num = strtol(num_str, &end, 10);
-            if(end == num_str || *end != '\0' || num < 0) break;
+int serHotplugOpen(struct SerialHotplugMonitor *out)
+{
+    //Group 1 is the kernel uevent broadcast, so no dependency on udev running or libudev
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_pid = 0,
+        .nl_groups = 1
+    };
 
-            unsigned long encoded = (unsigned long)num + device_types[i].offset;
-            if(encoded > 255) break;
+    out->fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if(out->fd < 0) {
+        return -1;
+    }
 
-            char full_path[64];
-            snprintf(full_path, sizeof(full_path), "/dev/%.58s", entry->d_name);
+    if(bind(out->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(out->fd);
+        out->fd = -1;
+        return -1;
+    }
 
-            ports_discovered++;
-            if(cb(full_path, (uint8_t)encoded, user_data) == SER_ENUM_STOP) {
-                closedir(dev_dir);
-                return ports_discovered;
-            }
-            break;
+    return 0;
+}
+
+void serHotplugClose(struct SerialHotplugMonitor *monitor)
+{
+    if(monitor->fd < 0) return;
+    close(monitor->fd);
+    monitor->fd = -1;
+}
+
+//Parses a single uevent message of the form "action@devpath\0KEY=VALUE\0KEY=VALUE\0..."
+static bool parseUevent(const char *msg, size_t len, uint8_t *event, uint8_t *port, const char **name)
+{
+    const char *action = NULL, *subsystem = NULL, *devname = NULL;
+    const char *cur = msg;
+    const char *end = msg + len;
+
+    //Skip the action@devpath summary, the key value pairs contain everything needed
+    cur += strnlen(cur, (size_t)(end - cur)) + 1;
+    while(cur < end) {
+        size_t field_len = strnlen(cur, (size_t)(end - cur));
+        if(strncmp(cur, "ACTION=", 7) == 0) action = cur + 7;
+        else if(strncmp(cur, "SUBSYSTEM=", 10) == 0) subsystem = cur + 10;
+        else if(strncmp(cur, "DEVNAME=", 8) == 0) devname = cur + 8;
+        cur += field_len + 1;
+    }
+
+    if(action == NULL || subsystem == NULL || devname == NULL) return false;
+    if(strcmp(subsystem, "tty") != 0) return false;
+
+    if(strcmp(action, "add") == 0) *event = SER_HOTPLUG_ADD;
+    else if(strcmp(action, "remove") == 0) *event = SER_HOTPLUG_REMOVE;
+    else return false;
+
+    //DEVNAME may or may not include the /dev/ prefix
+    if(strncmp(devname, "/dev/", 5) == 0) devname += 5;
+    if(nameToPort(devname, port) != 0) return false;
+
+    *name = devname;
+    return true;
+}
+
+int serHotplugUpdate(struct SerialHotplugMonitor *monitor, uint32_t timeout_ms, 
+    void (*cb)(uint8_t event, uint8_t port, const char *name, void *user_data), void *user_data)
+{
+    char buffer[4096];
+    struct sockaddr_nl sender;
+    socklen_t sender_len;
+    int num_events = 0;
+
+    if(monitor->fd < 0) return -1;
+
+    struct pollfd pfd = { .fd = monitor->fd, .events = POLLIN };
+    int result = poll(&pfd, 1, (int)timeout_ms);
+    if(result < 0) {
+        //Interrupted by a signal is the same as no events yet
+        return (errno == EINTR) ? 0 : -1;
+    }
+    if(result == 0) return 0;
+
+    //Process everything that is available
+    while(true) {
+        sender_len = sizeof(sender);
+        ssize_t len = recvfrom(monitor->fd, buffer, sizeof(buffer) - 1, 0, (struct sockaddr*)&sender, &sender_len);
+        if(len <= 0) break;
+        buffer[len] = '\0';
+
+        //Only trust messages that came from the kernel
+        if(sender_len != sizeof(sender) || sender.nl_pid != 0) continue;
+
+        uint8_t event, port;
+        const char *name;
+        if(parseUevent(buffer, (size_t)len, &event, &port, &name)) {
+            num_events++;
+            cb(event, port, name, user_data);
         }
     }
 
-    closedir(dev_dir);
-    return ports_discovered;
+    return num_events;
 }
 
 #endif /* __linux__ || unix */
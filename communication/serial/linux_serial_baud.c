@@ -0,0 +1,55 @@
+/*
+*   Arbitrary baudrate support for the Linux serial backend.
+*
+*   Kept separate from linux_serial.c because the kernel termios2 definitions
+*   conflict with the glibc <termios.h> used there.
+*/
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+int serLinuxSetCustomBaudrate(int fd, uint32_t baudrate);
+
+//Sets any baudrate the driver supports, not just the standard Bxxx rates. Returns 0 on success.
+int serLinuxSetCustomBaudrate(int fd, uint32_t baudrate)
+{
+    struct termios2 tty, saved;
+
+    if(ioctl(fd, TCGETS2, &tty) != 0) {
+        return -1;
+    }
+    saved = tty;
+
+    tty.c_cflag &= ~(tcflag_t)CBAUD;
+    tty.c_cflag |= BOTHER;
+    tty.c_ispeed = baudrate;
+    tty.c_ospeed = baudrate;
+
+    //Same as tcsetattr with TCSADRAIN, so pending output is sent at the old rate first
+    if(ioctl(fd, TCSETSW2, &tty) != 0) {
+        return -1;
+    }
+
+    //Drivers pick the closest rate they can generate, which is only known once applied.
+    //Reject it if too far off to communicate reliably, going back to the previous rate.
+    if(ioctl(fd, TCGETS2, &tty) != 0) {
+        ioctl(fd, TCSETS2, &saved);
+        return -1;
+    }
+    speed_t diff = (tty.c_ospeed > baudrate) ? tty.c_ospeed - baudrate : baudrate - tty.c_ospeed;
+    if(diff > baudrate / 50) {
+        ioctl(fd, TCSETS2, &saved);
+        return -1;
+    }
+
+    return 0;
+}
+
+#else
+
+/* Dummy variable to prevent empty translation unit warning under ISO C */
+typedef int tss_dummy_linux_serial_baud_tu;
+
+#endif /* __linux__ */
@@ -1,18 +1,26 @@
 #include "tss/com/serial.h"
+#include "internal.h"
 #include "tss/errors.h"
 #include "tss/sys/time.h"
+#include "tss/api/sensor.h"
 
 #include <stdbool.h>
+#include <string.h>
+
+//Matches the most pieces the core gathers a frame from
+#define SERIAL_COM_MAX_WRITE_IOV 16
 
 static int open(struct TSS_Com_Class *com);
 static int close(struct TSS_Com_Class *com);
 
 static int read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out);
+static int read_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
 
 static void set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
 uint32_t get_timeout(struct TSS_Com_Class *com);
 
 static int write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len);
+static int write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
 
 static int reenumerate(struct TSS_Com_Class *com, TssComAutoDetectCallback cb, void *detect_data);
 
@@ -26,6 +34,7 @@ static const struct TSS_Com_Class_API m_serial_com_api = {
     .in = {
         .read = read,
         .read_until = tssManagedComBaseReadUntil,
+        .read_vectored = read_vectored,
 
         .set_timeout = set_timeout,
         .get_timeout = get_timeout,
@@ -34,7 +43,8 @@ static const struct TSS_Com_Class_API m_serial_com_api = {
         .clear_timeout = tssManagedComBaseClearTimeout
     },
     .out = {
-        .write = write
+        .write = write,
+        .write_vectored = write_vectored
     },
 };
 
@@ -48,6 +58,7 @@ void create_serial_com_class(uint8_t port, struct SerialComClass *out)
         .port = {
             .port = port,
         },
+        .baudrate = SERIAL_COM_DEFAULT_BAUDRATE,
     };
 
     //Wrap it in the default functions
@@ -61,19 +72,106 @@ static int write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len)
     return 0;
 }
 
+static int write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    struct SerialComClass *self = (struct SerialComClass *)com;
+    struct SerialBuffer buffers[SERIAL_COM_MAX_WRITE_IOV];
+    uint8_t i, count;
+
+    while(iov_count > 0) {
+        count = (iov_count > SERIAL_COM_MAX_WRITE_IOV) ? SERIAL_COM_MAX_WRITE_IOV : iov_count;
+        for(i = 0; i < count; i++) {
+            buffers[i].data = iov[i].base;
+            buffers[i].len = (uint32_t)iov[i].len;
+        }
+        serWriteVectored(&self->port, buffers, count);
+        iov += count;
+        iov_count -= count;
+    }
+    return 0;
+}
+
 static int open(struct TSS_Com_Class *com)
 {
     struct SerialComClass *self = (struct SerialComClass *)com;
-    int result = serOpen(self->port.port, 115200, &self->port);
+    int result = serOpen(self->port.port, self->baudrate, &self->port);
     if(result) return result;
+    self->is_open = true;
+    if(self->low_latency) {
+        self->low_latency_applied = serSetLowLatency(&self->port, true);
+    }
     serConfigBufferSize(&self->port, 4096, 64);
+
+    //Remember what device this is so it can be found again if the port changes
+    if(serGetUsbSerial(self->port.port, self->usb_serial, sizeof(self->usb_serial))) {
+        self->usb_serial[0] = '\0';
+    }
+    return 0;
+}
+
+int serial_com_set_baudrate(struct SerialComClass *ser, uint32_t baudrate)
+{
+    int result;
+
+    //Only need to change the port now if it is open, otherwise will be used when opened
+    if(ser->is_open) {
+        result = serSetBaudrate(&ser->port, baudrate);
+        if(result) return result;
+    }
+    ser->baudrate = baudrate;
     return 0;
 }
 
+uint8_t serial_com_set_low_latency(struct SerialComClass *ser, bool enable)
+{
+    ser->low_latency = enable;
+    if(ser->is_open) {
+        ser->low_latency_applied = serSetLowLatency(&ser->port, enable);
+    }
+    return ser->low_latency_applied;
+}
+
+int serial_com_negotiate_baudrate(TSS_Sensor *sensor, struct SerialComClass *ser, uint32_t baudrate)
+{
+    uint32_t old_baudrate;
+    uint64_t serial_number;
+    int err;
+
+    old_baudrate = ser->baudrate;
+    if(baudrate == old_baudrate) return TSS_SUCCESS;
+
+    //Make sure the host supports the rate before changing the sensor
+    if(serial_com_set_baudrate(ser, baudrate) || serial_com_set_baudrate(ser, old_baudrate)) {
+        serial_com_set_baudrate(ser, old_baudrate);
+        return TSS_ERR_INVALID_SIZE;
+    }
+
+    //The sensor responds at the current rate, then switches
+    err = sensorWriteSettings(sensor, (const char*[]){"uart_baudrate"}, 1, (const void*[]){&baudrate});
+    if(err) return err;
+
+    serial_com_set_baudrate(ser, baudrate);
+    tss_com_clear_timeout(sensor->com, 5);
+
+    //Confirm communication still works at the new rate
+    err = sensorReadSerialNumber(sensor, &serial_number);
+    if(err == TSS_SUCCESS && serial_number == sensor->serial_number) {
+        return TSS_SUCCESS;
+    }
+
+    //Failed, go back to the old rate and make sure the sensor setting matches it again
+    serial_com_set_baudrate(ser, old_baudrate);
+    tss_com_clear_timeout(sensor->com, 5);
+    sensorWriteSettings(sensor, (const char*[]){"uart_baudrate"}, 1, (const void*[]){&old_baudrate});
+    return (err) ? err : TSS_ERR_DETECTION;
+}
+
 static int close(struct TSS_Com_Class *com)
 {
     struct SerialComClass *self = (struct SerialComClass *)com;
     serClose(&self->port);
+    self->is_open = false;
+    self->low_latency_applied = 0;
 
     return 0;
 }
@@ -84,6 +182,20 @@ static int read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out)
     return (int)serRead(&self->port, (char*)out, (uint32_t)num_bytes);
 }
 
+static int read_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    struct SerialComClass *self = (struct SerialComClass *)com;
+    struct SerialBuffer buffers[2];
+    uint8_t i;
+
+    //The managed com class only ever fills 2 segments of its ring
+    for(i = 0; i < iov_count && i < 2; i++) {
+        buffers[i].data = iov[i].base;
+        buffers[i].len = (uint32_t)iov[i].len;
+    }
+    return (int)serReadVectored(&self->port, buffers, i);
+}
+
 static void set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms)
 {
     struct SerialComClass *self = (struct SerialComClass *)com;
@@ -98,6 +210,10 @@ uint32_t get_timeout(struct TSS_Com_Class *com)
 
 struct PortEnumerate {
     struct TSS_Com_Class *out;
+    uint32_t baudrate;
+    bool low_latency;
+    struct SerialComPortCache *port_cache;
+    uint64_t port_cache_serial_number;
     TssComAutoDetectCallback cb;
     void *detect_data;
     int result;
@@ -111,6 +227,10 @@ static uint8_t auto_detect(const char *name, uint8_t port, void *detect_data)
     //TSS_Com_Class is the first element of  SerialComClass, so this is a valid cast
     struct SerialComClass *com = (struct SerialComClass*) params->out;
     create_serial_com_class(port, com);
+    com->baudrate = params->baudrate;
+    com->low_latency = params->low_latency;
+    com->port_cache = params->port_cache;
+    com->port_cache_serial_number = params->port_cache_serial_number;
 
     if(params->cb != NULL) {
         params->result = params->cb((struct TSS_Com_Class*)com, params->detect_data);
@@ -131,6 +251,7 @@ int serial_com_auto_detect(struct TSS_Com_Class *out, TssComAutoDetectCallback c
     //The serEnumerate is also implemented as a callback function, so have to wrap it
     struct PortEnumerate params = {
         .out = out,
+        .baudrate = SERIAL_COM_DEFAULT_BAUDRATE,
         .cb = cb,
         .detect_data = detect_data,
         .result = TSS_AUTO_DETECT_CONTINUE
@@ -143,7 +264,100 @@ int serial_com_auto_detect(struct TSS_Com_Class *out, TssComAutoDetectCallback c
     return params.result;
 }
 
+static uint8_t collect_port(const char *name, uint8_t port, void *user_data)
+{
+    (void) name;
+    struct SerialPortList *list = user_data;
+    list->ports[list->count++] = port;
+    return SER_ENUM_CONTINUE;
+}
+
+void serialPortListCollect(struct SerialPortList *list)
+{
+    list->count = 0;
+    serEnumeratePorts(collect_port, list);
+}
+
+//Returns the index after the moved port, or front if the port is not in the rest of the list
+static uint16_t move_port_to_front(struct SerialPortList *list, uint16_t front, uint8_t port)
+{
+    for(uint16_t i = front; i < list->count; i++) {
+        if(list->ports[i] == port) {
+            list->ports[i] = list->ports[front];
+            list->ports[front] = port;
+            return front + 1;
+        }
+    }
+    return front;
+}
+
+int serial_com_find_usb_serial(const char *usb_serial, uint8_t *port)
+{
+    struct SerialPortList list;
+    char cur_serial[SERIAL_COM_USB_SERIAL_MAX_LEN];
+
+    if(usb_serial[0] == '\0') return -1;
+
+    serialPortListCollect(&list);
+    for(uint16_t i = 0; i < list.count; i++) {
+        if(serGetUsbSerial(list.ports[i], cur_serial, sizeof(cur_serial)) == 0 && strcmp(cur_serial, usb_serial) == 0) {
+            *port = list.ports[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
 static int reenumerate(struct TSS_Com_Class *com, TssComAutoDetectCallback cb, void *detect_data)
 {
-    return serial_com_auto_detect(com, cb, detect_data);
-}
\ No newline at end of file
+    struct SerialComClass *self = (struct SerialComClass *)com;
+    struct SerialPortList list;
+    uint16_t i, num_first;
+    uint8_t port;
+
+    struct PortEnumerate params = {
+        .out = com,
+        .baudrate = self->baudrate,
+        .low_latency = self->low_latency,
+        .port_cache = self->port_cache,
+        .port_cache_serial_number = self->port_cache_serial_number,
+        .cb = cb,
+        .detect_data = detect_data,
+        .result = TSS_AUTO_DETECT_CONTINUE
+    };
+
+    serialPortListCollect(&list);
+
+    //Try the most likely ports first, before they are lost by recreating the com class while searching.
+    //First is wherever the same USB device is now, then the port last used, then where the cache last saw the sensor.
+    num_first = 0;
+    if(serial_com_find_usb_serial(self->usb_serial, &port) == 0) {
+        num_first = move_port_to_front(&list, num_first, port);
+    }
+    num_first = move_port_to_front(&list, num_first, self->port.port);
+    if(params.port_cache != NULL && serial_com_port_cache_lookup(params.port_cache, params.port_cache_serial_number, &port) == 0) {
+        move_port_to_front(&list, num_first, port);
+    }
+
+    for(i = 0; i < list.count; i++) {
+        char name[32];
+        serPortToName(list.ports[i], name, sizeof(name));
+        if(auto_detect(name, list.ports[i], &params) == SER_ENUM_STOP) {
+            break;
+        }
+    }
+
+    if(params.result == TSS_AUTO_DETECT_CONTINUE) {
+        return TSS_AUTO_DETECT_DONE;
+    }
+    if(params.result == TSS_AUTO_DETECT_SUCCESS && params.port_cache != NULL) {
+        serial_com_port_cache_update(params.port_cache, params.port_cache_serial_number, self);
+    }
+    return params.result;
+}
+
+void serial_com_set_port_cache(struct SerialComClass *ser, struct SerialComPortCache *cache, uint64_t serial_number)
+{
+    ser->port_cache = cache;
+    ser->port_cache_serial_number = serial_number;
+}
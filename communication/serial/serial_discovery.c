@@ -0,0 +1,262 @@
+/*
+*   Discovers all sensors connected over serial by probing every port at the same time.
+*
+*   Each open port is driven by a small state machine that is only ever polled with
+*   non blocking reads, so a port that is not a sensor only costs the shared timeout
+*   instead of a full tssInitSensor timeout per port. Between updates, the ports are
+*   waited on together and only the ones with new data are updated.
+*/
+#include "tss/com/serial.h"
+#include "internal.h"
+#include "tss/api/core.h"
+#include "tss/api/command.h"
+#include "tss/sys/endian.h"
+#include "tss/sys/stdinc.h"
+#include "tss/constants.h"
+#include "tss/errors.h"
+#include "tss/sys/time.h"
+
+#include <stdbool.h>
+
+//How long a port must be quiet after stopping streaming before probing it
+#define DISCOVERY_SETTLE_MS 5
+
+//"<KEY_ERROR>\0" + "\0" + checksum
+#define DISCOVERY_KEY_ERR_RESPONSE_LEN (TSS_BINARY_SETTINGS_ID_SIZE + TSS_SETTING_KEY_ERR_STRING_LEN + 3)
+//"serial_number\0" + U64 + "\0" + checksum
+#define DISCOVERY_SERIAL_RESPONSE_LEN (TSS_BINARY_SETTINGS_ID_SIZE + sizeof("serial_number") + 8 + 2)
+//Bootloader serial number is followed by a line feed
+#define DISCOVERY_BOOTLOADER_SERIAL_LEN 9
+
+enum ProbeState {
+    PROBE_STATE_SETTLE,
+    PROBE_STATE_DETECT,
+    PROBE_STATE_SERIAL,
+    PROBE_STATE_BOOTLOADER_SERIAL,
+    PROBE_STATE_DONE
+};
+
+struct PortProbe {
+    struct SerialComClass *ser;
+    enum ProbeState state;
+    tss_time_t last_data_time;
+    bool ready; //Has data to process
+};
+
+static void probe_start(struct PortProbe *probe)
+{
+    struct TSS_Com_Class *com = (struct TSS_Com_Class*)probe->ser;
+
+    //Same priming init uses for the bootloader baudrate detection
+    TSS_COM_BEGIN_WRITE(com);
+    tss_com_write(com, (uint8_t*)"UUU", 3);
+    TSS_COM_END_WRITE(com);
+
+    //Stop anything that could be outputting data. These have no response when sent without a header.
+    tssWriteCommand(com, false, tssGetCommand(86), NULL);
+    tssWriteCommand(com, false, tssGetCommand(181), NULL);
+    tssWriteCommand(com, false, tssGetCommand(61), NULL);
+
+    probe->state = PROBE_STATE_SETTLE;
+    probe->last_data_time = tssTimeGet();
+}
+
+//Advances the probe as far as it can with the data currently available.
+//Returns true when the probe has found a sensor.
+static bool probe_update(struct PortProbe *probe, struct SerialComDiscovery *out)
+{
+    struct TSS_Com_Class *com = (struct TSS_Com_Class*)probe->ser;
+    uint8_t buffer[DISCOVERY_KEY_ERR_RESPONSE_LEN];
+    size_t len;
+    uint32_t id;
+
+    len = tss_com_length(com);
+    switch(probe->state) {
+    case PROBE_STATE_SETTLE:
+        if(len > 0) {
+            tss_com_clear_immediate(com);
+            probe->last_data_time = tssTimeGet();
+        }
+        else if(tssTimeDiff(probe->last_data_time) >= DISCOVERY_SETTLE_MS) {
+            //Sending ? as a setting gives an instant error response in firmware and "OK" in the bootloader
+            tssGetSettingsWrite(com, true, "?");
+            probe->state = PROBE_STATE_DETECT;
+        }
+        break;
+
+    case PROBE_STATE_DETECT:
+        if(len < 2) break;
+        tss_com_peek(com, 0, 2, buffer);
+        if(buffer[0] == 'O' && buffer[1] == 'K') {
+            //Clear the remaining "OK" responses before asking for the serial number
+            tss_com_clear_immediate(com);
+            TSS_COM_BEGIN_WRITE(com);
+            tss_com_write(com, (uint8_t*)"Q", 1);
+            TSS_COM_END_WRITE(com);
+            probe->state = PROBE_STATE_BOOTLOADER_SERIAL;
+            break;
+        }
+        if(len < TSS_BINARY_SETTINGS_ID_SIZE) break;
+        tssPeekSettingsHeader(com, &id);
+        if(id != TSS_BINARY_READ_SETTINGS_ID) {
+            tss_com_read(com, 1, buffer); //Misaligned, discard a byte
+            break;
+        }
+        if(len < DISCOVERY_KEY_ERR_RESPONSE_LEN) break;
+        tss_com_read(com, DISCOVERY_KEY_ERR_RESPONSE_LEN, buffer);
+        tssGetSettingsWrite(com, true, "serial_number");
+        probe->state = PROBE_STATE_SERIAL;
+        break;
+
+    case PROBE_STATE_SERIAL:
+        if(len < TSS_BINARY_SETTINGS_ID_SIZE) break;
+        tssPeekSettingsHeader(com, &id);
+        if(id != TSS_BINARY_READ_SETTINGS_ID) {
+            tss_com_read(com, 1, buffer);
+            break;
+        }
+        if(len < DISCOVERY_SERIAL_RESPONSE_LEN) break;
+        //The full response is buffered, so these reads return immediately
+        tssReadSettingsHeader(com, &id);
+        if(tssGetSettingsRead(com, NULL, &out->serial_number) == TSS_SUCCESS) {
+            out->in_bootloader = false;
+            probe->state = PROBE_STATE_DONE;
+            return true;
+        }
+        probe->state = PROBE_STATE_DONE;
+        break;
+
+    case PROBE_STATE_BOOTLOADER_SERIAL:
+        if(len < DISCOVERY_BOOTLOADER_SERIAL_LEN) break;
+        tss_com_read(com, DISCOVERY_BOOTLOADER_SERIAL_LEN, buffer);
+        probe->state = PROBE_STATE_DONE;
+        if(buffer[8] != '\n') break;
+        //Bootloader works in Big Endian
+        memcpy(&out->serial_number, buffer, 8);
+        TSS_ENDIAN_SWAP_DEVICE_TO_BIG(&out->serial_number, 8);
+        out->in_bootloader = true;
+        return true;
+
+    case PROBE_STATE_DONE:
+        break;
+    }
+
+    return false;
+}
+
+//Updates the probe until the data available is used up.
+//Returns true when the probe has found a sensor.
+static bool probe_drain(struct PortProbe *probe, struct SerialComDiscovery *out)
+{
+    struct TSS_Com_Class *com = (struct TSS_Com_Class*)probe->ser;
+    enum ProbeState state;
+    size_t len;
+
+    do {
+        state = probe->state;
+        len = tss_com_length(com);
+        if(probe_update(probe, out)) return true;
+    } while(probe->state != PROBE_STATE_DONE && (probe->state != state || tss_com_length(com) != len));
+    return false;
+}
+
+//How long until the probe has to be updated even without new data
+static uint32_t probe_wait_time(const struct PortProbe *probe, uint32_t max_ms)
+{
+    uint32_t elapsed;
+    if(probe->state != PROBE_STATE_SETTLE) return max_ms;
+    elapsed = tssTimeDiff(probe->last_data_time);
+    if(elapsed >= DISCOVERY_SETTLE_MS) return 0;
+    return (DISCOVERY_SETTLE_MS - elapsed < max_ms) ? DISCOVERY_SETTLE_MS - elapsed : max_ms;
+}
+
+int serial_com_discover(struct SerialComClass *coms, uint8_t num_coms, struct SerialComDiscovery *out, uint8_t max_out, uint32_t timeout_ms)
+{
+    struct PortProbe probes[256];
+    struct SerialDevice *devices[256];
+    uint8_t pending[256];
+    bool ready[256];
+    struct SerialPortList list;
+    uint16_t next_port, i;
+    uint8_t num_found, num_active, num_pending;
+    uint32_t elapsed, wait_ms;
+    tss_time_t start_time;
+
+    if(num_coms == 0) return TSS_ERR_INVALID_SIZE;
+
+    serialPortListCollect(&list);
+
+    num_found = 0;
+    next_port = 0;
+    while(next_port < list.count && num_found < max_out) {
+        //Open as many ports as there are com classes to probe with at once
+        num_active = 0;
+        while(num_active < num_coms && next_port < list.count) {
+            struct SerialComClass *ser = &coms[num_active];
+            create_serial_com_class(list.ports[next_port++], ser);
+            if(tss_com_open((struct TSS_Com_Class*)ser)) continue;
+
+            probes[num_active].ser = ser;
+            probe_start(&probes[num_active]);
+            num_active++;
+        }
+
+        //Update every open port until all are done or out of time. Only ports with new data,
+        //or waiting to settle, are updated, and the rest of the time is spent waiting on all of them.
+        start_time = tssTimeGet();
+        for(i = 0; i < num_active; i++) {
+            probes[i].ready = true;
+        }
+        while(true) {
+            num_pending = 0;
+            for(i = 0; i < num_active; i++) {
+                if(probes[i].state == PROBE_STATE_DONE) continue;
+                if(num_found >= max_out) {
+                    probes[i].state = PROBE_STATE_DONE;
+                    continue;
+                }
+                if(probes[i].ready || probe_wait_time(&probes[i], 1) == 0) {
+                    out[num_found].port = probes[i].ser->port.port;
+                    if(probe_drain(&probes[i], &out[num_found])) {
+                        num_found++;
+                    }
+                }
+                if(probes[i].state != PROBE_STATE_DONE) {
+                    pending[num_pending++] = (uint8_t)i;
+                }
+            }
+
+            elapsed = tssTimeDiff(start_time);
+            if(num_pending == 0 || elapsed >= timeout_ms) break;
+
+            wait_ms = timeout_ms - elapsed;
+            for(i = 0; i < num_pending; i++) {
+                probes[pending[i]].ready = false;
+                devices[i] = &probes[pending[i]].ser->port;
+                wait_ms = probe_wait_time(&probes[pending[i]], wait_ms);
+            }
+            memset(ready, 0, sizeof(ready[0]) * num_pending);
+            if(serWaitReadable(devices, num_pending, ready, wait_ms) < 0) {
+                //Stop probing the ports that failed, and only give up on the round if none are known to have
+                bool any_failed = false;
+                for(i = 0; i < num_pending; i++) {
+                    if(ready[i]) {
+                        probes[pending[i]].state = PROBE_STATE_DONE;
+                        any_failed = true;
+                    }
+                }
+                if(!any_failed) break;
+                continue;
+            }
+            for(i = 0; i < num_pending; i++) {
+                probes[pending[i]].ready = ready[i];
+            }
+        }
+
+        for(i = 0; i < num_active; i++) {
+            tss_com_close((struct TSS_Com_Class*)probes[i].ser);
+        }
+    }
+
+    return num_found;
+}
@@ -0,0 +1,116 @@
+/*
+*   Map from sensor serial numbers to the serial port they were last found on.
+*   Allows connecting to a known sensor by trying its likely port before searching every port.
+*/
+#include "tss/com/serial.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+//Written in place of the USB serial when it is unknown, so every line has the same number of fields
+#define EMPTY_USB_SERIAL "-"
+
+void serial_com_port_cache_init(struct SerialComPortCache *cache)
+{
+    cache->count = 0;
+}
+
+static struct SerialComPortCacheEntry* find_entry(const struct SerialComPortCache *cache, uint64_t serial_number)
+{
+    for(uint8_t i = 0; i < cache->count; i++) {
+        if(cache->entries[i].serial_number == serial_number) {
+            return (struct SerialComPortCacheEntry*)&cache->entries[i];
+        }
+    }
+    return NULL;
+}
+
+void serial_com_port_cache_update(struct SerialComPortCache *cache, uint64_t serial_number, const struct SerialComClass *ser)
+{
+    struct SerialComPortCacheEntry *entry;
+
+    entry = find_entry(cache, serial_number);
+    if(entry == NULL) {
+        if(cache->count == SERIAL_COM_PORT_CACHE_MAX_ENTRIES) {
+            //Full, drop the oldest entry
+            memmove(&cache->entries[0], &cache->entries[1], sizeof(cache->entries[0]) * (SERIAL_COM_PORT_CACHE_MAX_ENTRIES - 1));
+            cache->count--;
+        }
+        entry = &cache->entries[cache->count++];
+    }
+
+    entry->serial_number = serial_number;
+    entry->port = ser->port.port;
+    memcpy(entry->usb_serial, ser->usb_serial, sizeof(entry->usb_serial));
+    entry->usb_serial[sizeof(entry->usb_serial) - 1] = '\0';
+}
+
+int serial_com_port_cache_lookup(const struct SerialComPortCache *cache, uint64_t serial_number, uint8_t *port)
+{
+    const struct SerialComPortCacheEntry *entry;
+
+    entry = find_entry(cache, serial_number);
+    if(entry == NULL) return -1;
+
+    //The device may have been given a different port since it was cached
+    if(serial_com_find_usb_serial(entry->usb_serial, port) == 0) {
+        return 0;
+    }
+    *port = entry->port;
+    return 0;
+}
+
+int serial_com_port_cache_save(const struct SerialComPortCache *cache, const char *path)
+{
+    FILE *file;
+
+    file = fopen(path, "w");
+    if(file == NULL) return -1;
+
+    //One entry per line: <serial number hex> <port> <usb serial>
+    for(uint8_t i = 0; i < cache->count; i++) {
+        const struct SerialComPortCacheEntry *entry = &cache->entries[i];
+        fprintf(file, "%016" PRIX64 " %u %s\n", entry->serial_number, (unsigned)entry->port,
+            (entry->usb_serial[0] != '\0') ? entry->usb_serial : EMPTY_USB_SERIAL);
+    }
+
+    if(fclose(file) != 0) return -1;
+    return 0;
+}
+
+int serial_com_port_cache_load(struct SerialComPortCache *cache, const char *path)
+{
+    struct SerialComPortCacheEntry entry;
+    char line[128];
+    unsigned port;
+    int usb_serial_start;
+    size_t len;
+    FILE *file;
+
+    file = fopen(path, "r");
+    if(file == NULL) return -1;
+
+    serial_com_port_cache_init(cache);
+    while(cache->count < SERIAL_COM_PORT_CACHE_MAX_ENTRIES && fgets(line, sizeof(line), file) != NULL) {
+        //The USB serial is the rest of the line, since it may contain spaces
+        usb_serial_start = 0;
+        if(sscanf(line, "%" SCNx64 " %u%n", &entry.serial_number, &port, &usb_serial_start) != 2 || port > 255 || line[usb_serial_start] != ' ') {
+            continue; //Skip malformed lines
+        }
+        len = strcspn(&line[usb_serial_start + 1], "\r\n");
+        if(len == 0 || len >= sizeof(entry.usb_serial)) {
+            continue;
+        }
+        memcpy(entry.usb_serial, &line[usb_serial_start + 1], len);
+        entry.usb_serial[len] = '\0';
+        if(strcmp(entry.usb_serial, EMPTY_USB_SERIAL) == 0) {
+            entry.usb_serial[0] = '\0';
+        }
+        entry.port = (uint8_t)port;
+        cache->entries[cache->count++] = entry;
+    }
+
+    fclose(file);
+    return 0;
+}
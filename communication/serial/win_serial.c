@@ -1,5 +1,6 @@
 #if defined(_WIN32) || defined(_WIN64)
 #include "tss/com/backend/serial/ser_device.h"
+#include "tss/sys/trace.h"
 #include <windows.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -24,7 +25,7 @@ int serOpen(uint8_t port, uint32_t baudrate, struct SerialDevice *out)
     //Open the port
     handle = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
     if(handle == INVALID_HANDLE_VALUE) {
-        printf("Failed to open serial port %s with error %d.\n", name, GetLastError());
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, (int32_t)GetLastError(), "serOpen: Failed to open serial port");
         return -1;
     };
     out->handle = handle;
@@ -61,6 +62,20 @@ void serClose(struct SerialDevice *ser)
     ser->handle = 0;
 }
 
+int serSetBaudrate(struct SerialDevice *ser, uint32_t baudrate)
+{
+    DCB config;
+    if(!ser->handle) {
+        return -1;
+    }
+    FlushFileBuffers(ser->handle);
+    if(GetCommState(ser->handle, &config) == 0) {
+        return -1;
+    }
+    config.BaudRate = baudrate;
+    return !SetCommState(ser->handle, &config);
+}
+
 int serConfigBufferSize(struct SerialDevice *ser, uint32_t in_size, uint32_t out_size)
 {
     return !SetupComm(ser->handle, in_size, out_size);
@@ -100,6 +115,28 @@ uint32_t serRead(struct SerialDevice *ser, char *buffer, uint32_t len)
     return num_read;
 }
 
+uint32_t serReadVectored(struct SerialDevice *ser, const struct SerialBuffer *buffers, uint8_t count)
+{
+    uint32_t total = 0;
+    for(uint8_t i = 0; i < count; i++) {
+        uint32_t num_read = serRead(ser, buffers[i].data, buffers[i].len);
+        total += num_read;
+        if(num_read < buffers[i].len) break;
+    }
+    return total;
+}
+
+uint32_t serWriteVectored(struct SerialDevice *ser, const struct SerialBuffer *buffers, uint8_t count)
+{
+    uint32_t total = 0;
+    for(uint8_t i = 0; i < count; i++) {
+        uint32_t num_written = serWrite(ser, buffers[i].data, buffers[i].len);
+        total += num_written;
+        if(num_written < buffers[i].len) break;
+    }
+    return total;
+}
+
 uint32_t serWrite(struct SerialDevice *ser, const char *buffer, uint32_t len)
 {
     if(len == 0) return 0;
@@ -123,6 +160,33 @@ void serClear(struct SerialDevice *ser)
     PurgeComm(ser->handle, PURGE_RXCLEAR);
 }
 
+int serWaitReadable(struct SerialDevice *const *devices, uint8_t count, bool *ready, uint32_t timeout_ms)
+{
+    ULONGLONG start = GetTickCount64();
+    DWORD flags;
+    COMSTAT comstat;
+    int num_ready;
+
+    //Overlapped reads are tied to a single port, so check the input queues and sleep between checks
+    while(true) {
+        num_ready = 0;
+        for(uint8_t i = 0; i < count; i++) {
+            if(!ClearCommError(devices[i]->handle, &flags, &comstat)) {
+                for(uint8_t j = 0; j < count; j++) {
+                    ready[j] = (j == i);
+                }
+                return -1;
+            }
+            ready[i] = comstat.cbInQue > 0;
+            if(ready[i]) num_ready++;
+        }
+        if(num_ready > 0 || GetTickCount64() - start >= timeout_ms) {
+            return num_ready;
+        }
+        Sleep(1);
+    }
+}
+
 static void serSetActualTimeout(struct SerialDevice *ser, uint32_t timeout_ms)
 {
     COMMTIMEOUTS timeouts;
@@ -140,6 +204,13 @@ static void serSetActualTimeout(struct SerialDevice *ser, uint32_t timeout_ms)
     SetCommTimeouts(ser->handle, &timeouts);
 }
 
+uint8_t serSetLowLatency(struct SerialDevice *ser, bool enable)
+{
+    //The FTDI latency timer is only configurable through the driver settings on Windows
+    (void)ser; (void)enable;
+    return 0;
+}
+
 uint32_t serGetTimeout(const struct SerialDevice *ser)
 {
     if(!ser->blocking) return 0;
@@ -169,6 +240,13 @@ const char * serPortToName(uint8_t port, char *out, size_t size)
     return out;
 }
 
+int serGetUsbSerial(uint8_t port, char *out, size_t size)
+{
+    //Not supported, always falls back to searching every port
+    (void)port; (void)out; (void)size;
+    return -1;
+}
+
 static const char * findPattern(const char ** string, const char * pattern, int * value)
 {
     char n = 0;
@@ -0,0 +1,145 @@
+#include "tss/com/sim.h"
+#include "tss/errors.h"
+
+#include <time.h>
+
+#define SIM_COM_DEFAULT_TIMEOUT_MS 1000
+
+//Longest a blocked read sleeps before checking for output again
+#define SIM_COM_MAX_SLEEP_US 1000
+
+static int sim_open(struct TSS_Com_Class *com);
+static int sim_close(struct TSS_Com_Class *com);
+
+static int sim_read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out);
+
+static void sim_set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
+static uint32_t sim_get_timeout(struct TSS_Com_Class *com);
+
+static int sim_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len);
+static int sim_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
+
+static const struct TSS_Com_Class_API m_sim_com_api = {
+    .open  = sim_open,
+    .close = sim_close,
+
+    //There is no port that can change
+    .reenumerate = NULL,
+    .auto_detect = NULL,
+
+    .in = {
+        .read       = sim_read,
+        .read_until = tssManagedComBaseReadUntil,
+
+        .set_timeout     = sim_set_timeout,
+        .get_timeout     = sim_get_timeout,
+
+        .clear_immediate = tssManagedComBaseClear,
+        .clear_timeout   = tssManagedComBaseClearTimeout,
+    },
+    .out = {
+        .write = sim_write,
+        .write_vectored = sim_write_vectored,
+    },
+};
+
+void create_sim_com_class(const struct SimSensorConfig *config, struct SimComClass *out)
+{
+    *out = (struct SimComClass) {
+        .sim_com = (struct TSS_Com_Class) {
+            .api          = &m_sim_com_api,
+            .reenumerates = false,
+        },
+        .timeout_ms = SIM_COM_DEFAULT_TIMEOUT_MS,
+    };
+    simSensorInit(&out->sensor, config);
+
+    tssCreateManagedCom(
+        &out->sim_com,
+        (struct TSS_Com_Class *)out,
+        out->read_buffer,  sizeof(out->read_buffer),
+        out->write_buffer, sizeof(out->write_buffer),
+        &out->base
+    );
+}
+
+static int sim_open(struct TSS_Com_Class *com)
+{
+    struct SimComClass *self = (struct SimComClass *)com;
+    self->open = true;
+    return 0;
+}
+
+static int sim_close(struct TSS_Com_Class *com)
+{
+    struct SimComClass *self = (struct SimComClass *)com;
+    self->open = false;
+    return 0;
+}
+
+static void sleep_us(uint64_t us)
+{
+    struct timespec ts = {
+        .tv_sec = (time_t)(us / 1000000),
+        .tv_nsec = (long)(us % 1000000) * 1000
+    };
+    nanosleep(&ts, NULL);
+}
+
+static int sim_read(struct TSS_Com_Class *com, size_t num_bytes, uint8_t *out)
+{
+    struct SimComClass *self = (struct SimComClass *)com;
+    uint64_t start_us, elapsed_us, timeout_us, wait_us;
+    size_t total;
+
+    if(!self->open) return TSS_ERR_READ;
+
+    start_us = simSensorTimeUs();
+    timeout_us = (uint64_t)self->timeout_ms * 1000;
+    total = 0;
+    while(true) {
+        simSensorUpdate(&self->sensor);
+        total += simSensorRead(&self->sensor, out + total, num_bytes - total);
+        if(total == num_bytes) break;
+
+        //Nothing else can produce data while blocked here, so sleep until the sensor next outputs
+        elapsed_us = simSensorTimeUs() - start_us;
+        if(elapsed_us >= timeout_us) break;
+        wait_us = simSensorNextOutputUs(&self->sensor);
+        if(wait_us > timeout_us - elapsed_us) wait_us = timeout_us - elapsed_us;
+        if(wait_us > SIM_COM_MAX_SLEEP_US) wait_us = SIM_COM_MAX_SLEEP_US;
+        if(wait_us > 0) sleep_us(wait_us);
+    }
+
+    return (int)total;
+}
+
+static void sim_set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms)
+{
+    struct SimComClass *self = (struct SimComClass *)com;
+    self->timeout_ms = timeout_ms;
+}
+
+static uint32_t sim_get_timeout(struct TSS_Com_Class *com)
+{
+    struct SimComClass *self = (struct SimComClass *)com;
+    return self->timeout_ms;
+}
+
+static int sim_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len)
+{
+    struct SimComClass *self = (struct SimComClass *)com;
+    if(!self->open) return TSS_ERR_WRITE;
+    simSensorWrite(&self->sensor, bytes, len);
+    return 0;
+}
+
+static int sim_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    struct SimComClass *self = (struct SimComClass *)com;
+    if(!self->open) return TSS_ERR_WRITE;
+    for(uint8_t i = 0; i < iov_count; i++) {
+        simSensorWrite(&self->sensor, iov[i].base, iov[i].len);
+    }
+    return 0;
+}
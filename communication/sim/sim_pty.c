@@ -0,0 +1,244 @@
+/*
+*   Serves a simulated sensor on a pseudo terminal, so the real serial com class
+*   can be pointed at it as if it were a sensor plugged in over USB.
+*
+*   The slave side of the pseudo terminal is printed on startup. Giving a port number
+*   also links the name the serial com class uses for that port to the slave, so
+*   create_serial_com_class and port enumeration find it:
+*
+*       tss_sim_pty -p 10          (create_serial_com_class(10, ...) opens /dev/ttyUSB10)
+*
+*   Everything the serial backend does, including termios, polling and enumeration, then
+*   runs unchanged against a sensor with a known, controllable load.
+*/
+#define _GNU_SOURCE
+
+#include "tss/com/backend/sim/sim_sensor.h"
+#include "tss/com/backend/serial/ser_device.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#define SIM_PTY_IO_BUFFER_SIZE 4096
+
+//Longest poll while nothing is scheduled, so the stats interval is still honored
+#define SIM_PTY_IDLE_POLL_US 100000
+
+static volatile sig_atomic_t m_running = 1;
+
+static void onSignal(int signal)
+{
+    (void) signal;
+    m_running = 0;
+}
+
+static void printUsage(const char *name)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -p <port>      Link the serial com class name for this port to the pseudo terminal\n"
+        "  -l <path>      Link this path to the pseudo terminal\n"
+        "  -s <serial>    Serial number, in hex\n"
+        "  -u             Stream unthrottled, as fast as the host reads\n"
+        "  -d <hz>        Debug messages per second while debug_mode is 1\n"
+        "  -c <interval>  Corrupt one bit in every this many output bytes\n"
+        "  -r <seed>      Seed for the corruption\n"
+        "  -b             Start in the bootloader\n"
+        "  -i <seconds>   Print stats every this many seconds\n",
+        name);
+}
+
+static void printStats(const struct SimSensor *sim)
+{
+    const struct SimSensorStats *stats = &sim->stats;
+    fprintf(stderr,
+        "in: %" PRIu64 " out: %" PRIu64 " commands: %" PRIu32 " settings r/w: %" PRIu32 "/%" PRIu32
+        " packets: %" PRIu64 " dropped: %" PRIu64 " debug: %" PRIu32 " corrupted: %" PRIu32 " firmware: %" PRIu64 "\n",
+        stats->bytes_in, stats->bytes_out, stats->commands, stats->settings_reads, stats->settings_writes,
+        stats->packets_streamed, stats->packets_dropped, stats->debug_messages, stats->bytes_corrupted, stats->firmware_bytes);
+}
+
+//Opens the master side of a new pseudo terminal. Also returns an open slave fd, which must be kept
+//open so the master does not report a hang up every time the host closes its side.
+static int openPty(int *master_out, int *slave_out, char *slave_name, size_t size)
+{
+    struct termios tty;
+    const char *name;
+    int master, slave;
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0) return -1;
+    if(grantpt(master) != 0 || unlockpt(master) != 0 || (name = ptsname(master)) == NULL) {
+        close(master);
+        return -1;
+    }
+    snprintf(slave_name, size, "%s", name);
+
+    slave = open(slave_name, O_RDWR | O_NOCTTY);
+    if(slave < 0) {
+        close(master);
+        return -1;
+    }
+
+    //Raw until the host configures it, so nothing is echoed or translated back to the host
+    if(tcgetattr(slave, &tty) == 0) {
+        cfmakeraw(&tty);
+        tcsetattr(slave, TCSANOW, &tty);
+    }
+
+    //Output is queued in the simulated sensor while the host is not reading
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    *master_out = master;
+    *slave_out = slave;
+    return 0;
+}
+
+static int createLink(const char *link_path, const char *target)
+{
+    struct stat info;
+
+    //Only replace a previous link, never a real device
+    if(lstat(link_path, &info) == 0) {
+        if(!S_ISLNK(info.st_mode)) {
+            fprintf(stderr, "%s already exists and is not a link\n", link_path);
+            return -1;
+        }
+        unlink(link_path);
+    }
+    if(symlink(target, link_path) != 0) {
+        fprintf(stderr, "Failed to link %s: %s\n", link_path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct SimSensorConfig config = {0};
+    struct SimSensor *sim;
+    struct sigaction action;
+    struct pollfd pfd;
+    struct timespec timeout;
+    uint8_t in[SIM_PTY_IO_BUFFER_SIZE], out[SIM_PTY_IO_BUFFER_SIZE];
+    char slave_name[64], port_name[64];
+    const char *link_path = NULL;
+    uint64_t wait_us, stats_interval_us = 0, next_stats_us = 0;
+    size_t out_len = 0, out_index = 0;
+    ssize_t result;
+    int master, slave, port, opt;
+
+    while((opt = getopt(argc, argv, "p:l:s:ud:c:r:bi:h")) != -1) {
+        switch(opt) {
+        case 'p':
+            port = atoi(optarg);
+            if(port < 0 || port > 255) {
+                fprintf(stderr, "Port must be 0-255\n");
+                return 1;
+            }
+            link_path = serPortToName((uint8_t)port, port_name, sizeof(port_name));
+            break;
+        case 'l': link_path = optarg; break;
+        case 's': config.serial_number = strtoull(optarg, NULL, 16); break;
+        case 'u': config.unthrottled = true; break;
+        case 'd': config.debug_message_hz = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'c': config.corrupt_interval = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'r': config.seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+        case 'b': config.start_in_bootloader = true; break;
+        case 'i': stats_interval_us = strtoull(optarg, NULL, 10) * 1000000ull; break;
+        default:
+            printUsage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    //Too large for the stack
+    sim = malloc(sizeof(*sim));
+    if(sim == NULL) return 1;
+    simSensorInit(sim, &config);
+
+    if(openPty(&master, &slave, slave_name, sizeof(slave_name)) != 0) {
+        fprintf(stderr, "Failed to create pseudo terminal: %s\n", strerror(errno));
+        free(sim);
+        return 1;
+    }
+    if(link_path != NULL && createLink(link_path, slave_name) != 0) {
+        link_path = NULL;
+        m_running = 0;
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    if(m_running) {
+        printf("%s\n", (link_path != NULL) ? link_path : slave_name);
+        fflush(stdout);
+    }
+    next_stats_us = simSensorTimeUs() + stats_interval_us;
+
+    while(m_running) {
+        //Pass along whatever the sensor has output, keeping what the pseudo terminal can't take yet
+        simSensorUpdate(sim);
+        if(out_index == out_len) {
+            out_len = simSensorRead(sim, out, sizeof(out));
+            out_index = 0;
+        }
+        while(out_index < out_len) {
+            result = write(master, out + out_index, out_len - out_index);
+            if(result <= 0) break;
+            out_index += (size_t)result;
+        }
+
+        //Wait for the host to send something, or for the sensor to have more to output
+        pfd.fd = master;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if(out_index < out_len) {
+            pfd.events |= POLLOUT;
+            wait_us = SIM_PTY_IDLE_POLL_US;
+        }
+        else {
+            wait_us = simSensorNextOutputUs(sim);
+            if(wait_us > SIM_PTY_IDLE_POLL_US) wait_us = SIM_PTY_IDLE_POLL_US;
+        }
+        timeout.tv_sec = (time_t)(wait_us / 1000000);
+        timeout.tv_nsec = (long)(wait_us % 1000000) * 1000;
+        if(ppoll(&pfd, 1, &timeout, NULL) < 0 && errno != EINTR) {
+            fprintf(stderr, "poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if(pfd.revents & POLLIN) {
+            result = read(master, in, sizeof(in));
+            if(result > 0) {
+                simSensorWrite(sim, in, (size_t)result);
+            }
+        }
+
+        if(stats_interval_us > 0 && simSensorTimeUs() >= next_stats_us) {
+            printStats(sim);
+            next_stats_us += stats_interval_us;
+        }
+    }
+
+    printStats(sim);
+    if(link_path != NULL) {
+        unlink(link_path);
+    }
+    close(slave);
+    close(master);
+    free(sim);
+    return 0;
+}
@@ -0,0 +1,1033 @@
+/*
+*   In memory emulation of a 3-Space sensor running firmware or its bootloader.
+*
+*   Everything is produced synchronously from the caller's thread. Requests are answered
+*   the moment their last byte is written, and streaming packets and debug messages are
+*   generated from elapsed time whenever simSensorUpdate is called. File streaming is
+*   generated the same way, from the file position the host left the cursor at.
+*/
+#include "tss/com/backend/sim/sim_sensor.h"
+#include "tss/api/command.h"
+#include "tss/api/header.h"
+#include "tss/sys/config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define SIM_DEFAULT_SERIAL_NUMBER 0x0000000100000001ull
+#define SIM_DEFAULT_STREAM_INTERVAL_US 10000 //100Hz
+#define SIM_STRING_OUTPUT "sim"
+
+//Any non zero error is a failure to the host
+#define SIM_SETTING_ERR_KEY 1
+#define SIM_SETTING_ERR_VALUE 2
+
+//Write settings requests with more keys than this are rejected
+#define SIM_MAX_WRITE_KEYS 32
+
+//Reported by the bootloader info request
+#define SIM_BOOTLOADER_MEM_START 0x00008000u
+#define SIM_BOOTLOADER_MEM_END   0x0007FFFFu
+#define SIM_BOOTLOADER_PAGE_SIZE 2048
+#define SIM_BOOTLOADER_VERSION   1
+
+//How many packets can be owed before they are counted as dropped without being generated
+#define SIM_MAX_STREAM_CATCHUP (SIM_SENSOR_OUT_BUFFER_SIZE / 16)
+
+static const char * const K_HEADER_BIT_KEYS[] = {
+    "header_status", "header_timestamp", "header_echo", "header_checksum", "header_serial", "header_length"
+};
+
+//----------------------------------------HELPERS------------------------------------------------
+
+uint64_t simSensorTimeUs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000ull + (uint64_t)now.tv_nsec / 1000ull;
+}
+
+static uint32_t nextRand(struct SimSensor *sim)
+{
+    //xorshift32, must never be seeded with 0
+    uint32_t x = sim->rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->rand_state = x;
+    return x;
+}
+
+static void putLittleEndian(uint8_t *out, uint64_t value, uint16_t size)
+{
+    for(uint16_t i = 0; i < size; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t getLittleEndian(const uint8_t *data, uint16_t size)
+{
+    uint64_t value = 0;
+    for(uint16_t i = 0; i < size && i < 8; i++) {
+        value |= (uint64_t)data[i] << (8 * i);
+    }
+    return value;
+}
+
+static void putBigEndian(uint8_t *out, uint64_t value, uint16_t size)
+{
+    for(uint16_t i = 0; i < size; i++) {
+        out[i] = (uint8_t)(value >> (8 * (size - 1 - i)));
+    }
+}
+
+static uint8_t sumBytes(const uint8_t *data, size_t len)
+{
+    uint8_t checksum = 0;
+    for(size_t i = 0; i < len; i++) {
+        checksum += data[i];
+    }
+    return checksum;
+}
+
+static bool keyEquals(const char *a, const char *b)
+{
+    while(*a != '\0' && *b != '\0') {
+        char ca = (*a >= 'A' && *a <= 'Z') ? (char)(*a - 'A' + 'a') : *a;
+        char cb = (*b >= 'A' && *b <= 'Z') ? (char)(*b - 'A' + 'a') : *b;
+        if(ca != cb) return false;
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+//Length of the parameters at data in the given format. -1 if data does not contain all of them yet.
+static int paramsLength(const struct TSS_Param *param, const uint8_t *data, size_t len)
+{
+    size_t total = 0;
+    const uint8_t *end;
+
+    if(param == NULL) return 0;
+    for(; !TSS_PARAM_IS_NULL(param); param++) {
+        if(TSS_PARAM_IS_STRING(param)) {
+            for(uint8_t i = 0; i < param->count; i++) {
+                end = memchr(data + total, '\0', len - total);
+                if(end == NULL) return -1;
+                total = (size_t)(end - data) + 1;
+            }
+        }
+        else {
+            total += (size_t)param->count * param->size;
+            if(total > len) return -1;
+        }
+    }
+    return (int)total;
+}
+
+//Writes the values for an output format, changing with sample so repeated outputs are not identical.
+//Returns the length written, or -1 if out is too small.
+static int fillParams(const struct TSS_Param *param, uint64_t sample, uint8_t *out, size_t size)
+{
+    size_t total = 0;
+    uint16_t element_size;
+    uint32_t u32;
+    uint64_t u64;
+    float f;
+    double d;
+
+    if(param == NULL) return 0;
+    for(; !TSS_PARAM_IS_NULL(param); param++) {
+        if(TSS_PARAM_IS_STRING(param)) {
+            for(uint8_t i = 0; i < param->count; i++) {
+                if(total + sizeof(SIM_STRING_OUTPUT) > size) return -1;
+                memcpy(out + total, SIM_STRING_OUTPUT, sizeof(SIM_STRING_OUTPUT));
+                total += sizeof(SIM_STRING_OUTPUT);
+            }
+            continue;
+        }
+
+        element_size = param->size;
+        if(total + (size_t)param->count * element_size > size) return -1;
+        for(uint8_t i = 0; i < param->count; i++) {
+            u64 = sample + i;
+#if TSS_INCLUDE_PARAM_TYPE
+            if(param->type == TSS_ParamTypeFloat) {
+                f = (float)(u64 % 1000) / 1000.0f;
+                memcpy(&u32, &f, sizeof(u32));
+                u64 = u32;
+            }
+            else if(param->type == TSS_ParamTypeDouble) {
+                d = (double)(u64 % 1000) / 1000.0;
+                memcpy(&u64, &d, sizeof(u64));
+            }
+#else
+            (void) f;
+            (void) d;
+            (void) u32;
+            u64 = 0; //Without types, floats can't be told apart from integers
+#endif
+            putLittleEndian(out + total, u64, element_size);
+            total += element_size;
+        }
+    }
+    return (int)total;
+}
+
+//----------------------------------------OUTPUT------------------------------------------------
+
+static size_t outSize(const struct SimSensor *sim)
+{
+    return sim->out_w_index - sim->out_r_index;
+}
+
+static size_t outSpace(const struct SimSensor *sim)
+{
+    return SIM_SENSOR_OUT_BUFFER_SIZE - outSize(sim);
+}
+
+static void outPush(struct SimSensor *sim, const uint8_t *data, size_t len)
+{
+    size_t index;
+    for(size_t i = 0; i < len; i++) {
+        index = sim->out_w_index++ & (SIM_SENSOR_OUT_BUFFER_SIZE - 1);
+        sim->out_buffer[index] = data[i];
+        if(sim->config.corrupt_interval > 0 && --sim->bytes_until_corrupt == 0) {
+            sim->out_buffer[index] ^= (uint8_t)(1u << (nextRand(sim) & 7));
+            sim->bytes_until_corrupt = sim->config.corrupt_interval;
+            sim->stats.bytes_corrupted++;
+        }
+    }
+    sim->stats.bytes_out += len;
+}
+
+static uint64_t sensorTimestamp(const struct SimSensor *sim)
+{
+    return simSensorTimeUs() - sim->start_us;
+}
+
+//Outputs a response to a command. The header is only included if requested with the command.
+//Returns false if there is no room for it.
+static bool outCommandResponse(struct SimSensor *sim, bool header, uint8_t cmd_num, int8_t status, const uint8_t *data, uint16_t len)
+{
+    uint8_t buffer[TSS_HEADER_MAX_SIZE];
+    uint16_t header_len = 0;
+
+    if(header) {
+        if(sim->header_bits & TSS_HEADER_STATUS_BIT) {
+            buffer[header_len++] = (uint8_t)status;
+        }
+        if(sim->header_bits & TSS_HEADER_TIMESTAMP_BIT) {
+            putLittleEndian(buffer + header_len, sensorTimestamp(sim), 4);
+            header_len += 4;
+        }
+        if(sim->header_bits & TSS_HEADER_ECHO_BIT) {
+            buffer[header_len++] = cmd_num;
+        }
+        if(sim->header_bits & TSS_HEADER_CHECKSUM_BIT) {
+            buffer[header_len++] = sumBytes(data, len);
+        }
+        if(sim->header_bits & TSS_HEADER_SERIAL_BIT) {
+            putLittleEndian(buffer + header_len, sim->config.serial_number, 4);
+            header_len += 4;
+        }
+        if(sim->header_bits & TSS_HEADER_LENGTH_BIT) {
+            putLittleEndian(buffer + header_len, len, 2);
+            header_len += 2;
+        }
+    }
+
+    if(outSpace(sim) < (size_t)header_len + len) return false;
+    outPush(sim, buffer, header_len);
+    outPush(sim, data, len);
+    return true;
+}
+
+static bool outSettingsId(struct SimSensor *sim, bool header, uint32_t id, size_t response_len)
+{
+    uint8_t buffer[TSS_BINARY_SETTINGS_ID_SIZE];
+    if(outSpace(sim) < response_len + (header ? TSS_BINARY_SETTINGS_ID_SIZE : 0)) return false;
+    if(header) {
+        putLittleEndian(buffer, id, TSS_BINARY_SETTINGS_ID_SIZE);
+        outPush(sim, buffer, TSS_BINARY_SETTINGS_ID_SIZE);
+    }
+    return true;
+}
+
+//----------------------------------------SETTINGS------------------------------------------------
+
+static struct SimSensorSetting* findSetting(struct SimSensor *sim, const char *key)
+{
+    for(uint8_t i = 0; i < sim->num_settings; i++) {
+        if(keyEquals(sim->settings[i].key, key)) {
+            return &sim->settings[i];
+        }
+    }
+    return NULL;
+}
+
+static void applyStreamSlots(struct SimSensor *sim, const char *value)
+{
+    const char *str = value;
+    char *end;
+    long cmd_num;
+
+    sim->num_slots = 0;
+    while(*str != '\0' && sim->num_slots < TSS_NUM_STREAM_SLOTS) {
+        cmd_num = strtol(str, &end, 10);
+        if(end == str || cmd_num < 0 || cmd_num >= 255) break;
+        sim->slot_commands[sim->num_slots++] = (uint8_t)cmd_num;
+
+        //Slot parameters don't change the size of the output, so they are only skipped
+        str = end;
+        if(*str == ':') strtol(str + 1, (char**)&str, 10);
+        if(*str != ',') break;
+        str++;
+    }
+
+    strncpy(sim->stream_slots, value, sizeof(sim->stream_slots) - 1);
+    sim->stream_slots[sizeof(sim->stream_slots) - 1] = '\0';
+}
+
+static void resetSettings(struct SimSensor *sim)
+{
+    sim->num_settings = 0;
+    sim->header_bits = 0;
+    sim->debug_mode = 0;
+    sim->stream_interval_us = SIM_DEFAULT_STREAM_INTERVAL_US;
+    applyStreamSlots(sim, "255");
+}
+
+//Writes the current value of a readable setting in its wire format.
+//Returns the length, or -1 if the setting can't be read.
+static int readSetting(struct SimSensor *sim, const char *key, uint8_t *out, size_t size)
+{
+    const struct TSS_Setting *setting;
+    const struct SimSensorSetting *stored;
+    float hz;
+    uint32_t u32;
+    size_t len;
+
+    setting = tssGetSetting(key);
+    if(setting == NULL || setting->out_format == NULL || TSS_PARAM_IS_NULL(setting->out_format)) {
+        return -1;
+    }
+
+    //Values the simulation keeps as its own state
+    if(keyEquals(key, "serial_number")) {
+        if(size < 8) return -1;
+        putLittleEndian(out, sim->config.serial_number, 8);
+        return 8;
+    }
+    if(keyEquals(key, "timestamp")) {
+        if(size < 8) return -1;
+        putLittleEndian(out, sensorTimestamp(sim), 8);
+        return 8;
+    }
+    if(keyEquals(key, "header")) {
+        if(size < 1) return -1;
+        out[0] = sim->header_bits;
+        return 1;
+    }
+    for(uint8_t i = 0; i < sizeof(K_HEADER_BIT_KEYS) / sizeof(K_HEADER_BIT_KEYS[0]); i++) {
+        if(keyEquals(key, K_HEADER_BIT_KEYS[i])) {
+            if(size < 1) return -1;
+            out[0] = (sim->header_bits >> i) & 1;
+            return 1;
+        }
+    }
+    if(keyEquals(key, "debug_mode")) {
+        if(size < 1) return -1;
+        out[0] = sim->debug_mode;
+        return 1;
+    }
+    if(keyEquals(key, "stream_slots")) {
+        len = strlen(sim->stream_slots) + 1;
+        if(size < len) return -1;
+        memcpy(out, sim->stream_slots, len);
+        return (int)len;
+    }
+    if(keyEquals(key, "stream_interval")) {
+        if(size < 8) return -1;
+        putLittleEndian(out, sim->stream_interval_us, 8);
+        return 8;
+    }
+    if(keyEquals(key, "stream_hz")) {
+        if(size < 4) return -1;
+        hz = 1000000.0f / (float)sim->stream_interval_us;
+        memcpy(&u32, &hz, sizeof(u32));
+        putLittleEndian(out, u32, 4);
+        return 4;
+    }
+
+    //Everything else reads back what was last written
+    stored = findSetting(sim, key);
+    if(stored != NULL) {
+        if(size < stored->len) return -1;
+        memcpy(out, stored->value, stored->len);
+        return stored->len;
+    }
+    return fillParams(setting->out_format, 0, out, size);
+}
+
+//Applies the value of a setting written by the host. Returns 0 on success.
+static int writeSetting(struct SimSensor *sim, const char *key, const struct TSS_Setting *setting, const uint8_t *value, uint16_t len)
+{
+    struct SimSensorSetting *stored;
+    uint64_t interval;
+    float hz;
+
+    if(keyEquals(key, "serial_number") || keyEquals(key, "timestamp")) {
+        return 0; //Accepted, but the simulation keeps these itself
+    }
+    if(keyEquals(key, "default")) {
+        resetSettings(sim);
+        return 0;
+    }
+    if(keyEquals(key, "reboot")) {
+        sim->streaming = false;
+        sim->file_open = false;
+        sim->file_streaming = false;
+        return 0;
+    }
+    if(setting->in_format != NULL && TSS_PARAM_IS_NULL(setting->in_format)) {
+        return 0; //Every other command setting, such as commit, has no effect
+    }
+    if(keyEquals(key, "header")) {
+        sim->header_bits = value[0];
+        return 0;
+    }
+    for(uint8_t i = 0; i < sizeof(K_HEADER_BIT_KEYS) / sizeof(K_HEADER_BIT_KEYS[0]); i++) {
+        if(keyEquals(key, K_HEADER_BIT_KEYS[i])) {
+            if(value[0]) sim->header_bits |= (uint8_t)(1u << i);
+            else sim->header_bits &= (uint8_t)~(1u << i);
+            return 0;
+        }
+    }
+    if(keyEquals(key, "debug_mode")) {
+        if(value[0] == 1 && sim->debug_mode != 1 && sim->config.debug_message_hz > 0) {
+            sim->next_debug_us = simSensorTimeUs() + 1000000ull / sim->config.debug_message_hz;
+        }
+        sim->debug_mode = value[0];
+        return 0;
+    }
+    if(keyEquals(key, "stream_slots")) {
+        applyStreamSlots(sim, (const char*)value);
+        return 0;
+    }
+    if(keyEquals(key, "stream_interval")) {
+        interval = getLittleEndian(value, 8);
+        sim->stream_interval_us = (interval > 0) ? interval : 1;
+        return 0;
+    }
+    if(keyEquals(key, "stream_hz")) {
+        uint32_t u32 = (uint32_t)getLittleEndian(value, 4);
+        memcpy(&hz, &u32, sizeof(hz));
+        if(!(hz > 0.0f)) return SIM_SETTING_ERR_VALUE;
+        sim->stream_interval_us = (uint64_t)(1000000.0f / hz);
+        if(sim->stream_interval_us == 0) sim->stream_interval_us = 1;
+        return 0;
+    }
+
+    stored = findSetting(sim, key);
+    if(stored == NULL) {
+        if(sim->num_settings == SIM_SENSOR_MAX_SETTINGS || strlen(key) >= sizeof(stored->key)) {
+            return SIM_SETTING_ERR_VALUE;
+        }
+        stored = &sim->settings[sim->num_settings++];
+        strcpy(stored->key, key);
+    }
+    if(len > sizeof(stored->value)) return SIM_SETTING_ERR_VALUE;
+    memcpy(stored->value, value, len);
+    stored->len = len;
+    return 0;
+}
+
+//----------------------------------------STREAMING------------------------------------------------
+
+//Builds the response to the batch command from the current stream slots
+static int buildBatch(struct SimSensor *sim, uint8_t *out, size_t size)
+{
+    const struct TSS_Command *command;
+    size_t total = 0;
+    int len;
+
+    for(uint8_t i = 0; i < sim->num_slots; i++) {
+        command = tssGetCommand(sim->slot_commands[i]);
+        if(command == NULL) continue;
+        len = fillParams(command->out_format, sim->stats.packets_streamed, out + total, size - total);
+        if(len < 0) return len;
+        total += (size_t)len;
+    }
+    return (int)total;
+}
+
+static void outStreamingPacket(struct SimSensor *sim)
+{
+    uint8_t data[TSS_MAX_CMD_LEN];
+    int len;
+
+    len = buildBatch(sim, data, sizeof(data));
+    if(len < 0 || !outCommandResponse(sim, true, TSS_STREAMING_DATA_BATCH_COMMAND_NUM, 0, data, (uint16_t)len)) {
+        sim->stats.packets_dropped++;
+        return;
+    }
+    sim->stats.packets_streamed++;
+}
+
+static void updateStreaming(struct SimSensor *sim, uint64_t now)
+{
+    uint64_t behind;
+
+    if(!sim->streaming) return;
+
+    if(sim->config.unthrottled) {
+        //Refill only once the host has caught up, so command responses are not stuck behind a full buffer
+        if(outSize(sim) > 0) return;
+        while(outSize(sim) < SIM_SENSOR_OUT_BUFFER_SIZE / 4) {
+            size_t before = outSize(sim);
+            outStreamingPacket(sim);
+            if(outSize(sim) == before) break;
+        }
+        return;
+    }
+
+    if(now < sim->next_stream_us) return;
+
+    //Too far behind to generate everything, those packets would have been lost by the sensor anyway
+    behind = (now - sim->next_stream_us) / sim->stream_interval_us;
+    if(behind > SIM_MAX_STREAM_CATCHUP) {
+        sim->stats.packets_dropped += behind - SIM_MAX_STREAM_CATCHUP;
+        sim->next_stream_us += (behind - SIM_MAX_STREAM_CATCHUP) * sim->stream_interval_us;
+    }
+
+    while(now >= sim->next_stream_us) {
+        outStreamingPacket(sim);
+        sim->next_stream_us += sim->stream_interval_us;
+    }
+}
+
+//----------------------------------------FILE------------------------------------------------
+
+uint8_t simSensorFileByte(uint64_t index)
+{
+    return (uint8_t)((index * 0x9E3779B97F4A7C15ull) >> 56);
+}
+
+static uint64_t fileRemaining(const struct SimSensor *sim)
+{
+    return sim->config.file_size - sim->file_cursor;
+}
+
+static void startFileStreaming(struct SimSensor *sim)
+{
+    sim->file_streaming = true;
+    sim->file_stream_start_us = simSensorTimeUs();
+    sim->file_stream_bytes = 0;
+    sim->file_bytes_until_drop = sim->config.file_drop_interval;
+}
+
+//Length of the next file streaming packet
+static uint16_t filePacketLen(const struct SimSensor *sim)
+{
+    uint64_t len = fileRemaining(sim);
+    return (uint16_t)((len > TSS_FILE_STREAMING_MAX_PACKET_SIZE) ? TSS_FILE_STREAMING_MAX_PACKET_SIZE : len);
+}
+
+//Returns false if there is no room for the packet
+static bool outFilePacket(struct SimSensor *sim)
+{
+    uint8_t data[TSS_FILE_STREAMING_MAX_PACKET_SIZE];
+    uint16_t len;
+
+    len = filePacketLen(sim);
+    for(uint16_t i = 0; i < len; i++) {
+        data[i] = simSensorFileByte(sim->file_cursor + i);
+    }
+    if(!outCommandResponse(sim, true, TSS_STREAMING_FILE_READ_BYTES_COMMAND_NUM, 0, data, len)) {
+        return false;
+    }
+
+    sim->file_cursor += len;
+    sim->file_stream_bytes += len;
+    sim->stats.file_bytes_streamed += len;
+    if(fileRemaining(sim) == 0) {
+        sim->file_streaming = false;
+    }
+    else if(sim->config.file_drop_interval > 0) {
+        if(sim->file_bytes_until_drop <= len) {
+            sim->file_streaming = false;
+            sim->stats.file_drops++;
+        }
+        else {
+            sim->file_bytes_until_drop -= len;
+        }
+    }
+    return true;
+}
+
+static void updateFileStreaming(struct SimSensor *sim, uint64_t now)
+{
+    uint64_t allowed;
+
+    if(!sim->file_streaming) return;
+
+    if(sim->config.file_bytes_per_s == 0) {
+        //Same as unthrottled streaming, refill once the host has caught up
+        if(outSize(sim) > 0) return;
+        while(sim->file_streaming && outSize(sim) < SIM_SENSOR_OUT_BUFFER_SIZE / 4) {
+            if(!outFilePacket(sim)) break;
+        }
+        return;
+    }
+
+    //Nothing is lost when the host falls behind, the sensor waits for room the same as it would over USB
+    allowed = (now - sim->file_stream_start_us) * sim->config.file_bytes_per_s / 1000000ull;
+    while(sim->file_streaming && sim->file_stream_bytes + filePacketLen(sim) <= allowed) {
+        if(!outFilePacket(sim)) break;
+    }
+}
+
+static void updateDebugMessages(struct SimSensor *sim, uint64_t now)
+{
+    char message[32];
+    uint64_t period;
+
+    if(sim->in_bootloader || sim->debug_mode != 1 || sim->config.debug_message_hz == 0) return;
+
+    period = 1000000ull / sim->config.debug_message_hz;
+    if(now >= sim->next_debug_us + period * SIM_MAX_STREAM_CATCHUP) {
+        sim->next_debug_us = now; //Skip messages that are long overdue instead of flooding the output
+    }
+    while(now >= sim->next_debug_us) {
+        snprintf(message, sizeof(message), "Simulated message %" PRIu32, sim->stats.debug_messages);
+        simSensorDebugMessage(sim, TSS_DEBUG_LEVEL_INFO, 0, message);
+        sim->next_debug_us += period;
+    }
+}
+
+//----------------------------------------REQUESTS------------------------------------------------
+
+static void runCommand(struct SimSensor *sim, bool header, uint8_t cmd_num, const struct TSS_Command *command, const uint8_t *params)
+{
+    uint8_t data[TSS_MAX_CMD_LEN];
+    uint64_t index;
+    int len = 0;
+
+    sim->stats.commands++;
+    if(command == NULL) {
+        outCommandResponse(sim, header, cmd_num, 1, NULL, 0);
+        return;
+    }
+
+    switch(cmd_num) {
+    case TSS_STREAMING_DATA_BATCH_COMMAND_NUM:
+        len = buildBatch(sim, data, sizeof(data));
+        break;
+    case 85: //Start streaming
+        sim->streaming = true;
+        sim->next_stream_us = simSensorTimeUs();
+        break;
+    case 86: //Stop streaming
+        sim->streaming = false;
+        break;
+    case 173: //Open file, the same file whatever the path. Like the sensor, only one can be open at a time.
+        if(sim->config.file_size == 0 || sim->file_open) len = -1;
+        sim->file_open = (len == 0);
+        sim->file_cursor = 0;
+        sim->file_streaming = false;
+        break;
+    case 174: //Close file
+        sim->file_open = false;
+        sim->file_streaming = false;
+        break;
+    case 175: //Remaining size
+        if(!sim->file_open) { len = -1; break; }
+        putLittleEndian(data, fileRemaining(sim), 8);
+        len = 8;
+        break;
+    case 179: //Set cursor
+        index = getLittleEndian(params, 8);
+        if(!sim->file_open || index > sim->config.file_size) { len = -1; break; }
+        sim->file_cursor = index;
+        break;
+    case 180: //Start file streaming, from the cursor to the end of the file
+        if(!sim->file_open) { len = -1; break; }
+        putLittleEndian(data, fileRemaining(sim), 8);
+        len = 8;
+        startFileStreaming(sim);
+        if(fileRemaining(sim) == 0) sim->file_streaming = false;
+        break;
+    case 181: //Stop file streaming
+        sim->file_streaming = false;
+        break;
+    case 226: //Software reset
+        sim->streaming = false;
+        sim->file_open = false;
+        sim->file_streaming = false;
+        sim->start_us = simSensorTimeUs();
+        break;
+    case 229: //Enter bootloader
+        sim->streaming = false;
+        sim->file_open = false;
+        sim->file_streaming = false;
+        sim->in_bootloader = true;
+        break;
+    default:
+        len = fillParams(command->out_format, sim->stats.commands, data, sizeof(data));
+        break;
+    }
+
+    if(len < 0) {
+        outCommandResponse(sim, header, cmd_num, 1, NULL, 0);
+        return;
+    }
+    outCommandResponse(sim, header, cmd_num, 0, data, (uint16_t)len);
+}
+
+//Each handler returns how many bytes of the request were consumed, or 0 if it is incomplete.
+
+static size_t handleCommand(struct SimSensor *sim, const uint8_t *frame, size_t len)
+{
+    const struct TSS_Command *command;
+    int params_len;
+
+    if(len < 2) return 0;
+    command = tssGetCommand(frame[1]);
+    params_len = (command != NULL) ? paramsLength(command->in_format, frame + 2, len - 2) : 0;
+    if(params_len < 0 || len < (size_t)params_len + 3) return 0;
+
+    //A corrupt command is ignored, the same as the sensor would
+    if(sumBytes(frame + 1, (size_t)params_len + 1) == frame[params_len + 2]) {
+        runCommand(sim, frame[0] == TSS_BINARY_HEADER_START_BYTE, frame[1], command, frame + 2);
+    }
+    return (size_t)params_len + 3;
+}
+
+static size_t handleGetSettings(struct SimSensor *sim, const uint8_t *frame, size_t len)
+{
+    uint8_t response[TSS_MAX_CMD_LEN];
+    char key[TSS_MAX_SETTINGS_KEY_LEN];
+    const uint8_t *end;
+    const char *cur, *next;
+    size_t key_string_len, key_len, response_len;
+    bool header;
+    int value_len;
+
+    end = memchr(frame + 1, '\0', len - 1);
+    if(end == NULL || end == frame + len - 1) return 0; //Need the key string and checksum
+    key_string_len = (size_t)(end - (frame + 1));
+    if(sumBytes(frame + 1, key_string_len) != end[1]) {
+        return key_string_len + 3;
+    }
+
+    sim->stats.settings_reads++;
+    header = frame[0] == TSS_BINARY_READ_SETTINGS_HEADER_START_BYTE;
+
+    //Every key, its null terminator and value, each followed by a separator or the final null terminator
+    response_len = 0;
+    cur = (const char*)frame + 1;
+    while(cur != NULL) {
+        next = strchr(cur, TSS_SETTING_SEPARATOR);
+        key_len = (next != NULL) ? (size_t)(next - cur) : strlen(cur);
+        if(key_len >= sizeof(key) || response_len + key_len + 3 > sizeof(response)) break;
+        memcpy(key, cur, key_len);
+        key[key_len] = '\0';
+
+        memcpy(response + response_len, key, key_len + 1);
+        value_len = readSetting(sim, key, response + response_len + key_len + 1, sizeof(response) - response_len - key_len - 3);
+        if(value_len < 0) break;
+        response_len += key_len + 1 + (size_t)value_len;
+        response[response_len++] = (next != NULL) ? TSS_SETTING_SEPARATOR : '\0';
+        cur = (next != NULL) ? next + 1 : NULL;
+    }
+
+    //Unknown or unreadable keys fail the whole request
+    if(cur != NULL) {
+        memcpy(response, TSS_SETTING_KEY_ERR_STRING "\0", TSS_SETTING_KEY_ERR_STRING_LEN + 2);
+        response_len = TSS_SETTING_KEY_ERR_STRING_LEN + 2;
+    }
+
+    //The checksum covers everything except the null terminators of the keys
+    response[response_len] = 0;
+    for(size_t i = 0; i < response_len; i++) {
+        response[response_len] += response[i];
+    }
+    response_len++;
+
+    if(outSettingsId(sim, header, TSS_BINARY_READ_SETTINGS_ID, response_len)) {
+        outPush(sim, response, response_len);
+    }
+    return key_string_len + 3;
+}
+
+static size_t handleSetSettings(struct SimSensor *sim, const uint8_t *frame, size_t len)
+{
+    const uint8_t *keys[SIM_MAX_WRITE_KEYS], *values[SIM_MAX_WRITE_KEYS];
+    const struct TSS_Setting *settings[SIM_MAX_WRITE_KEYS], *setting;
+    uint16_t value_lens[SIM_MAX_WRITE_KEYS];
+    uint8_t response[TSS_BINARY_WRITE_SETTING_RESPONSE_LEN];
+    const uint8_t *end;
+    size_t pos;
+    uint8_t num_keys, num_success, err;
+    int params_len;
+
+    //Find the end of the request. Needs the key table to know how long each value is.
+    pos = 1;
+    num_keys = 0;
+    err = 0;
+    while(true) {
+        end = memchr(frame + pos, '\0', len - pos);
+        if(end == NULL) return 0;
+
+        setting = tssGetSetting((const char*)frame + pos);
+        if(setting == NULL || setting->in_format == NULL || num_keys == SIM_MAX_WRITE_KEYS) {
+            //Can't tell where the request ends, so everything buffered is dropped with it
+            err = SIM_SETTING_ERR_KEY;
+            pos = len;
+            break;
+        }
+        settings[num_keys] = setting;
+        keys[num_keys] = frame + pos;
+        pos = (size_t)(end - frame) + 1;
+
+        params_len = paramsLength(setting->in_format, frame + pos, len - pos);
+        if(params_len < 0 || pos + (size_t)params_len >= len) return 0;
+        values[num_keys] = frame + pos;
+        value_lens[num_keys] = (uint16_t)params_len;
+        pos += (size_t)params_len;
+        num_keys++;
+
+        if(frame[pos++] != TSS_SETTING_SEPARATOR) {
+            break; //Null terminator, or corrupt data which the checksum will catch
+        }
+    }
+
+    num_success = 0;
+    if(err == 0) {
+        if(pos >= len) return 0; //Need the checksum
+
+        //The checksum skips the null terminators, which add nothing to the sum anyway
+        if(frame[pos - 1] != '\0' || sumBytes(frame + 1, pos - 2) != frame[pos]) {
+            return pos + 1; //Corrupt, ignored the same as the sensor would
+        }
+        pos++;
+
+        for(uint8_t i = 0; i < num_keys; i++) {
+            err = (uint8_t)writeSetting(sim, (const char*)keys[i], settings[i], values[i], value_lens[i]);
+            if(err) break;
+            num_success++;
+        }
+    }
+
+    sim->stats.settings_writes++;
+    response[0] = err;
+    response[1] = num_success;
+    response[2] = (uint8_t)(err + num_success);
+    if(outSettingsId(sim, frame[0] == TSS_BINARY_WRITE_SETTINGS_HEADER_START_BYTE, TSS_BINARY_WRITE_SETTINGS_ID, sizeof(response))) {
+        outPush(sim, response, sizeof(response));
+    }
+    return pos;
+}
+
+//The bootloader takes single character commands and responds in big endian
+static size_t handleBootloaderRequest(struct SimSensor *sim, const uint8_t *frame, size_t len)
+{
+    uint8_t response[12];
+    uint16_t num_bytes, checksum;
+
+    switch(frame[0]) {
+    case 'U':
+        return 1; //Baudrate priming
+    case 'Q': //Serial number
+        putBigEndian(response, sim->config.serial_number, 8);
+        response[8] = '\n';
+        outPush(sim, response, 9);
+        return 1;
+    case 'I': //Info
+        putBigEndian(response, SIM_BOOTLOADER_MEM_START, 4);
+        putBigEndian(response + 4, SIM_BOOTLOADER_MEM_END, 4);
+        putBigEndian(response + 8, SIM_BOOTLOADER_PAGE_SIZE, 2);
+        putBigEndian(response + 10, SIM_BOOTLOADER_VERSION, 2);
+        outPush(sim, response, 12);
+        return 1;
+    case 'S': //Erase firmware
+        response[0] = 0;
+        outPush(sim, response, 1);
+        return 1;
+    case 'C': //Program, followed by the length, data and a 16 bit checksum of the data
+        if(len < 3) return 0;
+        num_bytes = (uint16_t)((frame[1] << 8) | frame[2]);
+        if(len < (size_t)num_bytes + 5) return 0;
+        checksum = 0;
+        for(uint16_t i = 0; i < num_bytes; i++) {
+            checksum += frame[3 + i];
+        }
+        response[0] = (checksum == ((frame[num_bytes + 3] << 8) | frame[num_bytes + 4])) ? 0 : 1;
+        if(response[0] == 0) {
+            sim->stats.firmware_bytes += num_bytes;
+        }
+        outPush(sim, response, 1);
+        return (size_t)num_bytes + 5;
+    case 'O': //Status
+        putBigEndian(response, 0, 4);
+        outPush(sim, response, 4);
+        return 1;
+    case 'R': //Restore factory settings
+        resetSettings(sim);
+        return 1;
+    case 'B': //Load firmware
+        sim->in_bootloader = false;
+        sim->start_us = simSensorTimeUs();
+        return 1;
+    default:
+        //Everything else, such as the settings request used to detect the bootloader, is acknowledged
+        outPush(sim, (const uint8_t*)"OK", 2);
+        return 1;
+    }
+}
+
+static size_t handleRequest(struct SimSensor *sim, const uint8_t *frame, size_t len)
+{
+    if(sim->in_bootloader) {
+        return handleBootloaderRequest(sim, frame, len);
+    }
+
+    switch(frame[0]) {
+    case TSS_BINARY_START_BYTE:
+    case TSS_BINARY_HEADER_START_BYTE:
+        return handleCommand(sim, frame, len);
+    case TSS_BINARY_READ_SETTINGS_START_BYTE:
+    case TSS_BINARY_READ_SETTINGS_HEADER_START_BYTE:
+        return handleGetSettings(sim, frame, len);
+    case TSS_BINARY_WRITE_SETTINGS_START_BYTE:
+    case TSS_BINARY_WRITE_SETTINGS_HEADER_START_BYTE:
+        return handleSetSettings(sim, frame, len);
+    default:
+        return 1; //Not the start of a request, such as the "UUU" baudrate priming
+    }
+}
+
+//----------------------------------------API------------------------------------------------
+
+void simSensorInit(struct SimSensor *sim, const struct SimSensorConfig *config)
+{
+    memset(sim, 0, sizeof(*sim));
+    if(config != NULL) {
+        sim->config = *config;
+    }
+    if(sim->config.serial_number == 0) {
+        sim->config.serial_number = SIM_DEFAULT_SERIAL_NUMBER;
+    }
+
+    sim->rand_state = (sim->config.seed != 0) ? sim->config.seed : 0x2545F491u;
+    sim->bytes_until_corrupt = sim->config.corrupt_interval;
+    sim->start_us = simSensorTimeUs();
+    sim->in_bootloader = sim->config.start_in_bootloader;
+    resetSettings(sim);
+}
+
+void simSensorWrite(struct SimSensor *sim, const uint8_t *bytes, size_t len)
+{
+    size_t count, pos, consumed;
+
+    sim->stats.bytes_in += len;
+    while(len > 0) {
+        count = sizeof(sim->in_buffer) - sim->in_len;
+        if(count > len) count = len;
+        memcpy(sim->in_buffer + sim->in_len, bytes, count);
+        sim->in_len += count;
+        bytes += count;
+        len -= count;
+
+        pos = 0;
+        while(pos < sim->in_len) {
+            consumed = handleRequest(sim, sim->in_buffer + pos, sim->in_len - pos);
+            if(consumed == 0) break;
+            pos += consumed;
+        }
+
+        //A request that can't fit is never going to complete
+        if(pos == 0 && sim->in_len == sizeof(sim->in_buffer)) {
+            pos = sim->in_len;
+        }
+        memmove(sim->in_buffer, sim->in_buffer + pos, sim->in_len - pos);
+        sim->in_len -= pos;
+    }
+}
+
+size_t simSensorUpdate(struct SimSensor *sim)
+{
+    uint64_t now = simSensorTimeUs();
+    updateDebugMessages(sim, now);
+    updateStreaming(sim, now);
+    updateFileStreaming(sim, now);
+    return outSize(sim);
+}
+
+size_t simSensorRead(struct SimSensor *sim, uint8_t *out, size_t num_bytes)
+{
+    size_t index, len, total;
+
+    if(num_bytes > outSize(sim)) num_bytes = outSize(sim);
+
+    //At most two copies, before and after the wrap point
+    total = 0;
+    while(total < num_bytes) {
+        index = sim->out_r_index & (SIM_SENSOR_OUT_BUFFER_SIZE - 1);
+        len = SIM_SENSOR_OUT_BUFFER_SIZE - index;
+        if(len > num_bytes - total) len = num_bytes - total;
+        memcpy(out + total, sim->out_buffer + index, len);
+        sim->out_r_index += len;
+        total += len;
+    }
+    return total;
+}
+
+void simSensorClear(struct SimSensor *sim)
+{
+    sim->out_r_index = sim->out_w_index;
+}
+
+uint64_t simSensorNextOutputUs(const struct SimSensor *sim)
+{
+    uint64_t now, next, file_next;
+
+    next = UINT64_MAX;
+    if(sim->streaming) {
+        next = sim->config.unthrottled ? 0 : sim->next_stream_us;
+    }
+    if(sim->file_streaming) {
+        file_next = 0;
+        if(sim->config.file_bytes_per_s > 0) {
+            file_next = sim->file_stream_start_us +
+                (sim->file_stream_bytes + filePacketLen(sim)) * 1000000ull / sim->config.file_bytes_per_s;
+        }
+        if(file_next < next) next = file_next;
+    }
+    if(!sim->in_bootloader && sim->debug_mode == 1 && sim->config.debug_message_hz > 0 && sim->next_debug_us < next) {
+        next = sim->next_debug_us;
+    }
+    if(next == UINT64_MAX) return next;
+
+    now = simSensorTimeUs();
+    return (next > now) ? next - now : 0;
+}
+
+void simSensorDebugMessage(struct SimSensor *sim, uint8_t level, uint8_t module, const char *message)
+{
+    char buffer[TSS_DEBUG_MESSAGE_MAX_SIZE];
+    int len;
+
+    len = snprintf(buffer, sizeof(buffer), "%" PRIu64 " Level: 0x%x Module: 0x%x  %s\r\n",
+        sensorTimestamp(sim), (unsigned)level, (unsigned)module, message);
+    if(len < 0) return;
+    if((size_t)len >= sizeof(buffer)) len = (int)sizeof(buffer) - 1;
+    if(outSpace(sim) < (size_t)len) return;
+
+    outPush(sim, (const uint8_t*)buffer, (size_t)len);
+    sim->stats.debug_messages++;
+}
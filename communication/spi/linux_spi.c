@@ -1,11 +1,13 @@
 #if defined(__linux__) || defined(unix)
 
 #include "tss/com/backend/spi/spi_device.h"
+#include "tss/com/backend/gpio/gpio_irq.h"
 #include "tss/constants.h"
 #include "tss/sys/time.h"
 #include "tss/errors.h"
+#include "tss/sys/trace.h"
 
-#include <stdio.h>
+#include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -13,11 +15,13 @@
 #include <linux/spi/spidev.h>
 #include <sys/ioctl.h>
 
-#define IRQ_ACTIVE_STATE 0
-#define IRQ_INACTIVE_STATE 1
+//Most command responses fit, while large reads only clock a little extra before learning the real size
+#define DEFAULT_RX_PIGGYBACK_LEN 64
+//Max transfers chained into one SPI message by spiTransfer
+#define SPI_MAX_TRANSFERS 8
 
-static int spiReadWithDataAvailableIrq(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
-static int spiReadWithFullIrq(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms);
+static int spiReadWithDataAvailableIrq(struct SpiDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
+static int spiReadWithFullIrq(struct SpiDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms);
 
 // -----------------------------------------------------------------------
 // Open / Close
@@ -34,7 +38,7 @@ int spiOpen(SpiPortId id, uint32_t speed_hz, struct SpiDevice *out)
         id.data_loaded_line_num = -1;
     }
     else if(id.data_available_line_num == 0 || id.data_loaded_line_num == 0) {
-        fprintf(stderr, "Warning: One IRQ line number is set to 0, while the other is not. Was this intentional?\n");
+        tssTrace(TSS_TRACE_WARNING, out, 0, 0, 0, "One IRQ line number is set to 0, while the other is not");
     }
 
     *out = (struct SpiDevice) {
@@ -45,14 +49,15 @@ int spiOpen(SpiPortId id, uint32_t speed_hz, struct SpiDevice *out)
         .mode          = SPI_MODE_0 | SPI_NO_CS,
         .timeout       = 1000,
         .header_timeout= 1,
+        .rx_piggyback_len = DEFAULT_RX_PIGGYBACK_LEN,
         .read_fn       = spiReadNoIrq,
     };
 
     //----------------Configure GPIO CS----------------
-    //Grab the chip
-    out->chip = gpiod_chip_open(id.chip_path);
+    //Grab the chip. Devices on a shared bus use the bus's chip.
+    out->chip = (id.bus != NULL) ? id.bus->chip : gpiod_chip_open(id.chip_path);
     if(!out->chip) {
-        perror("gpiod_chip_open");
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, errno, "spiOpen: gpiod_chip_open failed");
         spiClose(out);
         return -1;
     }   
@@ -60,14 +65,14 @@ int spiOpen(SpiPortId id, uint32_t speed_hz, struct SpiDevice *out)
     //Grab the pin
     out->cs_line = gpiod_chip_get_line(out->chip, id.cs_line_num);
     if(!out->cs_line) {
-        perror("gpiod_chip_get_line");
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, errno, "spiOpen: gpiod_chip_get_line failed");
         spiClose(out);
         return -1;
     }
 
     //Configure the pin
     if(gpiod_line_request_output(out->cs_line, "spi_cs", 1) < 0) {
-        perror("gpiod_line_request_output");
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, errno, "spiOpen: gpiod_line_request_output failed");
         spiClose(out);
         return -1;
     }
@@ -76,9 +81,15 @@ int spiOpen(SpiPortId id, uint32_t speed_hz, struct SpiDevice *out)
 
     //----------------Configure SPI device----------------
 
+    //The bus already opened and configured the spidev device
+    if(id.bus != NULL) {
+        out->fd = id.bus->fd;
+        return 0;
+    }
+
     int fd = open(id.device_name, O_RDWR);
     if (fd < 0) {
-        fprintf(stderr, "Failed to open SPI device %s: %s\n", id.device_name, strerror(errno));
+        tssTrace(TSS_TRACE_ERROR, out, 0, 0, errno, "spiOpen: Failed to open SPI device");
         spiClose(out);
         return -1;
     }
@@ -118,8 +129,7 @@ int spiConfigurePinMode(struct SpiDevice *dev, int data_available_line_num, int
     if(data_available_line_num >= 0) {
         dev->data_available_line = gpiod_chip_get_line(dev->chip, (unsigned int)data_available_line_num);
         if(dev->data_available_line != NULL) {
-            if(gpiod_line_request_input(dev->data_available_line, "spi_data_available") < 0) {
-                perror("gpiod_line_request_input");
+            if(gpioIrqRequestLine(dev->data_available_line, "spi_data_available", false, &dev->data_available_events) < 0) {
                 return -1;
             }
         }
@@ -127,8 +137,7 @@ int spiConfigurePinMode(struct SpiDevice *dev, int data_available_line_num, int
     if(data_loaded_line_num >= 0) {
         dev->data_loaded_line = gpiod_chip_get_line(dev->chip, (unsigned int)data_loaded_line_num);
         if(dev->data_loaded_line != NULL) {
-            if(gpiod_line_request_input(dev->data_loaded_line, "spi_data_loaded") < 0) {
-                perror("gpiod_line_request_input");
+            if(gpioIrqRequestLine(dev->data_loaded_line, "spi_data_loaded", true, &dev->data_loaded_events) < 0) {
                 return -1;
             }
         }
@@ -161,15 +170,117 @@ void spiClose(struct SpiDevice *dev)
         gpiod_line_release(dev->cs_line);
         dev->cs_line = NULL;
     }
-    if(dev->chip != NULL) {
+    //The chip and file descriptor of a shared bus stay open for the other devices on it
+    if(dev->chip != NULL && dev->id.bus == NULL) {
         gpiod_chip_close(dev->chip);
-        dev->chip = NULL;
     }
+    dev->chip = NULL;
     
-    close(dev->fd);
+    if(dev->id.bus == NULL) {
+        close(dev->fd);
+    }
     dev->fd = -1;
 }
 
+// -----------------------------------------------------------------------
+// IRQ lines
+// -----------------------------------------------------------------------
+
+int spiGetDataAvailableFd(const struct SpiDevice *dev)
+{
+    if(dev->data_available_line == NULL || !dev->data_available_events) {
+        return -1;
+    }
+    return gpiod_line_event_get_fd(dev->data_available_line);
+}
+
+// -----------------------------------------------------------------------
+// Shared bus
+// -----------------------------------------------------------------------
+
+int spiBusOpen(struct SpiBus *bus, const char *device_name, const char *chip_path, uint32_t speed_hz)
+{
+    *bus = (struct SpiBus) {
+        .fd            = -1,
+        .bits_per_word = 8,
+        .mode          = SPI_MODE_0 | SPI_NO_CS,
+    };
+
+    if(pthread_mutex_init(&bus->lock, NULL) != 0) {
+        return -1;
+    }
+
+    bus->chip = gpiod_chip_open(chip_path);
+    if(!bus->chip) {
+        tssTrace(TSS_TRACE_ERROR, bus, 0, 0, errno, "spiBusOpen: gpiod_chip_open failed");
+        spiBusClose(bus);
+        return -1;
+    }
+
+    bus->fd = open(device_name, O_RDWR);
+    if (bus->fd < 0) {
+        tssTrace(TSS_TRACE_ERROR, bus, 0, 0, errno, "spiBusOpen: Failed to open SPI device");
+        spiBusClose(bus);
+        return -1;
+    }
+
+    //Each device sends its own speed with every transfer, this is only the default
+    if (ioctl(bus->fd, SPI_IOC_WR_MODE,           &bus->mode)          < 0 ||
+        ioctl(bus->fd, SPI_IOC_WR_BITS_PER_WORD,  &bus->bits_per_word) < 0 ||
+        ioctl(bus->fd, SPI_IOC_WR_MAX_SPEED_HZ,   &speed_hz)           < 0) 
+        {
+            spiBusClose(bus);
+            return -1;
+        }
+
+    return 0;
+}
+
+void spiBusClose(struct SpiBus *bus)
+{
+    if(bus->chip != NULL) {
+        gpiod_chip_close(bus->chip);
+        bus->chip = NULL;
+    }
+    if(bus->fd >= 0) {
+        close(bus->fd);
+        bus->fd = -1;
+    }
+    pthread_mutex_destroy(&bus->lock);
+}
+
+//Asserts the device's CS. On a shared bus, first waits for any other device's transaction to finish.
+static void spiSelect(struct SpiDevice *dev)
+{
+    if(dev->id.bus != NULL) {
+        pthread_mutex_lock(&dev->id.bus->lock);
+    }
+    gpiod_line_set_value(dev->cs_line, 0);
+}
+
+static void spiDeselect(struct SpiDevice *dev)
+{
+    gpiod_line_set_value(dev->cs_line, 1);
+    if(dev->id.bus != NULL) {
+        pthread_mutex_unlock(&dev->id.bus->lock);
+    }
+}
+
+int spiBusSchedule(struct SpiBus *bus, struct SpiDevice *const *devices, uint8_t count, uint8_t *order, uint32_t timeout_ms)
+{
+    struct gpiod_line *lines[SPI_BUS_MAX_DEVICES];
+    bool events[SPI_BUS_MAX_DEVICES];
+    uint8_t i;
+
+    if(count > SPI_BUS_MAX_DEVICES) return -1;
+
+    for(i = 0; i < count; i++) {
+        lines[i] = devices[i]->data_available_line;
+        events[i] = devices[i]->data_available_events;
+    }
+    return gpioIrqSchedule(lines, events, count, &bus->next_start, order, timeout_ms);
+}
+
 // -----------------------------------------------------------------------
 // Write
 // -----------------------------------------------------------------------
@@ -187,7 +298,7 @@ int spiBasicWrite(struct SpiDevice *dev, const uint8_t *data, size_t len)
     };
 
     if (ioctl(dev->fd, SPI_IOC_MESSAGE(1), &xfer) < 0) {
-        perror("spiBasicWrite: SPI_IOC_MESSAGE");
+        tssTrace(TSS_TRACE_ERROR, dev, 0, 0, errno, "spiBasicWrite: SPI_IOC_MESSAGE failed");
         return -1;
     }
     return 0;
@@ -204,7 +315,7 @@ int spiWrite(struct SpiDevice *dev, const uint8_t *data, size_t len)
         { .rx_buf = 0, .speed_hz = dev->speed_hz, .bits_per_word = dev->bits_per_word },
     };
 
-    gpiod_line_set_value(dev->cs_line, 0); // Set CS low
+    spiSelect(dev); // Set CS low
     while(len > 0) {
         uint8_t send_len = (len > 255) ? 255 : (uint8_t)len;
         write_header[1] = send_len;
@@ -214,15 +325,99 @@ int spiWrite(struct SpiDevice *dev, const uint8_t *data, size_t len)
         xfer[1].tx_buf = (unsigned long)data;
         xfer[1].len    = send_len;
         if (ioctl(dev->fd, SPI_IOC_MESSAGE(2), xfer) < 0) {
-            gpiod_line_set_value(dev->cs_line, 1); // Set CS high
-            perror("spiWrite: SPI_IOC_MESSAGE");
+            spiDeselect(dev); // Set CS high
+            tssTrace(TSS_TRACE_ERROR, dev, 0, 0, errno, "spiWrite: SPI_IOC_MESSAGE failed");
             return -1;
         }
 
         len -= send_len;
         data += send_len;
     }
-    gpiod_line_set_value(dev->cs_line, 1); // Set CS high
+    spiDeselect(dev); // Set CS high
+    return 0;
+}
+
+//Max buffers chained after the write header in a single SPI message
+#define SPI_MAX_WRITE_SEGMENTS 16
+
+int spiWriteVectored(struct SpiDevice *dev, const struct SpiBuffer *buffers, uint8_t count)
+{
+    uint8_t write_header[2] = { TSS_TRANSACTION_WRITE_DATA_BYTE, 0xFF };
+    struct spi_ioc_transfer xfer[SPI_MAX_WRITE_SEGMENTS + 1];
+    size_t offset = 0; //Amount of the current buffer already sent
+    uint8_t num_xfer, send_len, segment_len;
+
+    if (dev->fd < 0) return 0;
+
+    spiSelect(dev); // Set CS low
+    while(count > 0) {
+        //Each write header can only describe up to 255 bytes, so chain as many buffers as fit
+        memset(xfer, 0, sizeof(xfer));
+        num_xfer = 1;
+        send_len = 0;
+        while(count > 0 && send_len < 255 && num_xfer <= SPI_MAX_WRITE_SEGMENTS) {
+            size_t remaining = buffers->len - offset;
+            segment_len = (remaining > (size_t)(255 - send_len)) ? (uint8_t)(255 - send_len) : (uint8_t)remaining;
+            if(segment_len > 0) {
+                xfer[num_xfer].tx_buf = (unsigned long)(buffers->data + offset);
+                xfer[num_xfer].len = segment_len;
+                num_xfer++;
+                send_len += segment_len;
+                offset += segment_len;
+            }
+            if(offset == buffers->len) {
+                buffers++;
+                count--;
+                offset = 0;
+            }
+        }
+        if(send_len == 0) break;
+
+        write_header[1] = send_len;
+        xfer[0].tx_buf = (unsigned long)write_header;
+        xfer[0].len = sizeof(write_header);
+        for(uint8_t i = 0; i < num_xfer; i++) {
+            xfer[i].speed_hz = dev->speed_hz;
+            xfer[i].bits_per_word = dev->bits_per_word;
+        }
+        if (ioctl(dev->fd, SPI_IOC_MESSAGE(num_xfer), xfer) < 0) {
+            spiDeselect(dev); // Set CS high
+            tssTrace(TSS_TRACE_ERROR, dev, 0, 0, errno, "spiWriteVectored: SPI_IOC_MESSAGE failed");
+            return -1;
+        }
+    }
+    spiDeselect(dev); // Set CS high
+    return 0;
+}
+
+// -----------------------------------------------------------------------
+// Full duplex transfer
+// -----------------------------------------------------------------------
+
+int spiTransfer(struct SpiDevice *dev, const struct SpiTransfer *transfers, uint8_t count)
+{
+    struct spi_ioc_transfer xfer[SPI_MAX_TRANSFERS];
+    uint8_t num_xfer = 0;
+
+    if (dev->fd < 0) return -1;
+    if (count > SPI_MAX_TRANSFERS) return -1;
+
+    memset(xfer, 0, sizeof(xfer));
+    for(uint8_t i = 0; i < count; i++) {
+        if(transfers[i].len == 0) continue;
+        xfer[num_xfer].tx_buf = (unsigned long)transfers[i].tx;
+        xfer[num_xfer].rx_buf = (unsigned long)transfers[i].rx;
+        xfer[num_xfer].len = transfers[i].len;
+        xfer[num_xfer].speed_hz = dev->speed_hz;
+        xfer[num_xfer].bits_per_word = dev->bits_per_word;
+        num_xfer++;
+    }
+    if(num_xfer == 0) return 0;
+
+    if (ioctl(dev->fd, SPI_IOC_MESSAGE(num_xfer), xfer) < 0) {
+        tssTrace(TSS_TRACE_ERROR, dev, 0, 0, errno, "spiTransfer: SPI_IOC_MESSAGE failed");
+        return -1;
+    }
     return 0;
 }
 
@@ -244,7 +439,7 @@ int spiBasicRead(struct SpiDevice *dev, uint8_t *out, size_t len)
     };
 
     if (ioctl(dev->fd, SPI_IOC_MESSAGE(1), &xfer) < 0) {
-        perror("spiBasicRead: SPI_IOC_MESSAGE");
+        tssTrace(TSS_TRACE_ERROR, dev, 0, 0, errno, "spiBasicRead: SPI_IOC_MESSAGE failed");
         return -1;
     }
     return (int)len;
@@ -254,24 +449,30 @@ int spiBasicRead(struct SpiDevice *dev, uint8_t *out, size_t len)
 // Protocol read (no-IRQ polling style)
 // -----------------------------------------------------------------------
 
-int spiReadNoIrq(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
+//The READ_DATA_WITH_SIZE length is a single byte, so larger reads are split into chunks of this size
+static uint8_t spiReadChunkLen(size_t remaining)
 {
-    (void) timeout_ms;
-    
-    if (length == 0) return 0;
-    // Send READ_DATA_WITH_SIZE command followed by the requested byte count.
-    uint8_t header[2] = { TSS_TRANSACTION_READ_DATA_WITH_SIZE_BYTE, length };
-    gpiod_line_set_value(dev->cs_line, 0); // Set CS low
-    spiBasicWrite(dev, header, sizeof(header));
-    gpiod_line_set_value(dev->cs_line, 1); // Set CS high
+    return (remaining > 255) ? 255 : (uint8_t)remaining;
+}
 
+//Polls the status of a READ_DATA_WITH_SIZE request until the sensor has the response ready.
+//On success CS is left low so the payload can be clocked out next.
+//Returns the payload length, or TSS_ERR_TIMEOUT.
+static int spiPollReadStatus(struct SpiDevice *dev, uint8_t requested)
+{
+    uint8_t header[2];
     uint8_t status = 0xFF, data_len = 0;
     tss_time_t start = tssTimeGet();
     uint32_t elapsed_time = 0;
+    bool first_poll = true;
     while (status == 0xFF && elapsed_time <= dev->header_timeout) {
         //Doing in this order to ensure a toggle between iterations, and that it stays low after the while loop.
-        gpiod_line_set_value(dev->cs_line, 1); // Set CS high
-        gpiod_line_set_value(dev->cs_line, 0); // Set CS low
+        //CS is already high after the request, so the first poll only needs to lower it.
+        if(!first_poll) {
+            spiDeselect(dev); // Set CS high
+        }
+        first_poll = false;
+        spiSelect(dev); // Set CS low
 
         memset(header, 0xFF, sizeof(header));
         spiBasicRead(dev, header, sizeof(header));
@@ -280,52 +481,80 @@ int spiReadNoIrq(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t t
         data_len = header[1];
 
         // Guard against buffer overflows caused by a corrupt length field.
-        if (status != 0xFF && data_len > length) {
+        if (status != 0xFF && data_len > requested) {
             status = 0xFF;
-            fprintf(stderr,
-                    "spiReadNoIrq: sensor data_len (%d) > buffer (%d), retrying...\n",
-                    data_len, length);
+            tssTrace(TSS_TRACE_RETRY, dev, 0, data_len, requested, "spiReadNoIrq: sensor data_len > buffer, retrying");
         }
         elapsed_time = tssTimeDiff(start);
     }
 
     if(status == 0xFF) {
-        gpiod_line_set_value(dev->cs_line, 1); // Set CS high
-        fprintf(stderr, "spiReadNoIrq: timeout waiting for valid header\n");
+        spiDeselect(dev); // Set CS high
+        tssTrace(TSS_TRACE_ERROR, dev, 0, 0, TSS_ERR_TIMEOUT, "spiReadNoIrq: timeout waiting for valid header");
         return TSS_ERR_TIMEOUT;
     }
+    return data_len;
+}
 
-    if (data_len > 0) {
-        if(data_len > length) {
-            gpiod_line_set_value(dev->cs_line, 1); // Set CS high
-            fprintf(stderr, "spiReadNoIrq: Unexpected data_len (%d) > buffer (%d)\n", data_len, length);
+int spiReadNoIrq(struct SpiDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms)
+{
+    (void) timeout_ms;
+    
+    if (length == 0) return 0;
+    // Send READ_DATA_WITH_SIZE command followed by the requested byte count.
+    uint8_t request[2] = { TSS_TRANSACTION_READ_DATA_WITH_SIZE_BYTE, spiReadChunkLen(length) };
+    spiSelect(dev); // Set CS low
+    spiBasicWrite(dev, request, sizeof(request));
+    spiDeselect(dev); // Set CS high
+
+    size_t total = 0;
+    while(true) {
+        uint8_t requested = request[1];
+        int data_len = spiPollReadStatus(dev, requested);
+        if(data_len < 0) {
+            //Previous chunks were already consumed from the sensor, so report them instead of the timeout
+            return (total > 0) ? (int)total : data_len;
+        }
+
+        //A full chunk means the sensor may have more queued. The request for the next chunk
+        //is clocked out in the same message as this payload, so each chunk after the first
+        //costs a single CS assertion instead of one for the request and one for the response.
+        size_t remaining = length - total - (size_t)data_len;
+        bool more = (data_len == requested && remaining > 0);
+        if(more) {
+            request[1] = spiReadChunkLen(remaining);
+        }
+        struct SpiTransfer transfers[2] = {
+            { .tx = NULL, .rx = out + total, .len = (uint32_t)data_len },
+            { .tx = request, .rx = NULL, .len = more ? sizeof(request) : 0 }
+        };
+        int err = spiTransfer(dev, transfers, 2);
+        spiDeselect(dev); // Set CS high
+        if(err) {
             return -1;
         }
-        spiBasicRead(dev, out, data_len);
+
+        total += (size_t)data_len;
+        if(!more) break;
     }
-    gpiod_line_set_value(dev->cs_line, 1); // Set CS high
-    return data_len;
+    return (int)total;
 }
 
-static int spiReadWithDataAvailableIrq(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
+static int spiReadWithDataAvailableIrq(struct SpiDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms)
 {
     if (length == 0) return 0;
 
     // Wait for the Data Available line to go low
-    tss_time_t start = tssTimeGet();
-    uint32_t elapsed_time = 0;
-    while (gpiod_line_get_value(dev->data_available_line) == IRQ_INACTIVE_STATE) {
-        if(elapsed_time > timeout_ms) {
-            return TSS_ERR_TIMEOUT;
-        }
-        elapsed_time = tssTimeDiff(start);
+    int result = gpioIrqWaitForLine(dev->data_available_line, dev->data_available_events, GPIO_IRQ_ACTIVE_STATE, timeout_ms);
+    if(result < 0) {
+        return result;
     }
 
     //Then do a normal read
     return spiReadNoIrq(dev, out, length, timeout_ms);
 }
 
-static int spiReadWithFullIrq(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
+static int spiReadChunkWithFullIrq(struct SpiDevice *dev, uint8_t *out, uint8_t length, uint32_t timeout_ms)
 {
     if(length == 0) return 0;
 
@@ -334,60 +563,64 @@ static int spiReadWithFullIrq(struct SpiDevice *dev, uint8_t *out, uint8_t lengt
     //back to back that his pin may not have been deasserted yet.
     //Doing this check here instead of after reading to avoid wasting time when could continue processing.
     tss_time_t start_time = tssTimeGet();
-    tss_time_t elapsed_time = 0;
-
-    while(gpiod_line_get_value(dev->data_loaded_line) == IRQ_ACTIVE_STATE) {
-        if(elapsed_time > timeout_ms + dev->header_timeout) {
-            //There might actually be data loaded that shouldn't be there if this times out.
-            //Clear it.
-
-            //Have to clear using the no irq mode otherwise the same issue will occur.
-            uint8_t clear_buffer[40];
-            int len;
-            do {
-                len = spiReadNoIrq(dev, clear_buffer, sizeof(clear_buffer), 0);
-            } while(len > 0);
-            return TSS_ERR_TIMEOUT;
-        }
-        elapsed_time = tssTimeDiff(start_time);
+    int result = gpioIrqWaitForLine(dev->data_loaded_line, dev->data_loaded_events, GPIO_IRQ_INACTIVE_STATE, timeout_ms + dev->header_timeout);
+    if(result == TSS_ERR_TIMEOUT) {
+        //There might actually be data loaded that shouldn't be there if this times out.
+        //Clear it.
+
+        //Have to clear using the no irq mode otherwise the same issue will occur.
+        uint8_t clear_buffer[40];
+        int len;
+        do {
+            len = spiReadNoIrq(dev, clear_buffer, sizeof(clear_buffer), 0);
+        } while(len > 0);
+        return TSS_ERR_TIMEOUT;
+    }
+    if(result < 0) {
+        return result;
     }
 
     //Wait for data to be available
-    elapsed_time = 0;
-    while(gpiod_line_get_value(dev->data_available_line) == IRQ_INACTIVE_STATE) {
-        if(elapsed_time > timeout_ms) {
-            return TSS_ERR_TIMEOUT;
-        }
-        elapsed_time = tssTimeDiff(start_time);
+    uint32_t elapsed_time = tssTimeDiff(start_time);
+    if(elapsed_time > timeout_ms) {
+        elapsed_time = timeout_ms;
+    }
+    result = gpioIrqWaitForLine(dev->data_available_line, dev->data_available_events, GPIO_IRQ_ACTIVE_STATE, timeout_ms - elapsed_time);
+    if(result < 0) {
+        return result;
     }
 
     //Start the read
     uint8_t header[2] = { TSS_TRANSACTION_READ_DATA_WITH_SIZE_BYTE, length };
-    gpiod_line_set_value(dev->cs_line, 0); // Set CS low
+    spiSelect(dev); // Set CS low
     spiBasicWrite(dev, header, sizeof(header));
-    gpiod_line_set_value(dev->cs_line, 1); // Set CS high
+    spiDeselect(dev); // Set CS high
 
     //Wait until the data is loaded
-    start_time = tssTimeGet();
-    elapsed_time = 0;
-    while(gpiod_line_get_value(dev->data_loaded_line) == IRQ_INACTIVE_STATE) {
-        if(elapsed_time > timeout_ms + dev->header_timeout) {
-            return -1; //Somehow failed to load data
-        }
-        elapsed_time = tssTimeDiff(start_time);
+    if(gpioIrqWaitForLine(dev->data_loaded_line, dev->data_loaded_events, GPIO_IRQ_ACTIVE_STATE, timeout_ms + dev->header_timeout) != 0) {
+        return -1; //Somehow failed to load data
     }
 
-    //Read the header
-    gpiod_line_set_value(dev->cs_line, 0); // Set CS low
+    //The response is fully loaded, so the status and the start of the payload
+    //can be read in one message instead of reading the status first.
+    uint8_t piggyback_len = (length < dev->rx_piggyback_len) ? length : dev->rx_piggyback_len;
+    struct SpiTransfer transfers[2] = {
+        { .tx = NULL, .rx = header, .len = sizeof(header) },
+        { .tx = NULL, .rx = out, .len = piggyback_len }
+    };
+    spiSelect(dev); // Set CS low
 
-    spiBasicRead(dev, header, sizeof(header));
+    if(spiTransfer(dev, transfers, 2)) {
+        spiDeselect(dev); // Set CS high
+        return -1;
+    }
     uint8_t status = header[0];
     uint8_t data_len = header[1];
 
     //This should never occur when using the data loaded pin, but checking anyways
     if(status == 0xFF) {
-        gpiod_line_set_value(dev->cs_line, 1); // Set CS high
-        fprintf(stderr, "spiReadWithFullIrq: Unexpected 0xFF status when using full data IRQ\n");
+        spiDeselect(dev); // Set CS high
+        tssTrace(TSS_TRACE_ERROR, dev, 0, 0, -1, "spiReadWithFullIrq: Unexpected 0xFF status when using full data IRQ");
         return -1;
     }
 
@@ -396,16 +629,39 @@ static int spiReadWithFullIrq(struct SpiDevice *dev, uint8_t *out, uint8_t lengt
         //issue with the SPI lines. Checking anyways
         //to ensure no buffer overruns.
         if(data_len > length) {
-            fprintf(stderr, "spiReadWithFullIrq: Unexpected data_len (%d) > buffer (%d)\n", data_len, length);
+            spiDeselect(dev); // Set CS high
+            tssTrace(TSS_TRACE_ERROR, dev, 0, data_len, (int32_t)length, "spiReadWithFullIrq: Unexpected data_len > buffer");
             return -1;
         }
-        spiBasicRead(dev, out, data_len);
+        //Anything past data_len in the piggybacked bytes is filler and is ignored
+        if(data_len > piggyback_len) {
+            spiBasicRead(dev, out + piggyback_len, data_len - piggyback_len);
+        }
     }
 
-    gpiod_line_set_value(dev->cs_line, 1); // Set CS high
+    spiDeselect(dev); // Set CS high
     return data_len;
 }
 
+static int spiReadWithFullIrq(struct SpiDevice *dev, uint8_t *out, size_t length, uint32_t timeout_ms)
+{
+    size_t total = 0;
+    while(total < length) {
+        uint8_t requested = spiReadChunkLen(length - total);
+        int n = spiReadChunkWithFullIrq(dev, out + total, requested, timeout_ms);
+        if(n < 0) {
+            return (total > 0) ? (int)total : n;
+        }
+        total += (size_t)n;
+
+        //Only keep going while the sensor still has data, otherwise the next chunk would wait out the timeout
+        if(n < requested || gpiod_line_get_value(dev->data_available_line) == GPIO_IRQ_INACTIVE_STATE) {
+            break;
+        }
+    }
+    return (int)total;
+}
+
 // -----------------------------------------------------------------------
 // High-level read (uses dev->read_fn and dev->timeout)
 // -----------------------------------------------------------------------
@@ -418,11 +674,8 @@ int spiRead(struct SpiDevice *dev, size_t num_bytes, uint8_t *out)
     tss_time_t start = tssTimeGet();
     uint32_t elapsed_time = 0;
     while (total < num_bytes && elapsed_time <= dev->timeout) {
-        size_t chunk = num_bytes - total;
-        if (chunk > 255) chunk = 255;
-
         uint32_t remaining = dev->timeout - elapsed_time;
-        int n = dev->read_fn(dev, out + total, (uint8_t)chunk, remaining);
+        int n = dev->read_fn(dev, out + total, num_bytes - total, remaining);
         if(n >= 0) {
             total += (size_t)n;
         }
@@ -4,6 +4,9 @@
 
 #include <stdbool.h>
 
+//Matches the most pieces the core gathers a frame from
+#define SPI_COM_MAX_WRITE_IOV 16
+
 static int spi_open(struct TSS_Com_Class *com);
 static int spi_close(struct TSS_Com_Class *com);
 
@@ -13,6 +16,7 @@ static void spi_set_timeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
 static uint32_t spi_get_timeout(struct TSS_Com_Class *com);
 
 static int spi_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len);
+static int spi_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
 
 static const struct TSS_Com_Class_API m_spi_com_api = {
     .open  = spi_open,
@@ -35,6 +39,7 @@ static const struct TSS_Com_Class_API m_spi_com_api = {
     },
     .out = {
         .write = spi_write,
+        .write_vectored = spi_write_vectored,
     },
 };
 
@@ -96,3 +101,48 @@ static int spi_write(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len
     struct SpiComClass *self = (struct SpiComClass *)com;
     return spiWrite(&self->device, bytes, len);
 }
+
+static int spi_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    struct SpiComClass *self = (struct SpiComClass *)com;
+    struct SpiBuffer buffers[SPI_COM_MAX_WRITE_IOV];
+    uint8_t i, count;
+    int result;
+
+    while(iov_count > 0) {
+        count = (iov_count > SPI_COM_MAX_WRITE_IOV) ? SPI_COM_MAX_WRITE_IOV : iov_count;
+        for(i = 0; i < count; i++) {
+            buffers[i].data = iov[i].base;
+            buffers[i].len = iov[i].len;
+        }
+        result = spiWriteVectored(&self->device, buffers, count);
+        if(result) return result;
+        iov += count;
+        iov_count -= count;
+    }
+    return 0;
+}
+
+#if TSS_MINIMAL_SENSOR == 0
+int spi_com_bus_update(struct SpiBus *bus, struct SpiComClass *const *coms, uint8_t count, uint32_t timeout_ms)
+{
+    struct SpiDevice *devices[SPI_BUS_MAX_DEVICES];
+    uint8_t order[SPI_BUS_MAX_DEVICES];
+    uint8_t i;
+    int num_ready;
+
+    if(count > SPI_BUS_MAX_DEVICES) return TSS_ERR_INVALID_SIZE;
+
+    for(i = 0; i < count; i++) {
+        devices[i] = &coms[i]->device;
+    }
+
+    num_ready = spiBusSchedule(bus, devices, count, order, timeout_ms);
+    for(i = 0; i < num_ready; i++) {
+        //Checking the length of a managed com class reads everything available into its buffer
+        tss_com_length((struct TSS_Com_Class *)coms[order[i]]);
+    }
+
+    return num_ready;
+}
+#endif
@@ -33,6 +33,51 @@ TSS_API int tssReadCommandArray(struct TSS_Com_Class *com, const struct TSS_Comm
 TSS_API int tssReadCommandChecksumOnly(struct TSS_Com_Class *com, const struct TSS_Command *command);
 
 
+//--------------------------------PREBUILT COMMANDS----------------------------------
+
+//Largest command number + inputs + checksum a prebuilt frame can hold
+#define TSS_COMMAND_FRAME_MAX_SIZE 64
+//Largest response a prebuilt frame can decode in a single read
+#define TSS_COMMAND_FRAME_MAX_RESPONSE_SIZE 256
+#define TSS_COMMAND_FRAME_MAX_OUTPUTS 16
+
+struct TSS_Command_Frame_Output {
+    uint16_t offset;        //Location of the output in the response
+    uint16_t len;           //Total length of the output
+    uint16_t element_size;  //Size of each element for endian conversion
+};
+
+//A command and its inputs serialized once, along with the layout of its response,
+//so it can be sent and decoded repeatedly without redoing that work every time.
+struct TSS_Command_Frame {
+    const struct TSS_Command *command;
+
+    //Everything after the start byte. The start byte is added when sent, so the
+    //frame remains valid if the header is enabled/disabled after building it.
+    uint8_t data[TSS_COMMAND_FRAME_MAX_SIZE];
+    uint16_t len;
+
+    uint16_t response_size;
+    uint8_t num_outputs;
+    struct TSS_Command_Frame_Output outputs[TSS_COMMAND_FRAME_MAX_OUTPUTS];
+};
+
+/**
+ * @brief Serializes the command and its inputs into a frame that can be sent any number of times via \ref tssWriteCommandFrame
+ * @param command The command to build.
+ * @param data The inputs to the command, in the same format as \ref tssWriteCommand. Copied into the frame.
+ * @param out The frame to build.
+ * @retval TSS_SUCCESS on success.
+ * @retval TSS_ERR_INVALID_SIZE if the command has a variable length (string) response or the response is too large to decode in one read.
+ * @retval TSS_ERR_BUFFER_OVERFLOW if the inputs do not fit in the frame.
+ */
+TSS_API int tssBuildCommandFrame(const struct TSS_Command *command, const void **data, struct TSS_Command_Frame *out);
+TSS_API int tssWriteCommandFrame(struct TSS_Com_Class *com, bool header, const struct TSS_Command_Frame *frame);
+
+//Reads the full response with a single read and decodes it into out. out has one pointer per output.
+//Returns -Error or >= 0 checksum
+TSS_API int tssReadCommandFrameResponse(struct TSS_Com_Class *com, const struct TSS_Command_Frame *frame, void **out);
+
 TSS_API int tssReadHeader(struct TSS_Com_Class *com, const struct TSS_Header_Info *header_info, struct TSS_Header *out);
 TSS_API int tssPeekHeader(struct TSS_Com_Class *com, const struct TSS_Header_Info *header_info, struct TSS_Header *out);
 
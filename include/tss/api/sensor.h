@@ -13,6 +13,8 @@
 #include "tss/api/header.h"
 #include "tss/api/command.h"
 #include "tss/api/core.h"
+#include "tss/constants.h"
+#include "tss/sys/time.h"
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -30,6 +32,78 @@ enum TSS_DataCallbackState {
     TSS_DataCallbackStateProcessed = 1
 };
 
+struct TSS_Stream_Slot {
+    uint8_t cmd_num;
+    uint8_t param;
+    bool has_param;
+};
+
+#if !(TSS_MINIMAL_SENSOR)
+//Number of recently used batch get slot configurations to keep parsed
+#define TSS_BATCH_GET_CACHE_SIZE 4
+//Index used to indicate the user's stream slots are programmed on the sensor
+#define TSS_BATCH_GET_USER_SLOTS 0xFF
+
+//A parsed stream slot configuration and the layout of its streaming batch response
+struct TSS_Stream_Slot_Layout {
+    struct TSS_Stream_Slot slots[TSS_NUM_STREAM_SLOTS];
+    const struct TSS_Command *commands[TSS_NUM_STREAM_SLOTS+1];
+    uint8_t num_slots;
+    uint16_t output_size;
+    uint32_t last_used; //0 if unused
+};
+#endif
+
+#if TSS_INSTRUMENTATION
+//Kinds of packets counted by struct TSS_Sensor_Stats
+enum TSS_Stats_Packet {
+    TSS_STATS_PACKET_COMMAND,           //Command responses, including batch gets
+    TSS_STATS_PACKET_READ_SETTINGS,
+    TSS_STATS_PACKET_WRITE_SETTINGS,
+    TSS_STATS_PACKET_DATA_STREAM,
+    TSS_STATS_PACKET_FILE_STREAM,
+    TSS_STATS_PACKET_LOG_STREAM,
+    TSS_STATS_PACKET_DEBUG_MESSAGE,
+    TSS_STATS_PACKET_COUNT
+};
+
+//Counters of what a sensor has done since it was created or its stats were reset.
+//The minimal sensor does not validate or realign, so only counts packets and callbacks.
+struct TSS_Sensor_Stats {
+    uint64_t packets[TSS_STATS_PACKET_COUNT];
+    uint64_t misaligned_bytes;      //Discarded one at a time while searching for the next valid packet
+    uint32_t checksum_failures;     //Packets whose data did not match the header checksum
+    uint32_t length_failures;       //Headers with a length other than what was expected
+    uint32_t insufficient_buffer;   //Packets too large to validate in the com class, accepted unchecked
+    uint32_t timeouts;              //Waits for a response that ran out of time
+    uint32_t callbacks;             //Calls into the streaming and debug callbacks
+    uint64_t callback_us;           //Total time spent in those callbacks
+};
+
+#include "tss/utility/histogram.h"
+
+//Latencies recorded in microseconds by struct TSS_Sensor_Latency
+enum TSS_Latency {
+    TSS_LATENCY_COMMAND,        //From writing a command to its response being found, including batch gets
+    TSS_LATENCY_AWAIT,          //Every wait for a command response, including those that timed out
+    TSS_LATENCY_STREAM_AGE,     //How old streaming packets are when processed. Requires the timestamp header.
+    TSS_LATENCY_COUNT
+};
+
+struct TSS_Sensor_Latency {
+    struct TSS_Histogram histograms[TSS_LATENCY_COUNT];
+
+    tss_time_t command_start;
+    bool command_pending;
+
+    //The sensor timestamp is mapped onto host time using the smallest difference between
+    //the two seen since streaming started, treating the fastest packet as having no delay.
+    tss_time_t stream_epoch;
+    uint32_t stream_offset;
+    bool stream_offset_valid;
+};
+#endif
+
 typedef struct TSS_Sensor TSS_Sensor;
 typedef enum TSS_DataCallbackState (*TssDataCallback)(TSS_Sensor *sensor);
 
@@ -64,6 +138,7 @@ struct TSS_Sensor {
             TssDataCallback cb;
             uint64_t remaining_len;
             uint16_t remaining_cur_packet_len;
+            uint32_t skipped_bytes; //Discarded to find the current packet, so packets before it may have been lost
             bool active;
         } file;
         struct {
@@ -73,13 +148,29 @@ struct TSS_Sensor {
         } log;
     } streaming;
 
+#if !(TSS_MINIMAL_SENSOR)
+    //Stream slot configurations temporarily programmed by sensorBatchGet
+    struct {
+        struct TSS_Stream_Slot_Layout cache[TSS_BATCH_GET_CACHE_SIZE];
+        struct TSS_Stream_Slot_Layout user; //What the stream slots are outside of batch gets
+        uint8_t programmed; //Index into cache of the slots on the sensor, or TSS_BATCH_GET_USER_SLOTS
+        uint32_t use_count;
+    } batch;
+#endif
+
     //Control/Status Info
     bool _in_bootloader;
     bool dirty; //Unknown setting state. Cached values may be incorrect.
+    uint32_t _resync_bytes; //Discarded since the last valid packet, traced once the next is found
 
     //Cached Data (Either useful for user or required for some functionality)
     uint64_t serial_number;
 
+#if TSS_INSTRUMENTATION
+    struct TSS_Sensor_Stats stats;
+    struct TSS_Sensor_Latency latency;
+#endif
+
     void *user_data;
 };
 
@@ -100,6 +191,19 @@ static inline void sensorMarkSettingsDirty(TSS_Sensor *sensor) {
     sensor->dirty = true;
 }
 
+#if TSS_INSTRUMENTATION
+//----------------------------INSTRUMENTATION--------------------------------------
+/// @brief Copies the current counters of the sensor. See struct TSS_Sensor_Stats.
+/// The counters of the com class are read separately, such as with tssManagedComGetStats.
+TSS_API void sensorGetStats(const TSS_Sensor *sensor, struct TSS_Sensor_Stats *out);
+TSS_API void sensorResetStats(TSS_Sensor *sensor);
+
+/// @brief Copies one of the latency histograms of the sensor. Query it with histogram_percentile.
+/// @param latency Which histogram, see enum TSS_Latency
+TSS_API void sensorGetLatencyHistogram(const TSS_Sensor *sensor, enum TSS_Latency latency, struct TSS_Histogram *out);
+TSS_API void sensorResetLatencyHistograms(TSS_Sensor *sensor);
+#endif
+
 //----------------------------SETTERS--------------------------------------
 static inline void sensorSetDebugCallback(TSS_Sensor *sensor, TssDataCallback callback) {
     sensor->debug.cb = callback;
@@ -152,6 +256,32 @@ TSS_API int sensorLoggingStart(TSS_Sensor *sensor, TssDataCallback cb);
 
 TSS_API int sensorStreamingGetPacketArray(TSS_Sensor *sensor, void **outputs);
 
+#if !(TSS_MINIMAL_SENSOR)
+/// @brief Gets the outputs of several commands in a single round trip by temporarily programming
+/// them into the stream slots and requesting one streaming batch.
+/// The stream slots are only reprogrammed if the sensor's current slots do not already contain
+/// every requested command, and the user's slots are only restored when something needs them
+/// (Starting streaming, getting a streaming packet, committing settings, or reading any setting
+/// directly from the sensor, since queries such as "all" include the stream slots).
+/// @param sensor The sensor object
+/// @param slots The commands to get, in the same format as the stream_slots setting. EX: "0,39,41:1"
+/// @param outputs One pointer per output of each command, in the order the commands are listed
+/// @return TSS_SUCCESS or a negative error code. TSS_ERR_STREAMING_ACTIVE if streaming or logging.
+/// @warning Can not be used while streaming since the stream slots may be modified.
+TSS_API int sensorBatchGet(TSS_Sensor *sensor, const char *slots, void **outputs);
+
+/// @brief Immediately restores the user's stream slots if sensorBatchGet changed them.
+TSS_API int sensorBatchGetRestoreSlots(TSS_Sensor *sensor);
+#endif
+
+/// @brief Sends a frame prebuilt via tssBuildCommandFrame and decodes the response.
+/// Avoids rebuilding the command on every call for commands that are polled repeatedly.
+/// @param sensor The sensor object
+/// @param frame The prebuilt command
+/// @param outputs One pointer per output of the command
+/// @return TSS_SUCCESS or a negative error code
+TSS_API int sensorExecuteCommandFrame(TSS_Sensor *sensor, const struct TSS_Command_Frame *frame, void **outputs);
+
 /// @brief Disconnects and reconnects to the sensor. May
 /// require additional com class functionality (Reenumerate/Auto Detect)
 /// @param sensor The sensor to connect to
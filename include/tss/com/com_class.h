@@ -29,6 +29,12 @@ struct TSS_Com_Class;
 * an error occurs.
 */
 
+//A single buffer used by the optional vectored read/write functions
+struct TSS_Com_Iovec {
+    void *base;
+    size_t len;
+};
+
 struct TSS_Input_Stream {
     /**
      * @brief Reads up to the specified number of bytes.
@@ -51,6 +57,18 @@ struct TSS_Input_Stream {
      */
     int (*read_until)(struct TSS_Com_Class *com, uint8_t value, uint8_t *out, size_t size);
 
+    /**
+     * @brief Optional. Reads up to the total length of all the buffers, filling each buffer completely before moving to the next.
+     * Allows filling multiple buffers, such as both halves of a ring buffer, with a single underlying read.
+     * If NULL, \ref read is called for each buffer instead.
+     * @note This is a blocking call. The timeout set via \ref set_timeout determines how long to attempt to read.
+     * @param com This com object.
+     * @param iov The buffers to read into.
+     * @param iov_count The number of buffers in \p iov
+     * @return The total number of bytes read or negative error code.
+     */
+    int (*read_vectored)(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
+
     //Peek should have a minimum look ahead length of 50. In general, if the available
     //look ahead length is not long enough, accidentally validating corrupt data becomes more likely.
     //For peek sizes, we recommend either 64, 256, 1024, or >=4096.
@@ -154,6 +172,19 @@ struct TSS_Output_Stream {
      */
     int (*write)(struct TSS_Com_Class *com, const uint8_t *bytes, size_t len);
 
+    /**
+     * @brief Optional. Sends the data from each buffer, in order, as if it were one contiguous write.
+     * Allows sending a command built from multiple pieces, such as a start byte, parameters, and checksum,
+     * without first copying them into a single buffer.
+     * If NULL, \ref tss_com_write_vectored falls back to calling \ref write for each buffer.
+     * @note Unlike \ref write, this sends immediately and should not be called between begin_write and end_write.
+     * @param com This com object.
+     * @param iov The buffers to send. The data they point to is not modified.
+     * @param iov_count The number of buffers in \p iov
+     * @return 0 on success, non-zero on error.
+     */
+    int (*write_vectored)(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count);
+
 #if TSS_BUFFERED_WRITES
     /**
      * @brief Perform any initialization required when starting to send data. Such as resetting buffer indices.
@@ -350,4 +381,22 @@ static inline int tss_com_write(struct TSS_Com_Class *com, const uint8_t *bytes,
     return com->api->out.write(com, bytes, len);
 }
 
+static inline int tss_com_write_vectored(struct TSS_Com_Class *com, const struct TSS_Com_Iovec *iov, uint8_t iov_count)
+{
+    int result;
+    uint8_t i;
+
+    if(com->api->out.write_vectored != NULL) {
+        return com->api->out.write_vectored(com, iov, iov_count);
+    }
+
+    result = 0;
+    TSS_COM_BEGIN_WRITE(com);
+    for(i = 0; i < iov_count && result == 0; i++) {
+        result = com->api->out.write(com, (const uint8_t*)iov[i].base, iov[i].len);
+    }
+    TSS_COM_END_WRITE(com);
+    return result;
+}
+
 #endif /* __COM_CLASS_H__ */
\ No newline at end of file
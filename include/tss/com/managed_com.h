@@ -27,6 +27,21 @@
 extern "C" {
 #endif
 
+#if TSS_INSTRUMENTATION
+//Counters of what a managed com class has done since it was created or its stats were reset
+struct TSS_Managed_Com_Stats {
+    uint64_t bytes_filled;          //Read from the child into the peek ring
+    uint32_t fill_reads;            //Child reads issued to fill the ring, usually a system call each
+    uint32_t empty_fill_reads;      //Fill reads that returned nothing
+    uint64_t bytes_read_direct;     //Read from the child straight into the caller's buffer once the ring ran out
+    uint32_t direct_reads;
+    uint64_t bytes_written;         //Passed to the child to send
+    uint32_t writes;                //Child writes issued
+    uint32_t peek_timeouts;         //Peeks with a non-zero timeout that ran out before the requested data arrived
+    size_t peak_ring_occupancy;     //Most bytes ever buffered in the ring at once
+};
+#endif
+
 struct TSS_Managed_Com_Class {
     struct TSS_Com_Class base;
 
@@ -43,6 +58,10 @@ struct TSS_Managed_Com_Class {
     uint8_t *write_buffer;
     size_t write_buffer_size;
     uint16_t write_buffer_index;
+
+#if TSS_INSTRUMENTATION
+    struct TSS_Managed_Com_Stats stats;
+#endif
 };
 
 //TODO: Document me
@@ -55,6 +74,12 @@ TSS_API int tssManagedComBaseReadUntil(struct TSS_Com_Class *com, uint8_t value,
 TSS_API void tssManagedComBaseClear(struct TSS_Com_Class *com);
 TSS_API void tssManagedComBaseClearTimeout(struct TSS_Com_Class *com, uint32_t timeout_ms);
 
+#if TSS_INSTRUMENTATION
+/// @brief Copies the current counters of the managed com class. Kept across reenumeration.
+TSS_API void tssManagedComGetStats(const struct TSS_Managed_Com_Class *com, struct TSS_Managed_Com_Stats *out);
+TSS_API void tssManagedComResetStats(struct TSS_Managed_Com_Class *com);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
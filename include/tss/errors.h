@@ -28,5 +28,9 @@
 #define TSS_ERR_FIRMWARE_UPLOAD -23
 #define TSS_ERR_FIRMWARE_UPLOAD_INVALID_FORMAT -24
 #define TSS_ERR_FIRMWARE_UPLOAD_PROGRAM -25
+#define TSS_ERR_STREAMING_ACTIVE -26
+#define TSS_ERR_FILE -27
+#define TSS_ERR_INVALID_FORMAT -28
+#define TSS_ERR_WRITE -29
 
 #endif /* __TSS_ERRORS_H__ */
\ No newline at end of file
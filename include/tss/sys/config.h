@@ -54,6 +54,15 @@
 //          (These bits are automatically handled, the user is not required to worry about the configuration.)
 #define TSS_MINIMAL_SENSOR 0
 
+//If enabled, sensors and managed com classes count what their hot paths do, such as
+//bytes read, packets parsed, data discarded while realigning and time spent in callbacks.
+//Read with sensorGetStats and tssManagedComGetStats. Off by default since it costs a few
+//additions per packet and grows the structs. Can also be set with the TSS_INSTRUMENTATION
+//CMake option, the API and everything using it must be built with the same value.
+#ifndef TSS_INSTRUMENTATION
+#define TSS_INSTRUMENTATION 0
+#endif
+
 //Types
 #define TSS_ENDIAN_AUTO_DETECT 0
 #define TSS_ENDIAN_RUN_TIME 1
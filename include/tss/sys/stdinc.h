@@ -20,6 +20,8 @@
 size_t strlen(const char *string);
 int strcmp (const char* str1, const char* str2);
 int tolower(int c);
+void *memcpy(void *dest, const void *src, size_t count);
+void *memchr(const void *ptr, int value, size_t count);
 
 #endif
 
@@ -30,11 +30,24 @@ TSS_API tss_time_t tssTimeGet(void);
 TSS_API uint32_t tssTimeDiff(tss_time_t start_time);
 
 
+/// @brief Returns the time difference between the current
+/// system time and the given start time with microsecond resolution.
+/// Used where milliseconds are too coarse, such as timing callbacks.
+/// @param start_time The start time as retrieved by tssTimeGet
+/// @return Time difference in microseconds. Only has millisecond resolution
+/// if custom time functions were set without a microsecond version.
+TSS_API uint64_t tssTimeDiffUs(tss_time_t start_time);
+
 /// @brief Allows setting the time functions used by the API
 /// @param timeGet Returns the current time
 /// @param timeDiff Gets the timer difference between the current time and passed time in milliseconds
 TSS_API void tssTimeSetFunctions(tss_time_t (*timeGet)(void), uint32_t (*timeDiff)(tss_time_t));
 
+/// @brief Allows setting the microsecond time difference function used by the API.
+/// Must be set after tssTimeSetFunctions, which clears it.
+/// @param timeDiffUs Gets the time difference between the current time and passed time in microseconds
+TSS_API void tssTimeSetDiffUsFunction(uint64_t (*timeDiffUs)(tss_time_t));
+
 #ifdef __cplusplus
 }
 #endif
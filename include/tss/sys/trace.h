@@ -0,0 +1,105 @@
+/*
+*   Hooks for tracing protocol events, such as frames being sent and received,
+*   resyncs, errors and retries in the com backends.
+*   Nothing is traced and nothing is printed unless hooks are set.
+*/
+
+#ifndef __TSS_TRACE_H__
+#define __TSS_TRACE_H__
+
+#include "tss/export.h"
+#include "tss/sys/time.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum TSS_Trace_Event_Id {
+    TSS_TRACE_FRAME_SENT,       //A command or settings frame was written. length is the bytes written.
+    TSS_TRACE_FRAME_RECEIVED,   //A response or streaming packet was found. length is its data length, 0 if unknown.
+    TSS_TRACE_RESYNC,           //Data was discarded to realign with the next valid packet. value is the bytes discarded.
+    TSS_TRACE_ERROR,            //value is the error code or errno, message describes it
+    TSS_TRACE_RETRY,            //A backend is retrying an operation, message describes it
+    TSS_TRACE_WARNING,          //Something that may be a mistake, message describes it
+    TSS_TRACE_EVENT_COUNT
+};
+
+struct TSS_Trace_Event {
+    enum TSS_Trace_Event_Id id;
+    const void *source;     //The sensor, com class or backend device the event happened on
+    uint8_t cmd;            //Command number, or the start byte for settings frames
+    uint16_t length;        //Frame length, see the event ids
+    int32_t value;
+    const char *message;    //Static string, never formatted. May be NULL.
+};
+
+typedef void (*TssTraceCallback)(const struct TSS_Trace_Event *event, void *user_data);
+
+//Any callback left NULL is not traced
+struct TSS_Trace_Hooks {
+    TssTraceCallback callbacks[TSS_TRACE_EVENT_COUNT];
+    void *user_data;
+};
+
+/// @brief Sets the hooks called for every traced event. The hooks are copied.
+/// Should be set before using the API, as it is not synchronized with tracing on other threads.
+/// @param hooks The hooks to use, or NULL to stop tracing
+TSS_API void tssTraceSetHooks(const struct TSS_Trace_Hooks *hooks);
+
+/// @brief Traces an event if a hook is set for it. Used by the API and com classes.
+TSS_API void tssTrace(enum TSS_Trace_Event_Id id, const void *source, uint8_t cmd, uint16_t length, int32_t value, const char *message);
+
+//---------------------------------TRACE RING-----------------------------------------
+//Records every event into a fixed size ring in memory, overwriting the oldest once full.
+//Meant to be left running and read after something unexpected happens.
+//
+//The ring is not synchronized, so it is single threaded only. Every traced sensor and com class
+//must be used from the same thread, and the ring read from that thread too. When tracing from
+//several threads, wrap the ring's hooks in hooks that hold a lock around each call, or use a sink
+//of your own.
+
+//Compact binary form of an event. The source and message are not kept.
+struct TSS_Trace_Record {
+    uint64_t time_us;   //Since the ring was created
+    int32_t value;
+    uint16_t length;
+    uint8_t id;         //enum TSS_Trace_Event_Id
+    uint8_t cmd;
+};
+
+struct TSS_Trace_Ring {
+    struct TSS_Trace_Record *records;
+    size_t capacity; //This MUST be a power of 2
+    size_t w_index;
+    tss_time_t start_time;
+};
+
+/// @brief Initialises a trace ring over the given records
+/// @param records Storage for the records. Must outlive the ring.
+/// @param capacity Number of records, must be a power of 2
+/// @return TSS_SUCCESS or TSS_ERR_INVALID_SIZE if capacity is not a power of 2
+TSS_API int tssTraceRingCreate(struct TSS_Trace_Ring *ring, struct TSS_Trace_Record *records, size_t capacity);
+
+/// @brief Fills the hooks so that every event is recorded into the ring. Only for events from a single thread.
+TSS_API void tssTraceRingHooks(struct TSS_Trace_Ring *ring, struct TSS_Trace_Hooks *out);
+
+/// @brief Copies the newest records in the ring, oldest first
+/// @return Number of records copied
+TSS_API size_t tssTraceRingRead(const struct TSS_Trace_Ring *ring, struct TSS_Trace_Record *out, size_t max);
+
+/// @return Number of records lost to the ring being full
+static inline uint64_t tssTraceRingDropped(const struct TSS_Trace_Ring *ring) {
+    return (ring->w_index > ring->capacity) ? ring->w_index - ring->capacity : 0;
+}
+
+static inline void tssTraceRingClear(struct TSS_Trace_Ring *ring) {
+    ring->w_index = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TSS_TRACE_H__ */
@@ -0,0 +1,184 @@
+#ifndef __TSS_LOG_PARSER_H__
+#define __TSS_LOG_PARSER_H__
+
+/*
+*   Parses log files written to the sensor's SD card as they are retrieved with file streaming,
+*   and builds an index of where each timestamp is in the file along the way. Once retrieved,
+*   any part of a large log can be decoded by seeking to an index entry, without a second pass.
+*
+*   The format of a log is given by the logging settings it was written with:
+*       log_slots           The commands output in each record, decoded the same as stream slots
+*       log_data_mode       Binary records of the header and each output, or one line of comma separated ASCII values each
+*       log_header_enabled  Each record starts with the header set by the header setting
+*       log_output_settings The log starts with one line of the sensor's settings, which is skipped
+*
+*   Timestamps in the header are 32 bit microseconds, so they are unwrapped into 64 bits assuming
+*   no gap between records is longer than the wrap period.
+*   Binary records have no delimiters, so they are located only by their fixed size from the start of
+*   the log. The header checksum and length are not verified and there is no resync, so the log must be
+*   fed without gaps or corruption. A lost or extra byte misaligns every record after it.
+*   ASCII records are resynced at the next line, and lines that can't be parsed are counted as malformed.
+*   Nothing is allocated, the index is stored in a buffer given by the caller. When it fills, every other
+*   entry is dropped and entries are added half as often, so any length of log is indexed in bounded memory.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "tss/export.h"
+#include "tss/api/sensor.h"
+
+//Longest ASCII record line. Binary records are at most the header plus TSS_LOG_STREAMING_MAX_PACKET_SIZE.
+#define TSS_LOG_MAX_RECORD_LEN (TSS_HEADER_MAX_SIZE + TSS_LOG_STREAMING_MAX_PACKET_SIZE)
+
+#define TSS_LOG_MAX_FIELDS 64
+
+//Returned by tssLogParserFeedFileStreaming when the record callback stopped parsing
+#define TSS_LOG_PARSER_STOPPED 1
+
+struct TSS_Log_Format {
+    uint8_t data_mode;          //TSS_LOG_DATA_MODE_BINARY or TSS_LOG_DATA_MODE_ASCII
+    bool settings_preamble;
+    struct TSS_Header_Info header; //Size 0 if log_header_enabled is off
+
+    const struct TSS_Command *commands[TSS_NUM_STREAM_SLOTS+1];
+    const struct TSS_Param *fields[TSS_LOG_MAX_FIELDS];
+    uint8_t num_fields;
+    uint16_t data_size;         //Of the outputs of a binary record, not including the header
+};
+
+//A parsed record. Only valid during the record callback.
+struct TSS_Log_Record {
+    uint64_t index;
+    uint64_t offset;            //Of the start of the record in the log file
+    struct TSS_Header header;   //Only the fields enabled in the format are set
+    uint64_t timestamp;         //Unwrapped header timestamp, if the format has timestamps
+    const uint8_t *data;        //The outputs in binary, or the line in ASCII without the header values
+    uint16_t len;
+};
+
+//Where a record starts in the log. Decoding can resume from any entry with tssLogParserSeek.
+struct TSS_Log_Index_Entry {
+    uint64_t record;
+    uint64_t offset;
+    uint64_t timestamp;
+};
+
+struct TSS_Log_Parser;
+
+/**
+ * @brief Called for every record parsed.
+ * @return 0 to continue, non-zero to stop parsing and return that value from tssLogParserFeed.
+ */
+typedef int (*TssLogRecordCallback)(struct TSS_Log_Parser *parser, const struct TSS_Log_Record *record);
+
+struct TSS_Log_Parser {
+    struct TSS_Log_Format format;
+
+    TssLogRecordCallback cb; //May be NULL to only build the index
+    void *user_data;
+
+    //Holds a record split across fed chunks
+    uint8_t pending[TSS_LOG_MAX_RECORD_LEN];
+    uint16_t pending_len;
+    bool discarding_line;   //Skipping the rest of an ASCII line that was too long
+    bool in_preamble;
+
+    uint64_t offset;        //Into the log file of the next byte fed
+    int stop_result;        //Value the record callback last stopped parsing with
+    uint64_t records;
+    uint32_t malformed_records; //ASCII lines that could not be parsed, skipped and not counted as records
+
+    uint32_t last_timestamp;
+    uint64_t timestamp_high;
+    bool have_timestamp;
+
+    struct TSS_Log_Index_Entry *index;
+    size_t index_capacity;
+    size_t index_count;
+    uint64_t index_interval; //Records between index entries
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Builds a log format from the values of the logging settings.
+ * @param log_slots The log_slots setting. EX: "0,39"
+ * @param data_mode The log_data_mode setting
+ * @param header_bitfield The header setting if log_header_enabled was set, otherwise 0
+ * @param output_settings The log_output_settings setting
+ * @return TSS_SUCCESS, TSS_ERR_INVALID_FORMAT if the slots or data mode are not valid,
+ * or TSS_ERR_INVALID_SIZE if a slot outputs a string or there are more than TSS_LOG_MAX_FIELDS fields.
+ */
+TSS_API int tssLogFormatCreate(struct TSS_Log_Format *out, const char *log_slots, uint8_t data_mode, uint8_t header_bitfield, bool output_settings);
+
+/**
+ * @brief Builds a log format from the sensor's current logging settings.
+ * @note The header of logged records is the header setting of the sensor, so this is only correct for
+ * logs written since the header was last changed. The API may change the header while initializing.
+ */
+TSS_API int tssLogFormatFromSensor(TSS_Sensor *sensor, struct TSS_Log_Format *out);
+
+/**
+ * @brief Initialises a parser at the start of a log.
+ * @param index Storage for the index. May be NULL with a capacity of 0 to not index.
+ * @param index_interval Records between index entries to start with, grows as the index fills. 0 is treated as 1.
+ */
+TSS_API void tssLogParserCreate(struct TSS_Log_Parser *parser, const struct TSS_Log_Format *format,
+    TssLogRecordCallback cb, void *user_data,
+    struct TSS_Log_Index_Entry *index, size_t index_capacity, uint64_t index_interval);
+
+/**
+ * @brief Parses the next bytes of the log.
+ * @return 0 once all bytes are parsed, or the non-zero value returned by the record callback, which is
+ * also kept in parser->stop_result. When stopped by the callback, the bytes after that record are not
+ * parsed, and parser->offset is the position in the log of the first of them. Feed them again to continue where it stopped.
+ */
+TSS_API int tssLogParserFeed(struct TSS_Log_Parser *parser, const uint8_t *data, size_t len);
+
+/**
+ * @brief Reads the current file streaming packet and parses it. Call from the file streaming callback
+ * in place of sensorProcessFileStreamingCallbackOutput.
+ * @param out Receives the raw bytes of the packet, such as to save them to a file.
+ * Should be at least TSS_FILE_STREAMING_MAX_PACKET_SIZE.
+ * @param out_len Receives the number of bytes read into out, even if parsing stopped part way.
+ * @return 0 once the whole packet is parsed, a negative error code if it could not be read, or
+ * TSS_LOG_PARSER_STOPPED if the record callback stopped parsing. The value the callback returned is then
+ * in parser->stop_result, and as with tssLogParserFeed, the rest of the packet is not parsed and starts
+ * at parser->offset in the log.
+ */
+TSS_API int tssLogParserFeedFileStreaming(struct TSS_Log_Parser *parser, TSS_Sensor *sensor, uint8_t *out, uint16_t size, uint16_t *out_len);
+
+/**
+ * @brief Decodes the outputs of a record, one output per field, the same as sensorProcessDataStreamingCallbackOutputArray.
+ * @return TSS_SUCCESS or TSS_ERR_INVALID_FORMAT if an ASCII record does not contain the expected values.
+ * ASCII records can only be decoded when built with TSS_INCLUDE_PARAM_TYPE and TSS_STDC_AVAILABLE.
+ */
+TSS_API int tssLogRecordRead(const struct TSS_Log_Parser *parser, const struct TSS_Log_Record *record, void **outputs);
+
+/**
+ * @brief Finds the last index entry at or before the timestamp, or the first entry if there is none.
+ * @return The entry, or NULL if the index is empty.
+ */
+TSS_API const struct TSS_Log_Index_Entry* tssLogIndexFindTime(const struct TSS_Log_Parser *parser, uint64_t timestamp);
+
+/**
+ * @brief Finds the last index entry at or before the record.
+ * @return The entry, or NULL if the index is empty.
+ */
+TSS_API const struct TSS_Log_Index_Entry* tssLogIndexFindRecord(const struct TSS_Log_Parser *parser, uint64_t record);
+
+/**
+ * @brief Moves the parser to an index entry, so bytes fed next are expected to start at entry->offset in the log.
+ * The index is kept, but not added to until parsing passes its last entry again.
+ */
+TSS_API void tssLogParserSeek(struct TSS_Log_Parser *parser, const struct TSS_Log_Index_Entry *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TSS_LOG_PARSER_H__ */
@@ -0,0 +1,114 @@
+#ifndef __TSS_OFFLOAD_H__
+#define __TSS_OFFLOAD_H__
+
+/*
+*   Copies files off the SD cards of many sensors at once.
+*
+*   File streaming is started on every sensor together, and each is polled in turn from the
+*   calling thread, so the total time is that of the slowest sensor instead of the sum of all of them.
+*   Received data is gathered into a fixed pool of buffers, which are written to disk asynchronously
+*   with io_uring where the kernel supports it, or a small pool of threads calling pwrite otherwise.
+*   Memory use is bounded by the pool regardless of file size or number of sensors. When every buffer
+*   is waiting on the disk, polling pauses until one is written, leaving the data with the sensors.
+*
+*   Every packet is checked against the remaining length the sensor reported when streaming started.
+*   If a sensor stops sending, it is reconnected and streaming resumes from the last byte received.
+*   If data was lost, such as a corrupt packet being skipped, streaming resumes from before it.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "tss/export.h"
+#include "tss/api/sensor.h"
+
+#define TSS_OFFLOAD_DEFAULT_BUFFER_SIZE 65536
+#define TSS_OFFLOAD_DEFAULT_NUM_BUFFERS 64
+#define TSS_OFFLOAD_DEFAULT_NUM_THREADS 4
+#define TSS_OFFLOAD_DEFAULT_STALL_TIMEOUT_MS 2000
+#define TSS_OFFLOAD_DEFAULT_RECONNECT_TIMEOUT_MS 5000
+#define TSS_OFFLOAD_DEFAULT_MAX_RESUMES 10
+
+struct TSS_Offload_Config {
+    //Size of each buffer, at least TSS_FILE_STREAMING_MAX_PACKET_SIZE. Each write to disk is at most this.
+    size_t buffer_size;
+    //Should be at least twice the number of jobs, so every sensor can fill one while another is written
+    uint32_t num_buffers;
+
+    //Write with the thread pool even if io_uring is available
+    bool force_thread_pool;
+    uint32_t num_threads;
+
+    //How long a sensor can send nothing before it is reconnected
+    uint32_t stall_timeout_ms;
+    uint32_t reconnect_timeout_ms;
+    //Times a job may resume streaming, after reconnecting or losing data, before it fails
+    uint32_t max_resumes;
+};
+
+struct TSS_Offload_Buffer;
+
+struct TSS_Offload_Job {
+    TSS_Sensor *sensor;
+    const char *sensor_path; //Of the file on the SD card
+    const char *out_path;
+
+    //TSS_SUCCESS once the whole file is written, otherwise why it stopped.
+    //A failed job leaves everything written so far in the output file.
+    int result;
+    uint64_t size;          //Of the file, as reported when streaming first started
+    uint64_t received;
+    uint64_t written;
+    uint32_t resumes;
+    uint32_t reconnects;
+
+    //Internal state
+    uint8_t _state;
+    int _fd;
+    bool _file_open;        //The sensor file is open on the sensor
+    struct TSS_Offload_Buffer *_buffer; //Being filled
+    uint32_t _writes_in_flight;
+    tss_time_t _last_progress;
+    bool _data_lost;        //Part of the stream was lost, must resume before it
+    int _read_result;
+    void *_sensor_user_data;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fills in the defaults for every option.
+ */
+TSS_API void tssOffloadConfigDefault(struct TSS_Offload_Config *config);
+
+/**
+ * @brief Initialises a job to copy the file at sensor_path on the sensor's SD card to out_path,
+ * replacing it if it exists. Both paths must outlive the job.
+ */
+TSS_API void tssOffloadJobCreate(struct TSS_Offload_Job *job, TSS_Sensor *sensor, const char *sensor_path, const char *out_path);
+
+/**
+ * @brief Runs every job until each has finished or failed.
+ * The sensors must be initialized, not streaming, and each used by only one job.
+ * The user_data of each sensor is used while running and restored after.
+ * @param config NULL for the defaults.
+ * @return TSS_SUCCESS if every file was offloaded, or the result of the first job that failed.
+ * TSS_ERR_INSUFFICIENT_BUFFER if the buffers are too small or could not be allocated,
+ * or TSS_ERR_FILE if the thread pool could not be started, in which case no job was started.
+ */
+TSS_API int tssOffloadRun(struct TSS_Offload_Job *jobs, uint32_t num_jobs, const struct TSS_Offload_Config *config);
+
+/**
+ * @brief Whether tssOffloadRun will write with io_uring instead of the thread pool.
+ * False if built without it, or the kernel does not support it.
+ */
+TSS_API bool tssOffloadIoUringAvailable(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TSS_OFFLOAD_H__ */
@@ -0,0 +1,190 @@
+#ifndef __TSS_RECORDING_H__
+#define __TSS_RECORDING_H__
+
+/*
+*   Records decoded streaming packets into a compact binary file, and reads them back.
+*
+*   The file starts with a header describing the stream slots and the type, count and size
+*   of every field in a packet, so it can be read without knowing how it was recorded.
+*   Every packet is stored as a fixed size record of the host time, the sensor timestamp and
+*   the decoded fields, packed in slot order. Records are written in chunks, each with a small
+*   header giving the number of records and their time range. A recording is only ever appended
+*   to, so one cut short by a crash can still be read up to its last complete chunk.
+*
+*   The reader memory maps the file and finds records by index or time without reading them all.
+*   Values are stored in the byte order of the recording host and are not aligned, so they
+*   should be copied out, such as with tssRecordingReaderRead.
+*/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "tss/export.h"
+#include "tss/api/sensor.h"
+
+#define TSS_RECORDING_MAGIC "TSSREC"
+#define TSS_RECORDING_MAGIC_LEN 6
+#define TSS_RECORDING_VERSION 1
+
+#define TSS_RECORDING_MAX_FIELDS 64
+
+//File header before the slot and field descriptions
+#define TSS_RECORDING_HEADER_SIZE 36
+#define TSS_RECORDING_CHUNK_HEADER_SIZE 24
+#define TSS_RECORDING_CHUNK_MAGIC 0x4B435354u //"TSCK" when little endian
+
+//Every record starts with the uint64_t host time in microseconds and the uint32_t sensor timestamp
+#define TSS_RECORDING_RECORD_HEADER_SIZE 12
+
+//The sensor timestamp of each record is valid. Otherwise it is 0.
+#define TSS_RECORDING_FLAG_SENSOR_TIMESTAMP 0x01
+
+struct TSS_Recording_Slot {
+    uint8_t cmd_num;
+    uint8_t param;
+    bool has_param;
+    uint8_t num_fields; //Fields of the slot's command output, which follow those of the previous slot
+};
+
+struct TSS_Recording_Field {
+    uint8_t type;   //enum TSS_ParamType, TSS_ParamTypeBlob if built without TSS_INCLUDE_PARAM_TYPE
+    uint8_t count;
+    uint16_t size;  //Of each value, so the field is count * size bytes
+};
+
+//Everything the file header describes
+struct TSS_Recording_Info {
+    uint64_t serial_number;
+    int64_t start_unix_time;    //Seconds since the epoch when recording started
+    uint8_t flags;
+    uint8_t num_slots;
+    uint8_t num_fields;
+    uint16_t data_size;         //Size of all the fields of a packet
+    uint16_t record_size;       //TSS_RECORDING_RECORD_HEADER_SIZE + data_size
+    struct TSS_Recording_Slot slots[TSS_NUM_STREAM_SLOTS];
+    struct TSS_Recording_Field fields[TSS_RECORDING_MAX_FIELDS];
+    uint16_t field_offsets[TSS_RECORDING_MAX_FIELDS]; //From the start of the data
+};
+
+struct TSS_Recorder {
+    TSS_Sensor *sensor;
+    FILE *file;
+    struct TSS_Recording_Info info;
+
+    //Holds the chunk being filled
+    uint8_t *buffer;
+    size_t buffer_size;
+    uint32_t chunk_capacity;
+    uint32_t chunk_records;
+    uint64_t chunk_first_us;
+
+    void *outputs[TSS_RECORDING_MAX_FIELDS];
+    tss_time_t start_time;
+    uint64_t last_us;
+
+    uint64_t records;
+    uint32_t chunks;
+
+    //Writing a chunk failed. Nothing more is written, so the file ends at the last complete chunk.
+    bool write_failed;
+};
+
+struct TSS_Recording_Chunk {
+    size_t offset;          //Of the first record in the file
+    uint64_t first_record;  //Index of the first record in the recording
+    uint32_t num_records;
+    uint64_t first_us;
+    uint64_t last_us;
+};
+
+struct TSS_Recording_Reader {
+    const uint8_t *data;
+    size_t size;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#endif
+
+    struct TSS_Recording_Info info;
+
+    struct TSS_Recording_Chunk *chunks;
+    size_t num_chunks;
+    uint64_t num_records;
+
+    //The file ended part way through a chunk, which was ignored
+    bool truncated;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Creates the recording file and writes the header describing the sensor's current stream slots.
+ * The stream slots must be set before opening and not changed while recording.
+ * @param buffer Holds each chunk before it is written. The number of records in a chunk is as many as fit,
+ * so a larger buffer means fewer, larger writes. Must outlive the recorder.
+ * @return TSS_SUCCESS,
+ * TSS_ERR_INVALID_SIZE if a stream slot outputs a string or there are more than TSS_RECORDING_MAX_FIELDS fields,
+ * TSS_ERR_INSUFFICIENT_BUFFER if the buffer can not hold a chunk of at least one record,
+ * TSS_ERR_FILE if the file could not be created,
+ * or an error from updating the cached settings.
+ */
+TSS_API int tssRecorderOpen(struct TSS_Recorder *recorder, TSS_Sensor *sensor, const char *path, uint8_t *buffer, size_t buffer_size);
+
+/**
+ * @brief Decodes the current streaming packet straight into the recording. Call from the data streaming
+ * callback in place of sensorProcessDataStreamingCallbackOutput.
+ * @return TSS_SUCCESS, TSS_ERR_INVALID_SIZE if the stream slots changed since opening and the packet was not
+ * read, TSS_ERR_FILE if writing a full chunk failed now or before, or an error from reading the packet.
+ */
+TSS_API int tssRecorderRecordPacket(struct TSS_Recorder *recorder);
+
+/**
+ * @brief Writes the records in the current chunk to the file, even if it is not full.
+ * @return TSS_SUCCESS or TSS_ERR_FILE if the write failed. After a failed write the recorder stops writing
+ * and every later call fails, keeping the records of the failed chunk in the buffer.
+ */
+TSS_API int tssRecorderFlush(struct TSS_Recorder *recorder);
+
+/**
+ * @brief Flushes and closes the file.
+ */
+TSS_API int tssRecorderClose(struct TSS_Recorder *recorder);
+
+/**
+ * @brief Memory maps a recording and indexes its chunks.
+ * @return TSS_SUCCESS, TSS_ERR_FILE if it could not be opened or mapped,
+ * or TSS_ERR_INVALID_FORMAT if it is not a recording this version can read.
+ */
+TSS_API int tssRecordingReaderOpen(struct TSS_Recording_Reader *reader, const char *path);
+TSS_API void tssRecordingReaderClose(struct TSS_Recording_Reader *reader);
+
+/**
+ * @brief Gets a record by its index in the recording.
+ * @return The start of the record in the mapped file, or NULL if out of range.
+ */
+TSS_API const uint8_t* tssRecordingReaderRecord(const struct TSS_Recording_Reader *reader, uint64_t index);
+
+/**
+ * @brief Finds the first record at or after the given time since recording started.
+ * @return Its index, or the number of records if every record is earlier.
+ */
+TSS_API uint64_t tssRecordingReaderFind(const struct TSS_Recording_Reader *reader, uint64_t time_us);
+
+/**
+ * @brief Copies a record out in the same way sensorProcessDataStreamingCallbackOutputArray reads a packet,
+ * one output per field.
+ * @param time_us Output for the host time of the record. May be NULL.
+ * @param sensor_timestamp Output for the sensor timestamp of the record. May be NULL.
+ * @return TSS_SUCCESS or TSS_ERR_INVALID_SIZE if the index is out of range.
+ */
+TSS_API int tssRecordingReaderRead(const struct TSS_Recording_Reader *reader, uint64_t index, uint64_t *time_us, uint32_t *sensor_timestamp, void **outputs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TSS_RECORDING_H__ */
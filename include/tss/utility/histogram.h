@@ -0,0 +1,107 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+*   Log bucketed histogram for latencies, in the style of HDR histograms.
+*   Values below TSS_HISTOGRAM_LINEAR_MAX each have their own bucket. Above that every power of 2 is split
+*   into TSS_HISTOGRAM_SUB_BUCKETS buckets, so a value is never off by more than 1/TSS_HISTOGRAM_SUB_BUCKETS.
+*   Recording is constant time and the size is fixed, so it is safe to use on hot paths.
+*/
+
+//Sub buckets per power of 2 is 2^TSS_HISTOGRAM_SUB_BUCKET_BITS
+#define TSS_HISTOGRAM_SUB_BUCKET_BITS 3
+#define TSS_HISTOGRAM_SUB_BUCKETS (1u << TSS_HISTOGRAM_SUB_BUCKET_BITS)
+#define TSS_HISTOGRAM_LINEAR_MAX (TSS_HISTOGRAM_SUB_BUCKETS * 2)
+
+//Covers every uint32_t value
+#define TSS_HISTOGRAM_BUCKETS (TSS_HISTOGRAM_LINEAR_MAX + (32 - TSS_HISTOGRAM_SUB_BUCKET_BITS - 1) * TSS_HISTOGRAM_SUB_BUCKETS)
+
+struct TSS_Histogram {
+    uint32_t counts[TSS_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint32_t min; //Only valid if count > 0
+    uint32_t max;
+};
+
+inline static void histogram_reset(struct TSS_Histogram *histogram) {
+    *histogram = (struct TSS_Histogram) {0};
+}
+
+//Index of the highest set bit, value must not be 0
+inline static uint32_t histogram_log2(uint32_t value) {
+    uint32_t result = 0;
+    if(value >= 1u << 16) { value >>= 16; result += 16; }
+    if(value >= 1u << 8) { value >>= 8; result += 8; }
+    if(value >= 1u << 4) { value >>= 4; result += 4; }
+    if(value >= 1u << 2) { value >>= 2; result += 2; }
+    if(value >= 1u << 1) { result += 1; }
+    return result;
+}
+
+inline static size_t histogram_bucket(uint32_t value) {
+    uint32_t exponent, sub_bucket;
+    if(value < TSS_HISTOGRAM_LINEAR_MAX) return value;
+    exponent = histogram_log2(value);
+    sub_bucket = (value >> (exponent - TSS_HISTOGRAM_SUB_BUCKET_BITS)) & (TSS_HISTOGRAM_SUB_BUCKETS - 1);
+    return TSS_HISTOGRAM_LINEAR_MAX + (exponent - TSS_HISTOGRAM_SUB_BUCKET_BITS - 1) * TSS_HISTOGRAM_SUB_BUCKETS + sub_bucket;
+}
+
+//The smallest value that is counted in the given bucket
+inline static uint32_t histogram_bucket_lowest(size_t bucket) {
+    uint32_t exponent, sub_bucket;
+    if(bucket < TSS_HISTOGRAM_LINEAR_MAX) return (uint32_t)bucket;
+    bucket -= TSS_HISTOGRAM_LINEAR_MAX;
+    exponent = (uint32_t)(bucket / TSS_HISTOGRAM_SUB_BUCKETS) + TSS_HISTOGRAM_SUB_BUCKET_BITS + 1;
+    sub_bucket = (uint32_t)(bucket % TSS_HISTOGRAM_SUB_BUCKETS);
+    return (TSS_HISTOGRAM_SUB_BUCKETS + sub_bucket) << (exponent - TSS_HISTOGRAM_SUB_BUCKET_BITS);
+}
+
+//The largest value that is counted in the given bucket
+inline static uint32_t histogram_bucket_highest(size_t bucket) {
+    if(bucket + 1 >= TSS_HISTOGRAM_BUCKETS) return UINT32_MAX;
+    return histogram_bucket_lowest(bucket + 1) - 1;
+}
+
+inline static void histogram_record(struct TSS_Histogram *histogram, uint64_t value) {
+    uint32_t clamped = (value > UINT32_MAX) ? UINT32_MAX : (uint32_t)value;
+    histogram->counts[histogram_bucket(clamped)]++;
+    if(histogram->count == 0 || clamped < histogram->min) histogram->min = clamped;
+    if(clamped > histogram->max) histogram->max = clamped;
+    histogram->count++;
+    histogram->sum += clamped;
+}
+
+inline static double histogram_mean(const struct TSS_Histogram *histogram) {
+    if(histogram->count == 0) return 0.0;
+    return (double)histogram->sum / (double)histogram->count;
+}
+
+//Returns the value the given percent (0-100) of recorded values are at or below.
+//This is the highest value of the bucket it falls in, but never more than the max recorded.
+inline static uint32_t histogram_percentile(const struct TSS_Histogram *histogram, double percentile) {
+    double exact;
+    uint64_t target, seen = 0;
+    uint32_t value;
+    size_t i;
+
+    if(histogram->count == 0) return 0;
+    if(percentile >= 100.0) return histogram->max;
+    exact = percentile / 100.0 * (double)histogram->count;
+    target = (uint64_t)exact;
+    if((double)target < exact) target++;
+    if(target < 1) target = 1;
+    if(target > histogram->count) target = histogram->count;
+
+    for(i = 0; i < TSS_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if(seen >= target) break;
+    }
+    value = histogram_bucket_highest(i);
+    return (value > histogram->max) ? histogram->max : value;
+}
+
+#endif
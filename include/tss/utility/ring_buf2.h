@@ -51,6 +51,22 @@ inline static void ring_advance(struct TSS_Ring_Buf2 *ring, size_t count) {
     ring->r_index += count;
 }
 
+//Free space that can be written directly, from the write index up to either the end of the buffer
+//or the read index. Returns where it starts and sets len to its size.
+inline static uint8_t* ring_write_span(const struct TSS_Ring_Buf2 *ring, size_t *len) {
+    size_t start = ring_index(ring, ring->w_index);
+    *len = ring->capacity - start;
+    if(*len > ring_space(ring)) {
+        *len = ring_space(ring);
+    }
+    return ring->data + start;
+}
+
+//Adds count bytes that were written directly after the write index, such as into ring_write_span
+inline static void ring_commit(struct TSS_Ring_Buf2 *ring, size_t count) {
+    ring->w_index += count;
+}
+
 inline static void ring_clear(struct TSS_Ring_Buf2 *ring)
 {
     ring_advance(ring, ring_size(ring));